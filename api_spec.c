@@ -0,0 +1,196 @@
+#include "api_spec.h"
+
+#include <string.h>
+
+void api_spec_init(ApiSpec* spec) {
+    memset(spec, 0, sizeof(ApiSpec));
+    arena_init(&spec->arena);
+}
+
+void api_spec_reset(ApiSpec* spec) {
+    arena_reset(&spec->arena);
+    memset(spec, 0, sizeof(ApiSpec));
+}
+
+ResourceInfo* api_spec_add_resources(ApiSpec* spec, int count) {
+    ResourceList* list = &spec->resources;
+    if (count <= 0) return list->items + list->count;
+
+    if (list->count + count > list->capacity) {
+        int capacity = list->capacity ? list->capacity : 8;
+        while (capacity < list->count + count) capacity *= 2;
+
+        ResourceInfo* items = arena_calloc(&spec->arena, capacity, sizeof(ResourceInfo));
+        if (!items) return NULL;
+        if (list->count > 0) memcpy(items, list->items, list->count * sizeof(ResourceInfo));
+        list->items = items;
+        list->capacity = capacity;
+    }
+
+    ResourceInfo* first = &list->items[list->count];
+    memset(first, 0, count * sizeof(ResourceInfo));
+    list->count += count;
+    return first;
+}
+
+int api_spec_find_resource(const ApiSpec* spec, const char* path) {
+    int low = 0;
+    int high = spec->resources.count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        const char* candidate = spec->resources.items[mid].source_path;
+        int cmp = strcmp(candidate ? candidate : "", path);
+        if (cmp == 0) return mid;
+        if (cmp < 0) low = mid + 1;
+        else high = mid;
+    }
+    return -low - 1;
+}
+
+ResourceInfo* api_spec_insert_resource(ApiSpec* spec, int index) {
+    ResourceList* list = &spec->resources;
+    if (index < 0 || index > list->count) return NULL;
+    if (!api_spec_add_resources(spec, 1)) return NULL;
+
+    memmove(&list->items[index + 1], &list->items[index], (list->count - 1 - index) * sizeof(ResourceInfo));
+    memset(&list->items[index], 0, sizeof(ResourceInfo));
+    return &list->items[index];
+}
+
+void api_spec_remove_resource(ApiSpec* spec, int index) {
+    ResourceList* list = &spec->resources;
+    if (index < 0 || index >= list->count) return;
+    memmove(&list->items[index], &list->items[index + 1], (list->count - 1 - index) * sizeof(ResourceInfo));
+    list->count--;
+}
+
+static const char* copy_string(Arena* arena, const char* str) {
+    return str ? arena_intern_cstr(arena, str) : NULL;
+}
+
+// Copies list->items into `arena`, each string through copy_string
+static int copy_strings(Arena* arena, StringList* list) {
+    StringList copy = { 0 };
+    for (int i = 0; i < list->count; i++) {
+        const char** slot = ARENA_PUSH(arena, copy);
+        if (!slot) return -1;
+        *slot = copy_string(arena, list->items[i]);
+    }
+    *list = copy;
+    return 0;
+}
+
+// Moves an arena-backed array of `count` items into `arena` as is
+static int copy_items(Arena* arena, void** items, int* count, int* capacity, size_t item_size) {
+    void* copy = NULL;
+    if (*count > 0) {
+        copy = arena_alloc(arena, *count * item_size);
+        if (!copy) return -1;
+        memcpy(copy, *items, *count * item_size);
+    }
+    *items = copy;
+    *capacity = *count;
+    return 0;
+}
+
+// Copies resolved declarations, which may be shared by several resources,
+// into `arena` for one of them
+static const ResourceSets* copy_sets(Arena* arena, const ResourceSets* sets) {
+    ResourceSets* copy = arena_alloc(arena, sizeof(ResourceSets));
+    if (!copy) return NULL;
+    *copy = *sets;
+    copy->paginator = copy_string(arena, sets->paginator);
+    if (copy_items(arena, (void**)&copy->attributes.items, &copy->attributes.count, &copy->attributes.capacity,
+                   sizeof(Symbol)) != 0 ||
+        copy_items(arena, (void**)&copy->creatable_fields.items, &copy->creatable_fields.count,
+                   &copy->creatable_fields.capacity, sizeof(Symbol)) != 0 ||
+        copy_items(arena, (void**)&copy->updatable_fields.items, &copy->updatable_fields.count,
+                   &copy->updatable_fields.capacity, sizeof(Symbol)) != 0 ||
+        copy_items(arena, (void**)&copy->filters.items, &copy->filters.count, &copy->filters.capacity,
+                   sizeof(Filter)) != 0 ||
+        copy_items(arena, (void**)&copy->relations.items, &copy->relations.count, &copy->relations.capacity,
+                   sizeof(Relation)) != 0) {
+        return NULL;
+    }
+    return copy;
+}
+
+static int copy_resource(Arena* arena, ResourceInfo* resource, int keep_resolved) {
+    resource->source_path = copy_string(arena, resource->source_path);
+    resource->class_name = copy_string(arena, resource->class_name);
+    resource->declared_name = copy_string(arena, resource->declared_name);
+    resource->model_name = copy_string(arena, resource->model_name);
+    resource->create_form = copy_string(arena, resource->create_form);
+    resource->paginator = copy_string(arena, resource->paginator);
+    resource->default_sort_field = copy_string(arena, resource->default_sort_field);
+    resource->default_sort_direction = copy_string(arena, resource->default_sort_direction);
+    resource->superclass = copy_string(arena, resource->superclass);
+    const ResourceSets* resolved = keep_resolved ? resource->resolved : NULL;
+    resource->resolved = resolved ? copy_sets(arena, resolved) : NULL;
+    if (resolved && !resource->resolved) return -1;
+    if (copy_strings(arena, &resource->includes) != 0) return -1;
+    // Symbols stay valid, so the symbol lists are copied as they are
+    if (copy_items(arena, (void**)&resource->attributes.items, &resource->attributes.count,
+                   &resource->attributes.capacity, sizeof(Symbol)) != 0 ||
+        copy_items(arena, (void**)&resource->creatable_fields.items, &resource->creatable_fields.count,
+                   &resource->creatable_fields.capacity, sizeof(Symbol)) != 0 ||
+        copy_items(arena, (void**)&resource->updatable_fields.items, &resource->updatable_fields.count,
+                   &resource->updatable_fields.capacity, sizeof(Symbol)) != 0 ||
+        copy_items(arena, (void**)&resource->filters.items, &resource->filters.count, &resource->filters.capacity,
+                   sizeof(Filter)) != 0 ||
+        copy_items(arena, (void**)&resource->relations.items, &resource->relations.count,
+                   &resource->relations.capacity, sizeof(Relation)) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int copy_spec(const ApiSpec* spec, ApiSpec* copy, int keep_resolved) {
+    api_spec_init(copy);
+
+    for (int i = 0; i < spec->routes.count; i++) {
+        const RouteInfo* route = &spec->routes.items[i];
+        RouteInfo* slot = ARENA_PUSH(&copy->arena, copy->routes);
+        if (!slot) goto failed;
+        slot->path = copy_string(&copy->arena, route->path);
+        slot->controller = copy_string(&copy->arena, route->controller);
+        slot->action = copy_string(&copy->arena, route->action);
+        slot->method = copy_string(&copy->arena, route->method);
+        slot->resource_name = copy_string(&copy->arena, route->resource_name);
+        slot->namespace_path = copy_string(&copy->arena, route->namespace_path);
+        slot->group = route->group;
+    }
+
+    ResourceInfo* resources = api_spec_add_resources(copy, spec->resources.count);
+    if (!resources && spec->resources.count > 0) goto failed;
+    for (int i = 0; i < spec->resources.count; i++) {
+        resources[i] = spec->resources.items[i];
+        if (copy_resource(&copy->arena, &resources[i], keep_resolved) != 0) goto failed;
+        if (resources[i].route) {
+            resources[i].route = &copy->routes.items[resources[i].route - spec->routes.items];
+        }
+    }
+    return 0;
+
+failed:
+    api_spec_reset(copy);
+    return -1;
+}
+
+int api_spec_copy(const ApiSpec* spec, ApiSpec* copy) {
+    return copy_spec(spec, copy, 1);
+}
+
+int api_spec_compact(ApiSpec* spec) {
+    ApiSpec copy;
+    if (copy_spec(spec, &copy, 0) != 0) return -1;
+    api_spec_reset(spec);
+    *spec = copy;
+    return 0;
+}
+
+void api_spec_compact_if_grown(ApiSpec* spec, size_t* compacted_size) {
+    if (spec->arena.bytes_used > *compacted_size * 2 + (1 << 20) && api_spec_compact(spec) == 0) {
+        *compacted_size = spec->arena.bytes_used;
+    }
+}
@@ -0,0 +1,169 @@
+#ifndef API_SPEC_H
+#define API_SPEC_H
+
+#include "arena.h"
+#include "symbol_table.h"
+
+// All strings in the model are interned in the owning ApiSpec's arena.
+// A NULL string means the value was not present in the source. Attribute,
+// filter, relation and field names and their types, which repeat across
+// resources, are Symbols instead; SYMBOL_NONE means not present.
+
+typedef struct {
+    const char** items;
+    int count;
+    int capacity;
+} StringList;
+
+typedef struct {
+    Symbol name;
+    Symbol type; // As declared; SYMBOL_NONE takes the column's type, else string
+    Symbol collection;
+} Filter;
+
+typedef struct {
+    Filter* items;
+    int count;
+    int capacity;
+} FilterList;
+
+typedef struct {
+    Symbol name;
+    Symbol relation_name;
+    Symbol foreign_key_on;
+    Symbol type; // "has_one", "has_many"
+} Relation;
+
+typedef struct {
+    Relation* items;
+    int count;
+    int capacity;
+} RelationList;
+
+typedef struct RouteInfo RouteInfo;
+typedef struct ModelTable ModelTable;
+
+// Declarations a resource ends up with once its superclasses and included
+// concerns are taken into account; see class_graph_resolve()
+typedef struct {
+    SymbolList attributes;
+    FilterList filters;
+    RelationList relations;
+    SymbolList creatable_fields;
+    SymbolList updatable_fields;
+    const char* paginator;
+} ResourceSets;
+
+typedef struct {
+    const char* source_path;   // File the resource was parsed from
+    const char* class_name;
+    const char* declared_name; // "Api::V1::UserResource", including enclosing modules
+    const char* model_name;
+    const char* create_form;
+    SymbolList attributes;
+    FilterList filters;
+    RelationList relations;
+    SymbolList creatable_fields;
+    SymbolList updatable_fields;
+    const char* paginator;
+    const char* default_sort_field;
+    const char* default_sort_direction;
+    const char* superclass; // "BaseResource" in `class UserResource < BaseResource`, as written
+    int abstract;           // Declares `abstract`: a base class that serves nothing itself
+    StringList includes;    // Modules named by `include`
+    // Own declarations merged over the inherited ones; NULL until
+    // class_graph_resolve() runs. Shared with the parent when nothing is added.
+    const ResourceSets* resolved;
+    const RouteInfo* route; // Set by match_resource_routes(); NULL if nothing matched
+    int route_count;        // Routes of the resource, starting at `route`
+    // Columns of the resource's table, set by model_schema_match(); NULL
+    // without a schema or when no table matched
+    const ModelTable* model_table;
+} ResourceInfo;
+
+struct RouteInfo {
+    const char* path;
+    const char* controller;
+    const char* action;
+    const char* method;
+    const char* resource_name;
+    const char* namespace_path; // "api/v1" for resources inside namespaces; NULL at the top level
+    int group;                  // Index of the first route drawn by the same declaration
+};
+
+typedef struct {
+    RouteInfo* items;
+    int count;
+    int capacity;
+} RouteList;
+
+typedef struct {
+    ResourceInfo* items;
+    int count;
+    int capacity;
+} ResourceList;
+
+typedef struct {
+    Arena arena;
+    RouteList routes;
+    ResourceList resources;
+} ApiSpec;
+
+void api_spec_init(ApiSpec* spec);
+
+// Releases every resource, route and string of the spec in one go.
+void api_spec_reset(ApiSpec* spec);
+
+// Appends `count` zeroed resources and returns the first of them.
+ResourceInfo* api_spec_add_resources(ApiSpec* spec, int count);
+
+// Index of the resource parsed from `path` in a list sorted by source_path,
+// or -(insertion point) - 1 when there is none.
+int api_spec_find_resource(const ApiSpec* spec, const char* path);
+
+// Inserts a zeroed resource at `index` or removes the one there, keeping order.
+ResourceInfo* api_spec_insert_resource(ApiSpec* spec, int index);
+void api_spec_remove_resource(ApiSpec* spec, int index);
+
+// Copies the live resources and routes into a fresh arena and frees the old
+// one, reclaiming strings of replaced or removed entries. Resolved
+// declarations are dropped; run class_graph_resolve() again. Returns -1 (and
+// leaves the spec untouched) when out of memory.
+int api_spec_compact(ApiSpec* spec);
+
+// api_spec_compact() once the arena has grown past twice its size after
+// the last compaction plus a megabyte, `*compacted_size` holding that size
+// (0 or the size after the first parse, to begin with).
+void api_spec_compact_if_grown(ApiSpec* spec, size_t* compacted_size);
+
+// Fills `copy` with a deep copy of the spec in its own arena, resolved
+// declarations included, so it stays valid however `spec` changes later.
+// Returns -1 when out of memory.
+int api_spec_copy(const ApiSpec* spec, ApiSpec* copy);
+
+static inline int has_text(const char* str) {
+    return str && str[0] != '\0';
+}
+
+// Declarations of a resource including inherited ones once resolved
+static inline const SymbolList* resource_attributes(const ResourceInfo* resource) {
+    return resource->resolved ? &resource->resolved->attributes : &resource->attributes;
+}
+
+static inline const FilterList* resource_filters(const ResourceInfo* resource) {
+    return resource->resolved ? &resource->resolved->filters : &resource->filters;
+}
+
+static inline const RelationList* resource_relations(const ResourceInfo* resource) {
+    return resource->resolved ? &resource->resolved->relations : &resource->relations;
+}
+
+static inline const SymbolList* resource_creatable_fields(const ResourceInfo* resource) {
+    return resource->resolved ? &resource->resolved->creatable_fields : &resource->creatable_fields;
+}
+
+static inline const SymbolList* resource_updatable_fields(const ResourceInfo* resource) {
+    return resource->resolved ? &resource->resolved->updatable_fields : &resource->updatable_fields;
+}
+
+#endif
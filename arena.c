@@ -0,0 +1,190 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+struct ArenaBlock {
+    ArenaBlock* next;
+    size_t size;
+    size_t used;
+    // Offset of the last allocation, so it can be grown in place
+    size_t last;
+    _Alignas(ARENA_ALIGNMENT) unsigned char data[];
+};
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+void arena_init(Arena* arena) {
+    memset(arena, 0, sizeof(Arena));
+}
+
+void arena_reset(Arena* arena) {
+    ArenaBlock* block = arena->blocks;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena->intern_slots);
+    memset(arena, 0, sizeof(Arena));
+}
+
+void arena_adopt(Arena* parent, Arena* child) {
+    if (child->blocks) {
+        // Keep the parent's current block in front so it continues bump-allocating
+        ArenaBlock* tail = child->blocks;
+        while (tail->next) tail = tail->next;
+        if (parent->blocks) {
+            tail->next = parent->blocks->next;
+            parent->blocks->next = child->blocks;
+        } else {
+            parent->blocks = child->blocks;
+        }
+    }
+    parent->bytes_used += child->bytes_used;
+    parent->bytes_reserved += child->bytes_reserved;
+    parent->allocations += child->allocations;
+
+    free(child->intern_slots);
+    memset(child, 0, sizeof(Arena));
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = align_up(size ? size : 1);
+
+    ArenaBlock* block = arena->blocks;
+    if (!block || block->size - block->used < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        ArenaBlock* fresh = malloc(sizeof(ArenaBlock) + block_size);
+        if (!fresh) return NULL;
+        fresh->size = block_size;
+        fresh->used = 0;
+        fresh->last = 0;
+
+        // Oversized blocks go behind the current one, which still has room
+        if (block && block_size > ARENA_BLOCK_SIZE) {
+            fresh->next = block->next;
+            block->next = fresh;
+        } else {
+            fresh->next = block;
+            arena->blocks = fresh;
+        }
+        arena->bytes_reserved += block_size;
+        block = fresh;
+    }
+
+    void* ptr = block->data + block->used;
+    block->last = block->used;
+    block->used += size;
+    arena->bytes_used += size;
+    arena->allocations++;
+    return ptr;
+}
+
+void* arena_calloc(Arena* arena, size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) return NULL;
+    void* ptr = arena_alloc(arena, count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+char* arena_strndup(Arena* arena, const char* str, size_t len) {
+    char* copy = arena_alloc(arena, len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+static uint64_t hash_bytes(const char* str, size_t len) {
+    // FNV-1a
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int intern_rehash(Arena* arena) {
+    size_t capacity = arena->intern_capacity ? arena->intern_capacity * 2 : 256;
+    const char** slots = calloc(capacity, sizeof(const char*));
+    if (!slots) return 0;
+
+    for (size_t i = 0; i < arena->intern_capacity; i++) {
+        const char* str = arena->intern_slots[i];
+        if (!str) continue;
+        size_t slot = hash_bytes(str, strlen(str)) & (capacity - 1);
+        while (slots[slot]) slot = (slot + 1) & (capacity - 1);
+        slots[slot] = str;
+    }
+
+    free(arena->intern_slots);
+    arena->intern_slots = slots;
+    arena->intern_capacity = capacity;
+    return 1;
+}
+
+const char* arena_intern(Arena* arena, const char* str, size_t len) {
+    if ((arena->intern_count + 1) * 4 > arena->intern_capacity * 3 && !intern_rehash(arena)) {
+        return arena_strndup(arena, str, len);
+    }
+
+    size_t mask = arena->intern_capacity - 1;
+    size_t slot = hash_bytes(str, len) & mask;
+    while (arena->intern_slots[slot]) {
+        const char* existing = arena->intern_slots[slot];
+        if (strncmp(existing, str, len) == 0 && existing[len] == '\0') {
+            return existing;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    char* copy = arena_strndup(arena, str, len);
+    if (!copy) return NULL;
+    arena->intern_slots[slot] = copy;
+    arena->intern_count++;
+    return copy;
+}
+
+const char* arena_intern_cstr(Arena* arena, const char* str) {
+    return arena_intern(arena, str, strlen(str));
+}
+
+void* arena_push_item(Arena* arena, void** items, int* count, int* capacity, size_t item_size) {
+    if (*count < *capacity) {
+        unsigned char* item = (unsigned char*)*items + (size_t)*count * item_size;
+        (*count)++;
+        return item;
+    }
+
+    int new_capacity = *capacity ? *capacity * 2 : 8;
+    size_t old_size = (size_t)*capacity * item_size;
+    size_t new_size = (size_t)new_capacity * item_size;
+
+    // Extend in place when the array is the newest allocation of the current block
+    ArenaBlock* block = arena->blocks;
+    unsigned char* grown = NULL;
+    if (*items && block && (unsigned char*)*items == block->data + block->last &&
+        block->last + align_up(new_size) <= block->size) {
+        size_t old_used = block->used;
+        block->used = block->last + align_up(new_size);
+        arena->bytes_used += block->used - old_used;
+        grown = *items;
+        memset(grown + old_size, 0, new_size - old_size);
+    } else {
+        grown = arena_calloc(arena, new_capacity, item_size);
+        if (!grown) return NULL;
+        if (*items) memcpy(grown, *items, old_size);
+    }
+
+    *items = grown;
+    *capacity = new_capacity;
+    return grown + (size_t)(*count)++ * item_size;
+}
@@ -0,0 +1,48 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator for everything produced by one run. Individual allocations
+// are never freed; arena_reset() releases all of them at once.
+// An arena is not thread-safe: give each thread its own and merge them
+// afterwards with arena_adopt().
+typedef struct {
+    ArenaBlock* blocks;
+    size_t bytes_used;
+    size_t bytes_reserved;
+    size_t allocations; // arena_alloc() calls, for --stats
+    // Open-addressing set of interned strings, keyed by content
+    const char** intern_slots;
+    size_t intern_capacity;
+    size_t intern_count;
+} Arena;
+
+void arena_init(Arena* arena);
+void arena_reset(Arena* arena);
+
+// Moves every block of `child` into `parent`; `child` is left empty.
+void arena_adopt(Arena* parent, Arena* child);
+
+void* arena_alloc(Arena* arena, size_t size);
+void* arena_calloc(Arena* arena, size_t count, size_t size);
+
+// Returns a NUL-terminated copy of str[0..len).
+char* arena_strndup(Arena* arena, const char* str, size_t len);
+
+// Like arena_strndup, but equal strings share one copy for the arena's lifetime.
+const char* arena_intern(Arena* arena, const char* str, size_t len);
+const char* arena_intern_cstr(Arena* arena, const char* str);
+
+// Appends a zeroed item to an arena-backed array, doubling its capacity when
+// full (in place if the array is the newest allocation). Returns the new item,
+// or NULL when out of memory, in which case the array is left untouched.
+void* arena_push_item(Arena* arena, void** items, int* count, int* capacity, size_t item_size);
+
+// Growable array stored in an arena: struct { T* items; int count; int capacity; }.
+#define ARENA_PUSH(arena, list) \
+    arena_push_item((arena), (void**)&(list).items, &(list).count, &(list).capacity, sizeof(*(list).items))
+
+#endif
@@ -0,0 +1,173 @@
+#include "batch_manifest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "source_file.h"
+
+#define MAX_MANIFEST_FIELDS 3
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// "/api/customer/v1/" -> "/api/customer/v1"; "" and "/" mean every route
+static const char* normalize_prefix(Arena* arena, const char* prefix, size_t len) {
+    while (len > 0 && prefix[len - 1] == '/') len--;
+    while (len > 0 && prefix[0] == '/') {
+        prefix++;
+        len--;
+    }
+    if (len == 0) return NULL;
+    char* normalized = arena_alloc(arena, len + 2);
+    if (!normalized) return NULL;
+    normalized[0] = '/';
+    memcpy(normalized + 1, prefix, len);
+    normalized[len + 1] = '\0';
+    return normalized;
+}
+
+int batch_manifest_load(BatchManifest* manifest, const char* path) {
+    memset(manifest, 0, sizeof(BatchManifest));
+    arena_init(&manifest->arena);
+
+    SourceFile source;
+    if (source_file_open(&source, path) != 0) {
+        printf("Error: Cannot open batch manifest %s\n", path);
+        return -1;
+    }
+
+    int status = 0;
+    int line = 0;
+    const char* end = source.data + source.size;
+    for (const char* cur = source.data; cur < end && status == 0;) {
+        const char* eol = memchr(cur, '\n', end - cur);
+        if (!eol) eol = end;
+        line++;
+
+        const char* fields[MAX_MANIFEST_FIELDS];
+        size_t lengths[MAX_MANIFEST_FIELDS];
+        int count = 0;
+        const char* p = cur;
+        while (p < eol) {
+            while (p < eol && is_blank(*p)) p++;
+            if (p == eol || (*p == '#' && count == 0)) break;
+            const char* start = p;
+            while (p < eol && !is_blank(*p)) p++;
+            if (count == MAX_MANIFEST_FIELDS) {
+                count++;
+                break;
+            }
+            fields[count] = start;
+            lengths[count++] = p - start;
+        }
+        cur = eol + 1;
+        if (count == 0) continue;
+
+        if (count < 2 || count > MAX_MANIFEST_FIELDS) {
+            printf("Error: %s:%d: expected '<resource_dir> <output_file> [path_prefix]'\n", path, line);
+            status = -1;
+            break;
+        }
+
+        BatchEntry* entry = ARENA_PUSH(&manifest->arena, *manifest);
+        if (!entry) {
+            status = -1;
+            break;
+        }
+        entry->resource_dir = arena_strndup(&manifest->arena, fields[0], lengths[0]);
+        entry->output_path = arena_strndup(&manifest->arena, fields[1], lengths[1]);
+        if (count == 3) entry->path_prefix = normalize_prefix(&manifest->arena, fields[2], lengths[2]);
+        if (!entry->resource_dir || !entry->output_path) status = -1;
+    }
+    source_file_close(&source);
+
+    if (status == 0 && manifest->count == 0) {
+        printf("Error: Batch manifest %s lists no specs\n", path);
+        status = -1;
+    }
+    return status;
+}
+
+void batch_manifest_free(BatchManifest* manifest) {
+    path_list_free(&manifest->files);
+    arena_reset(&manifest->arena);
+    memset(manifest, 0, sizeof(BatchManifest));
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+int batch_manifest_collect(BatchManifest* manifest) {
+    PathList* lists = calloc(manifest->count, sizeof(PathList));
+    if (!lists) return -1;
+
+    // Every entry's files, then the union of them, sorted without duplicates
+    PathList all = { 0 };
+    for (int e = 0; e < manifest->count; e++) {
+        collect_resource_files(manifest->items[e].resource_dir, &lists[e]);
+        for (int i = 0; i < lists[e].count; i++) path_list_add(&all, lists[e].paths[i]);
+    }
+    qsort(all.paths, all.count, sizeof(char*), compare_paths);
+    for (int i = 0; i < all.count; i++) {
+        if (i > 0 && strcmp(all.paths[i], all.paths[i - 1]) == 0) continue;
+        path_list_add(&manifest->files, all.paths[i]);
+    }
+    path_list_free(&all);
+
+    int status = 0;
+    for (int e = 0; e < manifest->count && status == 0; e++) {
+        BatchEntry* entry = &manifest->items[e];
+        entry->files = arena_alloc(&manifest->arena, (lists[e].count ? lists[e].count : 1) * sizeof(int));
+        if (!entry->files) {
+            status = -1;
+            break;
+        }
+        for (int i = 0; i < lists[e].count; i++) {
+            char** found = bsearch(&lists[e].paths[i], manifest->files.paths, manifest->files.count,
+                                   sizeof(char*), compare_paths);
+            if (found) entry->files[entry->file_count++] = (int)(found - manifest->files.paths);
+        }
+    }
+
+    for (int e = 0; e < manifest->count; e++) path_list_free(&lists[e]);
+    free(lists);
+    return status;
+}
+
+static int under_prefix(const char* path, const char* prefix) {
+    if (!prefix) return 1;
+    size_t len = strlen(prefix);
+    return strncmp(path, prefix, len) == 0 && (path[len] == '\0' || path[len] == '/');
+}
+
+int batch_spec_view(const BatchEntry* entry, const ApiSpec* spec, ApiSpec* view) {
+    api_spec_init(view);
+    ResourceInfo* resources = api_spec_add_resources(view, entry->file_count);
+    if (!resources && entry->file_count > 0) return -1;
+    for (int i = 0; i < entry->file_count; i++) {
+        resources[i] = spec->resources.items[entry->files[i]];
+        resources[i].route = NULL;
+        resources[i].route_count = 0;
+    }
+
+    // Groups are contiguous, so a kept route starts a new group whenever
+    // its source group differs from the previous kept route's
+    int source_group = -1;
+    int group = 0;
+    for (int i = 0; i < spec->routes.count; i++) {
+        const RouteInfo* route = &spec->routes.items[i];
+        if (!under_prefix(route->path, entry->path_prefix)) continue;
+        RouteInfo* copy = ARENA_PUSH(&view->arena, view->routes);
+        if (!copy) return -1;
+        *copy = *route;
+        if (route->group != source_group) {
+            source_group = route->group;
+            group = view->routes.count - 1;
+        }
+        copy->group = group;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef BATCH_MANIFEST_H
+#define BATCH_MANIFEST_H
+
+#include "api_spec.h"
+#include "resource_scan.h"
+
+// One spec of a batch run
+typedef struct {
+    const char* resource_dir;
+    const char* output_path;
+    const char* path_prefix; // Only routes below it; NULL for every route
+    int* files;              // Indices into BatchManifest.files
+    int file_count;
+} BatchEntry;
+
+// Specs generated together by --batch. Resource files listed by several
+// entries appear once in `files`, so each is parsed only once.
+typedef struct {
+    BatchEntry* items;
+    int count;
+    int capacity;
+    PathList files; // Sorted, without duplicates
+    Arena arena;
+} BatchManifest;
+
+// Reads a manifest with one entry per line:
+//
+//     <resource_dir> <output_file> [path_prefix]
+//
+// separated by spaces or tabs; blank lines and lines starting with `#` are
+// skipped. Paths are taken relative to the working directory. Returns -1
+// after printing an error when the file is unreadable or a line is invalid.
+int batch_manifest_load(BatchManifest* manifest, const char* path);
+void batch_manifest_free(BatchManifest* manifest);
+
+// Collects the resource files of every entry into `files` and each entry's
+// indices into it.
+int batch_manifest_collect(BatchManifest* manifest);
+
+// Fills `view` with the entry's share of `spec`: the resources parsed from
+// its files (resource i of the manifest's files is spec->resources.items[i])
+// and the routes below its path prefix, with RouteInfo.group renumbered.
+// The view shares every string with `spec` and must not outlive it;
+// api_spec_reset(view) releases only its own arrays.
+int batch_spec_view(const BatchEntry* entry, const ApiSpec* spec, ApiSpec* view);
+
+#endif
@@ -0,0 +1,200 @@
+// Cold-cache benchmark for reading resource files: parses a synthetic tree
+// with every file_ingest mode (off: each parser maps its own files,
+// threads, io_uring) after evicting the tree from the page cache, and checks
+// that every mode extracts the same model.
+//
+// Eviction writes to /proc/sys/vm/drop_caches when that is allowed (root
+// outside a container) and otherwise drops each file's pages with
+// posix_fadvise(POSIX_FADV_DONTNEED), which leaves directory entries cached
+// and does nothing on tmpfs: put the tree on a real disk with --dir.
+//
+//   ingest_bench [--resources N] [--iterations N] [--jobs N] [--seed N]
+//                [--dir DIR] [--warm]
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "api_spec.h"
+#include "file_ingest.h"
+#include "resource_scan.h"
+#include "synthetic_tree.h"
+#include "work_pool.h"
+
+static const FileIngestMode modes[] = { FILE_INGEST_OFF, FILE_INGEST_THREADS, FILE_INGEST_IO_URING };
+#define MODE_COUNT (sizeof(modes) / sizeof(modes[0]))
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Empties the page cache, or failing that evicts every file; returns how
+static const char* evict(const PathList* files) {
+    sync();
+    FILE* drop = fopen("/proc/sys/vm/drop_caches", "w");
+    if (drop) {
+        int written = fputs("3\n", drop) >= 0;
+        if (fclose(drop) == 0 && written) return "drop_caches";
+    }
+    for (int i = 0; i < files->count; i++) {
+        int fd = open(files->paths[i], O_RDONLY);
+        if (fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+    return "fadvise";
+}
+
+// FNV-1a over what the parse extracted, to compare the modes
+static uint64_t hash_text(uint64_t hash, const char* str) {
+    for (const char* p = str ? str : ""; *p; p++) hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    return hash * 1099511628211ULL;
+}
+
+static uint64_t model_checksum(const ApiSpec* spec) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (int i = 0; i < spec->resources.count; i++) {
+        const ResourceInfo* resource = &spec->resources.items[i];
+        hash = hash_text(hash, resource->source_path);
+        hash = hash_text(hash, resource->declared_name);
+        hash = hash_text(hash, resource->superclass);
+        for (int a = 0; a < resource->attributes.count; a++) {
+            hash = hash_text(hash, symbol_name(resource->attributes.items[a]));
+        }
+        for (int f = 0; f < resource->filters.count; f++) {
+            hash = hash_text(hash, symbol_name(resource->filters.items[f].name));
+        }
+        for (int r = 0; r < resource->relations.count; r++) {
+            hash = hash_text(hash, symbol_name(resource->relations.items[r].name));
+        }
+    }
+    return hash;
+}
+
+static int compare_ns(const void* a, const void* b) {
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+static void print_usage(const char* program_name) {
+    fprintf(stderr,
+            "Usage: %s [--resources N] [--iterations N] [--jobs N] [--seed N] [--dir DIR] [--warm]\n"
+            "  --dir DIR: Use the tree in DIR, writing it first if DIR has none, and keep it\n"
+            "  --warm: Leave the page cache alone between runs\n",
+            program_name);
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option long_options[] = {
+        { "resources", required_argument, NULL, 'r' },
+        { "iterations", required_argument, NULL, 'i' },
+        { "jobs", required_argument, NULL, 'j' },
+        { "seed", required_argument, NULL, 's' },
+        { "dir", required_argument, NULL, 'D' },
+        { "warm", no_argument, NULL, 'W' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    SyntheticTreeOptions tree;
+    synthetic_tree_defaults(&tree);
+    tree.resources = 20000;
+    int iterations = 3;
+    int jobs = work_pool_default_jobs();
+    const char* keep_dir = NULL;
+    int warm = 0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:j:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'r': tree.resources = atoi(optarg); break;
+            case 'i': iterations = atoi(optarg); break;
+            case 'j': jobs = atoi(optarg); break;
+            case 's': tree.seed = strtoull(optarg, NULL, 10); break;
+            case 'D': keep_dir = optarg; break;
+            case 'W': warm = 1; break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if (iterations < 1 || jobs < 1 || tree.resources < 1) {
+        fprintf(stderr, "Error: --iterations, --jobs and --resources must be positive\n");
+        return 1;
+    }
+
+    char temp_dir[] = "/tmp/ingest_bench.XXXXXX";
+    const char* root = keep_dir;
+    if (!root) {
+        root = mkdtemp(temp_dir);
+        if (!root) {
+            perror("mkdtemp");
+            return 1;
+        }
+    }
+    char resources_dir[1024];
+    snprintf(resources_dir, sizeof(resources_dir), "%s/app/resources", root);
+    struct stat st;
+    int status = 0;
+    if (!keep_dir || stat(resources_dir, &st) != 0) {
+        SyntheticTreeStats stats;
+        status = synthetic_tree_write(root, &tree, &stats);
+    }
+
+    PathList files = { 0 };
+    collect_resource_files(resources_dir, &files);
+    size_t bytes = 0;
+    for (int i = 0; i < files.count; i++) {
+        if (stat(files.paths[i], &st) == 0) bytes += (size_t)st.st_size;
+    }
+    if (status == 0) {
+        printf("Corpus: %d files, %.1f MB, %d jobs, %d iterations, %s cache\n", files.count, bytes / 1e6, jobs,
+               iterations, warm ? "warm" : "cold");
+        printf("%-10s %12s %12s %10s  %s\n", "mode", "best ms", "median ms", "MB/s", "eviction");
+    }
+
+    long long* samples = calloc(iterations, sizeof(long long));
+    uint64_t expected = 0;
+    for (size_t m = 0; m < MODE_COUNT && status == 0 && samples; m++) {
+        file_ingest_set_mode(modes[m]);
+        FileIngestMode resolved = file_ingest_resolved_mode();
+        if (resolved != modes[m]) {
+            printf("%-10s %12s %12s %10s  (falls back to %s here)\n", file_ingest_mode_name(modes[m]), "-", "-", "-",
+                   file_ingest_mode_name(resolved));
+            continue;
+        }
+
+        const char* eviction = "none";
+        for (int i = 0; i < iterations; i++) {
+            if (!warm) eviction = evict(&files);
+            ApiSpec spec;
+            api_spec_init(&spec);
+            long long start = now_ns();
+            free(parse_resource_files(&files, &spec, jobs, NULL, NULL));
+            samples[i] = now_ns() - start;
+
+            uint64_t checksum = model_checksum(&spec);
+            if (m == 0 && i == 0) expected = checksum;
+            if (checksum != expected) {
+                fprintf(stderr, "Error: %s extracted a different model\n", file_ingest_mode_name(modes[m]));
+                status = -1;
+            }
+            api_spec_reset(&spec);
+        }
+        qsort(samples, iterations, sizeof(long long), compare_ns);
+        printf("%-10s %12.3f %12.3f %10.1f  %s\n", file_ingest_mode_name(modes[m]), samples[0] / 1e6,
+               samples[iterations / 2] / 1e6, bytes / 1e6 / (samples[0] / 1e9), eviction);
+    }
+
+    free(samples);
+    path_list_free(&files);
+    if (!keep_dir) synthetic_tree_remove(root);
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+// Micro-benchmark for the keyword prefilter: parses a synthetic corpus of
+// resource files with the prefilter off and with each implementation, and
+// checks that every run extracts exactly the same model.
+//
+//   prefilter_bench [--files N] [--iterations N] [--seed N] [--write-corpus DIR]
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "api_spec.h"
+#include "arena.h"
+#include "keyword_prefilter.h"
+#include "resource_parser.h"
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+typedef struct {
+    char name[64];
+    char* source;
+    size_t size;
+} CorpusFile;
+
+static uint64_t rng_state;
+
+static uint64_t next_random(void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static int random_below(int bound) {
+    return (int)(next_random() % (uint64_t)bound);
+}
+
+__attribute__((format(printf, 2, 3)))
+static void buffer_printf(Buffer* buffer, const char* format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        size_t room = buffer->capacity - buffer->size;
+        int written = vsnprintf(buffer->data + buffer->size, room, format, args);
+        va_end(args);
+        if (written < 0) return;
+        if ((size_t)written < room) {
+            buffer->size += written;
+            return;
+        }
+        buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        while (buffer->capacity - buffer->size <= (size_t)written) buffer->capacity *= 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+        if (!buffer->data) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+}
+
+static const char* const words[] = {
+    "name", "status", "amount", "currency", "created_at", "updated_at", "uuid", "external_id",
+    "description", "enabled", "priority", "region", "country", "balance", "limit", "email",
+};
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+// One resource file: roughly a third DSL declarations, the rest comments and
+// method bodies, which is what real resources in large apps look like.
+static void generate_resource(Buffer* out, int index) {
+    buffer_printf(out, "# frozen_string_literal: true\n\n");
+    buffer_printf(out, "# Resource %d exposes the model over JSON:API.\n# Keep the filters in sync with the index page.\n", index);
+    buffer_printf(out, "class Api::Rest::Customer::V1::Model%dResource < BaseResource\n", index);
+    buffer_printf(out, "  model_name 'Model%d'\n  paginator :paged\n", index);
+    buffer_printf(out, "  default_sort field: '%s', direction: :desc\n\n", words[random_below(WORD_COUNT)]);
+
+    int attributes = 4 + random_below(12);
+    buffer_printf(out, "  attributes :id");
+    for (int i = 0; i < attributes; i++) {
+        buffer_printf(out, ",%s:%s_%d", i % 4 == 3 ? "\n             " : " ", words[i % WORD_COUNT], i);
+    }
+    buffer_printf(out, "\n\n");
+
+    int filters = 2 + random_below(6);
+    for (int i = 0; i < filters; i++) {
+        switch (random_below(3)) {
+            case 0: buffer_printf(out, "  ransack_filter :%s, type: :string\n", words[random_below(WORD_COUNT)]); break;
+            case 1: buffer_printf(out, "  association_uuid_filter :model%d_id, class_name: 'Model%d'\n", i, i); break;
+            default: buffer_printf(out, "  filter :%s, apply: ->(records, values, _options) { records.where(id: values) }\n",
+                                   words[random_below(WORD_COUNT)]); break;
+        }
+    }
+    buffer_printf(out, "\n  has_one :account, foreign_key_on: :related\n  has_many :items\n\n");
+
+    int methods = 3 + random_below(5);
+    for (int m = 0; m < methods; m++) {
+        buffer_printf(out, "  # Computes the %s for the current context.\n", words[random_below(WORD_COUNT)]);
+        buffer_printf(out, "  # Callers must pass an authorized context.\n");
+        buffer_printf(out, "  def compute_%s_%d(context)\n", words[random_below(WORD_COUNT)], m);
+        int lines = 4 + random_below(14);
+        for (int l = 0; l < lines; l++) {
+            switch (random_below(6)) {
+                case 0: buffer_printf(out, "    value = context[:%s] || default_%s\n", words[random_below(WORD_COUNT)], words[l % WORD_COUNT]); break;
+                case 1: buffer_printf(out, "    return nil if value.blank? # nothing to do\n"); break;
+                case 2: buffer_printf(out, "    records = records.where(\"%s > ?\", value).order(:created_at)\n", words[random_below(WORD_COUNT)]); break;
+                case 3: buffer_printf(out, "    items.each do |item|\n      total += item.amount * rate\n    end\n"); break;
+                case 4: buffer_printf(out, "    # TODO: move this into the service object\n"); break;
+                default: buffer_printf(out, "    @cache[%d] ||= { id: value, label: 'Model %d' }\n", l, index); break;
+            }
+        }
+        buffer_printf(out, "  end\n\n");
+    }
+
+    buffer_printf(out, "  def self.creatable_fields(_context)\n    %%i[%s %s]\n  end\n\n",
+                  words[random_below(WORD_COUNT)], words[random_below(WORD_COUNT)]);
+    buffer_printf(out, "  def self.updatable_fields(_context)\n    %%i[%s]\n  end\nend\n", words[random_below(WORD_COUNT)]);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t mix(uint64_t hash, const char* str) {
+    if (!str) return hash * 31 + 7;
+    for (; *str; str++) hash = (hash ^ (unsigned char)*str) * 1099511628211ULL;
+    return hash;
+}
+
+static uint64_t fingerprint(const ResourceInfo* resource) {
+    uint64_t hash = 1469598103934665603ULL;
+    hash = mix(hash, resource->model_name);
+    hash = mix(hash, resource->paginator);
+    hash = mix(hash, resource->default_sort_field);
+    hash = mix(hash, resource->default_sort_direction);
+    for (int i = 0; i < resource->attributes.count; i++) hash = mix(hash, symbol_name(resource->attributes.items[i]));
+    for (int i = 0; i < resource->filters.count; i++) {
+        hash = mix(hash, symbol_name(resource->filters.items[i].name));
+        hash = mix(hash, symbol_name(resource->filters.items[i].type));
+    }
+    for (int i = 0; i < resource->relations.count; i++) {
+        hash = mix(hash, symbol_name(resource->relations.items[i].name));
+    }
+    for (int i = 0; i < resource->creatable_fields.count; i++) {
+        hash = mix(hash, symbol_name(resource->creatable_fields.items[i]));
+    }
+    for (int i = 0; i < resource->updatable_fields.count; i++) {
+        hash = mix(hash, symbol_name(resource->updatable_fields.items[i]));
+    }
+    return hash;
+}
+
+// Parses the whole corpus once; returns the elapsed seconds.
+static double run_parse(const CorpusFile* files, int count, uint64_t* checksum) {
+    Arena arena;
+    arena_init(&arena);
+    uint64_t sum = 0;
+
+    double start = now_seconds();
+    for (int i = 0; i < count; i++) {
+        ResourceInfo resource;
+        memset(&resource, 0, sizeof(resource));
+        parse_resource_source(files[i].name, files[i].source, files[i].size, &resource, &arena);
+        sum = sum * 1315423911ULL + fingerprint(&resource);
+    }
+    double elapsed = now_seconds() - start;
+
+    arena_reset(&arena);
+    *checksum = sum;
+    return elapsed;
+}
+
+static void write_corpus(const char* directory, const CorpusFile* files, int count) {
+    mkdir(directory, 0755);
+    for (int i = 0; i < count; i++) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", directory, files[i].name);
+        FILE* file = fopen(path, "w");
+        if (!file) {
+            fprintf(stderr, "Error: Cannot write %s\n", path);
+            return;
+        }
+        fwrite(files[i].source, 1, files[i].size, file);
+        fclose(file);
+    }
+    printf("Wrote %d files to %s\n", count, directory);
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option long_options[] = {
+        { "files", required_argument, NULL, 'f' },
+        { "iterations", required_argument, NULL, 'i' },
+        { "seed", required_argument, NULL, 's' },
+        { "write-corpus", required_argument, NULL, 'w' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int file_count = 10000;
+    int iterations = 5;
+    uint64_t seed = 42;
+    const char* corpus_dir = NULL;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "f:i:s:w:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'f': file_count = atoi(optarg); break;
+            case 'i': iterations = atoi(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 10); break;
+            case 'w': corpus_dir = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [--files N] [--iterations N] [--seed N] [--write-corpus DIR]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (file_count < 1 || iterations < 1) {
+        fprintf(stderr, "Error: --files and --iterations must be positive\n");
+        return 1;
+    }
+
+    rng_state = seed ? seed : 1;
+    CorpusFile* files = calloc(file_count, sizeof(CorpusFile));
+    size_t total_bytes = 0;
+    for (int i = 0; i < file_count; i++) {
+        Buffer buffer = { 0 };
+        generate_resource(&buffer, i);
+        snprintf(files[i].name, sizeof(files[i].name), "model%d_resource.rb", i);
+        files[i].source = buffer.data;
+        files[i].size = buffer.size;
+        total_bytes += buffer.size;
+    }
+    if (corpus_dir) write_corpus(corpus_dir, files, file_count);
+
+    printf("Corpus: %d files, %.1f MB, best of %d iterations\n", file_count, total_bytes / 1e6, iterations);
+    printf("%-8s %10s %12s %10s %9s\n", "mode", "total ms", "ns/file", "MB/s", "speedup");
+
+    static const KeywordPrefilterMode modes[] = {
+        KEYWORD_PREFILTER_OFF, KEYWORD_PREFILTER_SCALAR, KEYWORD_PREFILTER_SSE2, KEYWORD_PREFILTER_AVX2
+    };
+    double baseline = 0;
+    uint64_t expected = 0;
+    int failed = 0;
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        keyword_prefilter_set_mode(modes[m]);
+        KeywordPrefilterMode resolved = keyword_prefilter_resolved_mode();
+        if (resolved != modes[m]) {
+            printf("%-8s %10s (not supported, runs as %s)\n", keyword_prefilter_mode_name(modes[m]), "-",
+                   keyword_prefilter_mode_name(resolved));
+            continue;
+        }
+
+        double best = 0;
+        uint64_t checksum = 0;
+        for (int i = 0; i < iterations; i++) {
+            double elapsed = run_parse(files, file_count, &checksum);
+            if (i == 0 || elapsed < best) best = elapsed;
+        }
+
+        if (m == 0) {
+            baseline = best;
+            expected = checksum;
+        } else if (checksum != expected) {
+            failed = 1;
+        }
+
+        printf("%-8s %10.2f %12.0f %10.1f %8.2fx%s\n", keyword_prefilter_mode_name(modes[m]), best * 1e3,
+               best * 1e9 / file_count, total_bytes / best / 1e6, baseline / best,
+               checksum == expected ? "" : "  MISMATCH");
+    }
+
+    for (int i = 0; i < file_count; i++) free(files[i].source);
+    free(files);
+
+    if (failed) {
+        fprintf(stderr, "Error: prefiltered parse differs from the unfiltered parse\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,339 @@
+// End-to-end benchmark: generates a synthetic Rails tree and times every
+// phase of a run separately (scan, resource parse, routes parse, spec build
+// with inheritance resolution and route matching, serialize). Results go to stdout as a table, or as JSON with --json so
+// they can be tracked across commits. With --dir the tree is kept, which
+// also makes this the corpus generator for the parser itself.
+//
+//   spec_bench [--resources N] [--attributes N] [--filters N] [--relations N]
+//              [--depth N] [--routes N] [--iterations N] [--jobs N] [--seed N]
+//              [--dir DIR] [--json FILE|-]
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "api_spec.h"
+#include "class_graph.h"
+#include "json_writer.h"
+#include "openapi_writer.h"
+#include "output_sink.h"
+#include "resource_scan.h"
+#include "route_index.h"
+#include "routes_parser.h"
+#include "synthetic_tree.h"
+#include "work_pool.h"
+
+typedef enum {
+    PHASE_SCAN,
+    PHASE_RESOURCE_PARSE,
+    PHASE_ROUTES_PARSE,
+    PHASE_SPEC_BUILD,
+    PHASE_SERIALIZE,
+    PHASE_COUNT
+} Phase;
+
+static const char* const phase_names[PHASE_COUNT] = {
+    "scan", "resource_parse", "routes_parse", "spec_build", "serialize"
+};
+
+typedef struct {
+    int resources;
+    int routes;
+    int matched;
+    size_t output_bytes;
+    size_t model_bytes; // Spec arena once matched and resolved
+    size_t identifiers; // Symbols stored for names and types in the model
+    SymbolTableStats symbols;
+} RunResult;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Serialization target that only counts: the phase measures the writer, not the disk
+static int discard_output(void* ctx, const char* data, size_t size) {
+    (void)ctx;
+    (void)data;
+    (void)size;
+    return 0;
+}
+
+// One full run over the tree; fills `elapsed` with the nanoseconds of each phase
+static int run_once(const char* resources_dir, const char* routes_file, int jobs, long long elapsed[PHASE_COUNT],
+                    RunResult* result) {
+    ApiSpec spec;
+    api_spec_init(&spec);
+    PathList files = { 0 };
+
+    long long start = now_ns();
+    collect_resource_files(resources_dir, &files);
+    long long scanned = now_ns();
+    free(parse_resource_files(&files, &spec, jobs, NULL, NULL));
+    long long parsed = now_ns();
+    parse_routes_file(routes_file, &spec, NULL);
+    long long routed = now_ns();
+    ClassGraphSummary classes;
+    class_graph_resolve(&spec, &classes);
+    RouteMatchSummary matches;
+    match_resource_routes(&spec, &matches);
+    long long built = now_ns();
+
+    OutputSink sink;
+    int status = output_sink_init(&sink, 1 << 16, discard_output, NULL);
+    if (status == 0) {
+        JsonWriter writer;
+        json_writer_init(&writer, &sink, 1);
+        status = openapi_emit_parallel(&spec, &writer.emitter, NULL, jobs);
+        if (output_sink_flush(&sink) != 0) status = -1;
+    }
+    long long serialized = now_ns();
+
+    elapsed[PHASE_SCAN] = scanned - start;
+    elapsed[PHASE_RESOURCE_PARSE] = parsed - scanned;
+    elapsed[PHASE_ROUTES_PARSE] = routed - parsed;
+    elapsed[PHASE_SPEC_BUILD] = built - routed;
+    elapsed[PHASE_SERIALIZE] = serialized - built;
+
+    result->resources = 0;
+    for (int i = 0; i < spec.resources.count; i++) result->resources += !spec.resources.items[i].abstract;
+    result->routes = spec.routes.count;
+    result->matched = matches.matched;
+    result->output_bytes = status == 0 ? sink.bytes_written : 0;
+    result->model_bytes = spec.arena.bytes_used;
+    result->identifiers = 0;
+    for (int i = 0; i < spec.resources.count; i++) {
+        const ResourceInfo* resource = &spec.resources.items[i];
+        result->identifiers += resource->attributes.count + resource->creatable_fields.count +
+                               resource->updatable_fields.count + resource->filters.count * 3 +
+                               resource->relations.count * 4;
+    }
+    symbol_table_stats(&result->symbols);
+
+    if (status == 0) output_sink_free(&sink);
+    path_list_free(&files);
+    api_spec_reset(&spec);
+    return status;
+}
+
+static int compare_ns(const void* a, const void* b) {
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    long long best;
+    long long median;
+    long long mean;
+} PhaseTiming;
+
+static PhaseTiming summarize(long long* samples, int count) {
+    qsort(samples, count, sizeof(long long), compare_ns);
+    long long total = 0;
+    for (int i = 0; i < count; i++) total += samples[i];
+    PhaseTiming timing = { samples[0], samples[count / 2], total / count };
+    return timing;
+}
+
+static void write_json(FILE* file, const SyntheticTreeOptions* tree, const SyntheticTreeStats* stats, int iterations,
+                       int jobs, const PhaseTiming* timings, const RunResult* result) {
+    OutputSink sink;
+    if (output_sink_init(&sink, 1 << 12, output_sink_write_file, file) != 0) return;
+    JsonWriter writer;
+    json_writer_init(&writer, &sink, 1);
+    SpecEmitter* out = &writer.emitter;
+
+    out->begin_object(out);
+    emit_key_string(out, "benchmark", "spec_bench");
+
+    out->key(out, "config");
+    out->begin_object(out);
+    emit_key_integer(out, "resources", tree->resources);
+    emit_key_integer(out, "attributes", tree->attributes);
+    emit_key_integer(out, "filters", tree->filters);
+    emit_key_integer(out, "relations", tree->relations);
+    emit_key_integer(out, "depth", tree->depth);
+    emit_key_integer(out, "routes", tree->routes);
+    emit_key_integer(out, "seed", (long long)tree->seed);
+    emit_key_integer(out, "iterations", iterations);
+    emit_key_integer(out, "jobs", jobs);
+    out->end_object(out);
+
+    out->key(out, "corpus");
+    out->begin_object(out);
+    emit_key_integer(out, "files", stats->files);
+    emit_key_integer(out, "resource_bytes", (long long)stats->resource_bytes);
+    emit_key_integer(out, "routes_bytes", (long long)stats->routes_bytes);
+    out->end_object(out);
+
+    out->key(out, "phases");
+    out->begin_array(out);
+    long long total_best = 0;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        out->begin_object(out);
+        emit_key_string(out, "name", phase_names[p]);
+        emit_key_integer(out, "best_ns", timings[p].best);
+        emit_key_integer(out, "median_ns", timings[p].median);
+        emit_key_integer(out, "mean_ns", timings[p].mean);
+        out->end_object(out);
+        total_best += timings[p].best;
+    }
+    out->end_array(out);
+    emit_key_integer(out, "total_best_ns", total_best);
+
+    out->key(out, "result");
+    out->begin_object(out);
+    emit_key_integer(out, "resources", result->resources);
+    emit_key_integer(out, "routes", result->routes);
+    emit_key_integer(out, "matched", result->matched);
+    emit_key_integer(out, "output_bytes", (long long)result->output_bytes);
+    emit_key_integer(out, "model_bytes", (long long)result->model_bytes);
+    emit_key_integer(out, "identifiers", (long long)result->identifiers);
+    emit_key_integer(out, "symbols", (long long)result->symbols.count);
+    emit_key_integer(out, "symbol_table_bytes", (long long)result->symbols.bytes);
+    out->end_object(out);
+
+    out->end_object(out);
+    output_sink_putc(&sink, '\n');
+    output_sink_flush(&sink);
+    output_sink_free(&sink);
+}
+
+static void print_table(const SyntheticTreeStats* stats, int iterations, int jobs, const PhaseTiming* timings,
+                        const RunResult* result) {
+    printf("Corpus: %d files, %.1f MB, %d routes, %d jobs, %d iterations\n", stats->files,
+           (stats->resource_bytes + stats->routes_bytes) / 1e6, result->routes, jobs, iterations);
+    printf("%-16s %12s %12s %12s\n", "phase", "best ms", "median ms", "mean ms");
+    long long total = 0;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        printf("%-16s %12.3f %12.3f %12.3f\n", phase_names[p], timings[p].best / 1e6, timings[p].median / 1e6,
+               timings[p].mean / 1e6);
+        total += timings[p].best;
+    }
+    printf("%-16s %12.3f\n", "total", total / 1e6);
+    printf("Matched %d of %d resources, %zu bytes of output\n", result->matched, result->resources,
+           result->output_bytes);
+    printf("Model: %.1f KB arena; %zu names and types stored as 32-bit symbols (%.1f KB, %.1f KB as pointers) "
+           "into %zu distinct strings (%.1f KB symbol table)\n",
+           result->model_bytes / 1e3, result->identifiers, result->identifiers * sizeof(Symbol) / 1e3,
+           result->identifiers * sizeof(const char*) / 1e3, result->symbols.count, result->symbols.bytes / 1e3);
+}
+
+static void print_usage(const char* program_name) {
+    fprintf(stderr,
+            "Usage: %s [--resources N] [--attributes N] [--filters N] [--relations N] [--depth N]\n"
+            "          [--routes N] [--iterations N] [--jobs N] [--seed N] [--dir DIR] [--json FILE|-]\n"
+            "  --dir DIR: Write the tree to DIR and keep it (with --iterations 0, only generate it)\n"
+            "  --json FILE: Write the results as JSON to FILE, '-' for stdout\n",
+            program_name);
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option long_options[] = {
+        { "resources", required_argument, NULL, 'r' },
+        { "attributes", required_argument, NULL, 'a' },
+        { "filters", required_argument, NULL, 'f' },
+        { "relations", required_argument, NULL, 'l' },
+        { "depth", required_argument, NULL, 'd' },
+        { "routes", required_argument, NULL, 'R' },
+        { "iterations", required_argument, NULL, 'i' },
+        { "jobs", required_argument, NULL, 'j' },
+        { "seed", required_argument, NULL, 's' },
+        { "dir", required_argument, NULL, 'D' },
+        { "json", required_argument, NULL, 'J' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    SyntheticTreeOptions tree;
+    synthetic_tree_defaults(&tree);
+    int iterations = 5;
+    int jobs = work_pool_default_jobs();
+    const char* keep_dir = NULL;
+    const char* json_path = NULL;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:j:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'r': tree.resources = atoi(optarg); break;
+            case 'a': tree.attributes = atoi(optarg); break;
+            case 'f': tree.filters = atoi(optarg); break;
+            case 'l': tree.relations = atoi(optarg); break;
+            case 'd': tree.depth = atoi(optarg); break;
+            case 'R': tree.routes = atoi(optarg); break;
+            case 'i': iterations = atoi(optarg); break;
+            case 'j': jobs = atoi(optarg); break;
+            case 's': tree.seed = strtoull(optarg, NULL, 10); break;
+            case 'D': keep_dir = optarg; break;
+            case 'J': json_path = optarg; break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if (iterations < 0 || jobs < 1 || tree.attributes < 0 || tree.filters < 0 || tree.relations < 0) {
+        fprintf(stderr, "Error: --iterations must not be negative, counts must be positive\n");
+        return 1;
+    }
+    if (iterations == 0 && !keep_dir) {
+        fprintf(stderr, "Error: --iterations 0 only makes sense with --dir\n");
+        return 1;
+    }
+
+    char temp_dir[] = "/tmp/spec_bench.XXXXXX";
+    const char* root = keep_dir;
+    if (!root) {
+        root = mkdtemp(temp_dir);
+        if (!root) {
+            perror("mkdtemp");
+            return 1;
+        }
+    }
+
+    SyntheticTreeStats stats;
+    int status = synthetic_tree_write(root, &tree, &stats);
+    if (status == 0 && keep_dir) {
+        fprintf(stderr, "Wrote %d resource files and config/routes.rb to %s\n", stats.files, keep_dir);
+    }
+
+    char resources_dir[1024];
+    char routes_file[1024];
+    snprintf(resources_dir, sizeof(resources_dir), "%s/app/resources", root);
+    snprintf(routes_file, sizeof(routes_file), "%s/config/routes.rb", root);
+
+    long long* samples = calloc((size_t)PHASE_COUNT * (iterations ? iterations : 1), sizeof(long long));
+    RunResult result = { 0 };
+    for (int i = 0; i < iterations && status == 0; i++) {
+        long long elapsed[PHASE_COUNT];
+        status = run_once(resources_dir, routes_file, jobs, elapsed, &result);
+        for (int p = 0; p < PHASE_COUNT; p++) samples[p * iterations + i] = elapsed[p];
+    }
+
+    if (status == 0 && iterations > 0) {
+        PhaseTiming timings[PHASE_COUNT];
+        for (int p = 0; p < PHASE_COUNT; p++) timings[p] = summarize(samples + p * iterations, iterations);
+
+        if (!json_path || strcmp(json_path, "-") != 0) print_table(&stats, iterations, jobs, timings, &result);
+        if (json_path) {
+            FILE* file = strcmp(json_path, "-") == 0 ? stdout : fopen(json_path, "w");
+            if (file) {
+                write_json(file, &tree, &stats, iterations, jobs, timings, &result);
+                if (file != stdout) fclose(file);
+            } else {
+                fprintf(stderr, "Error: Cannot write %s\n", json_path);
+                status = -1;
+            }
+        }
+        if (result.matched != tree.resources) {
+            fprintf(stderr, "Error: Only %d of %d resources matched a route\n", result.matched, tree.resources);
+            status = -1;
+        }
+    }
+
+    free(samples);
+    if (!keep_dir) synthetic_tree_remove(root);
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,334 @@
+#define _XOPEN_SOURCE 700
+#include "synthetic_tree.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <ftw.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define MAX_DEPTH 16
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+static uint64_t rng_state;
+
+static uint64_t next_random(void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static int random_below(int bound) {
+    return (int)(next_random() % (uint64_t)bound);
+}
+
+__attribute__((format(printf, 2, 3)))
+static void buffer_printf(Buffer* buffer, const char* format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        size_t room = buffer->capacity - buffer->size;
+        int written = vsnprintf(buffer->data + buffer->size, room, format, args);
+        va_end(args);
+        if (written < 0) return;
+        if ((size_t)written < room) {
+            buffer->size += written;
+            return;
+        }
+        buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        while (buffer->capacity - buffer->size <= (size_t)written) buffer->capacity *= 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+        if (!buffer->data) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+}
+
+static const char* const words[] = {
+    "name", "status", "amount", "currency", "created_at", "updated_at", "uuid", "external_id",
+    "description", "enabled", "priority", "region", "country", "balance", "limit", "email",
+};
+#define WORD_COUNT (int)(sizeof(words) / sizeof(words[0]))
+
+// Resource names get the index appended, so none of them ends in "y" or "s"
+static const char* const nouns[] = {
+    "invoice", "account", "payment", "customer", "contract", "order", "shipment", "ticket",
+    "device", "gateway", "tariff", "report", "session", "contact", "product", "voucher",
+};
+#define NOUN_COUNT (int)(sizeof(nouns) / sizeof(nouns[0]))
+
+// Two namespaces per level below "api", so a tree of depth d has 2^(d-1) leaves
+static const char* const namespace_pairs[][2] = {
+    { "api", "api" }, { "v1", "v2" }, { "admin", "customer" }, { "billing", "catalog" },
+    { "internal", "partner" }, { "reports", "settings" },
+};
+#define NAMED_LEVELS (int)(sizeof(namespace_pairs) / sizeof(namespace_pairs[0]))
+
+static void namespace_name(int level, int leaf, char* name, size_t size) {
+    int branch = level == 0 ? 0 : (leaf >> (level - 1)) & 1;
+    if (level < NAMED_LEVELS) {
+        snprintf(name, size, "%s", namespace_pairs[level][branch]);
+    } else {
+        snprintf(name, size, "ns%d%c", level, branch ? 'b' : 'a');
+    }
+}
+
+static void append_camel(Buffer* out, const char* snake) {
+    int upper = 1;
+    for (const char* p = snake; *p; p++) {
+        if (*p == '_') {
+            upper = 1;
+            continue;
+        }
+        buffer_printf(out, "%c", upper ? toupper((unsigned char)*p) : *p);
+        upper = 0;
+    }
+}
+
+static void resource_name(int index, char* name, size_t size) {
+    snprintf(name, size, "%s%d", nouns[index % NOUN_COUNT], index);
+}
+
+// One resource file: DSL declarations mixed with comments and method bodies,
+// which is what real resources in large apps look like.
+static void generate_resource(Buffer* out, const SyntheticTreeOptions* options, int index, int leaf) {
+    char name[64];
+    resource_name(index, name, sizeof(name));
+
+    buffer_printf(out, "# frozen_string_literal: true\n\n");
+    buffer_printf(out, "# Exposes %s over JSON:API.\n# Keep the filters in sync with the index page.\n", name);
+    buffer_printf(out, "class ");
+    for (int level = 0; level < options->depth; level++) {
+        char segment[32];
+        namespace_name(level, leaf, segment, sizeof(segment));
+        append_camel(out, segment);
+        buffer_printf(out, "::");
+    }
+    append_camel(out, name);
+    buffer_printf(out, "Resource < BaseResource\n");
+    buffer_printf(out, "  model_name '");
+    append_camel(out, name);
+    buffer_printf(out, "'\n  paginator :paged\n");
+    buffer_printf(out, "  default_sort field: '%s', direction: :desc\n\n", words[random_below(WORD_COUNT)]);
+
+    buffer_printf(out, "  attributes :id");
+    for (int i = 0; i < options->attributes; i++) {
+        buffer_printf(out, ",%s:%s_%d", i % 4 == 3 ? "\n             " : " ", words[i % WORD_COUNT], i);
+    }
+    buffer_printf(out, "\n\n");
+
+    for (int i = 0; i < options->filters; i++) {
+        switch (random_below(3)) {
+            case 0: buffer_printf(out, "  ransack_filter :%s_%d, type: :string\n", words[random_below(WORD_COUNT)], i); break;
+            case 1: buffer_printf(out, "  association_uuid_filter :%s_id, class_name: '%s'\n", nouns[i % NOUN_COUNT],
+                                  nouns[i % NOUN_COUNT]); break;
+            default: buffer_printf(out, "  filter :%s_%d, apply: ->(records, values, _options) { records.where(id: values) }\n",
+                                   words[random_below(WORD_COUNT)], i); break;
+        }
+    }
+    buffer_printf(out, "\n");
+
+    for (int i = 0; i < options->relations; i++) {
+        char related[64];
+        resource_name(random_below(options->resources), related, sizeof(related));
+        if (i % 2 == 0) {
+            buffer_printf(out, "  has_one :%s, foreign_key_on: :related\n", related);
+        } else {
+            buffer_printf(out, "  has_many :%ss\n", related);
+        }
+    }
+    buffer_printf(out, "\n");
+
+    int methods = 2 + random_below(5);
+    for (int m = 0; m < methods; m++) {
+        buffer_printf(out, "  # Computes the %s for the current context.\n", words[random_below(WORD_COUNT)]);
+        buffer_printf(out, "  def compute_%s_%d(context)\n", words[random_below(WORD_COUNT)], m);
+        int lines = 3 + random_below(10);
+        for (int l = 0; l < lines; l++) {
+            switch (random_below(5)) {
+                case 0: buffer_printf(out, "    value = context[:%s] || default_%s\n", words[random_below(WORD_COUNT)], words[l % WORD_COUNT]); break;
+                case 1: buffer_printf(out, "    return nil if value.blank? # nothing to do\n"); break;
+                case 2: buffer_printf(out, "    records = records.where(\"%s > ?\", value).order(:created_at)\n", words[random_below(WORD_COUNT)]); break;
+                case 3: buffer_printf(out, "    items.each do |item|\n      total += item.amount * rate\n    end\n"); break;
+                default: buffer_printf(out, "    @cache[%d] ||= { id: value, label: '%s' }\n", l, name); break;
+            }
+        }
+        buffer_printf(out, "  end\n\n");
+    }
+
+    buffer_printf(out, "  def self.creatable_fields(_context)\n    %%i[%s_0 %s_1]\n  end\n\n", words[0], words[1]);
+    buffer_printf(out, "  def self.updatable_fields(_context)\n    %%i[%s_0]\n  end\nend\n", words[0]);
+}
+
+static int make_directories(const char* path) {
+    char partial[1024];
+    size_t len = strlen(path);
+    if (len >= sizeof(partial)) return -1;
+    memcpy(partial, path, len + 1);
+    for (size_t i = 1; i <= len; i++) {
+        if (partial[i] != '/' && partial[i] != '\0') continue;
+        char saved = partial[i];
+        partial[i] = '\0';
+        if (mkdir(partial, 0755) != 0 && errno != EEXIST) return -1;
+        partial[i] = saved;
+    }
+    return 0;
+}
+
+static int write_file(const char* path, const Buffer* buffer) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot write %s\n", path);
+        return -1;
+    }
+    int status = fwrite(buffer->data, 1, buffer->size, file) == buffer->size ? 0 : -1;
+    if (fclose(file) != 0) status = -1;
+    if (status != 0) fprintf(stderr, "Error: Cannot write %s\n", path);
+    return status;
+}
+
+// Directory of leaf `leaf` below `base`: base/api/v1/admin
+static void leaf_directory(const char* base, int depth, int leaf, char* path, size_t size) {
+    size_t len = snprintf(path, size, "%s", base);
+    for (int level = 0; level < depth && len < size; level++) {
+        char segment[32];
+        namespace_name(level, leaf, segment, sizeof(segment));
+        len += snprintf(path + len, size - len, "/%s", segment);
+    }
+}
+
+void synthetic_tree_defaults(SyntheticTreeOptions* options) {
+    options->resources = 1000;
+    options->attributes = 12;
+    options->filters = 4;
+    options->relations = 3;
+    options->depth = 3;
+    options->routes = 0;
+    options->seed = 42;
+}
+
+int synthetic_tree_write(const char* root, const SyntheticTreeOptions* options, SyntheticTreeStats* stats) {
+    memset(stats, 0, sizeof(SyntheticTreeStats));
+    if (options->resources < 1 || options->depth < 1 || options->depth > MAX_DEPTH) {
+        fprintf(stderr, "Error: Need at least one resource and a depth between 1 and %d\n", MAX_DEPTH);
+        return -1;
+    }
+    rng_state = options->seed ? options->seed : 1;
+
+    int leaves = 1 << (options->depth - 1);
+    char resources_dir[512];
+    char path[1024];
+    snprintf(resources_dir, sizeof(resources_dir), "%s/app/resources", root);
+    for (int leaf = 0; leaf < leaves && leaf < options->resources; leaf++) {
+        leaf_directory(resources_dir, options->depth, leaf, path, sizeof(path));
+        if (make_directories(path) != 0) {
+            fprintf(stderr, "Error: Cannot create %s\n", path);
+            return -1;
+        }
+    }
+
+    Buffer buffer = { 0 };
+    int status = 0;
+    for (int i = 0; i < options->resources && status == 0; i++) {
+        int leaf = i % leaves;
+        buffer.size = 0;
+        generate_resource(&buffer, options, i, leaf);
+
+        char name[64];
+        resource_name(i, name, sizeof(name));
+        leaf_directory(resources_dir, options->depth, leaf, path, sizeof(path));
+        size_t len = strlen(path);
+        snprintf(path + len, sizeof(path) - len, "/%s_resource.rb", name);
+        status = write_file(path, &buffer);
+        stats->files++;
+        stats->resource_bytes += buffer.size;
+    }
+
+    // The BaseResource every resource extends, and a concern it includes
+    if (status == 0) {
+        buffer.size = 0;
+        buffer_printf(&buffer, "# frozen_string_literal: true\n\n");
+        buffer_printf(&buffer, "class BaseResource < JSONAPI::Resource\n  abstract\n  include Timestamps\n\n");
+        buffer_printf(&buffer, "  attributes :external_id\n  filter :external_id\n  paginator :offset\nend\n");
+        snprintf(path, sizeof(path), "%s/base_resource.rb", resources_dir);
+        status = write_file(path, &buffer);
+        stats->files++;
+        stats->resource_bytes += buffer.size;
+    }
+    if (status == 0) {
+        buffer.size = 0;
+        buffer_printf(&buffer, "# frozen_string_literal: true\n\nmodule Timestamps\n");
+        buffer_printf(&buffer, "  extend ActiveSupport::Concern\n\n  included do\n");
+        buffer_printf(&buffer, "    attributes :created_at, :updated_at\n    filter :created_at, type: 'datetime'\n");
+        buffer_printf(&buffer, "  end\nend\n");
+        snprintf(path, sizeof(path), "%s/concerns", resources_dir);
+        status = make_directories(path);
+        snprintf(path, sizeof(path), "%s/concerns/timestamps.rb", resources_dir);
+        if (status == 0) status = write_file(path, &buffer);
+        stats->files++;
+        stats->resource_bytes += buffer.size;
+    }
+
+    // routes.rb: one namespace chain per leaf with the resources living there;
+    // routes beyond the resources are spread over the leaves and match nothing
+    if (status == 0) {
+        buffer.size = 0;
+        buffer_printf(&buffer, "Rails.application.routes.draw do\n");
+        int extra = options->routes > options->resources ? options->routes - options->resources : 0;
+        for (int leaf = 0; leaf < leaves && leaf < options->resources + extra; leaf++) {
+            for (int level = 0; level < options->depth; level++) {
+                char segment[32];
+                namespace_name(level, leaf, segment, sizeof(segment));
+                buffer_printf(&buffer, "%*snamespace :%s do\n", 2 + level * 2, "", segment);
+            }
+            int indent = 2 + options->depth * 2;
+            for (int i = leaf; i < options->resources; i += leaves) {
+                char name[64];
+                resource_name(i, name, sizeof(name));
+                buffer_printf(&buffer, "%*sresources :%ss\n", indent, "", name);
+            }
+            for (int i = leaf; i < extra; i += leaves) {
+                buffer_printf(&buffer, "%*sresources :archive%ds, only: %%i[index show]\n", indent, "", i);
+            }
+            for (int level = options->depth - 1; level >= 0; level--) {
+                buffer_printf(&buffer, "%*send\n", 2 + level * 2, "");
+            }
+        }
+        buffer_printf(&buffer, "end\n");
+
+        snprintf(path, sizeof(path), "%s/config", root);
+        if (make_directories(path) != 0) {
+            fprintf(stderr, "Error: Cannot create %s\n", path);
+            status = -1;
+        } else {
+            snprintf(path, sizeof(path), "%s/config/routes.rb", root);
+            status = write_file(path, &buffer);
+            stats->routes_bytes = buffer.size;
+        }
+    }
+
+    free(buffer.data);
+    return status;
+}
+
+static int remove_entry(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void)st;
+    (void)type;
+    (void)ftw;
+    return remove(path);
+}
+
+int synthetic_tree_remove(const char* root) {
+    return nftw(root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
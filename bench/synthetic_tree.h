@@ -0,0 +1,38 @@
+#ifndef SYNTHETIC_TREE_H
+#define SYNTHETIC_TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Shape of a generated Rails tree. Resources are spread over the namespaces
+// `depth` levels below app/resources (api/v1/admin/...) and all extend an
+// abstract BaseResource that includes a concern from app/resources/concerns.
+// routes.rb holds one `resources` line for each of them plus unrelated ones
+// up to `routes`.
+typedef struct {
+    int resources;
+    int attributes; // Per resource
+    int filters;
+    int relations;
+    int depth;      // Namespace levels, at least 1 ("api")
+    int routes;     // `resources` lines in routes.rb; never fewer than `resources`
+    uint64_t seed;
+} SyntheticTreeOptions;
+
+typedef struct {
+    int files;
+    size_t resource_bytes;
+    size_t routes_bytes;
+} SyntheticTreeStats;
+
+void synthetic_tree_defaults(SyntheticTreeOptions* options);
+
+// Writes root/app/resources/**/*_resource.rb and root/config/routes.rb.
+// The same options always produce the same tree. Returns -1 (with a message
+// on stderr) when a file cannot be written.
+int synthetic_tree_write(const char* root, const SyntheticTreeOptions* options, SyntheticTreeStats* stats);
+
+// Deletes `root` and everything below it.
+int synthetic_tree_remove(const char* root);
+
+#endif
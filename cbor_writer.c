@@ -0,0 +1,90 @@
+#include "cbor_writer.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+
+#define CBOR_INDEFINITE 31
+#define CBOR_FALSE 0xf4
+#define CBOR_TRUE 0xf5
+#define CBOR_BREAK 0xff
+
+// Initial byte of `major` followed by the shortest big-endian encoding of `value`
+static void write_head(OutputSink* sink, int major, uint64_t value) {
+    unsigned char head[9];
+    size_t len;
+    if (value < 24) {
+        head[0] = (unsigned char)(major << 5 | value);
+        len = 1;
+    } else {
+        int bytes = value <= 0xff ? 1 : value <= 0xffff ? 2 : value <= 0xffffffffULL ? 4 : 8;
+        head[0] = (unsigned char)(major << 5 | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+        for (int i = 0; i < bytes; i++) head[bytes - i] = (unsigned char)(value >> (8 * i));
+        len = 1 + bytes;
+    }
+    output_sink_write(sink, (const char*)head, len);
+}
+
+static void write_text(OutputSink* sink, const char* str) {
+    size_t len = strlen(str);
+    write_head(sink, CBOR_TEXT, len);
+    output_sink_write(sink, str, len);
+}
+
+static void writer_begin_object(SpecEmitter* emitter) {
+    output_sink_putc(((CborWriter*)emitter)->sink, (char)(CBOR_MAP << 5 | CBOR_INDEFINITE));
+}
+
+static void writer_begin_array(SpecEmitter* emitter) {
+    output_sink_putc(((CborWriter*)emitter)->sink, (char)(CBOR_ARRAY << 5 | CBOR_INDEFINITE));
+}
+
+static void writer_end(SpecEmitter* emitter) {
+    output_sink_putc(((CborWriter*)emitter)->sink, (char)CBOR_BREAK);
+}
+
+static void writer_text(SpecEmitter* emitter, const char* value) {
+    write_text(((CborWriter*)emitter)->sink, value);
+}
+
+static void writer_boolean(SpecEmitter* emitter, int value) {
+    output_sink_putc(((CborWriter*)emitter)->sink, (char)(value ? CBOR_TRUE : CBOR_FALSE));
+}
+
+static void writer_integer(SpecEmitter* emitter, long long value) {
+    OutputSink* sink = ((CborWriter*)emitter)->sink;
+    // -1 - n is encoded as n; ~value computes it without overflow
+    if (value >= 0) write_head(sink, CBOR_UNSIGNED, (uint64_t)value);
+    else write_head(sink, CBOR_NEGATIVE, ~(uint64_t)value);
+}
+
+static SpecEmitter* writer_fork(const SpecEmitter* emitter, void* copy, OutputSink* sink) {
+    CborWriter* writer = memcpy(copy, emitter, sizeof(CborWriter));
+    writer->sink = sink;
+    return &writer->emitter;
+}
+
+static void writer_splice(SpecEmitter* emitter, const char* data, size_t size) {
+    output_sink_write(((CborWriter*)emitter)->sink, data, size);
+}
+
+void cbor_writer_init(CborWriter* writer, OutputSink* sink) {
+    memset(writer, 0, sizeof(CborWriter));
+    writer->emitter.begin_object = writer_begin_object;
+    writer->emitter.end_object = writer_end;
+    writer->emitter.begin_array = writer_begin_array;
+    writer->emitter.end_array = writer_end;
+    writer->emitter.key = writer_text;
+    writer->emitter.string = writer_text;
+    writer->emitter.boolean = writer_boolean;
+    writer->emitter.integer = writer_integer;
+    writer->emitter.fork_size = sizeof(CborWriter);
+    writer->emitter.fork = writer_fork;
+    writer->emitter.splice = writer_splice;
+    writer->sink = sink;
+}
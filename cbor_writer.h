@@ -0,0 +1,17 @@
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#include "output_sink.h"
+#include "spec_emitter.h"
+
+// Streams CBOR (RFC 8949) into a sink. Objects and arrays are written with
+// indefinite lengths, so no container has to be counted before it is
+// written; strings are definite-length text strings.
+typedef struct {
+    SpecEmitter emitter;
+    OutputSink* sink;
+} CborWriter;
+
+void cbor_writer_init(CborWriter* writer, OutputSink* sink);
+
+#endif
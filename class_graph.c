@@ -0,0 +1,423 @@
+#include "class_graph.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "diagnostics.h"
+#include "resource_parser.h"
+
+#define MAX_CONSTANT_LENGTH 512
+#define MAX_SEARCH_LEVELS 16
+
+typedef enum {
+    NODE_NEW,
+    NODE_RESOLVING,
+    NODE_DONE
+} NodeState;
+
+// One class or module: a parsed resource or a file loaded for a lookup
+typedef struct {
+    ResourceInfo* info;
+    const char* scope; // Module nesting names are looked up from, "Api::V1"
+    const ResourceSets* sets;
+    NodeState state;
+    int shares_parent; // Adds nothing, so `sets` is the superclass's
+} ClassNode;
+
+// Constant name, "<scope>\t<name>" lookup or "\t<path>" file key -> node,
+// or -1 for a lookup known to fail
+typedef struct {
+    const char* key;
+    int node;
+} GraphSlot;
+
+typedef struct {
+    ApiSpec* spec;
+    ClassNode* nodes;
+    int node_count;
+    int node_capacity;
+    GraphSlot* slots;
+    size_t capacity;
+    size_t used;
+    Arena scratch; // Keys and loaded ResourceInfo structs
+    ClassGraphSummary* summary;
+    int failed;
+} ClassGraph;
+
+static uint64_t hash_key(const char* key) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const char* p = key; *p; p++) hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    return hash;
+}
+
+static GraphSlot* find_slot(GraphSlot* slots, size_t capacity, const char* key) {
+    size_t mask = capacity - 1;
+    for (size_t i = hash_key(key) & mask;; i = (i + 1) & mask) {
+        if (!slots[i].key || strcmp(slots[i].key, key) == 0) return &slots[i];
+    }
+}
+
+static const GraphSlot* lookup_key(const ClassGraph* graph, const char* key) {
+    const GraphSlot* slot = find_slot(graph->slots, graph->capacity, key);
+    return slot->key ? slot : NULL;
+}
+
+// Maps `key` to `node` unless the key is taken; the table stays below half full
+static void insert_key(ClassGraph* graph, const char* key, int node) {
+    if ((graph->used + 1) * 2 > graph->capacity) {
+        size_t capacity = graph->capacity ? graph->capacity * 2 : 64;
+        GraphSlot* slots = calloc(capacity, sizeof(GraphSlot));
+        if (!slots) {
+            graph->failed = 1;
+            return;
+        }
+        for (size_t i = 0; i < graph->capacity; i++) {
+            if (graph->slots[i].key) *find_slot(slots, capacity, graph->slots[i].key) = graph->slots[i];
+        }
+        free(graph->slots);
+        graph->slots = slots;
+        graph->capacity = capacity;
+    }
+
+    GraphSlot* slot = find_slot(graph->slots, graph->capacity, key);
+    if (slot->key) return;
+    slot->key = arena_intern_cstr(&graph->scratch, key);
+    if (!slot->key) {
+        graph->failed = 1;
+        return;
+    }
+    slot->node = node;
+    graph->used++;
+}
+
+// "Api::V1" of "Api::V1::UserResource"; "" at the top level
+static const char* scope_of(ClassGraph* graph, const char* name) {
+    const char* separator = NULL;
+    for (const char* p = name; (p = strstr(p, "::")); p += 2) separator = p;
+    if (!separator) return "";
+    return arena_intern(&graph->scratch, name, separator - name);
+}
+
+static int add_node(ClassGraph* graph, ResourceInfo* info, const char* scope) {
+    if (graph->node_count == graph->node_capacity) {
+        int capacity = graph->node_capacity ? graph->node_capacity * 2 : 64;
+        ClassNode* nodes = realloc(graph->nodes, capacity * sizeof(ClassNode));
+        if (!nodes) {
+            graph->failed = 1;
+            return -1;
+        }
+        graph->nodes = nodes;
+        graph->node_capacity = capacity;
+    }
+    ClassNode* node = &graph->nodes[graph->node_count];
+    node->info = info;
+    node->scope = scope;
+    node->sets = NULL;
+    node->state = NODE_NEW;
+    node->shares_parent = 0;
+    return graph->node_count++;
+}
+
+// "Api::AuditLogging" -> "api/audit_logging"
+static void constant_file_name(const char* name, char* out, size_t size) {
+    size_t pos = 0;
+    size_t len = strlen(name);
+    for (size_t i = 0; i < len && pos + 2 < size; i++) {
+        char c = name[i];
+        if (c == ':' && i + 1 < len && name[i + 1] == ':') {
+            out[pos++] = '/';
+            i++;
+            continue;
+        }
+        if (isupper((unsigned char)c)) {
+            // Word boundary before "Logging" in "AuditLogging" and before "Log" in "HTTPLog"
+            int boundary = i > 0 && (islower((unsigned char)name[i - 1]) || isdigit((unsigned char)name[i - 1]) ||
+                                     (isupper((unsigned char)name[i - 1]) && islower((unsigned char)name[i + 1])));
+            if (boundary && pos > 0 && out[pos - 1] != '/') out[pos++] = '_';
+            c = (char)tolower((unsigned char)c);
+        }
+        out[pos++] = c;
+    }
+    out[pos] = '\0';
+}
+
+static int is_file(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// Parses the file defining `constant` into a new node, searching the
+// directory of `from_path` and its ancestors. Returns -1 when there is none.
+static int load_constant(ClassGraph* graph, const char* constant, const char* from_path) {
+    char file_name[MAX_CONSTANT_LENGTH];
+    constant_file_name(constant, file_name, sizeof(file_name));
+
+    char directory[MAX_CONSTANT_LENGTH];
+    snprintf(directory, sizeof(directory), "%s", from_path ? from_path : "");
+    char* slash = strrchr(directory, '/');
+    if (slash) *slash = '\0';
+    else strcpy(directory, ".");
+
+    for (int level = 0; level < MAX_SEARCH_LEVELS; level++) {
+        static const char* const layouts[] = { "%s/%s.rb", "%s/concerns/%s.rb" };
+        for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+            char path[MAX_CONSTANT_LENGTH * 2 + 16];
+            snprintf(path, sizeof(path), layouts[l], directory, file_name);
+            if (!is_file(path)) continue;
+
+            char key[sizeof(path) + 1];
+            snprintf(key, sizeof(key), "\t%s", path);
+            const GraphSlot* known = lookup_key(graph, key);
+            if (known) return known->node;
+
+            ResourceInfo* info = arena_calloc(&graph->scratch, 1, sizeof(ResourceInfo));
+            if (!info || parse_resource_file(path, info, &graph->spec->arena, NULL) != 0) return -1;
+            // A class file knows its own name; a concern is the constant that was asked for
+            int node = add_node(graph, info, scope_of(graph, has_text(info->declared_name) ? info->declared_name : constant));
+            if (node < 0) return -1;
+            insert_key(graph, key, node);
+            insert_key(graph, constant, node);
+            graph->summary->files_loaded++;
+            return node;
+        }
+
+        // Up one directory; stop at the top of a relative or absolute path
+        slash = strrchr(directory, '/');
+        if (slash && slash != directory) {
+            *slash = '\0';
+        } else if (strcmp(directory, ".") != 0 && !slash) {
+            strcpy(directory, ".");
+        } else {
+            break;
+        }
+    }
+    return -1;
+}
+
+// Node for `name` as written in `from` inside `scope`, like Ruby's lexical
+// constant lookup: "Api::V1::Name", then "Api::Name", then "Name"
+static int lookup(ClassGraph* graph, const char* scope, const ResourceInfo* from, const char* name, const char* what) {
+    if (strncmp(name, "JSONAPI::", 9) == 0 || strncmp(name, "ActiveSupport::", 15) == 0) return -1;
+
+    char key[MAX_CONSTANT_LENGTH * 2];
+    snprintf(key, sizeof(key), "%s\t%s", scope, name);
+    const GraphSlot* memo = lookup_key(graph, key);
+    if (memo) return memo->node;
+
+    const char* scopes[MAX_SEARCH_LEVELS];
+    int scope_count = 0;
+    if (strncmp(name, "::", 2) == 0) {
+        name += 2;
+        scopes[scope_count++] = "";
+    } else {
+        while (scope_count < MAX_SEARCH_LEVELS - 1) {
+            scopes[scope_count++] = scope;
+            if (!scope[0]) break;
+            scope = scope_of(graph, scope);
+            if (!scope) break;
+        }
+        if (scope_count == 0 || scopes[scope_count - 1][0]) scopes[scope_count++] = "";
+    }
+
+    char candidates[MAX_SEARCH_LEVELS][MAX_CONSTANT_LENGTH];
+    int node = -1;
+    for (int i = 0; i < scope_count && node < 0; i++) {
+        snprintf(candidates[i], sizeof(candidates[i]), "%s%s%s", scopes[i], scopes[i][0] ? "::" : "", name);
+        const GraphSlot* slot = lookup_key(graph, candidates[i]);
+        if (slot) node = slot->node;
+    }
+    for (int i = 0; i < scope_count && node < 0; i++) {
+        node = load_constant(graph, candidates[i], from->source_path);
+    }
+
+    if (node < 0) {
+        graph->summary->unresolved++;
+        report_diagnostic(DIAGNOSTIC_WARNING, DIAGNOSTIC_UNRESOLVED, from->source_path, "Cannot find %s %s of %s", what,
+                          name, has_text(from->class_name) ? from->class_name : "?");
+    }
+    insert_key(graph, key, node);
+    return node;
+}
+
+// Own declarations of a node, sharing its arrays
+static ResourceSets own_sets(const ResourceInfo* info) {
+    ResourceSets sets = { info->attributes, info->filters, info->relations, info->creatable_fields,
+                          info->updatable_fields, info->paginator };
+    return sets;
+}
+
+// Name of a list item: symbols are their own name, and Filter and Relation
+// start with theirs
+static Symbol item_name(const void* item) {
+    return *(const Symbol*)item;
+}
+
+// Appends the `from_count` items of `from` to the list (*items, *count),
+// replacing items of the same name in place. The list is copied into a fresh
+// array of `bound` items on its first change, so until then it can stay the
+// parent's.
+static int merge_items(Arena* arena, void** items, int* count, int* capacity, const void* from, int from_count,
+                       size_t size, int bound, int* copied) {
+    for (int i = 0; i < from_count; i++) {
+        const char* item = (const char*)from + i * size;
+        Symbol name = item_name(item);
+        int at = -1;
+        for (int j = 0; j < *count && at < 0; j++) {
+            if (name != SYMBOL_NONE && item_name((const char*)*items + j * size) == name) at = j;
+        }
+        if (at >= 0 && memcmp((const char*)*items + at * size, item, size) == 0) continue;
+
+        if (!*copied) {
+            void* copy = arena_alloc(arena, bound * size);
+            if (!copy) return -1;
+            if (*count > 0) memcpy(copy, *items, *count * size);
+            *items = copy;
+            *capacity = bound;
+            *copied = 1;
+        }
+        memcpy((char*)*items + (at >= 0 ? at : (*count)++) * size, item, size);
+    }
+    return 0;
+}
+
+#define MERGE_LIST(arena, into, from, bound, copied)                                                      \
+    merge_items((arena), (void**)&(into).items, &(into).count, &(into).capacity, (from).items, (from).count, \
+                sizeof(*(into).items), (bound), (copied))
+
+#define MAX_CONTRIBUTORS 32
+
+static const ResourceSets* store_sets(ClassGraph* graph, const ResourceSets* sets) {
+    ResourceSets* copy = arena_alloc(&graph->spec->arena, sizeof(ResourceSets));
+    if (!copy) {
+        graph->failed = 1;
+        return NULL;
+    }
+    *copy = *sets;
+    return copy;
+}
+
+static const ResourceSets* resolve(ClassGraph* graph, int index) {
+    ClassNode* node = &graph->nodes[index];
+    if (node->state == NODE_DONE) return node->sets;
+
+    ResourceInfo* info = node->info;
+    ResourceSets own = own_sets(info);
+    if (node->state == NODE_RESOLVING) {
+        report_diagnostic(DIAGNOSTIC_WARNING, DIAGNOSTIC_CYCLE, info->source_path, "Inheritance cycle through %s",
+                          has_text(info->class_name) ? info->class_name : "?");
+        return store_sets(graph, &own);
+    }
+    node->state = NODE_RESOLVING;
+
+    // Superclass first, then concerns in include order, then the class itself.
+    // Lookups may add nodes, so `node` is re-read after each.
+    const ResourceSets* base = NULL;
+    if (has_text(info->superclass)) {
+        int parent = lookup(graph, node->scope, info, info->superclass, "superclass");
+        if (parent >= 0) base = resolve(graph, parent);
+        node = &graph->nodes[index];
+    }
+    const ResourceSets* contributors[MAX_CONTRIBUTORS];
+    int count = 0;
+    for (int i = 0; i < info->includes.count && count < MAX_CONTRIBUTORS - 1; i++) {
+        int concern = lookup(graph, node->scope, info, info->includes.items[i], "module");
+        const ResourceSets* sets = concern >= 0 ? resolve(graph, concern) : NULL;
+        if (sets) contributors[count++] = sets;
+        node = &graph->nodes[index];
+    }
+    contributors[count++] = &own;
+
+    ResourceSets merged = base ? *base : (ResourceSets){ { 0 }, { 0 }, { 0 }, { 0 }, { 0 }, NULL };
+    int attributes = merged.attributes.count;
+    int filters = merged.filters.count;
+    int relations = merged.relations.count;
+    for (int i = 0; i < count; i++) {
+        attributes += contributors[i]->attributes.count;
+        filters += contributors[i]->filters.count;
+        relations += contributors[i]->relations.count;
+    }
+
+    // Arrays are copied on the first change only; until then they are the parent's
+    Arena* arena = &graph->spec->arena;
+    int copied[3] = { 0, 0, 0 };
+    int changed = 0;
+    for (int i = 0; i < count && !graph->failed; i++) {
+        const ResourceSets* from = contributors[i];
+        if (MERGE_LIST(arena, merged.attributes, from->attributes, attributes, &copied[0]) != 0 ||
+            MERGE_LIST(arena, merged.filters, from->filters, filters, &copied[1]) != 0 ||
+            MERGE_LIST(arena, merged.relations, from->relations, relations, &copied[2]) != 0) {
+            graph->failed = 1;
+        }
+        // A redefined creatable_fields, updatable_fields or paginator replaces the inherited one
+        if (from->creatable_fields.count > 0 && from->creatable_fields.items != merged.creatable_fields.items) {
+            merged.creatable_fields = from->creatable_fields;
+            changed = 1;
+        }
+        if (from->updatable_fields.count > 0 && from->updatable_fields.items != merged.updatable_fields.items) {
+            merged.updatable_fields = from->updatable_fields;
+            changed = 1;
+        }
+        if (from->paginator && from->paginator != merged.paginator) {
+            merged.paginator = from->paginator;
+            changed = 1;
+        }
+    }
+    changed |= copied[0] | copied[1] | copied[2];
+
+    node->shares_parent = base && !changed;
+    node->sets = node->shares_parent ? base : store_sets(graph, base || count > 1 ? &merged : &own);
+    node->state = NODE_DONE;
+    return node->sets;
+}
+
+int class_graph_resolve(ApiSpec* spec, ClassGraphSummary* summary) {
+    memset(summary, 0, sizeof(ClassGraphSummary));
+    ClassGraph graph;
+    memset(&graph, 0, sizeof(graph));
+    graph.spec = spec;
+    graph.summary = summary;
+    arena_init(&graph.scratch);
+
+    // Parsed resources are nodes 0..count-1, findable by their declared name
+    int count = spec->resources.count;
+    for (int i = 0; i < count && !graph.failed; i++) {
+        ResourceInfo* resource = &spec->resources.items[i];
+        const char* name = resource->declared_name;
+        add_node(&graph, resource, has_text(name) ? scope_of(&graph, name) : "");
+        if (has_text(name)) insert_key(&graph, name, i);
+        if (has_text(resource->source_path)) {
+            char key[MAX_CONSTANT_LENGTH * 2 + 16];
+            snprintf(key, sizeof(key), "\t%s", resource->source_path);
+            insert_key(&graph, key, i);
+        }
+    }
+
+    for (int i = 0; i < count && !graph.failed; i++) {
+        ResourceInfo* resource = &spec->resources.items[i];
+        const ResourceSets* sets = resolve(&graph, i);
+        if (graph.failed) break;
+        resource->resolved = sets;
+        if (graph.nodes[i].shares_parent) summary->shared++;
+        if (sets && (sets->attributes.items != resource->attributes.items ||
+                     sets->filters.items != resource->filters.items ||
+                     sets->relations.items != resource->relations.items ||
+                     sets->creatable_fields.items != resource->creatable_fields.items ||
+                     sets->updatable_fields.items != resource->updatable_fields.items ||
+                     sets->paginator != resource->paginator)) {
+            summary->inheriting++;
+        }
+    }
+
+    int status = graph.failed ? -1 : 0;
+    if (status != 0) {
+        for (int i = 0; i < count; i++) spec->resources.items[i].resolved = NULL;
+    }
+    free(graph.nodes);
+    free(graph.slots);
+    arena_reset(&graph.scratch);
+    return status;
+}
@@ -0,0 +1,29 @@
+#ifndef CLASS_GRAPH_H
+#define CLASS_GRAPH_H
+
+#include "api_spec.h"
+
+typedef struct {
+    int inheriting;   // Resources that got declarations from a superclass or concern
+    int shared;       // ... of which add nothing and share their parent's sets as is
+    int files_loaded; // Superclasses and concerns parsed from files outside the scan
+    int unresolved;   // Superclass and include names that matched nothing
+} ClassGraphSummary;
+
+// Sets ResourceInfo.resolved for every resource of `spec`: the attributes,
+// filters and relations of its superclass chain and included concerns,
+// followed by its own (a redeclared name keeps its first position), plus
+// the nearest paginator, creatable_fields and updatable_fields.
+//
+// Superclasses and concerns are looked up like Ruby constants, from the
+// innermost module of the class outwards, first among the parsed resources
+// and then as files named after the constant (Api::Auditable ->
+// api/auditable.rb, also below a concerns/ directory) in the resource's
+// directory and its ancestors. Each one is parsed and resolved once, and a
+// child that adds nothing to a set shares its parent's array instead of
+// copying it, so deep hierarchies cost little. Names under JSONAPI:: end
+// the chain quietly; others that cannot be found are reported once.
+// Everything is allocated in the spec's arena. Returns -1 when out of memory.
+int class_graph_resolve(ApiSpec* spec, ClassGraphSummary* summary);
+
+#endif
@@ -0,0 +1,39 @@
+#include "diagnostics.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_MESSAGE_LENGTH 1024
+
+static __thread DiagnosticHandler thread_handler;
+
+DiagnosticHandler diagnostics_set_handler(DiagnosticHandler handler) {
+    DiagnosticHandler previous = thread_handler;
+    thread_handler = handler;
+    return previous;
+}
+
+void report_diagnostic(DiagnosticLevel level, DiagnosticCode code, const char* source, const char* format, ...) {
+    char message[MAX_MESSAGE_LENGTH];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    if (thread_handler.fn) {
+        thread_handler.fn(thread_handler.ctx, level, code, source, message);
+    } else {
+        printf("%s: %s\n", level == DIAGNOSTIC_ERROR ? "Error" : "Warning", message);
+    }
+}
+
+const char* diagnostic_strerror(int error, char* buffer, size_t size) {
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+    // The GNU strerror_r() returns the text, in `buffer` or a static string
+    return strerror_r(error, buffer, size);
+#else
+    if (strerror_r(error, buffer, size) != 0) snprintf(buffer, size, "Error %d", error);
+    return buffer;
+#endif
+}
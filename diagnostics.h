@@ -0,0 +1,47 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stddef.h>
+
+// Errors and warnings of the parsers, the route and class matching and the
+// worker pool. Each thread reports to its own handler, so callers on
+// different threads can collect them separately; a thread without one
+// prints them to stdout as "Error: ..." and "Warning: ...".
+typedef enum {
+    DIAGNOSTIC_ERROR,
+    DIAGNOSTIC_WARNING
+} DiagnosticLevel;
+
+typedef enum {
+    DIAGNOSTIC_CANNOT_READ,    // A source file could not be opened or read
+    DIAGNOSTIC_OUT_OF_MEMORY,
+    DIAGNOSTIC_UNRESOLVED,     // A superclass or concern that no file defines
+    DIAGNOSTIC_CYCLE,          // A class that inherits from itself
+    DIAGNOSTIC_UNMATCHED,      // A resource that no route serves
+    DIAGNOSTIC_AMBIGUOUS,      // A resource that several routes serve
+    DIAGNOSTIC_REPEATED_PATH,  // A path an earlier batch already wrote
+    DIAGNOSTIC_NO_THREAD       // A worker thread that could not be started
+} DiagnosticCode;
+
+// Receives one diagnostic; `source` is the file it concerns, or NULL.
+// `message` has no "Error: " prefix and is only valid during the call.
+typedef void (*DiagnosticFn)(void* ctx, DiagnosticLevel level, DiagnosticCode code, const char* source,
+                             const char* message);
+
+typedef struct {
+    DiagnosticFn fn; // NULL prints to stdout
+    void* ctx;
+} DiagnosticHandler;
+
+// Routes the diagnostics of the calling thread to `handler` and returns
+// the one it replaces, for the caller to restore.
+DiagnosticHandler diagnostics_set_handler(DiagnosticHandler handler);
+
+void report_diagnostic(DiagnosticLevel level, DiagnosticCode code, const char* source, const char* format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+// The text of error number `error` in `buffer`, for reports from any thread
+// (strerror() may share one buffer between threads)
+const char* diagnostic_strerror(int error, char* buffer, size_t size);
+
+#endif
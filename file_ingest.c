@@ -0,0 +1,565 @@
+#include "file_ingest.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#if defined(__NR_io_uring_setup) && defined(IO_URING_OP_SUPPORTED)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef __APPLE__
+#define STAT_MTIME_NSEC(st) ((st).st_mtimespec.tv_nsec)
+#else
+#define STAT_MTIME_NSEC(st) ((st).st_mtim.tv_nsec)
+#endif
+
+#define MAX_READER_THREADS 16
+#define URING_DEPTH 64 // Files between open and the end of their read
+
+struct FileIngest {
+    char* const* paths;
+    int count;
+    int window;
+    FileIngestMode mode; // THREADS or IO_URING
+    IngestedFile* files;
+    int* ready; // Indices in the order their reads completed
+    pthread_mutex_t lock;
+    pthread_cond_t readable; // `ready_count` grew
+    pthread_cond_t room;     // `outstanding` dropped, or stopping
+    int ready_count;
+    int taken;       // Handed out to parsers
+    int started;     // Claimed by a reader
+    int outstanding; // Claimed and not yet released
+    int stopping;
+    pthread_t threads[MAX_READER_THREADS];
+    int thread_count;
+};
+
+static FileIngestMode configured_mode = FILE_INGEST_AUTO;
+
+void file_ingest_set_mode(FileIngestMode mode) {
+    configured_mode = mode;
+}
+
+FileIngestMode file_ingest_mode(void) {
+    return configured_mode;
+}
+
+const char* file_ingest_mode_name(FileIngestMode mode) {
+    switch (mode) {
+        case FILE_INGEST_AUTO:
+            return "auto";
+        case FILE_INGEST_OFF:
+            return "off";
+        case FILE_INGEST_THREADS:
+            return "threads";
+        case FILE_INGEST_IO_URING:
+            return "io_uring";
+    }
+    return "unknown";
+}
+
+int file_ingest_parse_mode(const char* name, FileIngestMode* mode) {
+    for (int m = FILE_INGEST_AUTO; m <= FILE_INGEST_IO_URING; m++) {
+        if (strcmp(name, file_ingest_mode_name((FileIngestMode)m)) == 0) {
+            *mode = (FileIngestMode)m;
+            return 0;
+        }
+    }
+    printf("Error: --ingest expects 'auto', 'off', 'threads' or 'io_uring', got '%s'\n", name);
+    return -1;
+}
+
+// Takes the next file to read, waiting while the window is full if `wait`
+// is set. Returns its index, or -1 when there is none (now).
+static int claim(FileIngest* ingest, int wait) {
+    pthread_mutex_lock(&ingest->lock);
+    while (wait && ingest->outstanding >= ingest->window && !ingest->stopping) {
+        pthread_cond_wait(&ingest->room, &ingest->lock);
+    }
+    int index = -1;
+    if (!ingest->stopping && ingest->started < ingest->count && ingest->outstanding < ingest->window) {
+        index = ingest->started++;
+        ingest->outstanding++;
+    }
+    pthread_mutex_unlock(&ingest->lock);
+    return index;
+}
+
+static void publish(FileIngest* ingest, int index) {
+    pthread_mutex_lock(&ingest->lock);
+    ingest->ready[ingest->ready_count++] = index;
+    // After the last file every parser still waiting has to learn it is done
+    if (ingest->ready_count == ingest->count) pthread_cond_broadcast(&ingest->readable);
+    else pthread_cond_signal(&ingest->readable);
+    pthread_mutex_unlock(&ingest->lock);
+}
+
+// Blocking read of a whole file; short of `size` when it shrank meanwhile
+static void read_whole(const char* path, IngestedFile* file) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        file->error = errno;
+        if (fd >= 0) close(fd);
+        return;
+    }
+    file->mtime_sec = st.st_mtime;
+    file->mtime_nsec = STAT_MTIME_NSEC(st);
+
+    size_t size = S_ISREG(st.st_mode) ? (size_t)st.st_size : 0;
+    char* data = size > 0 ? malloc(size) : NULL;
+    if (size > 0 && !data) file->error = ENOMEM;
+    size_t done = 0;
+    while (data && done < size) {
+        ssize_t n = pread(fd, data + done, size - done, (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            file->error = errno;
+            free(data);
+            data = NULL;
+            done = 0;
+        }
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    close(fd);
+    file->data = data;
+    file->size = done;
+}
+
+static void* read_files_blocking(void* ctx) {
+    FileIngest* ingest = ctx;
+    int index;
+    while ((index = claim(ingest, 1)) >= 0) {
+        read_whole(ingest->paths[index], &ingest->files[index]);
+        publish(ingest, index);
+    }
+    return NULL;
+}
+
+#ifdef HAVE_IO_URING
+
+typedef struct {
+    int fd;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    unsigned queued;    // Submission entries not yet passed to the kernel
+    unsigned in_kernel; // Entries the kernel took whose completion is not reaped yet
+} Uring;
+
+// A file between its openat/statx pair and the end of its read
+typedef struct {
+    int index; // -1 when the slot is free
+    int fd;
+    int waiting; // Completions still expected for the openat/statx pair
+    int error;
+    struct statx stx;
+    char* data;
+    size_t size;
+    size_t done;
+} UringSlot;
+
+enum {
+    URING_OPEN,
+    URING_STATX,
+    URING_READ
+};
+
+static void uring_close(Uring* ring) {
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(Uring));
+    ring->fd = -1;
+}
+
+static int uring_open(Uring* ring, unsigned entries) {
+    memset(ring, 0, sizeof(Uring));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) return -1;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        uring_close(ring);
+        return -1;
+    }
+    ring->cq_ring = single ? ring->sq_ring
+                           : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        if (ring->cq_ring == MAP_FAILED) ring->cq_ring = NULL;
+        if (ring->sqes == MAP_FAILED) ring->sqes = NULL;
+        uring_close(ring);
+        return -1;
+    }
+
+    char* sq = ring->sq_ring;
+    char* cq = ring->cq_ring;
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+// Whether the kernel implements every operation the reader submits
+static int uring_supports_reads(const Uring* ring) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, size);
+    if (!probe) return 0;
+    int supported = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    const int ops[] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ };
+    for (size_t i = 0; supported && i < sizeof(ops) / sizeof(ops[0]); i++) {
+        supported = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return supported;
+}
+
+// Queues one entry; the ring is sized so that every slot's entries fit
+static struct io_uring_sqe* uring_queue(Uring* ring, int slot, int op) {
+    unsigned tail = *ring->sq_tail + ring->queued;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = ((uint64_t)slot << 2) | (uint64_t)op;
+    ring->sq_array[index] = index;
+    ring->queued++;
+    return sqe;
+}
+
+// Submits the queued entries and waits for at least one completion
+static int uring_submit_and_wait(Uring* ring) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->queued, __ATOMIC_RELEASE);
+    unsigned to_submit = ring->queued;
+    ring->queued = 0;
+    for (;;) {
+        long submitted = syscall(__NR_io_uring_enter, ring->fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted >= 0) {
+            ring->in_kernel += (unsigned)submitted;
+            to_submit -= (unsigned)submitted;
+            if (to_submit == 0) return 0;
+            continue;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return -1;
+    }
+}
+
+// Reaps the completion of every entry the kernel took, so that nothing
+// writes into the slots once they are released; entries queued but never
+// submitted stay in the ring. Returns -1 if the ring stops answering.
+static int uring_drain(Uring* ring, UringSlot* slots) {
+    while (ring->in_kernel > 0) {
+        long result = syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (result < 0 && errno != EINTR) return -1;
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            UringSlot* state = &slots[cqe->user_data >> 2];
+            if ((cqe->user_data & 3) == URING_OPEN && cqe->res >= 0) state->fd = cqe->res;
+            ring->in_kernel--;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+static void queue_read(Uring* ring, UringSlot* slots, int slot) {
+    UringSlot* state = &slots[slot];
+    struct io_uring_sqe* sqe = uring_queue(ring, slot, URING_READ);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = state->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(state->data + state->done);
+    sqe->len = (unsigned)(state->size - state->done);
+    sqe->off = state->done;
+}
+
+static void finish_slot(FileIngest* ingest, UringSlot* state) {
+    if (state->fd >= 0) close(state->fd);
+    IngestedFile* file = &ingest->files[state->index];
+    file->mtime_sec = state->stx.stx_mtime.tv_sec;
+    file->mtime_nsec = state->stx.stx_mtime.tv_nsec;
+    file->error = state->error;
+    if (state->error) {
+        free(state->data);
+    } else {
+        file->data = state->data;
+        file->size = state->done;
+    }
+    int index = state->index;
+    memset(state, 0, sizeof(UringSlot));
+    state->index = -1;
+    state->fd = -1;
+    publish(ingest, index);
+}
+
+// Both halves of the openat/statx pair are back: read the whole file in one go
+static void start_read(FileIngest* ingest, Uring* ring, UringSlot* slots, int slot) {
+    UringSlot* state = &slots[slot];
+    state->size = S_ISREG(state->stx.stx_mode) ? (size_t)state->stx.stx_size : 0;
+    if (!state->error && state->size > 0) {
+        state->data = malloc(state->size);
+        if (!state->data) state->error = ENOMEM;
+    }
+    if (state->error || state->size == 0) {
+        finish_slot(ingest, state);
+        return;
+    }
+    queue_read(ring, slots, slot);
+}
+
+static void complete(FileIngest* ingest, Uring* ring, UringSlot* slots, const struct io_uring_cqe* cqe) {
+    int slot = (int)(cqe->user_data >> 2);
+    int op = (int)(cqe->user_data & 3);
+    UringSlot* state = &slots[slot];
+    if (op == URING_READ) {
+        if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+            queue_read(ring, slots, slot);
+        } else if (cqe->res < 0) {
+            state->error = -cqe->res;
+            finish_slot(ingest, state);
+        } else {
+            state->done += (size_t)cqe->res;
+            // A zero-length read means the file shrank since statx
+            if (cqe->res > 0 && state->done < state->size) queue_read(ring, slots, slot);
+            else finish_slot(ingest, state);
+        }
+        return;
+    }
+
+    if (cqe->res < 0 && !state->error) state->error = -cqe->res;
+    if (op == URING_OPEN && cqe->res >= 0) state->fd = cqe->res;
+    if (--state->waiting == 0) start_read(ingest, ring, slots, slot);
+}
+
+// Reads every file through one ring. Returns -1 if the ring failed; files
+// it had claimed are then finished with blocking reads.
+static int read_files_uring(FileIngest* ingest) {
+    Uring ring;
+    if (uring_open(&ring, URING_DEPTH * 2) != 0) return -1;
+    // On the heap, so that it can be leaked with the buffers if the ring fails
+    UringSlot* slots = malloc(URING_DEPTH * sizeof(UringSlot));
+    if (!slots) {
+        uring_close(&ring);
+        return -1;
+    }
+    for (int s = 0; s < URING_DEPTH; s++) {
+        memset(&slots[s], 0, sizeof(UringSlot));
+        slots[s].index = -1;
+        slots[s].fd = -1;
+    }
+
+    int in_flight = 0;
+    int status = 0;
+    for (;;) {
+        // Open and stat as many files as the depth and the window allow
+        for (int s = 0; s < URING_DEPTH; s++) {
+            if (slots[s].index >= 0) continue;
+            int index = claim(ingest, in_flight == 0);
+            if (index < 0) break;
+            const char* path = ingest->paths[index];
+            slots[s].index = index;
+            slots[s].waiting = 2;
+            in_flight++;
+
+            struct io_uring_sqe* sqe = uring_queue(&ring, s, URING_OPEN);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t)(uintptr_t)path;
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe = uring_queue(&ring, s, URING_STATX);
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t)(uintptr_t)path;
+            sqe->len = STATX_TYPE | STATX_SIZE | STATX_MTIME;
+            sqe->off = (uint64_t)(uintptr_t)&slots[s].stx;
+        }
+        if (in_flight == 0) break;
+
+        if (uring_submit_and_wait(&ring) != 0) {
+            status = -1;
+            break;
+        }
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const struct io_uring_cqe* cqe = &ring.cqes[head & *ring.cq_mask];
+            int slot = (int)(cqe->user_data >> 2);
+            ring.in_kernel--;
+            complete(ingest, &ring, slots, cqe);
+            if (slots[slot].index < 0) in_flight--;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    if (status != 0) {
+        // Reads and statx calls the kernel took may still write into the
+        // slots: wait for them, or leak the slots and their buffers if the
+        // ring no longer answers. Each claimed file is then read again.
+        int drained = uring_drain(&ring, slots) == 0;
+        uring_close(&ring);
+        for (int s = 0; s < URING_DEPTH; s++) {
+            if (slots[s].index < 0) continue;
+            if (slots[s].fd >= 0) close(slots[s].fd);
+            if (drained) free(slots[s].data);
+            read_whole(ingest->paths[slots[s].index], &ingest->files[slots[s].index]);
+            publish(ingest, slots[s].index);
+        }
+        if (drained) free(slots);
+        return -1;
+    }
+    uring_close(&ring);
+    free(slots);
+    return 0;
+}
+
+static void* read_files_ring_thread(void* ctx) {
+    FileIngest* ingest = ctx;
+    // A failed ring leaves the rest of the list to blocking reads
+    if (read_files_uring(ingest) != 0) read_files_blocking(ingest);
+    return NULL;
+}
+
+static pthread_once_t probe_once = PTHREAD_ONCE_INIT;
+static int uring_usable;
+
+static void probe_uring(void) {
+    Uring ring;
+    if (uring_open(&ring, 4) != 0) return;
+    uring_usable = uring_supports_reads(&ring);
+    uring_close(&ring);
+}
+
+#endif
+
+FileIngestMode file_ingest_resolved_mode(void) {
+    FileIngestMode mode = configured_mode;
+    if (mode == FILE_INGEST_OFF || mode == FILE_INGEST_THREADS) return mode;
+#ifdef HAVE_IO_URING
+    pthread_once(&probe_once, probe_uring);
+    if (uring_usable) return FILE_INGEST_IO_URING;
+#endif
+    return FILE_INGEST_THREADS;
+}
+
+FileIngest* file_ingest_start(char* const* paths, int count, int window) {
+    FileIngestMode mode = file_ingest_resolved_mode();
+    if (mode == FILE_INGEST_OFF) return NULL;
+
+    FileIngest* ingest = calloc(1, sizeof(FileIngest));
+    if (!ingest) return NULL;
+    ingest->paths = paths;
+    ingest->count = count;
+    ingest->window = window > 0 ? window : 1;
+    ingest->mode = mode;
+    ingest->files = calloc(count ? count : 1, sizeof(IngestedFile));
+    ingest->ready = calloc(count ? count : 1, sizeof(int));
+    if (!ingest->files || !ingest->ready) {
+        free(ingest->files);
+        free(ingest->ready);
+        free(ingest);
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) ingest->files[i].index = i;
+    pthread_mutex_init(&ingest->lock, NULL);
+    pthread_cond_init(&ingest->readable, NULL);
+    pthread_cond_init(&ingest->room, NULL);
+
+    void* (*reader)(void*) = read_files_blocking;
+    int threads = count < MAX_READER_THREADS ? count : MAX_READER_THREADS;
+#ifdef HAVE_IO_URING
+    if (mode == FILE_INGEST_IO_URING) {
+        reader = read_files_ring_thread;
+        threads = 1;
+    }
+#endif
+    if (threads > ingest->window) threads = ingest->window;
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&ingest->threads[t], NULL, reader, ingest) != 0) break;
+        ingest->thread_count++;
+    }
+    if (ingest->thread_count == 0 && count > 0) {
+        file_ingest_finish(ingest);
+        return NULL;
+    }
+    return ingest;
+}
+
+int file_ingest_next(FileIngest* ingest, IngestedFile* file) {
+    pthread_mutex_lock(&ingest->lock);
+    while (ingest->taken == ingest->ready_count && ingest->taken < ingest->count) {
+        pthread_cond_wait(&ingest->readable, &ingest->lock);
+    }
+    int index = ingest->taken < ingest->count ? ingest->ready[ingest->taken++] : -1;
+    if (index >= 0) *file = ingest->files[index];
+    pthread_mutex_unlock(&ingest->lock);
+    return index >= 0 ? 0 : -1;
+}
+
+void file_ingest_release(FileIngest* ingest, IngestedFile* file) {
+    free((void*)file->data);
+    file->data = NULL;
+    pthread_mutex_lock(&ingest->lock);
+    ingest->files[file->index].data = NULL;
+    ingest->outstanding--;
+    pthread_cond_signal(&ingest->room);
+    pthread_mutex_unlock(&ingest->lock);
+}
+
+void file_ingest_finish(FileIngest* ingest) {
+    if (!ingest) return;
+    pthread_mutex_lock(&ingest->lock);
+    ingest->stopping = 1;
+    pthread_cond_broadcast(&ingest->room);
+    pthread_mutex_unlock(&ingest->lock);
+    for (int t = 0; t < ingest->thread_count; t++) pthread_join(ingest->threads[t], NULL);
+
+    // Read but never handed out
+    for (int i = ingest->taken; i < ingest->ready_count; i++) free((void*)ingest->files[ingest->ready[i]].data);
+    pthread_cond_destroy(&ingest->room);
+    pthread_cond_destroy(&ingest->readable);
+    pthread_mutex_destroy(&ingest->lock);
+    free(ingest->ready);
+    free(ingest->files);
+    free(ingest);
+}
@@ -0,0 +1,61 @@
+#ifndef FILE_INGEST_H
+#define FILE_INGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Reads a list of files ahead of the threads that parse them. On a cold
+// page cache every open and read waits for the disk; issuing many of them
+// at once lets the device work on the next files while the parsers are busy
+// with the current ones. With io_uring one reader thread submits the
+// openat/statx pairs and reads in batches; without it a pool of reader
+// threads does the same with blocking calls.
+typedef enum {
+    FILE_INGEST_AUTO,     // io_uring where the kernel allows it, else threads
+    FILE_INGEST_OFF,      // No read-ahead: every parser maps its own files
+    FILE_INGEST_THREADS,
+    FILE_INGEST_IO_URING,
+} FileIngestMode;
+
+// One file read ahead of its parser
+typedef struct {
+    int index;        // Position in the path list
+    const char* data; // Whole content; NULL when empty or unreadable
+    size_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int error;        // errno of the failed open or read, else 0
+} IngestedFile;
+
+typedef struct FileIngest FileIngest;
+
+// Process-wide choice, set before parsing starts. IO_URING falls back to
+// THREADS when the kernel has no io_uring or forbids it.
+void file_ingest_set_mode(FileIngestMode mode);
+FileIngestMode file_ingest_mode(void);
+// What the configured mode resolves to here; the first call probes io_uring.
+FileIngestMode file_ingest_resolved_mode(void);
+const char* file_ingest_mode_name(FileIngestMode mode);
+
+// Parses a --ingest argument ("auto", "off", "threads", "io_uring");
+// prints an error and returns -1 for anything else.
+int file_ingest_parse_mode(const char* name, FileIngestMode* mode);
+
+// Starts reading `paths` in list order, with at most `window` files read
+// and not yet released, so memory stays bounded however far the readers
+// get ahead. Returns NULL when the mode is OFF or memory ran out; the
+// caller then reads the files itself.
+FileIngest* file_ingest_start(char* const* paths, int count, int window);
+
+// Blocks until a file has been read and hands it out, in the order reads
+// complete. Returns 0, or -1 once every file has been handed out. Any
+// number of threads may call it.
+int file_ingest_next(FileIngest* ingest, IngestedFile* file);
+
+// Frees the file's content and makes room for the next read.
+void file_ingest_release(FileIngest* ingest, IngestedFile* file);
+
+// Stops reading, waits for the readers and frees what was not handed out.
+void file_ingest_finish(FileIngest* ingest);
+
+#endif
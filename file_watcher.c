@@ -0,0 +1,405 @@
+#include "file_watcher.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#define MAX_WATCH_PATH 1024
+#define MAX_WATCH_DEPTH 32
+#define POLL_INTERVAL_MS 500
+
+static void change_list_add(ChangeList* changes, const char* path) {
+    if (changes->count == changes->capacity) {
+        int capacity = changes->capacity ? changes->capacity * 2 : 16;
+        char** paths = realloc(changes->paths, capacity * sizeof(char*));
+        if (!paths) return;
+        changes->paths = paths;
+        changes->capacity = capacity;
+    }
+    char* copy = strdup(path);
+    if (copy) changes->paths[changes->count++] = copy;
+}
+
+static int compare_strings(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+// Sorts the list and drops repeated paths
+static void change_list_unique(ChangeList* changes) {
+    if (changes->count < 2) return;
+    qsort(changes->paths, changes->count, sizeof(char*), compare_strings);
+    int kept = 1;
+    for (int i = 1; i < changes->count; i++) {
+        if (strcmp(changes->paths[i], changes->paths[kept - 1]) == 0) {
+            free(changes->paths[i]);
+        } else {
+            changes->paths[kept++] = changes->paths[i];
+        }
+    }
+    changes->count = kept;
+}
+
+void change_list_free(ChangeList* changes) {
+    for (int i = 0; i < changes->count; i++) free(changes->paths[i]);
+    free(changes->paths);
+    memset(changes, 0, sizeof(ChangeList));
+}
+
+// Same spelling as the resource scan: no doubled slash after a trailing one
+static int join_path(char* out, size_t size, const char* directory, const char* name) {
+    size_t len = strlen(directory);
+    const char* separator = (len > 0 && directory[len - 1] == '/') ? "" : "/";
+    int written = snprintf(out, size, "%s%s%s", directory, separator, name);
+    return written >= 0 && (size_t)written < size ? 0 : -1;
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+#ifdef __linux__
+
+// Close-after-write instead of every modify, so a save is one event
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+
+typedef struct {
+    int wd;
+    char* path;
+    int tree;      // Part of the recursively watched tree
+    int holds_file; // Contains the extra file
+} WatchDir;
+
+struct FileWatcher {
+    char* tree;
+    char* file;
+    const char* file_name; // Basename of `file`
+    int fd;
+    WatchDir* dirs;
+    int dir_count;
+    int dir_capacity;
+};
+
+static WatchDir* find_dir(FileWatcher* watcher, int wd) {
+    for (int i = 0; i < watcher->dir_count; i++) {
+        if (watcher->dirs[i].wd == wd) return &watcher->dirs[i];
+    }
+    return NULL;
+}
+
+// Registers `path` for `mask`; a directory that is already watched keeps its
+// descriptor and gains the new role
+static WatchDir* add_dir(FileWatcher* watcher, const char* path, uint32_t mask) {
+    int wd = inotify_add_watch(watcher->fd, path, mask | IN_ONLYDIR | IN_MASK_ADD);
+    if (wd < 0) {
+        printf("Warning: Cannot watch %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    WatchDir* dir = find_dir(watcher, wd);
+    if (dir) return dir;
+
+    if (watcher->dir_count == watcher->dir_capacity) {
+        int capacity = watcher->dir_capacity ? watcher->dir_capacity * 2 : 16;
+        WatchDir* dirs = realloc(watcher->dirs, capacity * sizeof(WatchDir));
+        if (!dirs) return NULL;
+        watcher->dirs = dirs;
+        watcher->dir_capacity = capacity;
+    }
+    dir = &watcher->dirs[watcher->dir_count];
+    memset(dir, 0, sizeof(WatchDir));
+    dir->wd = wd;
+    dir->path = strdup(path);
+    if (!dir->path) return NULL;
+    watcher->dir_count++;
+    return dir;
+}
+
+static void remove_dir(FileWatcher* watcher, WatchDir* dir) {
+    free(dir->path);
+    *dir = watcher->dirs[--watcher->dir_count];
+}
+
+static void add_tree(FileWatcher* watcher, const char* path, int depth) {
+    if (depth > MAX_WATCH_DEPTH) return;
+    WatchDir* watched = add_dir(watcher, path, WATCH_MASK);
+    if (!watched) return;
+    watched->tree = 1;
+
+    DIR* dir = opendir(path);
+    if (!dir) return;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char child[MAX_WATCH_PATH];
+        if (join_path(child, sizeof(child), path, entry->d_name) != 0) continue;
+
+        struct stat st;
+        int is_dir = entry->d_type == DT_DIR ||
+                     (entry->d_type == DT_UNKNOWN && lstat(child, &st) == 0 && S_ISDIR(st.st_mode));
+        if (is_dir) add_tree(watcher, child, depth + 1);
+    }
+    closedir(dir);
+}
+
+FileWatcher* file_watcher_open(const char* tree, const char* file) {
+    FileWatcher* watcher = calloc(1, sizeof(FileWatcher));
+    if (!watcher) return NULL;
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    watcher->tree = strdup(tree);
+    watcher->file = file ? strdup(file) : NULL;
+    if (watcher->fd < 0 || !watcher->tree || (file && !watcher->file)) {
+        file_watcher_close(watcher);
+        return NULL;
+    }
+
+    add_tree(watcher, tree, 0);
+
+    if (watcher->file) {
+        // Watch the directory so a save through rename is seen as well
+        char directory[MAX_WATCH_PATH];
+        const char* slash = strrchr(watcher->file, '/');
+        watcher->file_name = slash ? slash + 1 : watcher->file;
+        if (slash) snprintf(directory, sizeof(directory), "%.*s", (int)(slash - watcher->file + 1), watcher->file);
+        else strcpy(directory, ".");
+        WatchDir* dir = add_dir(watcher, directory, WATCH_MASK);
+        if (dir) dir->holds_file = 1;
+    }
+    return watcher;
+}
+
+void file_watcher_close(FileWatcher* watcher) {
+    if (!watcher) return;
+    for (int i = 0; i < watcher->dir_count; i++) free(watcher->dirs[i].path);
+    free(watcher->dirs);
+    if (watcher->fd >= 0) close(watcher->fd);
+    free(watcher->tree);
+    free(watcher->file);
+    free(watcher);
+}
+
+// Reads every queued event; returns -1 on a read error
+static int drain_events(FileWatcher* watcher, ChangeList* changes) {
+    char buffer[8192] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t length = read(watcher->fd, buffer, sizeof(buffer));
+        if (length < 0) return errno == EAGAIN || errno == EINTR ? 0 : -1;
+        if (length == 0) return 0;
+
+        for (char* p = buffer; p < buffer + length;) {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                change_list_add(changes, watcher->tree);
+                continue;
+            }
+            WatchDir* dir = find_dir(watcher, event->wd);
+            if (!dir) continue;
+            if (event->mask & IN_IGNORED) {
+                remove_dir(watcher, dir);
+                continue;
+            }
+            if (event->len == 0) continue;
+
+            if (dir->holds_file && strcmp(event->name, watcher->file_name) == 0) {
+                change_list_add(changes, watcher->file);
+            }
+            if (dir->tree && event->name[0] != '.') {
+                char path[MAX_WATCH_PATH];
+                if (join_path(path, sizeof(path), dir->path, event->name) != 0) continue;
+                // add_tree() may move `dir`, so it is not used past this point
+                if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    add_tree(watcher, path, 0);
+                }
+                change_list_add(changes, path);
+            }
+        }
+    }
+}
+
+int file_watcher_wait(FileWatcher* watcher, ChangeList* changes, int debounce_ms) {
+    struct pollfd pfd = { watcher->fd, POLLIN, 0 };
+    // A steady stream of events must not postpone the rebuild forever
+    int max_wait_ms = debounce_ms * 10 > 2000 ? debounce_ms * 10 : 2000;
+
+    while (changes->count == 0) {
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (drain_events(watcher, changes) != 0) return -1;
+
+        int64_t start = now_ms();
+        while (now_ms() - start < max_wait_ms) {
+            int ready = poll(&pfd, 1, debounce_ms);
+            if (ready < 0 && errno != EINTR) return -1;
+            if (ready == 0) break;
+            if (drain_events(watcher, changes) != 0) return -1;
+        }
+    }
+
+    change_list_unique(changes);
+    return changes->count;
+}
+
+#else
+
+// Without inotify the tree is compared against its previous stat() snapshot
+typedef struct {
+    char* path;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t size;
+} SnapshotEntry;
+
+typedef struct {
+    SnapshotEntry* entries;
+    int count;
+    int capacity;
+} Snapshot;
+
+struct FileWatcher {
+    char* tree;
+    char* file;
+    Snapshot snapshot;
+};
+
+#ifdef __APPLE__
+#define STAT_MTIME_NSEC(st) ((st).st_mtimespec.tv_nsec)
+#else
+#define STAT_MTIME_NSEC(st) 0
+#endif
+
+static void snapshot_add(Snapshot* snapshot, const char* path, const struct stat* st) {
+    if (snapshot->count == snapshot->capacity) {
+        int capacity = snapshot->capacity ? snapshot->capacity * 2 : 64;
+        SnapshotEntry* entries = realloc(snapshot->entries, capacity * sizeof(SnapshotEntry));
+        if (!entries) return;
+        snapshot->entries = entries;
+        snapshot->capacity = capacity;
+    }
+    SnapshotEntry* entry = &snapshot->entries[snapshot->count];
+    entry->path = strdup(path);
+    if (!entry->path) return;
+    entry->mtime_sec = st->st_mtime;
+    entry->mtime_nsec = STAT_MTIME_NSEC(*st);
+    entry->size = st->st_size;
+    snapshot->count++;
+}
+
+static void snapshot_free(Snapshot* snapshot) {
+    for (int i = 0; i < snapshot->count; i++) free(snapshot->entries[i].path);
+    free(snapshot->entries);
+    memset(snapshot, 0, sizeof(Snapshot));
+}
+
+static void snapshot_tree(Snapshot* snapshot, const char* path, int depth) {
+    if (depth > MAX_WATCH_DEPTH) return;
+    DIR* dir = opendir(path);
+    if (!dir) return;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char child[MAX_WATCH_PATH];
+        struct stat st;
+        if (join_path(child, sizeof(child), path, entry->d_name) != 0 || lstat(child, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) snapshot_tree(snapshot, child, depth + 1);
+        else if (S_ISREG(st.st_mode) || (stat(child, &st) == 0 && S_ISREG(st.st_mode))) snapshot_add(snapshot, child, &st);
+    }
+    closedir(dir);
+}
+
+static int compare_entries(const void* a, const void* b) {
+    return strcmp(((const SnapshotEntry*)a)->path, ((const SnapshotEntry*)b)->path);
+}
+
+static void take_snapshot(FileWatcher* watcher, Snapshot* snapshot) {
+    snapshot_tree(snapshot, watcher->tree, 0);
+    struct stat st;
+    if (watcher->file && stat(watcher->file, &st) == 0) snapshot_add(snapshot, watcher->file, &st);
+    qsort(snapshot->entries, snapshot->count, sizeof(SnapshotEntry), compare_entries);
+}
+
+// Adds every path that was added, removed or modified between the snapshots
+static void diff_snapshots(const Snapshot* before, const Snapshot* after, ChangeList* changes) {
+    int i = 0;
+    int j = 0;
+    while (i < before->count || j < after->count) {
+        int cmp = i == before->count ? 1 : j == after->count ? -1 : strcmp(before->entries[i].path, after->entries[j].path);
+        if (cmp < 0) {
+            change_list_add(changes, before->entries[i++].path);
+        } else if (cmp > 0) {
+            change_list_add(changes, after->entries[j++].path);
+        } else {
+            const SnapshotEntry* old = &before->entries[i++];
+            const SnapshotEntry* now = &after->entries[j++];
+            if (old->mtime_sec != now->mtime_sec || old->mtime_nsec != now->mtime_nsec || old->size != now->size) {
+                change_list_add(changes, now->path);
+            }
+        }
+    }
+}
+
+FileWatcher* file_watcher_open(const char* tree, const char* file) {
+    FileWatcher* watcher = calloc(1, sizeof(FileWatcher));
+    if (!watcher) return NULL;
+    watcher->tree = strdup(tree);
+    watcher->file = file ? strdup(file) : NULL;
+    if (!watcher->tree || (file && !watcher->file)) {
+        file_watcher_close(watcher);
+        return NULL;
+    }
+    take_snapshot(watcher, &watcher->snapshot);
+    return watcher;
+}
+
+void file_watcher_close(FileWatcher* watcher) {
+    if (!watcher) return;
+    snapshot_free(&watcher->snapshot);
+    free(watcher->tree);
+    free(watcher->file);
+    free(watcher);
+}
+
+int file_watcher_wait(FileWatcher* watcher, ChangeList* changes, int debounce_ms) {
+    while (changes->count == 0) {
+        usleep(POLL_INTERVAL_MS * 1000);
+        Snapshot current = { 0 };
+        take_snapshot(watcher, &current);
+        diff_snapshots(&watcher->snapshot, &current, changes);
+        snapshot_free(&watcher->snapshot);
+        watcher->snapshot = current;
+        if (changes->count == 0) continue;
+
+        // Keep collecting until the tree holds still
+        int64_t start = now_ms();
+        int max_wait_ms = debounce_ms * 10 > 2000 ? debounce_ms * 10 : 2000;
+        int before = -1;
+        while (changes->count != before && now_ms() - start < max_wait_ms) {
+            before = changes->count;
+            usleep(debounce_ms * 1000);
+            Snapshot settled = { 0 };
+            take_snapshot(watcher, &settled);
+            diff_snapshots(&watcher->snapshot, &settled, changes);
+            snapshot_free(&watcher->snapshot);
+            watcher->snapshot = settled;
+        }
+    }
+
+    change_list_unique(changes);
+    return changes->count;
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+// Reports changed paths below a directory tree and for one extra file.
+// Linux uses inotify; other systems compare stat() snapshots of the tree.
+typedef struct FileWatcher FileWatcher;
+
+typedef struct {
+    char** paths;
+    int count;
+    int capacity;
+} ChangeList;
+
+// `tree` is watched recursively; `file` (may be NULL) is watched on its own,
+// including replacement by rename as editors do on save. Returns NULL on failure.
+FileWatcher* file_watcher_open(const char* tree, const char* file);
+void file_watcher_close(FileWatcher* watcher);
+
+// Blocks until something changes, then keeps collecting until nothing has
+// changed for `debounce_ms`. Fills `changes` with the distinct paths, spelled
+// `tree` + "/" + relative path, or exactly `file`. A created, moved or deleted
+// directory is reported as the directory itself; `tree` itself stands for
+// "anything may have changed" (the event queue overflowed).
+// Returns the number of paths, or -1 on error.
+int file_watcher_wait(FileWatcher* watcher, ChangeList* changes, int debounce_ms);
+
+void change_list_free(ChangeList* changes);
+
+#endif
@@ -0,0 +1,163 @@
+#include "json_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char spaces[] = "                                                                ";
+
+static void write_indent(JsonWriter* writer, int level) {
+    if (!writer->pretty) return;
+    size_t width = (size_t)level * 2;
+    while (width > 0) {
+        size_t chunk = width < sizeof(spaces) - 1 ? width : sizeof(spaces) - 1;
+        output_sink_write(writer->sink, spaces, chunk);
+        width -= chunk;
+    }
+}
+
+void json_write_string(OutputSink* sink, const char* str) {
+    static const char hex[] = "0123456789abcdef";
+    output_sink_putc(sink, '"');
+
+    const char* run = str;
+    for (const char* p = str; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 0x20 && c != '"' && c != '\\' && c != '/') continue;
+
+        output_sink_write(sink, run, p - run);
+        run = p + 1;
+        switch (c) {
+            case '"': output_sink_write(sink, "\\\"", 2); break;
+            case '\\': output_sink_write(sink, "\\\\", 2); break;
+            case '/': output_sink_write(sink, "\\/", 2); break; // json-c escapes slashes too
+            case '\b': output_sink_write(sink, "\\b", 2); break;
+            case '\n': output_sink_write(sink, "\\n", 2); break;
+            case '\r': output_sink_write(sink, "\\r", 2); break;
+            case '\t': output_sink_write(sink, "\\t", 2); break;
+            case '\f': output_sink_write(sink, "\\f", 2); break;
+            default: {
+                char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+                output_sink_write(sink, escaped, sizeof(escaped));
+                break;
+            }
+        }
+    }
+    output_sink_write(sink, run, strlen(run));
+
+    output_sink_putc(sink, '"');
+}
+
+// Separator and indentation in front of a value; keys already wrote theirs
+static void begin_value(JsonWriter* writer) {
+    if (writer->after_key) {
+        writer->after_key = 0;
+        return;
+    }
+    if (writer->depth == 0) return;
+
+    if (writer->counts[writer->depth - 1]++ > 0) {
+        output_sink_putc(writer->sink, ',');
+        if (writer->pretty) output_sink_putc(writer->sink, '\n');
+    }
+    write_indent(writer, writer->depth);
+}
+
+static void open_container(JsonWriter* writer, char bracket) {
+    begin_value(writer);
+    output_sink_putc(writer->sink, bracket);
+    if (writer->depth == JSON_WRITER_MAX_DEPTH) {
+        writer->sink->failed = 1;
+        return;
+    }
+    writer->counts[writer->depth++] = 0;
+}
+
+static void close_container(JsonWriter* writer, char bracket) {
+    if (writer->depth == 0) return;
+    writer->depth--;
+    if (writer->pretty) {
+        if (writer->counts[writer->depth] > 0) output_sink_putc(writer->sink, '\n');
+        write_indent(writer, writer->depth);
+    }
+    output_sink_putc(writer->sink, bracket);
+}
+
+static void writer_begin_object(SpecEmitter* emitter) {
+    open_container((JsonWriter*)emitter, '{');
+}
+
+static void writer_end_object(SpecEmitter* emitter) {
+    close_container((JsonWriter*)emitter, '}');
+}
+
+static void writer_begin_array(SpecEmitter* emitter) {
+    JsonWriter* writer = (JsonWriter*)emitter;
+    open_container(writer, '[');
+    if (writer->pretty) output_sink_putc(writer->sink, '\n');
+}
+
+static void writer_end_array(SpecEmitter* emitter) {
+    close_container((JsonWriter*)emitter, ']');
+}
+
+static void writer_key(SpecEmitter* emitter, const char* key) {
+    JsonWriter* writer = (JsonWriter*)emitter;
+    if (writer->depth == 0) return;
+
+    if (writer->counts[writer->depth - 1]++ > 0) output_sink_putc(writer->sink, ',');
+    if (writer->pretty) output_sink_putc(writer->sink, '\n');
+    write_indent(writer, writer->depth);
+    json_write_string(writer->sink, key);
+    output_sink_putc(writer->sink, ':');
+    writer->after_key = 1;
+}
+
+static void writer_string(SpecEmitter* emitter, const char* value) {
+    JsonWriter* writer = (JsonWriter*)emitter;
+    begin_value(writer);
+    json_write_string(writer->sink, value);
+}
+
+static void writer_boolean(SpecEmitter* emitter, int value) {
+    JsonWriter* writer = (JsonWriter*)emitter;
+    begin_value(writer);
+    output_sink_puts(writer->sink, value ? "true" : "false");
+}
+
+static void writer_integer(SpecEmitter* emitter, long long value) {
+    JsonWriter* writer = (JsonWriter*)emitter;
+    begin_value(writer);
+    char digits[24];
+    int len = snprintf(digits, sizeof(digits), "%lld", value);
+    output_sink_write(writer->sink, digits, len);
+}
+
+// The value after a key never looks at the enclosing containers' counts
+static SpecEmitter* writer_fork(const SpecEmitter* emitter, void* copy, OutputSink* sink) {
+    JsonWriter* writer = memcpy(copy, emitter, sizeof(JsonWriter));
+    writer->sink = sink;
+    return &writer->emitter;
+}
+
+static void writer_splice(SpecEmitter* emitter, const char* data, size_t size) {
+    JsonWriter* writer = (JsonWriter*)emitter;
+    writer->after_key = 0;
+    output_sink_write(writer->sink, data, size);
+}
+
+void json_writer_init(JsonWriter* writer, OutputSink* sink, int pretty) {
+    memset(writer, 0, sizeof(JsonWriter));
+    writer->emitter.begin_object = writer_begin_object;
+    writer->emitter.end_object = writer_end_object;
+    writer->emitter.begin_array = writer_begin_array;
+    writer->emitter.end_array = writer_end_array;
+    writer->emitter.key = writer_key;
+    writer->emitter.string = writer_string;
+    writer->emitter.boolean = writer_boolean;
+    writer->emitter.integer = writer_integer;
+    writer->emitter.fork_size = sizeof(JsonWriter);
+    writer->emitter.fork = writer_fork;
+    writer->emitter.splice = writer_splice;
+    writer->sink = sink;
+    writer->pretty = pretty;
+}
@@ -0,0 +1,26 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include "output_sink.h"
+#include "spec_emitter.h"
+
+#define JSON_WRITER_MAX_DEPTH 32
+
+// Streams JSON text into a sink. The pretty layout and string escaping match
+// json_object_to_json_string_ext(JSON_C_TO_STRING_PRETTY) byte for byte, so
+// both output paths produce identical files.
+typedef struct {
+    SpecEmitter emitter;
+    OutputSink* sink;
+    int pretty;
+    int depth;
+    int counts[JSON_WRITER_MAX_DEPTH]; // Values written so far in each open container
+    int after_key;
+} JsonWriter;
+
+void json_writer_init(JsonWriter* writer, OutputSink* sink, int pretty);
+
+// Writes `str` as a quoted, escaped JSON string.
+void json_write_string(OutputSink* sink, const char* str);
+
+#endif
@@ -1,713 +1,1307 @@
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
 #include <sys/stat.h>
-#include <ctype.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
 #include <json-c/json.h>
 
-#define MAX_LINE_LENGTH 1024
-#define MAX_PATH_LENGTH 512
-#define MAX_ATTRIBUTES 100
-#define MAX_FILTERS 50
-#define MAX_RELATIONS 20
-
-typedef struct {
-    char name[64];
-    char type[32];
-    char collection[128];
-} Filter;
-
-typedef struct {
-    char name[64];
-    char relation_name[64];
-    char foreign_key_on[32];
-    char type[16]; // "has_one", "has_many"
-} Relation;
-
-typedef struct {
-    char class_name[128];
-    char model_name[64];
-    char create_form[128];
-    char attributes[MAX_ATTRIBUTES][64];
-    int attribute_count;
-    Filter filters[MAX_FILTERS];
-    int filter_count;
-    Relation relations[MAX_RELATIONS];
-    int relation_count;
-    char creatable_fields[MAX_ATTRIBUTES][64];
-    int creatable_count;
-    char updatable_fields[MAX_ATTRIBUTES][64];
-    int updatable_count;
-    char paginator[32];
-    char default_sort_field[64];
-    char default_sort_direction[8];
-} ResourceInfo;
+#include "api_spec.h"
+#include "batch_manifest.h"
+#include "class_graph.h"
+#include "file_ingest.h"
+#include "file_watcher.h"
+#include "json_writer.h"
+#include "model_schema.h"
+#include "openapi_writer.h"
+#include "output_compressor.h"
+#include "output_sink.h"
+#include "parse_cache.h"
+#include "resource_filter.h"
+#include "resource_parser.h"
+#include "resource_scan.h"
+#include "route_index.h"
+#include "routes_parser.h"
+#include "run_stats.h"
+#include "shard_files.h"
+#include "spec_diff.h"
+#include "spec_format.h"
+#include "spec_server.h"
+#include "work_pool.h"
 
+#define MAX_PATH_LENGTH 512
+#define DEFAULT_CACHE_PATH ".api_spec_cache"
+#define WATCH_DEBOUNCE_MS 150
+#define DEFAULT_STATS_TOP 10
+
+static const struct {
+    const char* name;
+    const char* extension;
+} spec_formats[] = {
+    [SPEC_FORMAT_JSON] = { "json", ".json" },
+    [SPEC_FORMAT_JSON_MIN] = { "json-min", ".json" },
+    [SPEC_FORMAT_YAML] = { "yaml", ".yaml" },
+    [SPEC_FORMAT_CBOR] = { "cbor", ".cbor" },
+};
+
+// Fans one output stream out to the output file (through its compressor)
+// and, with --print, uncompressed to stdout
 typedef struct {
-    char path[128];
-    char controller[128];
-    char action[32];
-    char method[16];  // Increased from 8 to 16 to safely hold "GET|POST"
-    char resource_name[64];
-} RouteInfo;
+    OutputCompressor* file;
+    FILE* echo;
+} OutputTargets;
+
+static int write_targets(void* ctx, const char* data, size_t size) {
+    OutputTargets* targets = ctx;
+    if (output_compressor_write(targets->file, data, size) != 0) return -1;
+    if (targets->echo && output_sink_write_file(targets->echo, data, size) != 0) return -1;
+    return 0;
+}
 
+// SpecEmitter that builds a json-c document from the walker's events
 typedef struct {
-    RouteInfo routes[100];
-    int route_count;
-    ResourceInfo resources[50];
-    int resource_count;
-} ApiSpec;
-
-// Utility functions
-char* trim_whitespace(char* str) {
-    char* end;
-    while(isspace((unsigned char)*str)) str++;
-    if(*str == 0) return str;
-    end = str + strlen(str) - 1;
-    while(end > str && isspace((unsigned char)*end)) end--;
-    end[1] = '\0';
-    return str;
-}
-
-char* extract_quoted_string(const char* line, const char* pattern) {
-    char* start = strstr(line, pattern);
-    if (!start) return NULL;
-
-    start = strchr(start, '\'');
-    if (!start) start = strchr(strstr(line, pattern), '"');
-    if (!start) return NULL;
-
-    start++;
-    char* end = strchr(start, start[-1]);
-    if (!end) return NULL;
-
-    int len = end - start;
-    char* result = malloc(len + 1);
-    strncpy(result, start, len);
-    result[len] = '\0';
-    return result;
-}
-
-void parse_attributes_line(const char* line, ResourceInfo* resource) {
-    const char* start = strstr(line, "attributes");
-    if (!start) return;
-
-    start = strchr(start, ':');
-    if (!start) return;
-
-    char* line_copy = strdup(line);
-    char* token = strtok(line_copy, " :,");
-    int found_attributes = 0;
-
-    while (token != NULL && resource->attribute_count < MAX_ATTRIBUTES) {
-        if (found_attributes && token[0] != '\0' && strcmp(token, "attributes") != 0) {
-            // Clean the token
-            char* clean_token = trim_whitespace(token);
-            if (strlen(clean_token) > 0 && clean_token[0] == ':') {
-                clean_token++;
-            }
-            if (strlen(clean_token) > 0) {
-                strncpy(resource->attributes[resource->attribute_count], clean_token, 63);
-                resource->attributes[resource->attribute_count][63] = '\0';
-                resource->attribute_count++;
-            }
-        }
-        if (strcmp(token, "attributes") == 0) {
-            found_attributes = 1;
-        }
-        token = strtok(NULL, " :,");
+    SpecEmitter emitter;
+    json_object* stack[JSON_WRITER_MAX_DEPTH];
+    int depth;
+    const char* key;
+    json_object* root;
+} DomBuilder;
+
+static void dom_add(DomBuilder* builder, json_object* value) {
+    if (builder->depth == 0) {
+        if (!builder->root) builder->root = json_object_get(value);
+        json_object_put(value);
+        return;
+    }
+    json_object* parent = builder->stack[builder->depth - 1];
+    if (json_object_is_type(parent, json_type_array)) {
+        json_object_array_add(parent, value);
+    } else {
+        json_object_object_add(parent, builder->key, value);
     }
+}
 
-    free(line_copy);
+static void dom_push(DomBuilder* builder, json_object* container) {
+    dom_add(builder, json_object_get(container));
+    if (builder->depth < JSON_WRITER_MAX_DEPTH) builder->stack[builder->depth++] = container;
+    json_object_put(container);
 }
 
-void parse_filter_line(const char* line, ResourceInfo* resource) {
-    if (strstr(line, "ransack_filter") || strstr(line, "association_uuid_filter") ||
-        (strstr(line, "filter") && !strstr(line, "def"))) {
+static void dom_begin_object(SpecEmitter* emitter) {
+    dom_push((DomBuilder*)emitter, json_object_new_object());
+}
 
-        if (resource->filter_count >= MAX_FILTERS) return;
+static void dom_begin_array(SpecEmitter* emitter) {
+    dom_push((DomBuilder*)emitter, json_object_new_array());
+}
 
-        Filter* filter = &resource->filters[resource->filter_count];
-        memset(filter, 0, sizeof(Filter)); // Initialize the filter structure
+static void dom_end(SpecEmitter* emitter) {
+    DomBuilder* builder = (DomBuilder*)emitter;
+    if (builder->depth > 0) builder->depth--;
+}
 
-        // Extract filter name
-        char* name_start = strchr(line, ':');
-        if (name_start) {
-            name_start++;
-            char* name_end = strchr(name_start, ',');
-            if (!name_end) name_end = strchr(name_start, '\n');
-            if (!name_end) name_end = name_start + strlen(name_start);
+static void dom_key(SpecEmitter* emitter, const char* key) {
+    ((DomBuilder*)emitter)->key = key;
+}
 
-            size_t name_len = name_end - name_start;
-            if (name_len > 0 && name_len < sizeof(filter->name)) {
-                strncpy(filter->name, name_start, name_len);
-                filter->name[sizeof(filter->name) - 1] = '\0'; // Ensure null termination
-                // Remove trailing whitespace
-                char* p = filter->name + strcspn(filter->name, " \t\n\r");
-                *p = '\0';
-            }
-        }
+static void dom_string(SpecEmitter* emitter, const char* value) {
+    dom_add((DomBuilder*)emitter, json_object_new_string(value));
+}
 
-        // Extract type
-        char* type_str = strstr(line, "type:");
-        if (type_str) {
-            char* extracted_type = extract_quoted_string(type_str, "type:");
-            if (extracted_type) {
-                strncpy(filter->type, extracted_type, sizeof(filter->type) - 1);
-                filter->type[sizeof(filter->type) - 1] = '\0';
-                free(extracted_type);
-            }
-        } else if (strstr(line, "association_uuid_filter")) {
-            strncpy(filter->type, "uuid", sizeof(filter->type) - 1);
-            filter->type[sizeof(filter->type) - 1] = '\0';
-        } else {
-            strncpy(filter->type, "string", sizeof(filter->type) - 1);
-            filter->type[sizeof(filter->type) - 1] = '\0';
-        }
+static void dom_boolean(SpecEmitter* emitter, int value) {
+    dom_add((DomBuilder*)emitter, json_object_new_boolean(value));
+}
 
-        // Extract collection
-        char* collection_str = strstr(line, "collection:");
-        if (collection_str) {
-            char* extracted_collection = extract_quoted_string(collection_str, "collection:");
-            if (extracted_collection) {
-                strncpy(filter->collection, extracted_collection, sizeof(filter->collection) - 1);
-                filter->collection[sizeof(filter->collection) - 1] = '\0';
-                free(extracted_collection);
-            }
-        }
+static void dom_integer(SpecEmitter* emitter, long long value) {
+    dom_add((DomBuilder*)emitter, json_object_new_int64(value));
+}
 
-        resource->filter_count++;
+json_object* generate_json_api_spec(const ApiSpec* spec, const char* path_prefix) {
+    DomBuilder builder = {
+        // A document is built in order, so the builder cannot fork
+        { dom_begin_object, dom_end, dom_begin_array, dom_end, dom_key, dom_string, dom_boolean, dom_integer, 0, NULL,
+          NULL },
+        { NULL }, 0, NULL, NULL
+    };
+    if (openapi_emit_prefix(spec, &builder.emitter, path_prefix) != 0) {
+        json_object_put(builder.root);
+        return NULL;
     }
+    return builder.root;
 }
 
-void parse_relation_line(const char* line, ResourceInfo* resource) {
-    if (strstr(line, "has_one") || strstr(line, "has_many")) {
-        if (resource->relation_count >= MAX_RELATIONS) return;
-
-        Relation* relation = &resource->relations[resource->relation_count];
+// Output goes to a temporary file next to `path` that replaces it with a
+// rename, so readers never see a half-written spec
+static FILE* open_output(const char* path, char* temp_path, size_t size) {
+    int written = snprintf(temp_path, size, "%s.tmp.%ld", path, (long)getpid());
+    if (written < 0 || (size_t)written >= size) return NULL;
+    return fopen(temp_path, "w");
+}
 
-        // Determine relation type
-        if (strstr(line, "has_one")) {
-            strcpy(relation->type, "has_one");
-        } else {
-            strcpy(relation->type, "has_many");
-        }
+static int commit_output(FILE* file, const char* temp_path, const char* path, int status) {
+    if (fclose(file) != 0) status = -1;
+    if (status == 0 && rename(temp_path, path) != 0) status = -1;
+    if (status != 0) remove(temp_path);
+    return status;
+}
 
-        // Extract relation name
-        char* name_start = strchr(line, ':');
-        if (name_start) {
-            name_start++;
-            char* name_end = strchr(name_start, ',');
-            if (!name_end) name_end = strchr(name_start, '\n');
-            if (!name_end) name_end = name_start + strlen(name_start);
-
-            int name_len = name_end - name_start;
-            if (name_len > 0 && name_len < 64) {
-                strncpy(relation->name, name_start, name_len);
-                relation->name[name_len] = '\0';
-                relation->name[strcspn(relation->name, " \t\n")] = '\0';
-            }
-        }
+typedef struct {
+    const char* resource_dir;
+    const char* routes_file;
+    const char* output_path;
+    const ModelSchema* schema; // --schema; NULL leaves attributes untyped
+    int jobs;
+    int print;
+    int use_dom;
+    SpecFormat format;
+    Compression compression;
+    SpecServer* server; // --serve; specs are published to it instead of written
+    const ResourceFilter* filter; // --include, --exclude and --path-prefix
+    const char* shard_dir; // --shard; one file per path and schema below it instead of one spec
+} RunOptions;
 
-        // Extract relation_name
-        char* relation_name_str = strstr(line, "relation_name:");
-        if (relation_name_str) {
-            char* extracted_name = extract_quoted_string(relation_name_str, "relation_name:");
-            if (extracted_name) {
-                strncpy(relation->relation_name, extracted_name, 63);
-                relation->relation_name[63] = '\0';
-                free(extracted_name);
-            }
-        }
+typedef struct {
+    const ApiSpec* spec;
+    const char* path_prefix;
+    int jobs;
+} SpecWalk;
+
+// The OpenAPI walker on `jobs` threads, keeping the paths below
+// `path_prefix` unless it is NULL
+static int walk_spec(void* ctx, SpecEmitter* emitter) {
+    const SpecWalk* walk = ctx;
+    return openapi_emit_parallel(walk->spec, emitter, walk->path_prefix, walk->jobs);
+}
 
-        // Extract foreign_key_on
-        char* foreign_key_str = strstr(line, "foreign_key_on:");
-        if (foreign_key_str) {
-            char* extracted_key = extract_quoted_string(foreign_key_str, "foreign_key_on:");
-            if (extracted_key) {
-                strncpy(relation->foreign_key_on, extracted_key, 31);
-                relation->foreign_key_on[31] = '\0';
-                free(extracted_key);
-            }
-        }
+// Streams the document `walk` emits to the output file (and stdout)
+// without building it in memory
+static int write_spec_stream(const RunOptions* options, RunStats* stats, SpecWalkFn walk, void* ctx) {
+    char temp_path[MAX_PATH_LENGTH];
+    FILE* output_file = open_output(options->output_path, temp_path, sizeof(temp_path));
+    if (!output_file) return -1;
 
-        resource->relation_count++;
+    OutputCompressor compressor;
+    if (output_compressor_open(&compressor, options->compression, output_file) != 0) {
+        return commit_output(output_file, temp_path, options->output_path, -1);
     }
-}
-
-void parse_resource_file(const char* filename, ResourceInfo* resource) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        printf("Error: Cannot open file %s\n", filename);
-        return;
+    OutputTargets targets = { &compressor, options->print ? stdout : NULL };
+    OutputSink sink;
+    if (output_sink_init(&sink, 1 << 16, write_targets, &targets) != 0) {
+        output_compressor_finish(&compressor);
+        return commit_output(output_file, temp_path, options->output_path, -1);
     }
 
-    char line[MAX_LINE_LENGTH];
-    int in_creatable_fields = 0;
-    int in_updatable_fields = 0;
-
-    // Extract class name from filename
-    const char* basename = strrchr(filename, '/');
-    if (basename) basename++;
-    else basename = filename;
+    run_stats_begin(stats, STATS_SERIALIZE);
+    int status = spec_format_emit(options->format, &sink, walk, ctx);
+    if (output_sink_flush(&sink) != 0) status = -1;
+    if (output_compressor_finish(&compressor) != 0) status = -1;
+    run_stats_end(stats, STATS_SERIALIZE);
+    if (stats) stats->output_bytes = compressor.bytes_out;
 
-    strncpy(resource->class_name, basename, 127);
-    resource->class_name[127] = '\0';
-
-    // Remove .rb extension
-    char* ext = strstr(resource->class_name, ".rb");
-    if (ext) *ext = '\0';
-
-    while (fgets(line, sizeof(line), file)) {
-        char* trimmed_line = trim_whitespace(line);
+    output_sink_free(&sink);
+    return commit_output(output_file, temp_path, options->output_path, status);
+}
 
-        // Parse model_name
-        if (strstr(trimmed_line, "model_name")) {
-            char* model_name = extract_quoted_string(trimmed_line, "model_name");
-            if (model_name) {
-                strncpy(resource->model_name, model_name, 63);
-                resource->model_name[63] = '\0';
-                free(model_name);
-            }
+// Builds the json-c document first and serializes it in one piece
+static int write_spec_dom(const ApiSpec* spec, const RunOptions* options, RunStats* stats) {
+    run_stats_begin(stats, STATS_GENERATE);
+    json_object* json_spec = generate_json_api_spec(spec, options->filter->path_prefix);
+    run_stats_end(stats, STATS_GENERATE);
+
+    run_stats_begin(stats, STATS_SERIALIZE);
+    int flags = options->format == SPEC_FORMAT_JSON ? JSON_C_TO_STRING_PRETTY : JSON_C_TO_STRING_PLAIN;
+    const char* json_string = json_spec ? json_object_to_json_string_ext(json_spec, flags) : NULL;
+    if (!json_string) {
+        json_object_put(json_spec);
+        return -1;
+    }
+    if (options->print) printf("%s\n", json_string);
+
+    int status = -1;
+    char temp_path[MAX_PATH_LENGTH];
+    FILE* output_file = open_output(options->output_path, temp_path, sizeof(temp_path));
+    OutputCompressor compressor = { 0 };
+    if (output_file) {
+        status = output_compressor_open(&compressor, options->compression, output_file);
+        if (status == 0) {
+            status = output_compressor_write(&compressor, json_string, strlen(json_string));
+            if (status == 0) status = output_compressor_write(&compressor, "\n", 1);
+            if (output_compressor_finish(&compressor) != 0) status = -1;
         }
+        status = commit_output(output_file, temp_path, options->output_path, status);
+    }
+    run_stats_end(stats, STATS_SERIALIZE);
+    if (stats) stats->output_bytes = compressor.bytes_out;
+    json_object_put(json_spec);
+    return status;
+}
 
-        // Parse create_form
-        if (strstr(trimmed_line, "create_form")) {
-            char* create_form = extract_quoted_string(trimmed_line, "create_form");
-            if (create_form) {
-                strncpy(resource->create_form, create_form, 127);
-                resource->create_form[127] = '\0';
-                free(create_form);
-            }
-        }
+// Renders the files of a sharded spec in the output format
+typedef struct {
+    SpecFormat format;
+    const OpenApiShards* shards;
+    const uint64_t* hashes; // Of every shard, for the index
+} ShardRender;
 
-        // Parse paginator
-        if (strstr(trimmed_line, "paginator")) {
-            char* paginator = extract_quoted_string(trimmed_line, "paginator");
-            if (paginator) {
-                strncpy(resource->paginator, paginator, 31);
-                resource->paginator[31] = '\0';
-                free(paginator);
-            } else if (strstr(trimmed_line, ":paged")) {
-                strcpy(resource->paginator, "paged");
-            }
-        }
+typedef struct {
+    const OpenApiShards* shards;
+    int index;
+} ShardWalk;
 
-        // Parse default_sort
-        if (strstr(trimmed_line, "default_sort") && strstr(trimmed_line, "field")) {
-            char* field_str = strstr(trimmed_line, "field:");
-            if (field_str) {
-                char* field = extract_quoted_string(field_str, "field:");
-                if (field) {
-                    strncpy(resource->default_sort_field, field, 63);
-                    resource->default_sort_field[63] = '\0';
-                    free(field);
-                }
-            }
+static int walk_shard(void* ctx, SpecEmitter* emitter) {
+    const ShardWalk* walk = ctx;
+    openapi_shards_emit(walk->shards, walk->index, emitter);
+    return 0;
+}
 
-            char* direction_str = strstr(trimmed_line, "direction:");
-            if (direction_str) {
-                if (strstr(direction_str, ":desc")) {
-                    strcpy(resource->default_sort_direction, "desc");
-                } else if (strstr(direction_str, ":asc")) {
-                    strcpy(resource->default_sort_direction, "asc");
-                }
-            }
-        }
+static void render_shard(void* ctx, int index, OutputSink* sink) {
+    const ShardRender* render = ctx;
+    ShardWalk walk = { render->shards, index };
+    spec_format_emit(render->format, sink, walk_shard, &walk);
+}
 
-        // Parse attributes
-        if (strstr(trimmed_line, "attributes") && !strstr(trimmed_line, "def")) {
-            parse_attributes_line(trimmed_line, resource);
-        }
+static int walk_shard_index(void* ctx, SpecEmitter* emitter) {
+    const ShardRender* render = ctx;
+    openapi_shards_emit_index(render->shards, render->hashes, emitter);
+    return 0;
+}
 
-        // Parse filters
-        parse_filter_line(trimmed_line, resource);
-
-        // Parse relations
-        parse_relation_line(trimmed_line, resource);
-
-        // Parse creatable_fields
-        if (strstr(trimmed_line, "def self.creatable_fields")) {
-            in_creatable_fields = 1;
-        } else if (in_creatable_fields && strstr(trimmed_line, "end")) {
-            in_creatable_fields = 0;
-        } else if (in_creatable_fields && strstr(trimmed_line, "%i[")) {
-            // Parse the fields array
-            char* start = strstr(trimmed_line, "%i[");
-            char* end = strchr(start, ']');
-            if (start && end) {
-                start += 3; // Skip "%i["
-                char* field_str = malloc(end - start + 1);
-                strncpy(field_str, start, end - start);
-                field_str[end - start] = '\0';
-
-                char* token = strtok(field_str, " ");
-                while (token && resource->creatable_count < MAX_ATTRIBUTES) {
-                    if (strlen(token) > 0) {
-                        strncpy(resource->creatable_fields[resource->creatable_count], token, 63);
-                        resource->creatable_fields[resource->creatable_count][63] = '\0';
-                        resource->creatable_count++;
-                    }
-                    token = strtok(NULL, " ");
-                }
-                free(field_str);
-            }
-        }
+static void render_shard_index(void* ctx, int index, OutputSink* sink) {
+    (void)index;
+    spec_format_emit(((const ShardRender*)ctx)->format, sink, walk_shard_index, ctx);
+}
 
-        // Parse updatable_fields (similar logic)
-        if (strstr(trimmed_line, "def self.updatable_fields")) {
-            in_updatable_fields = 1;
-        } else if (in_updatable_fields && strstr(trimmed_line, "end")) {
-            in_updatable_fields = 0;
-        } else if (in_updatable_fields && strstr(trimmed_line, "%i[")) {
-            // Parse the fields array
-            char* start = strstr(trimmed_line, "%i[");
-            char* end = strchr(start, ']');
-            if (start && end) {
-                start += 3; // Skip "%i["
-                char* field_str = malloc(end - start + 1);
-                strncpy(field_str, start, end - start);
-                field_str[end - start] = '\0';
-
-                char* token = strtok(field_str, " ");
-                while (token && resource->updatable_count < MAX_ATTRIBUTES) {
-                    if (strlen(token) > 0) {
-                        strncpy(resource->updatable_fields[resource->updatable_count], token, 63);
-                        resource->updatable_fields[resource->updatable_count][63] = '\0';
-                        resource->updatable_count++;
-                    }
-                    token = strtok(NULL, " ");
-                }
-                free(field_str);
-            }
-        }
+// Writes one file per path item and schema below --shard, then the index of
+// their hashes, leaving alone every file whose content is unchanged and
+// removing those of paths and schemas that are gone
+static int write_spec_shards(const ApiSpec* spec, const RunOptions* options, RunStats* stats) {
+    const char* directory = options->shard_dir;
+    const char* extension = spec_formats[options->format].extension;
+    run_stats_begin(stats, STATS_SERIALIZE);
+    OpenApiShards* shards = openapi_shards_open(spec, options->filter->path_prefix, extension, options->jobs);
+    int count = shards ? openapi_shard_count(shards) : 0;
+    ShardFile* files = shards ? calloc(count + 1, sizeof(ShardFile)) : NULL;
+    uint64_t* hashes = shards ? malloc(count * sizeof(uint64_t)) : NULL;
+    char index_path[64];
+    snprintf(index_path, sizeof(index_path), "index%s", extension);
+
+    ShardSummary summary = { 0 };
+    int status = files && hashes ? 0 : -1;
+    if (status == 0) {
+        for (int i = 0; i < count; i++) files[i].path = openapi_shard(shards, i)->file;
+        ShardRender render = { options->format, shards, NULL };
+        status = shard_files_write(directory, files, count, render_shard, &render, options->jobs, &summary);
+    }
+    // The index holds the hashes of the others, so it comes last
+    if (status == 0) {
+        for (int i = 0; i < count; i++) hashes[i] = files[i].hash;
+        files[count].path = index_path;
+        ShardRender render = { options->format, shards, hashes };
+        status = shard_files_write(directory, &files[count], 1, render_shard_index, &render, 1, &summary);
     }
+    if (status == 0) {
+        shard_files_prune(directory, "paths", files, count + 1, extension, &summary);
+        shard_files_prune(directory, "schemas", files, count + 1, extension, &summary);
+        printf("Wrote %d of %d spec files (%d unchanged, %d removed)\n", summary.written, count + 1,
+               summary.unchanged, summary.removed);
+    }
+    run_stats_end(stats, STATS_SERIALIZE);
+    if (stats) stats->output_bytes = summary.bytes_written;
 
-    fclose(file);
+    free(files);
+    free(hashes);
+    openapi_shards_free(shards);
+    return status;
 }
 
-void parse_routes_file(const char* filename, ApiSpec* spec) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        printf("Error: Cannot open routes file %s\n", filename);
-        return;
+static int write_spec(const ApiSpec* spec, const RunOptions* options, RunStats* stats) {
+    if (options->server) {
+        run_stats_begin(stats, STATS_SERIALIZE);
+        long number = spec_server_publish(options->server, spec);
+        run_stats_end(stats, STATS_SERIALIZE);
+        return number < 0 ? -1 : 0;
     }
+    if (options->use_dom) return write_spec_dom(spec, options, stats);
+    if (options->shard_dir) return write_spec_shards(spec, options, stats);
+    SpecWalk walk = { spec, options->filter->path_prefix, options->jobs };
+    return write_spec_stream(options, stats, walk_spec, &walk);
+}
 
-    char line[MAX_LINE_LENGTH];
-    char namespace_stack[10][64];
-    int namespace_depth = 0;
-
-    while (fgets(line, sizeof(line), file)) {
-        char* trimmed_line = trim_whitespace(line);
+// Merges inherited and included declarations into every resource
+static void resolve_classes(ApiSpec* spec, RunStats* stats) {
+    ClassGraphSummary summary;
+    run_stats_begin(stats, STATS_RESOLVE_CLASSES);
+    int status = class_graph_resolve(spec, &summary);
+    run_stats_end(stats, STATS_RESOLVE_CLASSES);
+    if (status != 0) {
+        printf("Error: Out of memory while resolving superclasses and concerns\n");
+    } else if (summary.inheriting > 0 || summary.files_loaded > 0) {
+        printf("Resolved %d resources from superclasses and concerns (%d sharing their parent's, %d files loaded, "
+               "%d names not found)\n", summary.inheriting, summary.shared, summary.files_loaded, summary.unresolved);
+    }
+}
 
-        // Skip empty lines and comments
-        if (strlen(trimmed_line) == 0 || trimmed_line[0] == '#') {
-            continue;
-        }
+// Reads the --schema file; returns -1 when it cannot be read
+static int load_schema(ModelSchema* schema, const char* path, RunStats* stats) {
+    printf("Parsing schema file: %s\n", path);
+    run_stats_begin(stats, STATS_PARSE_SCHEMA);
+    int status = model_schema_load(schema, path, stats ? &stats->schema : NULL);
+    run_stats_end(stats, STATS_PARSE_SCHEMA);
+    if (status == 0) printf("Read %d tables with %d columns\n", schema->table_count, schema->column_count);
+    return status;
+}
 
-        // Handle namespace declarations
-        if (strstr(trimmed_line, "namespace") && strchr(trimmed_line, ':')) {
-            char* namespace_start = strchr(trimmed_line, ':');
-            if (namespace_start) {
-                namespace_start++;
-                char* namespace_end = strstr(namespace_start, " do");
-                if (!namespace_end) namespace_end = strchr(namespace_start, '{');
-                if (!namespace_end) namespace_end = strchr(namespace_start, ' ');
-                if (namespace_end && namespace_depth < 9) {
-                    int len = namespace_end - namespace_start;
-                    if (len > 0 && len < 63) {
-                        strncpy(namespace_stack[namespace_depth], namespace_start, len);
-                        namespace_stack[namespace_depth][len] = '\0';
-                        // Remove quotes if present
-                        if (namespace_stack[namespace_depth][0] == '\'' || namespace_stack[namespace_depth][0] == '"') {
-                            memmove(namespace_stack[namespace_depth], namespace_stack[namespace_depth] + 1, len);
-                            namespace_stack[namespace_depth][len-2] = '\0';
-                        }
-                        namespace_depth++;
-                    }
-                }
-            }
-        }
+// Points every resource at its table so attributes and filters get column types
+static void type_resources(ApiSpec* spec, const ModelSchema* schema, RunStats* stats, int report) {
+    if (!schema) return;
+    ModelMatchSummary summary;
+    run_stats_begin(stats, STATS_PARSE_SCHEMA);
+    model_schema_match(schema, spec, &summary);
+    run_stats_end(stats, STATS_PARSE_SCHEMA);
+    if (report) printf("Typed %d resources from their tables (%d without a table)\n", summary.typed, summary.untyped);
+}
 
-        // Handle end statements (close namespace) - be more careful
-        if ((strcmp(trimmed_line, "end") == 0 || strstr(trimmed_line, "end ")) && namespace_depth > 0) {
-            namespace_depth--;
+// Re-parses one resource file, or drops it from the spec when it is gone
+static void refresh_resource(ApiSpec* spec, const char* path) {
+    int index = api_spec_find_resource(spec, path);
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (index >= 0) {
+            printf("Removed resource: %s\n", spec->resources.items[index].class_name);
+            api_spec_remove_resource(spec, index);
         }
+        return;
+    }
 
-        // Handle resource declarations
-        if (strstr(trimmed_line, "resources") && strchr(trimmed_line, ':')) {
-            if (spec->route_count >= 100) continue;
-
-            RouteInfo* route = &spec->routes[spec->route_count];
-            memset(route, 0, sizeof(RouteInfo)); // Initialize to zero
-
-            // Extract resource name
-            char* resource_start = strchr(trimmed_line, ':');
-            if (resource_start) {
-                resource_start++;
-                char* resource_end = strchr(resource_start, ',');
-                if (!resource_end) resource_end = strstr(resource_start, " do");
-                if (!resource_end) resource_end = strchr(resource_start, ' ');
-                if (!resource_end) resource_end = resource_start + strlen(resource_start);
-
-                int len = resource_end - resource_start;
-                if (len > 0 && len < 63) {
-                    strncpy(route->resource_name, resource_start, len);
-                    route->resource_name[len] = '\0';
-                    route->resource_name[strcspn(route->resource_name, " \t\n\r")] = '\0';
-
-                    // Remove quotes if present
-                    if (route->resource_name[0] == '\'' || route->resource_name[0] == '"') {
-                        memmove(route->resource_name, route->resource_name + 1, strlen(route->resource_name));
-                        int name_len = strlen(route->resource_name);
-                        if (name_len > 0 && (route->resource_name[name_len-1] == '\'' || route->resource_name[name_len-1] == '"')) {
-                            route->resource_name[name_len-1] = '\0';
-                        }
-                    }
-
-                    // Build full path from namespace stack - check buffer limits
-                    strcpy(route->path, "/api");
-                    for (int i = 0; i < namespace_depth && strlen(route->path) < 100; i++) {
-                        if (strlen(route->path) + strlen(namespace_stack[i]) + 2 < 127) {
-                            strcat(route->path, "/");
-                            strcat(route->path, namespace_stack[i]);
-                        }
-                    }
-                    if (strlen(route->path) + strlen(route->resource_name) + 2 < 127) {
-                        strcat(route->path, "/");
-                        strcat(route->path, route->resource_name);
-                    }
+    ResourceInfo parsed;
+    memset(&parsed, 0, sizeof(parsed));
+    if (parse_resource_file(path, &parsed, &spec->arena, NULL) != 0) return;
 
-                    // Set default HTTP methods for RESTful resources
-                    strcpy(route->method, "GET|POST");
+    if (index < 0) {
+        ResourceInfo* slot = api_spec_insert_resource(spec, -index - 1);
+        if (!slot) return;
+        *slot = parsed;
+    } else {
+        spec->resources.items[index] = parsed;
+    }
+    printf("Updated resource: %s\n", parsed.class_name);
+}
 
-                    spec->route_count++;
-                }
-            }
+// Drops every resource below a removed directory
+static void remove_resources_below(ApiSpec* spec, const char* directory) {
+    size_t len = strlen(directory);
+    for (int i = spec->resources.count - 1; i >= 0; i--) {
+        const char* path = spec->resources.items[i].source_path;
+        if (path && strncmp(path, directory, len) == 0 && (path[len] == '/' || directory[len - 1] == '/')) {
+            printf("Removed resource: %s\n", spec->resources.items[i].class_name);
+            api_spec_remove_resource(spec, i);
         }
     }
+}
 
-    fclose(file);
+// Whether the filter keeps a new or changed resource file
+static int selected(const ApiSpec* spec, const RunOptions* options, const char* path) {
+    if (!options->filter->path_prefix) return resource_filter_matches(options->filter, options->resource_dir, path);
+    PathList files = { 0 };
+    path_list_add(&files, path);
+    int kept = files.count == 1 && resource_filter_apply(options->filter, options->resource_dir, spec, &files) == 0;
+    path_list_free(&files);
+    return kept;
 }
 
-void scan_resource_files(const char* directory, ApiSpec* spec) {
-    DIR* dir = opendir(directory);
-    if (!dir) {
-        printf("Error: Cannot open directory %s\n", directory);
+static void apply_change(ApiSpec* spec, const RunOptions* options, const char* path, int* routes_changed) {
+    if (strcmp(path, options->routes_file) == 0) {
+        *routes_changed = 1;
+        return;
+    }
+    if (strcmp(path, options->resource_dir) == 0) {
+        // Events were lost; start over from the directory tree
+        printf("Rescanning %s\n", path);
+        spec->resources.count = 0;
+        free(scan_resource_files(path, spec, options->jobs, NULL, options->filter, NULL));
         return;
     }
 
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != NULL && spec->resource_count < 50) {
-        if (strstr(entry->d_name, "_resource.rb")) {
-            char filepath[MAX_PATH_LENGTH];
-            snprintf(filepath, sizeof(filepath), "%s/%s", directory, entry->d_name);
-
-            ResourceInfo* resource = &spec->resources[spec->resource_count];
-            memset(resource, 0, sizeof(ResourceInfo));
-
-            parse_resource_file(filepath, resource);
-            spec->resource_count++;
-
-            printf("Parsed resource: %s\n", resource->class_name);
+    struct stat st;
+    int exists = stat(path, &st) == 0;
+    if (exists && S_ISDIR(st.st_mode)) {
+        PathList files = { 0 };
+        collect_resource_files(path, &files);
+        for (int i = 0; i < files.count; i++) {
+            if (selected(spec, options, files.paths[i])) refresh_resource(spec, files.paths[i]);
         }
+        path_list_free(&files);
+    } else if (is_resource_path(path)) {
+        if (!exists || selected(spec, options, path)) refresh_resource(spec, path);
+    } else if (!exists) {
+        remove_resources_below(spec, path);
     }
-
-    closedir(dir);
 }
 
-json_object* generate_json_api_spec(const ApiSpec* spec) {
-    json_object* root = json_object_new_object();
-    if (!root) return NULL;
+// Keeps the spec in memory and rewrites it whenever the resource tree or the
+// routes file changes; only the changed files are parsed again. The watcher
+// is opened before the first scan so no edit in between goes unnoticed.
+static int watch_resources(ApiSpec* spec, const RunOptions* options, FileWatcher* watcher) {
+    printf("\nWatching %s and %s for changes (Ctrl-C to stop)\n", options->resource_dir, options->routes_file);
+    fflush(stdout);
+
+    size_t compacted_size = spec->arena.bytes_used;
+    ChangeList changes = { 0 };
+    while (file_watcher_wait(watcher, &changes, WATCH_DEBOUNCE_MS) >= 0) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        int routes_changed = 0;
+        const char* directory = NULL;
+        for (int i = 0; i < changes.count; i++) {
+            // Paths are sorted, so files of a new directory follow it and were already parsed
+            const char* path = changes.paths[i];
+            size_t len = directory ? strlen(directory) : 0;
+            if (directory && strncmp(path, directory, len) == 0 && path[len] == '/') continue;
+
+            apply_change(spec, options, path, &routes_changed);
+            struct stat st;
+            directory = stat(path, &st) == 0 && S_ISDIR(st.st_mode) ? path : NULL;
+        }
+        change_list_free(&changes);
+
+        if (routes_changed) {
+            printf("Parsing routes file: %s\n", options->routes_file);
+            spec->routes.count = 0;
+            parse_routes_file(options->routes_file, spec, NULL);
+            // The routes decide which resources a path prefix keeps
+            if (options->filter->path_prefix) {
+                printf("Rescanning %s\n", options->resource_dir);
+                spec->resources.count = 0;
+                free(scan_resource_files(options->resource_dir, spec, options->jobs, NULL, options->filter, NULL));
+            }
+        }
+        RouteMatchSummary matches;
+        match_resource_routes(spec, &matches);
+        type_resources(spec, options->schema, NULL, 0);
+
+        // Replaced resources leave their strings behind in the arena
+        api_spec_compact_if_grown(spec, &compacted_size);
+        // A changed parent or concern affects every descendant, so all are resolved again
+        resolve_classes(spec, NULL);
+
+        int status = write_spec(spec, options, NULL);
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+        if (status == 0 && options->server) {
+            printf("API specification published on %s (%d resources, %.1f ms)\n", options->output_path,
+                   spec->resources.count, elapsed_ms);
+        } else if (status == 0) {
+            printf("API specification written to %s (%d resources, %.1f ms)\n", options->output_path,
+                   spec->resources.count, elapsed_ms);
+        } else {
+            printf("Error: Could not write to %s\n", options->output_path);
+        }
+        fflush(stdout);
+    }
 
-    json_object* openapi = json_object_new_string("3.0.0");
-    json_object_object_add(root, "openapi", openapi);
+    change_list_free(&changes);
+    file_watcher_close(watcher);
+    printf("Error: Watching %s failed\n", options->resource_dir);
+    return 1;
+}
 
-    // Info section
-    json_object* info = json_object_new_object();
-    json_object* title = json_object_new_string("Rails JSON:API Specification");
-    json_object* version = json_object_new_string("1.0.0");
-    json_object_object_add(info, "title", title);
-    json_object_object_add(info, "version", version);
-    json_object_object_add(root, "info", info);
+// Restores the routes from the cache or parses them
+static CacheStamp parse_routes(const char* routes_file, ApiSpec* spec, const ParseCache* cache, RunStats* stats) {
+    printf("Parsing routes file: %s\n", routes_file);
+    CacheStamp routes_stamp = { 0 };
+    run_stats_begin(stats, STATS_PARSE_ROUTES);
+    if (!cache || parse_cache_routes(cache, routes_file, spec, &routes_stamp) != PARSE_CACHE_HIT) {
+        parse_routes_file(routes_file, spec, stats ? &stats->routes : NULL);
+    }
+    run_stats_end(stats, STATS_PARSE_ROUTES);
+    return routes_stamp;
+}
 
-    // Paths section
-    json_object* paths = json_object_new_object();
+// Rewrites the cache unless everything came from it unchanged or `filtered`
+// (only some files were parsed, and the cache keeps the others), and
+// reports hits and misses
+static void update_cache(const char* cache_path, const ParseCache* cache, const ApiSpec* spec,
+                         const CacheStamp* stamps, const char* routes_file, const CacheStamp* routes_stamp,
+                         int filtered) {
+    int hits = routes_stamp->result == PARSE_CACHE_HIT;
+    int misses = routes_stamp->result == PARSE_CACHE_MISS;
+    int cached = 0;
+    int stale = routes_stamp->rehashed;
+    for (int i = 0; i < spec->resources.count; i++) {
+        if (stamps[i].result == PARSE_CACHE_HIT) hits++;
+        if (stamps[i].result == PARSE_CACHE_MISS) misses++;
+        if (stamps[i].result != PARSE_CACHE_UNREADABLE) cached++;
+        stale |= stamps[i].rehashed;
+    }
+    // Nothing to write when every file came from the cache as it was and none disappeared
+    if (!filtered && (misses > 0 || stale || cached != cache->entry_count || routes_stamp->result != PARSE_CACHE_HIT)) {
+        parse_cache_save(cache_path, spec, stamps, routes_file, routes_stamp);
+    }
+    printf("Parse cache: %d hits, %d misses\n", hits, misses);
+}
 
-    for (int i = 0; i < spec->resource_count; i++) {
-        const ResourceInfo* resource = &spec->resources[i];
+typedef struct {
+    const BatchManifest* manifest;
+    ApiSpec* views;
+    const RunOptions* options;
+    int* status;
+} BatchJob;
+
+static void write_batch_task(void* ctx, size_t index, int worker_id) {
+    (void)worker_id;
+    BatchJob* job = ctx;
+    RunOptions options = *job->options;
+    options.output_path = job->manifest->items[index].output_path;
+    options.jobs = 1; // The specs are already written in parallel
+    job->status[index] = write_spec(&job->views[index], &options, NULL);
+}
 
-        // Find matching route
-        const char* resource_path = NULL;
-        char default_path[256];
+// Generates every spec of a manifest from one parse: resource files shared
+// by several entries and the routes file are parsed once into `spec`, each
+// entry is matched against its own view of it, and the specs are written
+// in parallel. Returns the process exit code.
+static int run_batch(const char* manifest_path, const RunOptions* options, ApiSpec* spec, ParseCache* cache,
+                     const char* cache_path, RunStats* stats) {
+    BatchManifest manifest;
+    if (batch_manifest_load(&manifest, manifest_path) != 0) {
+        batch_manifest_free(&manifest);
+        return 1;
+    }
 
-        for (int j = 0; j < spec->route_count; j++) {
-            if (strstr(resource->class_name, spec->routes[j].resource_name) ||
-                strstr(spec->routes[j].resource_name, resource->model_name)) {
-                resource_path = spec->routes[j].path;
-                break;
-            }
-        }
+    printf("Scanning resource files of %d specs in: %s\n", manifest.count, manifest_path);
+    run_stats_begin(stats, STATS_SCAN);
+    int status = batch_manifest_collect(&manifest);
+    run_stats_end(stats, STATS_SCAN);
+
+    ApiSpec* views = calloc(manifest.count, sizeof(ApiSpec));
+    int* statuses = calloc(manifest.count, sizeof(int));
+    RouteMatchSummary* matches = calloc(manifest.count, sizeof(RouteMatchSummary));
+    if (status != 0 || !views || !statuses || !matches) {
+        printf("Error: Out of memory while preparing batch %s\n", manifest_path);
+        free(views);
+        free(statuses);
+        free(matches);
+        batch_manifest_free(&manifest);
+        return 1;
+    }
 
-        if (!resource_path) {
-            // Generate default path - be safe with string operations
-            int written = snprintf(default_path, sizeof(default_path), "/api/v1/%s",
-                                  strlen(resource->model_name) > 0 ? resource->model_name : "resource");
-            if (written >= sizeof(default_path)) {
-                strcpy(default_path, "/api/v1/resource"); // fallback
-            }
-            resource_path = default_path;
+    FileParseStats* file_stats = run_stats_files(stats, manifest.files.count);
+    run_stats_begin(stats, STATS_PARSE_RESOURCES);
+    CacheStamp* stamps = parse_resource_files(&manifest.files, spec, options->jobs, cache, file_stats);
+    run_stats_end(stats, STATS_PARSE_RESOURCES);
+    for (int i = 0; i < spec->resources.count; i++) {
+        printf("Parsed resource: %s\n", spec->resources.items[i].class_name);
+    }
+    resolve_classes(spec, stats);
+    type_resources(spec, options->schema, stats, 1);
+    CacheStamp routes_stamp = parse_routes(options->routes_file, spec, cache, stats);
+
+    // Matching prints warnings, so it runs entry by entry; writing is parallel
+    run_stats_begin(stats, STATS_MATCH_ROUTES);
+    for (int e = 0; e < manifest.count; e++) {
+        const BatchEntry* entry = &manifest.items[e];
+        printf("Matching routes of %s\n", entry->output_path);
+        if (batch_spec_view(entry, spec, &views[e]) != 0) {
+            statuses[e] = -1;
+            continue;
         }
-
-        json_object* path_obj = json_object_new_object();
-        if (!path_obj) continue;
-
-        // GET method (list)
-        json_object* get_method = json_object_new_object();
-        json_object* get_summary = json_object_new_string("List resources");
-        json_object_object_add(get_method, "summary", get_summary);
-
-        // Add parameters for filters
-        if (resource->filter_count > 0) {
-            json_object* parameters = json_object_new_array();
-            for (int f = 0; f < resource->filter_count && f < MAX_FILTERS; f++) {
-                json_object* param = json_object_new_object();
-                if (!param) continue;
-
-                json_object* param_name = json_object_new_string(resource->filters[f].name);
-                json_object* param_in = json_object_new_string("query");
-                json_object* param_required = json_object_new_boolean(0);
-
-                json_object* param_schema = json_object_new_object();
-                const char* filter_type = strlen(resource->filters[f].type) > 0 ?
-                                         resource->filters[f].type : "string";
-                json_object* param_type = json_object_new_string(filter_type);
-                json_object_object_add(param_schema, "type", param_type);
-
-                json_object_object_add(param, "name", param_name);
-                json_object_object_add(param, "in", param_in);
-                json_object_object_add(param, "required", param_required);
-                json_object_object_add(param, "schema", param_schema);
-
-                json_object_array_add(parameters, param);
-            }
-            json_object_object_add(get_method, "parameters", parameters);
+        match_resource_routes(&views[e], &matches[e]);
+    }
+    run_stats_end(stats, STATS_MATCH_ROUTES);
+
+    printf("Generating %d JSON API specifications...\n", manifest.count);
+    run_stats_begin(stats, STATS_SERIALIZE);
+    BatchJob job = { &manifest, views, options, statuses };
+    work_pool_run(options->jobs, manifest.count, write_batch_task, &job);
+    run_stats_end(stats, STATS_SERIALIZE);
+
+    int failed = 0;
+    int listed = 0;
+    printf("\n");
+    for (int e = 0; e < manifest.count; e++) {
+        const BatchEntry* entry = &manifest.items[e];
+        listed += entry->file_count;
+        if (statuses[e] != 0) {
+            printf("Error: Could not write to %s\n", entry->output_path);
+            failed++;
+            continue;
         }
+        struct stat output;
+        if (stats && stat(entry->output_path, &output) == 0) stats->output_bytes += (size_t)output.st_size;
+        printf("%s: %d resources, %d routes, %d matched (%d ambiguous, %d unmatched)\n", entry->output_path,
+               views[e].resources.count, views[e].routes.count, matches[e].matched, matches[e].ambiguous,
+               matches[e].unmatched);
+    }
+    printf("\nWrote %d of %d specs from %d resource files (%d shared) and %d routes, each parsed once\n",
+           manifest.count - failed, manifest.count, spec->resources.count, listed - spec->resources.count,
+           spec->routes.count);
+
+    if (cache && stamps) update_cache(cache_path, cache, spec, stamps, options->routes_file, &routes_stamp, 0);
+    for (int e = 0; e < manifest.count; e++) api_spec_reset(&views[e]);
+    free(stamps);
+    free(views);
+    free(statuses);
+    free(matches);
+    batch_manifest_free(&manifest);
+    return failed ? 1 : 0;
+}
 
-        json_object_object_add(path_obj, "get", get_method);
-
-        // POST method (create) - only if creatable_fields exist
-        if (resource->creatable_count > 0) {
-            json_object* post_method = json_object_new_object();
-            json_object* post_summary = json_object_new_string("Create resource");
-            json_object_object_add(post_method, "summary", post_summary);
-
-            json_object_object_add(path_obj, "post", post_method);
-        }
+// Resource files --low-memory parses, matches and writes at a time
+#define LOW_MEMORY_BATCH 512
 
-        json_object_object_add(paths, resource_path, path_obj);
+typedef struct {
+    const RunOptions* options;
+    const PathList* files;
+    const ApiSpec* routes; // Parsed once; every batch is matched against them
+    Arena* names;          // Lives until the statistics are reported
+    const ParseCache* cache;
+    FileParseStats* file_stats;
+    RunStats* stats; // Times the phases of every batch; may be NULL
+    int resources;
+    ClassGraphSummary classes;
+    ModelMatchSummary typed;
+    RouteMatchSummary matches;
+    OpenApiStreamSummary stream;
+} LowMemoryRun;
+
+// Parses files [first, first + count) into `batch` and gets them ready to
+// be written, the way a single run prepares the whole tree
+static int load_batch(LowMemoryRun* run, const RouteIndex* index, ApiSpec* batch, int first, int count,
+                      RunStats* stats) {
+    PathList slice = { run->files->paths + first, count, count };
+    FileParseStats* file_stats = run->file_stats ? run->file_stats + first : NULL;
+    run_stats_begin(stats, STATS_PARSE_RESOURCES);
+    free(parse_resource_files(&slice, batch, run->options->jobs, run->cache, file_stats));
+    run_stats_end(stats, STATS_PARSE_RESOURCES);
+    for (int i = 0; i < batch->resources.count; i++) {
+        printf("Parsed resource: %s\n", batch->resources.items[i].class_name);
+        // The statistics outlive the batch and the file list, so they keep their own copy
+        if (file_stats) file_stats[i].path = arena_intern_cstr(run->names, slice.paths[i]);
     }
 
-    json_object_object_add(root, "paths", paths);
+    // Superclasses and concerns in other batches are found as files, as Rails autoloads them
+    ClassGraphSummary classes;
+    run_stats_begin(stats, STATS_RESOLVE_CLASSES);
+    int status = class_graph_resolve(batch, &classes);
+    run_stats_end(stats, STATS_RESOLVE_CLASSES);
+    if (status != 0) {
+        printf("Error: Out of memory while resolving superclasses and concerns\n");
+        return -1;
+    }
+    run->classes.inheriting += classes.inheriting;
+    run->classes.shared += classes.shared;
+    run->classes.files_loaded += classes.files_loaded;
+    run->classes.unresolved += classes.unresolved;
+
+    if (run->options->schema) {
+        ModelMatchSummary typed;
+        run_stats_begin(stats, STATS_PARSE_SCHEMA);
+        model_schema_match(run->options->schema, batch, &typed);
+        run_stats_end(stats, STATS_PARSE_SCHEMA);
+        run->typed.typed += typed.typed;
+        run->typed.untyped += typed.untyped;
+    }
 
-    // Components/Schemas section
-    json_object* components = json_object_new_object();
-    json_object* schemas = json_object_new_object();
+    run_stats_begin(stats, STATS_MATCH_ROUTES);
+    route_index_match(index, &batch->resources, &run->matches);
+    run_stats_end(stats, STATS_MATCH_ROUTES);
+    run->resources += batch->resources.count;
+    return 0;
+}
 
-    for (int i = 0; i < spec->resource_count; i++) {
-        const ResourceInfo* resource = &spec->resources[i];
+// Writes the document batch by batch; the serialization clock stops while
+// a batch is loaded
+static int walk_low_memory(void* ctx, SpecEmitter* emitter) {
+    LowMemoryRun* run = ctx;
+    RunStats* stats = run->stats;
+    const RunOptions* options = run->options;
+    OpenApiStream* stream = openapi_stream_open(emitter, options->filter->path_prefix, options->jobs);
+    RouteIndex* index = route_index_open(run->routes);
+    int status = stream && index ? 0 : -1;
+    if (status != 0) printf("Error: Cannot set up the batches (out of memory or no temporary file)\n");
+
+    for (int first = 0; status == 0 && first < run->files->count; first += LOW_MEMORY_BATCH) {
+        int count = run->files->count - first < LOW_MEMORY_BATCH ? run->files->count - first : LOW_MEMORY_BATCH;
+        ApiSpec batch;
+        api_spec_init(&batch);
+        run_stats_end(stats, STATS_SERIALIZE);
+        status = load_batch(run, index, &batch, first, count, stats);
+        run_stats_begin(stats, STATS_SERIALIZE);
+        if (status == 0) status = openapi_stream_add(stream, &batch);
+        api_spec_reset(&batch);
+        if (stats) stats->batches++;
+    }
 
-        json_object* schema = json_object_new_object();
-        if (!schema) continue;
+    route_index_close(index);
+    if (stream && openapi_stream_close(stream, &run->stream) != 0) status = -1;
+    if (stats) stats->spooled_bytes = run->stream.spooled_bytes;
+    return status;
+}
 
-        json_object* schema_type = json_object_new_string("object");
-        json_object_object_add(schema, "type", schema_type);
+// --low-memory: parses the resource files a batch at a time and writes each
+// batch's paths as soon as it is ready, spooling its schemas to a temporary
+// file, so memory stays flat however many resources the tree has. The parse
+// cache is read but not rewritten. Returns the process exit code.
+static int run_low_memory(const RunOptions* options, ApiSpec* spec, const ParseCache* cache, RunStats* stats) {
+    parse_routes(options->routes_file, spec, cache, stats);
+    printf("Scanning resource files in: %s\n", options->resource_dir);
+    PathList files = { 0 };
+    run_stats_begin(stats, STATS_SCAN);
+    select_resource_files(options->resource_dir, spec, options->filter, &files);
+    run_stats_end(stats, STATS_SCAN);
+
+    LowMemoryRun run;
+    memset(&run, 0, sizeof(run));
+    run.options = options;
+    run.files = &files;
+    run.routes = spec;
+    run.names = &spec->arena;
+    run.cache = cache;
+    run.file_stats = run_stats_files(stats, files.count);
+    run.stats = stats;
+    printf("Generating JSON API specification in batches of %d resources...\n", LOW_MEMORY_BATCH);
+    int status = write_spec_stream(options, stats, walk_low_memory, &run);
+
+    if (run.classes.inheriting > 0 || run.classes.files_loaded > 0) {
+        printf("Resolved %d resources from superclasses and concerns (%d sharing their parent's, %d files loaded, "
+               "%d names not found)\n", run.classes.inheriting, run.classes.shared, run.classes.files_loaded,
+               run.classes.unresolved);
+    }
+    if (options->schema) {
+        printf("Typed %d resources from their tables (%d without a table)\n", run.typed.typed, run.typed.untyped);
+    }
+    if (status == 0) {
+        printf("\nAPI specification written to %s\n", options->output_path);
+    } else {
+        printf("\nError: Could not write to %s\n", options->output_path);
+    }
+    printf("\nParsed %d resources and %d routes\n", run.resources, spec->routes.count);
+    printf("Matched %d resources to routes (%d ambiguous, %d unmatched)\n", run.matches.matched,
+           run.matches.ambiguous, run.matches.unmatched);
+    printf("Spooled %zu bytes of schemas; %d paths repeated across batches\n", run.stream.spooled_bytes,
+           run.stream.repeated_paths);
+    path_list_free(&files);
+    return status == 0 ? 0 : 1;
+}
 
-        json_object* properties = json_object_new_object();
+typedef struct {
+    const char* resource_dir;
+    const char* routes_file;
+    int jobs;
+    ApiSpec spec;
+} DiffTree;
+
+// Parses one tree without printing, so both can be parsed at once
+static void load_tree_task(void* ctx, size_t index, int worker_id) {
+    (void)worker_id;
+    DiffTree* tree = &((DiffTree*)ctx)[index];
+    PathList files = { 0 };
+    collect_resource_files(tree->resource_dir, &files);
+    free(parse_resource_files(&files, &tree->spec, tree->jobs, NULL, NULL));
+    path_list_free(&files);
+    parse_routes_file(tree->routes_file, &tree->spec, NULL);
+}
 
-        // Add attributes as properties
-        for (int a = 0; a < resource->attribute_count && a < MAX_ATTRIBUTES; a++) {
-            if (strlen(resource->attributes[a]) > 0) {
-                json_object* attr_schema = json_object_new_object();
-                json_object* attr_type = json_object_new_string("string"); // Default type
-                json_object_object_add(attr_schema, "type", attr_type);
-                json_object_object_add(properties, resource->attributes[a], attr_schema);
+static void print_change(const SpecChange* change) {
+    const char* name = symbol_name(change->name);
+    switch (change->kind) {
+        case SPEC_CHANGE_PATH_REMOVED: {
+            char verb[16];
+            size_t len = 0;
+            for (; change->verb[len] && len + 1 < sizeof(verb); len++) {
+                verb[len] = (char)toupper((unsigned char)change->verb[len]);
             }
+            verb[len] = '\0';
+            printf("Removed path: %s %s (%s)\n", verb, change->path, change->resource);
+            break;
         }
+        case SPEC_CHANGE_FILTER_REMOVED:
+            printf("Removed filter: %s (%s)\n", name, change->resource);
+            break;
+        case SPEC_CHANGE_FILTER_NARROWED:
+            printf("Narrowed filter: %s %s%s%s -> %s%s%s (%s)\n", name, change->before.type,
+                   change->before.format ? "/" : "", change->before.format ? change->before.format : "",
+                   change->after.type, change->after.format ? "/" : "", change->after.format ? change->after.format : "",
+                   change->resource);
+            break;
+        case SPEC_CHANGE_NOT_CREATABLE:
+            printf("Removed from creatable_fields: %s (%s)\n", name, change->resource);
+            break;
+        case SPEC_CHANGE_NOT_UPDATABLE:
+            printf("Removed from updatable_fields: %s (%s)\n", name, change->resource);
+            break;
+    }
+}
 
-        // Add relationships
-        for (int r = 0; r < resource->relation_count && r < MAX_RELATIONS; r++) {
-            if (strlen(resource->relations[r].name) > 0) {
-                json_object* rel_schema = json_object_new_object();
-                json_object* rel_type = json_object_new_string("object");
-                json_object_object_add(rel_schema, "type", rel_type);
-                json_object_object_add(properties, resource->relations[r].name, rel_schema);
+static void print_diff_usage(const char* program_name) {
+    printf("Usage: %s diff [options] <old_resource_directory> <old_routes_file> <new_resource_directory> "
+           "<new_routes_file>\n", program_name);
+    printf("Lists the breaking changes of the new tree's spec; exits with 0 when there are none, 1 when there\n");
+    printf("are some and 2 on errors.\n");
+    printf("Options:\n");
+    printf("  -j, --jobs N: Parse and compare on N threads (default: number of CPUs)\n");
+    printf("  --schema FILE: Type filters of both trees from db/schema.rb or structure.sql\n");
+    printf("  --ingest MODE: Read files ahead of the parsers with io_uring, threads, off or auto (default)\n");
+}
+
+// `diff` subcommand: parses both trees in parallel and compares their
+// resources by fingerprint. Returns 0 without breaking changes, 1 with
+// some and 2 on errors.
+static int run_diff(int argc, char* argv[], const char* program_name) {
+    static const struct option long_options[] = {
+        { "jobs", required_argument, NULL, 'j' },
+        { "schema", required_argument, NULL, 's' },
+        { "ingest", required_argument, NULL, 'I' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int jobs = work_pool_default_jobs();
+    const char* schema_path = NULL;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "j:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'j':
+                jobs = atoi(optarg);
+                if (jobs < 1) {
+                    printf("Error: --jobs expects a positive number, got '%s'\n", optarg);
+                    return 2;
+                }
+                break;
+            case 's':
+                schema_path = optarg;
+                break;
+            case 'I': {
+                FileIngestMode mode;
+                if (file_ingest_parse_mode(optarg, &mode) != 0) return 2;
+                file_ingest_set_mode(mode);
+                break;
             }
+            case 'h':
+                print_diff_usage(program_name);
+                return 0;
+            default:
+                print_diff_usage(program_name);
+                return 2;
         }
+    }
+    if (argc - optind != 4) {
+        print_diff_usage(program_name);
+        return 2;
+    }
 
-        json_object_object_add(schema, "properties", properties);
-
-        const char* schema_name = strlen(resource->model_name) > 0 ?
-                                 resource->model_name : resource->class_name;
-        json_object_object_add(schemas, schema_name, schema);
+    // Both trees are parsed at once, each on half of the threads
+    DiffTree trees[2];
+    for (int t = 0; t < 2; t++) {
+        trees[t].resource_dir = argv[optind + 2 * t];
+        trees[t].routes_file = argv[optind + 2 * t + 1];
+        trees[t].jobs = jobs > 1 ? (jobs + t) / 2 : 1;
+        struct stat st;
+        if (stat(trees[t].resource_dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            printf("Error: Cannot read resource directory %s\n", trees[t].resource_dir);
+            return 2;
+        }
+    }
+    api_spec_init(&trees[0].spec);
+    api_spec_init(&trees[1].spec);
+
+    ModelSchema schema;
+    model_schema_init(&schema);
+    int exit_code = 2;
+    if (schema_path && load_schema(&schema, schema_path, NULL) != 0) goto done;
+
+    printf("Parsing %s and %s\n", trees[0].resource_dir, trees[1].resource_dir);
+    work_pool_run(2, 2, load_tree_task, trees);
+    // Resolving and matching print warnings, so they run one tree after the other
+    for (int t = 0; t < 2; t++) {
+        ApiSpec* spec = &trees[t].spec;
+        printf("Matching routes of %s\n", trees[t].resource_dir);
+        resolve_classes(spec, NULL);
+        type_resources(spec, schema_path ? &schema : NULL, NULL, 0);
+        RouteMatchSummary matches;
+        match_resource_routes(spec, &matches);
     }
 
-    json_object_object_add(components, "schemas", schemas);
-    json_object_object_add(root, "components", components);
+    SpecDiff diff;
+    spec_diff_init(&diff);
+    if (spec_diff_compare(&diff, &trees[0].spec, &trees[1].spec, jobs) != 0) {
+        printf("Error: Out of memory while comparing %s with %s\n", trees[0].resource_dir, trees[1].resource_dir);
+    } else {
+        printf("\n");
+        for (int i = 0; i < diff.count; i++) print_change(&diff.items[i]);
+        printf("%s%d resources unchanged, %d changed, %d added, %d removed: %d breaking changes\n",
+               diff.count ? "\n" : "", diff.unchanged, diff.changed, diff.added, diff.removed, diff.count);
+        exit_code = diff.count > 0 ? 1 : 0;
+    }
+    spec_diff_free(&diff);
 
-    return root;
+done:
+    model_schema_free(&schema);
+    api_spec_reset(&trees[0].spec);
+    api_spec_reset(&trees[1].spec);
+    return exit_code;
 }
 
 void print_usage(const char* program_name) {
-    printf("Usage: %s <resource_directory> [routes_file]\n", program_name);
-    printf("  resource_directory: Directory containing *_resource.rb files\n");
+    printf("Usage: %s [options] <resource_directory> [routes_file]\n", program_name);
+    printf("       %s [options] --batch MANIFEST [routes_file]\n", program_name);
+    printf("       %s diff [options] <old_resource_directory> <old_routes_file> <new_resource_directory> "
+           "<new_routes_file>\n", program_name);
+    printf("  resource_directory: Directory searched recursively for *_resource.rb files\n");
     printf("  routes_file: Optional path to config/routes.rb (default: config/routes.rb)\n");
+    printf("Options:\n");
+    printf("  -j, --jobs N: Parse and serialize on N threads (default: number of CPUs)\n");
+    printf("  -o, --output FILE: Write the specification to FILE (default: api_spec.<format>)\n");
+    printf("  --format FORMAT: json (default), json-min, yaml or cbor\n");
+    printf("  --compress METHOD: Compress the written file with gzip or zstd\n");
+    printf("  -p, --print: Also print the specification to stdout\n");
+    printf("  --shard DIR: Write one file per path and schema below DIR with an index, leaving unchanged files "
+           "alone\n");
+    printf("  --dom: Build the specification as a json-c document before writing it (JSON formats only)\n");
+    printf("  --cache FILE: Reuse parse results of unchanged files from FILE (default: %s)\n", DEFAULT_CACHE_PATH);
+    printf("  --no-cache: Parse every file and leave the cache alone\n");
+    printf("  --schema FILE: Type attributes and filters from db/schema.rb or structure.sql\n");
+    printf("  --ingest MODE: Read files ahead of the parsers with io_uring, threads, off or auto (default)\n");
+    printf("  --low-memory: Parse and write %d resources at a time, so memory does not grow with the tree\n",
+           LOW_MEMORY_BATCH);
+    printf("  --include PATTERN: Only generate the resources whose class name, path or file name matches PATTERN\n");
+    printf("  --exclude PATTERN: Leave out the resources matching PATTERN (both repeatable)\n");
+    printf("  --path-prefix PREFIX: Only generate the paths below PREFIX and the resources routed there\n");
+    printf("  -w, --watch: Keep running and regenerate the specification when files change\n");
+    printf("  --serve SOCKET: Keep running and answer spec queries on a Unix socket (implies --watch)\n");
+    printf("  -b, --batch MANIFEST: Generate one spec per '<resource_dir> <output_file> [path_prefix]' line of MANIFEST\n");
+    printf("  --stats[=json]: Report time per phase, per-file parse times, bytes, lines, allocations and peak RSS\n");
+    printf("  --stats-file FILE: Write the statistics to FILE instead of stdout\n");
+    printf("  --stats-top N: Number of slowest files to list (default: %d)\n", DEFAULT_STATS_TOP);
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
+    if (argc > 1 && strcmp(argv[1], "diff") == 0) return run_diff(argc - 1, argv + 1, argv[0]);
+
+    static const struct option long_options[] = {
+        { "jobs", required_argument, NULL, 'j' },
+        { "output", required_argument, NULL, 'o' },
+        { "format", required_argument, NULL, 'f' },
+        { "compress", required_argument, NULL, 'z' },
+        { "print", no_argument, NULL, 'p' },
+        { "shard", required_argument, NULL, 'd' },
+        { "dom", no_argument, NULL, 'D' },
+        { "cache", required_argument, NULL, 'C' },
+        { "no-cache", no_argument, NULL, 'N' },
+        { "schema", required_argument, NULL, 's' },
+        { "ingest", required_argument, NULL, 'I' },
+        { "include", required_argument, NULL, 'i' },
+        { "exclude", required_argument, NULL, 'x' },
+        { "path-prefix", required_argument, NULL, 'P' },
+        { "low-memory", no_argument, NULL, 'M' },
+        { "watch", no_argument, NULL, 'w' },
+        { "batch", required_argument, NULL, 'b' },
+        { "serve", required_argument, NULL, 'L' },
+        { "stats", optional_argument, NULL, 'S' },
+        { "stats-file", required_argument, NULL, 'F' },
+        { "stats-top", required_argument, NULL, 'T' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    ResourceFilter filter;
+    resource_filter_init(&filter);
+    RunOptions options = { NULL, NULL, NULL, NULL, work_pool_default_jobs(), 0, 0, SPEC_FORMAT_JSON, COMPRESSION_NONE,
+                           NULL, &filter, NULL };
+    char default_output[64];
+    const char* cache_path = DEFAULT_CACHE_PATH;
+    const char* schema_path = NULL;
+    int watch = 0;
+    int low_memory = 0;
+    const char* batch_path = NULL;
+    const char* socket_path = NULL;
+    int collect_stats = 0;
+    StatsFormat stats_format = STATS_TEXT;
+    const char* stats_path = NULL;
+    int stats_top = DEFAULT_STATS_TOP;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "j:o:pwb:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'j':
+                options.jobs = atoi(optarg);
+                if (options.jobs < 1) {
+                    printf("Error: --jobs expects a positive number, got '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'o':
+                options.output_path = optarg;
+                break;
+            case 'f': {
+                int found = 0;
+                for (size_t i = 0; i < sizeof(spec_formats) / sizeof(spec_formats[0]) && !found; i++) {
+                    if (strcmp(optarg, spec_formats[i].name) == 0) {
+                        options.format = (SpecFormat)i;
+                        found = 1;
+                    }
+                }
+                if (!found) {
+                    printf("Error: --format expects 'json', 'json-min', 'yaml' or 'cbor', got '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'z':
+                if (compression_parse(optarg, &options.compression) != 0) return 1;
+                break;
+            case 'p':
+                options.print = 1;
+                break;
+            case 'd':
+                options.shard_dir = optarg;
+                break;
+            case 'D':
+                options.use_dom = 1;
+                break;
+            case 'w':
+                watch = 1;
+                break;
+            case 'M':
+                low_memory = 1;
+                break;
+            case 'b':
+                batch_path = optarg;
+                break;
+            case 'L':
+                socket_path = optarg;
+                watch = 1;
+                break;
+            case 'C':
+                cache_path = optarg;
+                break;
+            case 'N':
+                cache_path = NULL;
+                break;
+            case 's':
+                schema_path = optarg;
+                break;
+            case 'I': {
+                FileIngestMode mode;
+                if (file_ingest_parse_mode(optarg, &mode) != 0) return 1;
+                file_ingest_set_mode(mode);
+                break;
+            }
+            case 'i':
+            case 'x':
+                if (resource_filter_add(&filter, optarg, opt == 'x') != 0) {
+                    printf("Error: Out of memory\n");
+                    return 1;
+                }
+                break;
+            case 'P':
+                if (resource_filter_set_prefix(&filter, optarg) != 0) {
+                    printf("Error: Out of memory\n");
+                    return 1;
+                }
+                break;
+            case 'S':
+                collect_stats = 1;
+                if (optarg && strcmp(optarg, "json") == 0) {
+                    stats_format = STATS_JSON;
+                } else if (optarg && strcmp(optarg, "text") != 0) {
+                    printf("Error: --stats expects 'text' or 'json', got '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'F':
+                collect_stats = 1;
+                stats_path = optarg;
+                break;
+            case 'T':
+                stats_top = atoi(optarg);
+                if (stats_top < 0) {
+                    printf("Error: --stats-top expects a number, got '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (batch_path && (watch || options.print || options.output_path)) {
+        printf("Error: --batch cannot be combined with --%s\n",
+               socket_path ? "serve" : watch ? "watch" : options.print ? "print" : "output");
+        return 1;
+    }
+    if (low_memory && (watch || batch_path || options.use_dom)) {
+        printf("Error: --low-memory cannot be combined with --%s\n",
+               socket_path ? "serve" : watch ? "watch" : batch_path ? "batch" : "dom");
+        return 1;
+    }
+    if (batch_path && resource_filter_active(&filter)) {
+        printf("Error: --batch cannot be combined with --include, --exclude or --path-prefix; the manifest selects "
+               "the files\n");
+        return 1;
+    }
+    if (socket_path && filter.path_prefix) {
+        printf("Error: --serve cannot be combined with --path-prefix; ask for a 'prefix' instead\n");
+        return 1;
+    }
+    if (socket_path && (options.print || options.output_path || options.use_dom || options.compression)) {
+        printf("Error: --serve cannot be combined with --%s\n", options.print ? "print"
+                                                               : options.output_path ? "output"
+                                                               : options.use_dom ? "dom" : "compress");
+        return 1;
+    }
+    if (socket_path && options.format != SPEC_FORMAT_JSON && options.format != SPEC_FORMAT_JSON_MIN) {
+        printf("Error: --serve only answers with JSON\n");
+        return 1;
+    }
+    if (options.use_dom && options.format != SPEC_FORMAT_JSON && options.format != SPEC_FORMAT_JSON_MIN) {
+        printf("Error: --dom only builds JSON output\n");
+        return 1;
+    }
+    if (options.print && options.format == SPEC_FORMAT_CBOR) {
+        printf("Error: --print needs a text format, not cbor\n");
+        return 1;
+    }
+    if (options.shard_dir && (batch_path || low_memory || socket_path || options.use_dom || options.print ||
+                              options.output_path || options.compression)) {
+        printf("Error: --shard cannot be combined with --%s\n", batch_path ? "batch"
+                                                               : low_memory ? "low-memory"
+                                                               : socket_path ? "serve"
+                                                               : options.use_dom ? "dom"
+                                                               : options.print ? "print"
+                                                               : options.output_path ? "output" : "compress");
+        return 1;
+    }
+    // Messages name the directory where they would name the file
+    if (options.shard_dir) options.output_path = options.shard_dir;
+    if (!options.output_path) {
+        snprintf(default_output, sizeof(default_output), "api_spec%s%s", spec_formats[options.format].extension,
+                 compression_extension(options.compression));
+        options.output_path = default_output;
+    }
+    if (!batch_path && optind >= argc) {
         print_usage(argv[0]);
         return 1;
     }
 
-    const char* resource_dir = argv[1];
-    const char* routes_file = (argc > 2) ? argv[2] : "config/routes.rb";
+    // With --batch the resource directories come from the manifest
+    int routes_arg = batch_path ? optind : optind + 1;
+    options.resource_dir = batch_path ? NULL : argv[optind];
+    options.routes_file = routes_arg < argc ? argv[routes_arg] : "config/routes.rb";
+    const char* resource_dir = options.resource_dir;
+    const char* routes_file = options.routes_file;
+
+    FileWatcher* watcher = NULL;
+    if (watch) {
+        watcher = file_watcher_open(resource_dir, routes_file);
+        if (!watcher) {
+            printf("Error: Cannot watch %s\n", resource_dir);
+            return 1;
+        }
+    }
 
     ApiSpec spec;
-    memset(&spec, 0, sizeof(ApiSpec));
+    api_spec_init(&spec);
+    RunStats stats_storage;
+    run_stats_init(&stats_storage);
+    RunStats* stats = collect_stats ? &stats_storage : NULL;
+
+    ParseCache cache;
+    parse_cache_init(&cache);
+    if (cache_path) parse_cache_load(&cache, cache_path);
+
+    ModelSchema schema;
+    model_schema_init(&schema);
+    if (schema_path) {
+        if (load_schema(&schema, schema_path, stats) != 0) {
+            model_schema_free(&schema);
+            parse_cache_free(&cache);
+            run_stats_free(stats);
+            file_watcher_close(watcher);
+            return 1;
+        }
+        options.schema = &schema;
+    }
+    if (socket_path) {
+        options.server = spec_server_open(socket_path, options.jobs, options.format == SPEC_FORMAT_JSON);
+        if (!options.server) {
+            model_schema_free(&schema);
+            parse_cache_free(&cache);
+            run_stats_free(stats);
+            file_watcher_close(watcher);
+            return 1;
+        }
+        // Messages name the socket where they would name the file
+        options.output_path = socket_path;
+    }
 
-    printf("Scanning resource files in: %s\n", resource_dir);
-    scan_resource_files(resource_dir, &spec);
+    int exit_code = 0;
+    if (batch_path) {
+        exit_code = run_batch(batch_path, &options, &spec, cache_path ? &cache : NULL, cache_path, stats);
+    } else if (low_memory) {
+        exit_code = run_low_memory(&options, &spec, cache_path ? &cache : NULL, stats);
+    } else {
+        // A path prefix selects resource files by their routes, so those are parsed first
+        CacheStamp routes_stamp = { 0 };
+        if (filter.path_prefix) routes_stamp = parse_routes(routes_file, &spec, cache_path ? &cache : NULL, stats);
+        printf("Scanning resource files in: %s\n", resource_dir);
+        CacheStamp* stamps =
+            scan_resource_files(resource_dir, &spec, options.jobs, cache_path ? &cache : NULL, &filter, stats);
+        resolve_classes(&spec, stats);
+        type_resources(&spec, options.schema, stats, 1);
+        if (!filter.path_prefix) routes_stamp = parse_routes(routes_file, &spec, cache_path ? &cache : NULL, stats);
+
+        RouteMatchSummary matches;
+        run_stats_begin(stats, STATS_MATCH_ROUTES);
+        match_resource_routes(&spec, &matches);
+        run_stats_end(stats, STATS_MATCH_ROUTES);
+
+        printf("Generating JSON API specification...\n");
+        int status = write_spec(&spec, &options, stats);
+        if (status == 0 && options.server) {
+            printf("\nServing the API specification on %s\n", options.output_path);
+        } else if (status == 0) {
+            printf("\nAPI specification written to %s\n", options.output_path);
+        } else {
+            printf("\nError: Could not write to %s\n", options.output_path);
+            exit_code = 1;
+        }
 
-    printf("Parsing routes file: %s\n", routes_file);
-    parse_routes_file(routes_file, &spec);
-
-    printf("Generating JSON API specification...\n");
-    json_object* json_spec = generate_json_api_spec(&spec);
-
-    // Output the JSON
-    const char* json_string = json_object_to_json_string_ext(json_spec, JSON_C_TO_STRING_PRETTY);
-    if (json_string) {
-        printf("%s\n", json_string);
-
-        // Write to file
-        FILE* output_file = fopen("api_spec.json", "w");
-        if (output_file) {
-            fprintf(output_file, "%s\n", json_string);
-            fclose(output_file);
-            printf("\nAPI specification written to api_spec.json\n");
+        printf("\nParsed %d resources and %d routes\n", spec.resources.count, spec.routes.count);
+        printf("Matched %d resources to routes (%d ambiguous, %d unmatched)\n",
+               matches.matched, matches.ambiguous, matches.unmatched);
+
+        int filtered = resource_filter_active(&filter);
+        if (cache_path && stamps) update_cache(cache_path, &cache, &spec, stamps, routes_file, &routes_stamp, filtered);
+        free(stamps);
+    }
+    parse_cache_free(&cache);
+
+    if (stats) {
+        run_stats_arena(stats, &spec.arena);
+        FILE* stats_file = stats_path ? fopen(stats_path, "w") : stdout;
+        if (stats_file) {
+            run_stats_report(stats, stats_format, stats_top, stats_file);
+            if (stats_file != stdout) fclose(stats_file);
         } else {
-            printf("\nError: Could not write to api_spec.json\n");
+            printf("Error: Cannot write statistics to %s\n", stats_path);
         }
-    } else {
-        printf("Error: Could not generate JSON string\n");
+        run_stats_free(stats);
     }
 
-    json_object_put(json_spec);
-
-    printf("\nParsed %d resources and %d routes\n", spec.resource_count, spec.route_count);
+    if (watcher) exit_code = watch_resources(&spec, &options, watcher);
+    spec_server_close(options.server);
 
-    return 0;
+    api_spec_reset(&spec);
+    model_schema_free(&schema);
+    resource_filter_free(&filter);
+    return exit_code;
 }
 
@@ -0,0 +1,255 @@
+#include "jsonapi_parser.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "api_spec.h"
+#include "class_graph.h"
+#include "model_schema.h"
+#include "openapi_writer.h"
+#include "output_sink.h"
+#include "resource_filter.h"
+#include "resource_parser.h"
+#include "route_index.h"
+#include "routes_parser.h"
+#include "source_file.h"
+#include "spec_format.h"
+
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+
+typedef struct {
+    JsonApiDiagnostic* items;
+    int count;
+    int capacity;
+} DiagnosticList;
+
+struct JsonApiParser {
+    ApiSpec spec;
+    size_t compacted_size; // Arena size after the last compaction
+    ModelSchema schema;
+    int has_schema;
+    Arena diagnostic_arena;
+    DiagnosticList diagnostics;
+    DiagnosticHandler previous; // Handler of the calling thread, restored when a call returns
+};
+
+static void collect_diagnostic(void* ctx, DiagnosticLevel level, DiagnosticCode code, const char* source,
+                               const char* message) {
+    JsonApiParser* parser = ctx;
+    JsonApiDiagnostic* diagnostic = ARENA_PUSH(&parser->diagnostic_arena, parser->diagnostics);
+    if (!diagnostic) return;
+    diagnostic->level = level;
+    diagnostic->code = code;
+    diagnostic->source = source ? arena_intern_cstr(&parser->diagnostic_arena, source) : NULL;
+    diagnostic->message = arena_strndup(&parser->diagnostic_arena, message, strlen(message));
+    if (!diagnostic->message) parser->diagnostics.count--;
+}
+
+// Collects what the parsers report during one call
+static void begin_call(JsonApiParser* parser) {
+    DiagnosticHandler handler = { collect_diagnostic, parser };
+    parser->previous = diagnostics_set_handler(handler);
+}
+
+static void end_call(JsonApiParser* parser) {
+    diagnostics_set_handler(parser->previous);
+}
+
+static int read_descriptor(const char* name, int fd, SourceFile* source) {
+    if (source_file_open_fd(source, fd) == 0) return 0;
+    report_diagnostic(DIAGNOSTIC_ERROR, DIAGNOSTIC_CANNOT_READ, name, "Cannot read %s", name);
+    return -1;
+}
+
+JsonApiParser* jsonapi_parser_new(void) {
+    JsonApiParser* parser = calloc(1, sizeof(JsonApiParser));
+    if (!parser) return NULL;
+    api_spec_init(&parser->spec);
+    model_schema_init(&parser->schema);
+    arena_init(&parser->diagnostic_arena);
+    return parser;
+}
+
+void jsonapi_parser_free(JsonApiParser* parser) {
+    if (!parser) return;
+    api_spec_reset(&parser->spec);
+    model_schema_free(&parser->schema);
+    arena_reset(&parser->diagnostic_arena);
+    free(parser);
+}
+
+// Keeps resources sorted by name, as the scan leaves them
+static int add_resource(JsonApiParser* parser, const char* name, const char* data, size_t size) {
+    ResourceInfo parsed;
+    memset(&parsed, 0, sizeof(parsed));
+    parse_resource_source(name, data, size, &parsed, &parser->spec.arena);
+    if (!parsed.source_path) {
+        report_diagnostic(DIAGNOSTIC_ERROR, DIAGNOSTIC_OUT_OF_MEMORY, name, "Out of memory while parsing %s", name);
+        return -1;
+    }
+
+    int index = api_spec_find_resource(&parser->spec, name);
+    if (index < 0) {
+        ResourceInfo* slot = api_spec_insert_resource(&parser->spec, -index - 1);
+        if (!slot) {
+            report_diagnostic(DIAGNOSTIC_ERROR, DIAGNOSTIC_OUT_OF_MEMORY, name, "Out of memory while adding %s", name);
+            return -1;
+        }
+        *slot = parsed;
+    } else {
+        parser->spec.resources.items[index] = parsed;
+    }
+    return 0;
+}
+
+int jsonapi_parser_add_resource(JsonApiParser* parser, const char* name, const char* data, size_t size) {
+    begin_call(parser);
+    int status = add_resource(parser, name, data, size);
+    end_call(parser);
+    return status;
+}
+
+int jsonapi_parser_add_resource_fd(JsonApiParser* parser, const char* name, int fd) {
+    begin_call(parser);
+    SourceFile source;
+    int status = read_descriptor(name, fd, &source);
+    if (status == 0) {
+        status = add_resource(parser, name, source.data, source.size);
+        source_file_close(&source);
+    }
+    end_call(parser);
+    return status;
+}
+
+int jsonapi_parser_remove_resource(JsonApiParser* parser, const char* name) {
+    int index = api_spec_find_resource(&parser->spec, name);
+    if (index < 0) return -1;
+    api_spec_remove_resource(&parser->spec, index);
+    return 0;
+}
+
+static int set_routes(JsonApiParser* parser, const char* name, const char* data, size_t size) {
+    parser->spec.routes.count = 0;
+    return parse_routes_source(name, data, size, &parser->spec, NULL);
+}
+
+int jsonapi_parser_set_routes(JsonApiParser* parser, const char* name, const char* data, size_t size) {
+    begin_call(parser);
+    int status = set_routes(parser, name, data, size);
+    end_call(parser);
+    return status;
+}
+
+int jsonapi_parser_set_routes_fd(JsonApiParser* parser, const char* name, int fd) {
+    begin_call(parser);
+    SourceFile source;
+    int status = read_descriptor(name, fd, &source);
+    if (status == 0) {
+        status = set_routes(parser, name, source.data, source.size);
+        source_file_close(&source);
+    }
+    end_call(parser);
+    return status;
+}
+
+static int set_schema(JsonApiParser* parser, const char* name, const char* data, size_t size) {
+    model_schema_free(&parser->schema);
+    model_schema_init(&parser->schema);
+    parser->has_schema = model_schema_load_source(&parser->schema, name, data, size, NULL) == 0;
+    return parser->has_schema ? 0 : -1;
+}
+
+int jsonapi_parser_set_schema(JsonApiParser* parser, const char* name, const char* data, size_t size) {
+    begin_call(parser);
+    int status = set_schema(parser, name, data, size);
+    end_call(parser);
+    return status;
+}
+
+int jsonapi_parser_set_schema_fd(JsonApiParser* parser, const char* name, int fd) {
+    begin_call(parser);
+    SourceFile source;
+    int status = read_descriptor(name, fd, &source);
+    if (status == 0) {
+        status = set_schema(parser, name, source.data, source.size);
+        source_file_close(&source);
+    }
+    end_call(parser);
+    return status;
+}
+
+static const SpecFormat spec_formats[] = {
+    [JSONAPI_FORMAT_JSON] = SPEC_FORMAT_JSON,
+    [JSONAPI_FORMAT_JSON_MIN] = SPEC_FORMAT_JSON_MIN,
+    [JSONAPI_FORMAT_YAML] = SPEC_FORMAT_YAML,
+    [JSONAPI_FORMAT_CBOR] = SPEC_FORMAT_CBOR,
+};
+
+typedef struct {
+    const ApiSpec* spec;
+    const char* path_prefix;
+    int jobs;
+} BuildWalk;
+
+static int walk_spec(void* ctx, SpecEmitter* emitter) {
+    const BuildWalk* walk = ctx;
+    return openapi_emit_parallel(walk->spec, emitter, walk->path_prefix, walk->jobs);
+}
+
+static int build(JsonApiParser* parser, const JsonApiBuildOptions* options, JsonApiWriteFn write, void* ctx) {
+    ApiSpec* spec = &parser->spec;
+    // Resources added under a name already present, or removed, leave their strings behind
+    api_spec_compact_if_grown(spec, &parser->compacted_size);
+
+    ClassGraphSummary classes;
+    if (class_graph_resolve(spec, &classes) != 0) {
+        report_diagnostic(DIAGNOSTIC_ERROR, DIAGNOSTIC_OUT_OF_MEMORY, NULL,
+                          "Out of memory while resolving superclasses and concerns");
+        return -1;
+    }
+    if (parser->has_schema) {
+        ModelMatchSummary typed;
+        model_schema_match(&parser->schema, spec, &typed);
+    }
+    RouteMatchSummary matches;
+    match_resource_routes(spec, &matches);
+
+    // The prefix is normalized as --path-prefix is
+    ResourceFilter filter;
+    resource_filter_init(&filter);
+    int status = options->path_prefix ? resource_filter_set_prefix(&filter, options->path_prefix) : 0;
+
+    OutputSink sink;
+    if (status == 0 && output_sink_init(&sink, OUTPUT_BUFFER_SIZE, write, ctx) == 0) {
+        BuildWalk walk = { spec, filter.path_prefix, options->jobs > 1 ? options->jobs : 1 };
+        status = spec_format_emit(spec_formats[options->format], &sink, walk_spec, &walk);
+        if (output_sink_flush(&sink) != 0) status = -1;
+        output_sink_free(&sink);
+    } else {
+        report_diagnostic(DIAGNOSTIC_ERROR, DIAGNOSTIC_OUT_OF_MEMORY, NULL, "Out of memory while writing the spec");
+        status = -1;
+    }
+    resource_filter_free(&filter);
+    return status;
+}
+
+int jsonapi_parser_build(JsonApiParser* parser, const JsonApiBuildOptions* options, JsonApiWriteFn write, void* ctx) {
+    begin_call(parser);
+    int status = build(parser, options, write, ctx);
+    end_call(parser);
+    return status;
+}
+
+int jsonapi_parser_diagnostic_count(const JsonApiParser* parser) {
+    return parser->diagnostics.count;
+}
+
+const JsonApiDiagnostic* jsonapi_parser_diagnostic(const JsonApiParser* parser, int index) {
+    if (index < 0 || index >= parser->diagnostics.count) return NULL;
+    return &parser->diagnostics.items[index];
+}
+
+void jsonapi_parser_clear_diagnostics(JsonApiParser* parser) {
+    arena_reset(&parser->diagnostic_arena);
+    memset(&parser->diagnostics, 0, sizeof(DiagnosticList));
+}
@@ -0,0 +1,88 @@
+#ifndef JSONAPI_PARSER_H
+#define JSONAPI_PARSER_H
+
+#include <stddef.h>
+
+#include "diagnostics.h"
+
+// The parsers and spec writers as a library, for tools that generate specs
+// in-process instead of running the command once per spec. Sources are
+// handed over as buffers or open descriptors and nothing is printed:
+// errors and warnings are collected with the parser.
+//
+//     JsonApiParser* parser = jsonapi_parser_new();
+//     jsonapi_parser_add_resource(parser, "app/resources/user_resource.rb", source, size);
+//     jsonapi_parser_set_routes(parser, "config/routes.rb", routes, routes_size);
+//     JsonApiBuildOptions options = { JSONAPI_FORMAT_JSON, NULL, 1 };
+//     jsonapi_parser_build(parser, &options, output_sink_write_file, stdout);
+//     jsonapi_parser_free(parser);
+//
+// A parser must not be used by two threads at once, but any number of
+// parsers may be used concurrently, each on its own thread.
+typedef struct JsonApiParser JsonApiParser;
+
+typedef enum {
+    JSONAPI_FORMAT_JSON,     // Indented
+    JSONAPI_FORMAT_JSON_MIN, // Without whitespace
+    JSONAPI_FORMAT_YAML,
+    JSONAPI_FORMAT_CBOR
+} JsonApiFormat;
+
+typedef struct {
+    DiagnosticLevel level;
+    DiagnosticCode code;
+    const char* source;  // The file it concerns; NULL if none
+    const char* message; // Without an "Error: " or "Warning: " prefix
+} JsonApiDiagnostic;
+
+typedef struct {
+    JsonApiFormat format;
+    const char* path_prefix; // "/api/v1" keeps the paths below it; NULL for every path
+    int jobs;                // Threads serializing the spec; 1 or less uses the calling thread only
+} JsonApiBuildOptions;
+
+// Receives the spec in chunks; returns 0 on success, -1 to stop writing.
+// output_sink_write_file() (output_sink.h) writes to a FILE* `ctx`.
+typedef int (*JsonApiWriteFn)(void* ctx, const char* data, size_t size);
+
+// Returns NULL when out of memory.
+JsonApiParser* jsonapi_parser_new(void);
+void jsonapi_parser_free(JsonApiParser* parser);
+
+// Parses one *_resource.rb. `name` is its path, which names the class when
+// the source does not and is where superclasses and concerns that were not
+// added are looked for on disk (see class_graph.h); a resource added under
+// a name already present replaces the earlier one. Nothing refers to the
+// buffer afterwards, so it may be released. Returns -1 when out of memory,
+// or for the _fd variant when the descriptor cannot be read; the
+// descriptor is left open.
+int jsonapi_parser_add_resource(JsonApiParser* parser, const char* name, const char* data, size_t size);
+int jsonapi_parser_add_resource_fd(JsonApiParser* parser, const char* name, int fd);
+
+// Drops the resource added under `name`. Returns -1 when there is none.
+int jsonapi_parser_remove_resource(JsonApiParser* parser, const char* name);
+
+// Parses config/routes.rb, replacing the routes of an earlier call. Returns
+// -1 as jsonapi_parser_add_resource() does.
+int jsonapi_parser_set_routes(JsonApiParser* parser, const char* name, const char* data, size_t size);
+int jsonapi_parser_set_routes_fd(JsonApiParser* parser, const char* name, int fd);
+
+// Types attributes and filters from a db/schema.rb, or a structure.sql when
+// `name` ends in ".sql", replacing the schema of an earlier call. Returns -1
+// as jsonapi_parser_add_resource() does.
+int jsonapi_parser_set_schema(JsonApiParser* parser, const char* name, const char* data, size_t size);
+int jsonapi_parser_set_schema_fd(JsonApiParser* parser, const char* name, int fd);
+
+// Resolves superclasses and concerns, matches resources with their routes
+// and table, and writes the OpenAPI spec of everything added so far to
+// `write`, as the command would for the same files. May be called again
+// after more changes. Returns -1 when out of memory or a write failed.
+int jsonapi_parser_build(JsonApiParser* parser, const JsonApiBuildOptions* options, JsonApiWriteFn write, void* ctx);
+
+// Errors and warnings of the calls so far, oldest first. They stay valid
+// until jsonapi_parser_clear_diagnostics() or jsonapi_parser_free().
+int jsonapi_parser_diagnostic_count(const JsonApiParser* parser);
+const JsonApiDiagnostic* jsonapi_parser_diagnostic(const JsonApiParser* parser, int index);
+void jsonapi_parser_clear_diagnostics(JsonApiParser* parser);
+
+#endif
@@ -0,0 +1,357 @@
+#include "keyword_prefilter.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PREFILTER_X86 1
+#endif
+
+// Masks for one 64-byte chunk, bit i describing byte i
+typedef struct {
+    uint64_t newline;
+    uint64_t blank;
+    uint64_t leading;
+    uint64_t target;
+    uint64_t infix_first[KEYWORD_PREFILTER_MAX_INFIXES];
+    uint64_t infix_second[KEYWORD_PREFILTER_MAX_INFIXES];
+} ChunkMasks;
+
+typedef void (*ChunkMaskFn)(const KeywordPrefilter* filter, const unsigned char* chunk, uint8_t target,
+                            ChunkMasks* masks);
+
+static KeywordPrefilterMode configured_mode = KEYWORD_PREFILTER_AUTO;
+
+void keyword_prefilter_init(KeywordPrefilter* filter, const char* const* keywords, size_t keyword_count,
+                            const char* const* infixes, size_t infix_count) {
+    memset(filter, 0, sizeof(KeywordPrefilter));
+
+    for (size_t i = 0; i < keyword_count; i++) {
+        uint8_t c = (uint8_t)keywords[i][0];
+        if (c == 0 || filter->leading[c]) continue;
+        filter->leading[c] = 1;
+        if (filter->distinct_count < (int)sizeof(filter->distinct)) {
+            filter->distinct[filter->distinct_count++] = c;
+        } else {
+            filter->distinct_overflow = 1;
+        }
+    }
+
+    // Exact set membership through two 16-entry tables: each distinct high
+    // nibble gets one bit, set in the low-nibble entries that belong to it.
+    // Sets spanning more than eight high nibbles fall back to SSE2.
+    int groups = 0;
+    for (int c = 0; c < 256; c++) {
+        if (!filter->leading[c]) continue;
+        int hi = c >> 4;
+        if (!filter->hi_nibble[hi]) {
+            if (groups == 8) {
+                memset(filter->hi_nibble, 0, sizeof(filter->hi_nibble));
+                memset(filter->lo_nibble, 0, sizeof(filter->lo_nibble));
+                filter->nibble_overflow = 1;
+                break;
+            }
+            filter->hi_nibble[hi] = (uint8_t)(1u << groups++);
+        }
+        filter->lo_nibble[c & 15] |= filter->hi_nibble[hi];
+    }
+
+    for (size_t i = 0; i < infix_count && filter->infix_count < KEYWORD_PREFILTER_MAX_INFIXES; i++) {
+        size_t len = strlen(infixes[i]);
+        if (len < 2) continue;
+        filter->infixes[filter->infix_count] = infixes[i];
+        filter->infix_lengths[filter->infix_count] = len;
+        filter->infix_count++;
+    }
+}
+
+static void masks_scalar(const KeywordPrefilter* filter, const unsigned char* chunk, uint8_t target,
+                         ChunkMasks* masks) {
+    memset(masks, 0, sizeof(ChunkMasks));
+    for (int i = 0; i < 64; i++) {
+        uint8_t c = chunk[i];
+        uint64_t bit = 1ULL << i;
+        if (c == '\n') masks->newline |= bit;
+        else if (c == ' ' || c == '\t' || c == '\r') masks->blank |= bit;
+        if (filter->leading[c]) masks->leading |= bit;
+        if (c == target) masks->target |= bit;
+        for (int k = 0; k < filter->infix_count; k++) {
+            if (c == (uint8_t)filter->infixes[k][0]) masks->infix_first[k] |= bit;
+            if (c == (uint8_t)filter->infixes[k][1]) masks->infix_second[k] |= bit;
+        }
+    }
+}
+
+#ifdef PREFILTER_X86
+__attribute__((target("sse2")))
+static void masks_sse2(const KeywordPrefilter* filter, const unsigned char* chunk, uint8_t target,
+                       ChunkMasks* masks) {
+    memset(masks, 0, sizeof(ChunkMasks));
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    for (int part = 0; part < 4; part++) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(chunk + part * 16));
+        int shift = part * 16;
+
+        masks->newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)) << shift;
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(bytes, space),
+                                     _mm_or_si128(_mm_cmpeq_epi8(bytes, tab), _mm_cmpeq_epi8(bytes, cr)));
+        masks->blank |= (uint64_t)(uint16_t)_mm_movemask_epi8(blank) << shift;
+
+        __m128i leading = _mm_setzero_si128();
+        for (int i = 0; i < filter->distinct_count; i++) {
+            leading = _mm_or_si128(leading, _mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)filter->distinct[i])));
+        }
+        masks->leading |= (uint64_t)(uint16_t)_mm_movemask_epi8(leading) << shift;
+        masks->target |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)target))) << shift;
+
+        for (int k = 0; k < filter->infix_count; k++) {
+            __m128i first = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(filter->infixes[k][0]));
+            __m128i second = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(filter->infixes[k][1]));
+            masks->infix_first[k] |= (uint64_t)(uint16_t)_mm_movemask_epi8(first) << shift;
+            masks->infix_second[k] |= (uint64_t)(uint16_t)_mm_movemask_epi8(second) << shift;
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void masks_avx2(const KeywordPrefilter* filter, const unsigned char* chunk, uint8_t target,
+                       ChunkMasks* masks) {
+    memset(masks, 0, sizeof(ChunkMasks));
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i low_bits = _mm256_set1_epi8(0x0f);
+    const __m256i lo_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)filter->lo_nibble));
+    const __m256i hi_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)filter->hi_nibble));
+
+    for (int part = 0; part < 2; part++) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(chunk + part * 32));
+        int shift = part * 32;
+
+        masks->newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)) << shift;
+        __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, space),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(bytes, tab), _mm256_cmpeq_epi8(bytes, cr)));
+        masks->blank |= (uint64_t)(uint32_t)_mm256_movemask_epi8(blank) << shift;
+
+        // Byte c is in the set when lo_nibble[c & 15] & hi_nibble[c >> 4] != 0
+        __m256i lo = _mm256_shuffle_epi8(lo_table, _mm256_and_si256(bytes, low_bits));
+        __m256i hi = _mm256_shuffle_epi8(hi_table, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), low_bits));
+        __m256i miss = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256());
+        masks->leading |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(miss) << shift;
+        masks->target |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8((char)target))) << shift;
+
+        for (int k = 0; k < filter->infix_count; k++) {
+            __m256i first = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(filter->infixes[k][0]));
+            __m256i second = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(filter->infixes[k][1]));
+            masks->infix_first[k] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(first) << shift;
+            masks->infix_second[k] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(second) << shift;
+        }
+    }
+}
+#endif
+
+void keyword_prefilter_set_mode(KeywordPrefilterMode mode) {
+    configured_mode = mode;
+}
+
+KeywordPrefilterMode keyword_prefilter_mode(void) {
+    return configured_mode;
+}
+
+static KeywordPrefilterMode resolve_mode(KeywordPrefilterMode mode) {
+#ifdef PREFILTER_X86
+    if (mode == KEYWORD_PREFILTER_AUTO) mode = KEYWORD_PREFILTER_AVX2;
+    if (mode == KEYWORD_PREFILTER_AVX2 && !__builtin_cpu_supports("avx2")) mode = KEYWORD_PREFILTER_SSE2;
+#else
+    // The scalar filter is slower than lexing every line, so it is only used when asked for
+    if (mode == KEYWORD_PREFILTER_AUTO) mode = KEYWORD_PREFILTER_OFF;
+    if (mode == KEYWORD_PREFILTER_SSE2 || mode == KEYWORD_PREFILTER_AVX2) mode = KEYWORD_PREFILTER_SCALAR;
+#endif
+    return mode;
+}
+
+KeywordPrefilterMode keyword_prefilter_resolved_mode(void) {
+    return resolve_mode(configured_mode);
+}
+
+const char* keyword_prefilter_mode_name(KeywordPrefilterMode mode) {
+    switch (mode) {
+        case KEYWORD_PREFILTER_AUTO: return "auto";
+        case KEYWORD_PREFILTER_OFF: return "off";
+        case KEYWORD_PREFILTER_SCALAR: return "scalar";
+        case KEYWORD_PREFILTER_SSE2: return "sse2";
+        case KEYWORD_PREFILTER_AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+// The configured implementation, or a narrower one when the candidate set
+// does not fit its tables; past SSE2 no filter beats lexing every line
+static ChunkMaskFn select_masks(const KeywordPrefilter* filter) {
+    KeywordPrefilterMode mode = resolve_mode(configured_mode);
+    if (mode == KEYWORD_PREFILTER_AVX2 && filter->nibble_overflow) mode = KEYWORD_PREFILTER_SSE2;
+    if (mode == KEYWORD_PREFILTER_SSE2 && filter->distinct_overflow) mode = KEYWORD_PREFILTER_OFF;
+    switch (mode) {
+        case KEYWORD_PREFILTER_OFF: return NULL;
+#ifdef PREFILTER_X86
+        case KEYWORD_PREFILTER_AVX2: return masks_avx2;
+        case KEYWORD_PREFILTER_SSE2: return masks_sse2;
+#endif
+        default: return masks_scalar;
+    }
+}
+
+static int count_newlines(const char* start, const char* end) {
+    int count = 0;
+    while ((start = memchr(start, '\n', end - start)) != NULL) {
+        count++;
+        start++;
+    }
+    return count;
+}
+
+// First non-blank byte of the line containing `hit`, not before `floor`.
+static size_t line_lead(const char* data, size_t floor, size_t hit) {
+    size_t start = hit;
+    while (start > floor && data[start - 1] != '\n') start--;
+    while (start < hit && (data[start] == ' ' || data[start] == '\t' || data[start] == '\r')) start++;
+    return start;
+}
+
+size_t keyword_prefilter_next(const KeywordPrefilter* filter, const char* data, size_t size,
+                              size_t pos, int* lines) {
+    ChunkMaskFn build_masks = select_masks(filter);
+    if (!build_masks) return pos;
+
+    unsigned char tail[65];
+    uint64_t line_start_carry = 1; // `pos` starts a line
+    uint64_t indent_carry = 0;     // Indentation run continuing from the previous chunk
+    int newlines = 0;
+
+    for (size_t chunk = pos; chunk < size; chunk += 64) {
+        size_t available = size - chunk;
+        const unsigned char* bytes = (const unsigned char*)data + chunk;
+        uint64_t valid = ~0ULL;
+        if (available < 65) {
+            // Copy the final chunk (plus the look-ahead byte) so loads stay in bounds
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, bytes, available);
+            bytes = tail;
+            if (available < 64) valid = (1ULL << available) - 1;
+        }
+
+        ChunkMasks masks;
+        build_masks(filter, bytes, 0, &masks);
+
+        // Carry-propagating add: each line start runs through its indentation
+        // and lands on the line's first non-blank byte.
+        uint64_t starts = (masks.newline << 1) | line_start_carry | indent_carry;
+        uint64_t sum;
+        indent_carry = __builtin_add_overflow(masks.blank, starts, &sum);
+        line_start_carry = masks.newline >> 63;
+        uint64_t leads = sum & ~masks.blank & ~masks.newline & valid;
+
+        size_t best = size;
+        uint64_t candidates = leads & masks.leading;
+        if (candidates) best = chunk + __builtin_ctzll(candidates);
+
+        for (int k = 0; k < filter->infix_count; k++) {
+            uint64_t second = (masks.infix_second[k] >> 1) |
+                              ((uint64_t)(bytes[64] == (uint8_t)filter->infixes[k][1]) << 63);
+            uint64_t hits = masks.infix_first[k] & second & valid;
+            while (hits) {
+                size_t hit = chunk + __builtin_ctzll(hits);
+                hits &= hits - 1;
+                if (hit >= best) break;
+                size_t len = filter->infix_lengths[k];
+                if (hit + len <= size && memcmp(data + hit, filter->infixes[k], len) == 0) {
+                    size_t lead = line_lead(data, pos, hit);
+                    if (lead < best) best = lead;
+                    break;
+                }
+            }
+        }
+
+        if (best < size) {
+            if (lines) {
+                if (best >= chunk) {
+                    uint64_t below = (best - chunk) >= 64 ? ~0ULL : (1ULL << (best - chunk)) - 1;
+                    *lines += newlines + __builtin_popcountll(masks.newline & below);
+                } else {
+                    *lines += newlines - count_newlines(data + best, data + chunk);
+                }
+            }
+            return best;
+        }
+        newlines += __builtin_popcountll(masks.newline & valid);
+    }
+
+    if (lines) *lines += newlines;
+    return size;
+}
+
+static int is_word_byte(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+size_t keyword_prefilter_find_line(const KeywordPrefilter* filter, const char* data, size_t size,
+                                   size_t pos, size_t column, const char* word, int* lines) {
+    ChunkMaskFn build_masks = select_masks(filter);
+    size_t word_len = strlen(word);
+    if (!build_masks || column >= 64 || word_len == 0) return size;
+
+    unsigned char tail[65];
+    uint64_t line_start_carry = 1;
+    uint64_t indent_carry = 0;
+    uint64_t previous_starts = 0; // Line starts of the previous chunk, for the column shift
+    int newlines = 0;
+
+    for (size_t chunk = pos; chunk < size; chunk += 64) {
+        size_t available = size - chunk;
+        const unsigned char* bytes = (const unsigned char*)data + chunk;
+        uint64_t valid = ~0ULL;
+        if (available < 65) {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, bytes, available);
+            bytes = tail;
+            if (available < 64) valid = (1ULL << available) - 1;
+        }
+
+        ChunkMasks masks;
+        build_masks(filter, bytes, (uint8_t)word[0], &masks);
+
+        uint64_t starts = (masks.newline << 1) | line_start_carry;
+        uint64_t sum;
+        indent_carry = __builtin_add_overflow(masks.blank, starts | indent_carry, &sum);
+        line_start_carry = masks.newline >> 63;
+        uint64_t leads = sum & ~masks.blank & ~masks.newline & valid;
+
+        // A lead sits at `column` exactly when its line started `column` bytes earlier
+        uint64_t at_column = column == 0 ? starts
+                                         : (starts << column) | (previous_starts >> (64 - column));
+        previous_starts = starts;
+
+        uint64_t candidates = leads & at_column & masks.target;
+        while (candidates) {
+            size_t hit = chunk + __builtin_ctzll(candidates);
+            candidates &= candidates - 1;
+            if (hit + word_len <= size && memcmp(data + hit, word, word_len) == 0 &&
+                (hit + word_len == size || !is_word_byte(data[hit + word_len]))) {
+                if (lines) {
+                    uint64_t below = (1ULL << (hit - chunk)) - 1;
+                    *lines += newlines + __builtin_popcountll(masks.newline & below);
+                }
+                return hit;
+            }
+        }
+        newlines += __builtin_popcountll(masks.newline & valid);
+    }
+
+    if (lines) *lines += newlines;
+    return size;
+}
@@ -0,0 +1,62 @@
+#ifndef KEYWORD_PREFILTER_H
+#define KEYWORD_PREFILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define KEYWORD_PREFILTER_MAX_INFIXES 4
+
+// Finds the lines of a source buffer that may start a DSL statement, so the
+// lexer can jump over comments and ordinary code without tokenizing them.
+// A line is a candidate when its first non-blank byte is the first byte of
+// one of the keywords, or when it contains one of the infixes anywhere
+// (e.g. "_filter" for custom filter macros, "<<~" so heredoc bodies stay
+// attached to the statement that opens them).
+typedef struct {
+    uint8_t leading[256];
+    uint8_t distinct[32]; // Distinct leading bytes, for the SSE2 compares
+    int distinct_count;
+    int distinct_overflow; // More than `distinct` holds: SSE2 falls back to no filter
+    uint8_t lo_nibble[16]; // Nibble lookup tables for the AVX2 shuffle test
+    uint8_t hi_nibble[16];
+    int nibble_overflow;   // More than eight high nibbles: AVX2 falls back to SSE2
+    const char* infixes[KEYWORD_PREFILTER_MAX_INFIXES];
+    size_t infix_lengths[KEYWORD_PREFILTER_MAX_INFIXES];
+    int infix_count;
+} KeywordPrefilter;
+
+typedef enum {
+    KEYWORD_PREFILTER_AUTO,   // Best SIMD implementation the CPU supports, else OFF
+    KEYWORD_PREFILTER_OFF,    // Lex every line
+    KEYWORD_PREFILTER_SCALAR,
+    KEYWORD_PREFILTER_SSE2,
+    KEYWORD_PREFILTER_AVX2
+} KeywordPrefilterMode;
+
+// Leading bytes of `keywords` are added to the candidate set; at most
+// KEYWORD_PREFILTER_MAX_INFIXES infixes (two bytes or longer) are kept.
+void keyword_prefilter_init(KeywordPrefilter* filter, const char* const* keywords, size_t keyword_count,
+                            const char* const* infixes, size_t infix_count);
+
+// Process-wide implementation choice; modes the CPU lacks fall back to the
+// next best one. Set it before parsing starts.
+void keyword_prefilter_set_mode(KeywordPrefilterMode mode);
+KeywordPrefilterMode keyword_prefilter_mode(void);
+// Implementation AUTO resolves to on this CPU.
+KeywordPrefilterMode keyword_prefilter_resolved_mode(void);
+const char* keyword_prefilter_mode_name(KeywordPrefilterMode mode);
+
+// Returns the offset of the first non-blank byte of the first candidate line
+// at or after `pos`, or `size` if there is none. `pos` must be the start of a
+// line. The number of newlines skipped is added to `*lines` when non-NULL.
+size_t keyword_prefilter_next(const KeywordPrefilter* filter, const char* data, size_t size,
+                              size_t pos, int* lines);
+
+// Returns the offset of the first line at or after `pos` (a line start) that
+// begins with `word` at exactly `column` bytes of indentation, or `size` if
+// there is none or the prefilter is off. Used to jump from a `def` straight
+// to the `end` aligned with it.
+size_t keyword_prefilter_find_line(const KeywordPrefilter* filter, const char* data, size_t size,
+                                   size_t pos, size_t column, const char* word, int* lines);
+
+#endif
@@ -0,0 +1,555 @@
+#include "model_schema.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diagnostics.h"
+#include "route_index.h"
+#include "ruby_lexer.h"
+#include "source_file.h"
+
+#define MAX_NAME_LENGTH 256
+
+typedef struct {
+    Symbol column;
+    uint8_t type; // Index into column_types
+} ColumnSlot;
+
+struct ModelTable {
+    Symbol name; // As written: "users", "billing_invoices"
+    ColumnSlot* slots;
+    uint32_t mask;
+    int column_count;
+};
+
+// Rails column types and the SQL types behind them (first word only, so
+// "character varying" is "character" and "double precision" is "double")
+static const struct {
+    const char* name;
+    ColumnType type;
+} column_types[] = {
+    { "string", { "string", NULL } },
+    { "text", { "string", NULL } },
+    { "citext", { "string", NULL } },
+    { "character", { "string", NULL } },
+    { "varchar", { "string", NULL } },
+    { "char", { "string", NULL } },
+    { "tinytext", { "string", NULL } },
+    { "mediumtext", { "string", NULL } },
+    { "longtext", { "string", NULL } },
+    { "enum", { "string", NULL } },
+    { "inet", { "string", NULL } },
+    { "cidr", { "string", NULL } },
+    { "macaddr", { "string", NULL } },
+    { "time", { "string", NULL } },
+    { "integer", { "integer", "int32" } },
+    { "int", { "integer", "int32" } },
+    { "smallint", { "integer", "int32" } },
+    { "tinyint", { "integer", "int32" } },
+    { "mediumint", { "integer", "int32" } },
+    { "serial", { "integer", "int32" } },
+    { "bigint", { "integer", "int64" } },
+    { "bigserial", { "integer", "int64" } },
+    { "float", { "number", "float" } },
+    { "real", { "number", "float" } },
+    { "double", { "number", "double" } },
+    { "decimal", { "number", NULL } },
+    { "numeric", { "number", NULL } },
+    { "number", { "number", NULL } },
+    { "boolean", { "boolean", NULL } },
+    { "bool", { "boolean", NULL } },
+    { "datetime", { "string", "date-time" } },
+    { "timestamp", { "string", "date-time" } },
+    { "timestamptz", { "string", "date-time" } },
+    { "date", { "string", "date" } },
+    { "uuid", { "string", "uuid" } },
+    { "json", { "object", NULL } },
+    { "jsonb", { "object", NULL } },
+    { "hstore", { "object", NULL } },
+    { "binary", { "string", "binary" } },
+    { "bytea", { "string", "binary" } },
+    { "blob", { "string", "binary" } },
+};
+
+#define COLUMN_TYPE_COUNT (sizeof(column_types) / sizeof(column_types[0]))
+#define NO_COLUMN_TYPE 0xff
+
+static pthread_once_t type_symbols_once = PTHREAD_ONCE_INIT;
+static Symbol type_symbols[COLUMN_TYPE_COUNT];
+
+static void init_type_symbols(void) {
+    for (size_t i = 0; i < COLUMN_TYPE_COUNT; i++) type_symbols[i] = symbol_intern_cstr(column_types[i].name);
+}
+
+static uint8_t type_index(Symbol type_name) {
+    pthread_once(&type_symbols_once, init_type_symbols);
+    if (type_name == SYMBOL_NONE) return NO_COLUMN_TYPE;
+    for (size_t i = 0; i < COLUMN_TYPE_COUNT; i++) {
+        if (type_symbols[i] == type_name) return (uint8_t)i;
+    }
+    return NO_COLUMN_TYPE;
+}
+
+const ColumnType* model_column_type(Symbol type_name) {
+    uint8_t index = type_index(type_name);
+    return index == NO_COLUMN_TYPE ? NULL : &column_types[index].type;
+}
+
+static uint32_t hash_symbol(Symbol symbol) {
+    return symbol * 2654435761u;
+}
+
+const ColumnType* model_table_column(const ModelTable* table, Symbol column) {
+    if (!table || column == SYMBOL_NONE) return NULL;
+    for (uint32_t i = hash_symbol(column) & table->mask;; i = (i + 1) & table->mask) {
+        const ColumnSlot* slot = &table->slots[i];
+        if (slot->column == column) return &column_types[slot->type].type;
+        if (slot->column == SYMBOL_NONE) return NULL;
+    }
+}
+
+static const TableSlot* find_table(const ModelSchema* schema, Symbol key) {
+    if (schema->capacity == 0 || key == SYMBOL_NONE) return NULL;
+    size_t mask = schema->capacity - 1;
+    for (size_t i = hash_symbol(key) & mask;; i = (i + 1) & mask) {
+        const TableSlot* slot = &schema->slots[i];
+        if (slot->key == key || slot->key == SYMBOL_NONE) return slot;
+    }
+}
+
+void model_schema_init(ModelSchema* schema) {
+    memset(schema, 0, sizeof(ModelSchema));
+    arena_init(&schema->arena);
+}
+
+void model_schema_free(ModelSchema* schema) {
+    free(schema->slots);
+    arena_reset(&schema->arena);
+    memset(schema, 0, sizeof(ModelSchema));
+}
+
+// Columns of the table being read, before they are indexed
+typedef struct {
+    ModelSchema* schema;
+    Symbol table;
+    ColumnSlot* columns;
+    int count;
+    int capacity;
+    int failed;
+} SchemaLoader;
+
+static void add_column(SchemaLoader* loader, const char* name, size_t len, uint8_t type) {
+    if (loader->table == SYMBOL_NONE || len == 0 || type == NO_COLUMN_TYPE) return;
+    if (loader->count == loader->capacity) {
+        int capacity = loader->capacity ? loader->capacity * 2 : 64;
+        ColumnSlot* columns = realloc(loader->columns, capacity * sizeof(ColumnSlot));
+        if (!columns) {
+            loader->failed = 1;
+            return;
+        }
+        loader->columns = columns;
+        loader->capacity = capacity;
+    }
+    loader->columns[loader->count++] = (ColumnSlot){ symbol_intern(name, len), type };
+}
+
+static void begin_table(SchemaLoader* loader, const char* name, size_t len) {
+    // "public.users" -> "users"
+    for (size_t i = len; i > 0; i--) {
+        if (name[i - 1] == '.') {
+            name += i;
+            len -= i;
+            break;
+        }
+    }
+    loader->table = len > 0 ? symbol_intern(name, len) : SYMBOL_NONE;
+    loader->count = 0;
+}
+
+static int grow_tables(ModelSchema* schema) {
+    size_t capacity = schema->capacity ? schema->capacity * 2 : 64;
+    TableSlot* slots = calloc(capacity, sizeof(TableSlot));
+    if (!slots) return -1;
+    for (size_t i = 0; i < schema->capacity; i++) {
+        const TableSlot* old = &schema->slots[i];
+        if (old->key == SYMBOL_NONE) continue;
+        size_t at = hash_symbol(old->key) & (capacity - 1);
+        while (slots[at].key != SYMBOL_NONE) at = (at + 1) & (capacity - 1);
+        slots[at] = *old;
+    }
+    free(schema->slots);
+    schema->slots = slots;
+    schema->capacity = capacity;
+    return 0;
+}
+
+// Indexes the columns read since begin_table(); a column declared twice keeps its last type
+static void end_table(SchemaLoader* loader) {
+    ModelSchema* schema = loader->schema;
+    Symbol name = loader->table;
+    loader->table = SYMBOL_NONE;
+    if (name == SYMBOL_NONE || loader->failed) return;
+
+    char key[MAX_NAME_LENGTH];
+    route_singular_name(symbol_name(name), symbol_length(name), key, sizeof(key));
+    Symbol key_symbol = symbol_intern_cstr(key);
+    if (key_symbol == SYMBOL_NONE) return;
+    if ((size_t)(schema->table_count + 1) * 2 > schema->capacity && grow_tables(schema) != 0) {
+        loader->failed = 1;
+        return;
+    }
+    TableSlot* slot = (TableSlot*)find_table(schema, key_symbol);
+    if (slot->key != SYMBOL_NONE) return; // The first table of a name wins
+
+    uint32_t capacity = 8;
+    while (capacity < (uint32_t)loader->count * 2) capacity *= 2;
+    ModelTable* table = arena_alloc(&schema->arena, sizeof(ModelTable));
+    ColumnSlot* columns = arena_calloc(&schema->arena, capacity, sizeof(ColumnSlot));
+    if (!table || !columns) {
+        loader->failed = 1;
+        return;
+    }
+    table->name = name;
+    table->slots = columns;
+    table->mask = capacity - 1;
+    table->column_count = 0;
+    for (int i = 0; i < loader->count; i++) {
+        uint32_t at = hash_symbol(loader->columns[i].column) & table->mask;
+        while (columns[at].column != SYMBOL_NONE && columns[at].column != loader->columns[i].column) {
+            at = (at + 1) & table->mask;
+        }
+        if (columns[at].column == SYMBOL_NONE) table->column_count++;
+        columns[at] = loader->columns[i];
+    }
+
+    slot->key = key_symbol;
+    slot->table = table;
+    schema->table_count++;
+    schema->column_count += table->column_count;
+}
+
+static uint8_t type_of(StrView name) {
+    return type_index(symbol_intern(name.ptr, name.len));
+}
+
+static int is_value_token(const RubyToken* token) {
+    return token->type == RUBY_TOKEN_SYMBOL || token->type == RUBY_TOKEN_STRING;
+}
+
+// create_table "users", id: :uuid, force: :cascade do |t|
+static void begin_rb_table(SchemaLoader* loader, const RubyStatement* stmt) {
+    RubyTokenizer tokenizer;
+    RubyToken token;
+    StrView primary_key = { "id", 2 };
+    uint8_t primary_type = type_of((StrView){ "bigint", 6 });
+    int named = 0;
+    ruby_tokenizer_init(&tokenizer, stmt->args);
+    while (ruby_tokenizer_next(&tokenizer, &token)) {
+        if (!named && token.depth == 0 && is_value_token(&token)) {
+            begin_table(loader, token.text.ptr, token.text.len);
+            named = 1;
+        } else if (token.type == RUBY_TOKEN_LABEL && token.depth == 0) {
+            StrView label = token.text;
+            if (!ruby_tokenizer_next(&tokenizer, &token)) break;
+            if (STR_VIEW_EQ(label, "id")) {
+                // id: false has no primary key column
+                primary_type = is_value_token(&token) ? type_of(token.text) : NO_COLUMN_TYPE;
+            } else if (STR_VIEW_EQ(label, "primary_key") && is_value_token(&token)) {
+                primary_key = token.text;
+            }
+        }
+    }
+    if (named) add_column(loader, primary_key.ptr, primary_key.len, primary_type);
+}
+
+// t.string "name", null: false / t.column "name", :string / t.references "account", type: :uuid
+static void add_rb_columns(SchemaLoader* loader, const RubyStatement* stmt) {
+    RubyTokenizer tokenizer;
+    RubyToken token;
+    ruby_tokenizer_init(&tokenizer, stmt->args);
+    if (!ruby_tokenizer_next(&tokenizer, &token) || token.type != RUBY_TOKEN_PUNCT || token.text.ptr[0] != '.') {
+        return;
+    }
+    if (!ruby_tokenizer_next(&tokenizer, &token) || token.type != RUBY_TOKEN_IDENT) return;
+    StrView method = token.text;
+
+    if (STR_VIEW_EQ(method, "timestamps")) {
+        uint8_t type = type_of((StrView){ "datetime", 8 });
+        add_column(loader, "created_at", 10, type);
+        add_column(loader, "updated_at", 10, type);
+        return;
+    }
+
+    int reference = STR_VIEW_EQ(method, "references") || STR_VIEW_EQ(method, "belongs_to");
+    int is_column = STR_VIEW_EQ(method, "column");
+    StrView names[16];
+    int name_count = 0;
+    StrView column_type = method;
+    int array = 0;
+    int polymorphic = 0;
+    while (ruby_tokenizer_next(&tokenizer, &token)) {
+        if (token.depth != 0) continue;
+        if (token.type == RUBY_TOKEN_LABEL) {
+            StrView label = token.text;
+            if (!ruby_tokenizer_next(&tokenizer, &token)) break;
+            int yes = token.type == RUBY_TOKEN_IDENT && STR_VIEW_EQ(token.text, "true");
+            if (STR_VIEW_EQ(label, "array")) array = yes;
+            else if (STR_VIEW_EQ(label, "polymorphic")) polymorphic = yes;
+            else if (STR_VIEW_EQ(label, "type") && reference && is_value_token(&token)) column_type = token.text;
+        } else if (is_value_token(&token)) {
+            if (is_column && name_count == 1) column_type = token.text;
+            else if (name_count < (int)(sizeof(names) / sizeof(names[0]))) names[name_count++] = token.text;
+        }
+    }
+    if (array) return; // No element type in the OpenAPI type yet
+
+    if (!reference) {
+        uint8_t type = type_of(column_type);
+        for (int i = 0; i < name_count; i++) add_column(loader, names[i].ptr, names[i].len, type);
+        return;
+    }
+    uint8_t type = type_of(column_type.ptr == method.ptr ? (StrView){ "bigint", 6 } : column_type);
+    for (int i = 0; i < name_count; i++) {
+        char column[MAX_NAME_LENGTH];
+        int len = snprintf(column, sizeof(column), "%.*s_id", (int)names[i].len, names[i].ptr);
+        if (len > 0 && (size_t)len < sizeof(column)) add_column(loader, column, len, type);
+        len = snprintf(column, sizeof(column), "%.*s_type", (int)names[i].len, names[i].ptr);
+        if (polymorphic && len > 0 && (size_t)len < sizeof(column)) {
+            add_column(loader, column, len, type_of((StrView){ "string", 6 }));
+        }
+    }
+}
+
+static void load_schema_rb(SchemaLoader* loader, RubyLexer* lexer) {
+    RubyStatement stmt;
+    while (ruby_lexer_next(lexer, &stmt)) {
+        if (!STR_VIEW_EQ(stmt.keyword, "create_table")) continue;
+        begin_rb_table(loader, &stmt);
+        if (stmt.block_delta <= 0) {
+            end_table(loader);
+            continue;
+        }
+        while (ruby_lexer_next(lexer, &stmt)) {
+            if (stmt.block_delta < 0) break;
+            if (stmt.block_delta > 0) {
+                ruby_lexer_skip_block(lexer);
+                continue;
+            }
+            add_rb_columns(loader, &stmt);
+        }
+        end_table(loader);
+    }
+}
+
+static int starts_with_word(const char* p, const char* end, const char* word) {
+    size_t len = strlen(word);
+    if ((size_t)(end - p) < len || strncasecmp(p, word, len) != 0) return 0;
+    return p + len == end || !(isalnum((unsigned char)p[len]) || p[len] == '_');
+}
+
+static const char* skip_blanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+// Name at `p`, without "", `` or [] quotes; returns the position after it
+static const char* read_sql_name(const char* p, const char* end, StrView* name) {
+    char close = *p == '"' ? '"' : *p == '`' ? '`' : *p == '[' ? ']' : '\0';
+    if (close) {
+        const char* start = ++p;
+        while (p < end && *p != close) p++;
+        *name = (StrView){ start, (size_t)(p - start) };
+        return p < end ? p + 1 : p;
+    }
+    const char* start = p;
+    while (p < end && (isalnum((unsigned char)*p) || *p == '_' || *p == '$')) p++;
+    *name = (StrView){ start, (size_t)(p - start) };
+    return p;
+}
+
+// CREATE [UNLOGGED|TEMPORARY] TABLE [IF NOT EXISTS] public.users (
+static void begin_sql_table(SchemaLoader* loader, const char* p, const char* end) {
+    p = skip_blanks(p + 6, end);
+    for (;;) {
+        if (starts_with_word(p, end, "TABLE")) break;
+        if (!(starts_with_word(p, end, "UNLOGGED") || starts_with_word(p, end, "TEMPORARY") ||
+              starts_with_word(p, end, "TEMP"))) {
+            return;
+        }
+        while (p < end && isalpha((unsigned char)*p)) p++;
+        p = skip_blanks(p, end);
+    }
+    p = skip_blanks(p + 5, end);
+    while (starts_with_word(p, end, "IF") || starts_with_word(p, end, "NOT") || starts_with_word(p, end, "EXISTS")) {
+        while (p < end && isalpha((unsigned char)*p)) p++;
+        p = skip_blanks(p, end);
+    }
+    if (!memchr(p, '(', end - p)) return; // CREATE TABLE ... AS SELECT
+
+    // Schema-qualified names keep only the last part
+    StrView name = { p, 0 };
+    while (p < end) {
+        p = read_sql_name(p, end, &name);
+        if (p >= end || *p != '.') break;
+        p++;
+    }
+    begin_table(loader, name.ptr, name.len);
+}
+
+// One column line: `    name character varying(255) NOT NULL,`
+static void add_sql_column(SchemaLoader* loader, const char* p, const char* end) {
+    static const char* const constraints[] = { "CONSTRAINT", "PRIMARY", "UNIQUE", "KEY", "INDEX", "FOREIGN",
+                                               "CHECK", "EXCLUDE", "FULLTEXT", "SPATIAL" };
+    if (*p != '"' && *p != '`' && *p != '[') {
+        for (size_t i = 0; i < sizeof(constraints) / sizeof(constraints[0]); i++) {
+            if (starts_with_word(p, end, constraints[i])) return;
+        }
+    }
+    StrView name;
+    p = skip_blanks(read_sql_name(p, end, &name), end);
+
+    char type[32];
+    size_t len = 0;
+    const char* q = p;
+    for (; q < end && (isalnum((unsigned char)*q) || *q == '_') && len + 1 < sizeof(type); q++) {
+        type[len++] = (char)tolower((unsigned char)*q);
+    }
+    type[len] = '\0';
+
+    // Array columns (integer[]) have no OpenAPI type here; tinyint(1) is a MySQL boolean
+    const char* type_end = q;
+    while (type_end < end && *type_end != ',' &&
+           !(*type_end == ' ' && type_end + 1 < end && isupper((unsigned char)type_end[1]))) {
+        type_end++;
+    }
+    if (memchr(q, '[', type_end - q)) return;
+    if (strcmp(type, "tinyint") == 0 && (size_t)(end - q) >= 3 && memcmp(q, "(1)", 3) == 0) {
+        memcpy(type, "boolean", 8);
+        len = 7;
+    }
+    add_column(loader, name.ptr, name.len, type_of((StrView){ type, len }));
+}
+
+static int load_structure_sql(SchemaLoader* loader, const char* data, size_t size) {
+    const char* end = data + size;
+    int lines = 0;
+    for (const char* line = data; line < end; lines++) {
+        const char* line_end = memchr(line, '\n', end - line);
+        if (!line_end) line_end = end;
+        const char* p = skip_blanks(line, line_end);
+
+        if (loader->table != SYMBOL_NONE) {
+            if (p < line_end && *p == ')') end_table(loader);
+            else if (p < line_end && !(p + 1 < line_end && p[0] == '-' && p[1] == '-')) add_sql_column(loader, p, line_end);
+        } else if (starts_with_word(p, line_end, "CREATE")) {
+            begin_sql_table(loader, p, line_end);
+        }
+        line = line_end + 1;
+    }
+    end_table(loader);
+    return lines;
+}
+
+static int ends_with(const char* str, const char* suffix) {
+    size_t len = strlen(str);
+    size_t suffix_len = strlen(suffix);
+    return len >= suffix_len && strcmp(str + len - suffix_len, suffix) == 0;
+}
+
+int model_schema_load_source(ModelSchema* schema, const char* filename, const char* data, size_t size,
+                             ParseCounts* counts) {
+    SchemaLoader loader = { schema, SYMBOL_NONE, NULL, 0, 0, 0 };
+    int lines;
+    if (ends_with(filename, ".sql")) {
+        lines = load_structure_sql(&loader, data, size);
+    } else {
+        RubyLexer lexer;
+        ruby_lexer_init(&lexer, data, size);
+        load_schema_rb(&loader, &lexer);
+        lines = lexer.line - (size > 0 && data[size - 1] == '\n');
+    }
+    if (counts) {
+        counts->bytes = size;
+        counts->lines = lines;
+    }
+
+    free(loader.columns);
+    if (loader.failed) {
+        report_diagnostic(DIAGNOSTIC_ERROR, DIAGNOSTIC_OUT_OF_MEMORY, filename, "Out of memory while reading schema %s",
+                          filename);
+        return -1;
+    }
+    return 0;
+}
+
+int model_schema_load(ModelSchema* schema, const char* filename, ParseCounts* counts) {
+    SourceFile source;
+    if (source_file_open(&source, filename) != 0) {
+        char reason[128];
+        report_diagnostic(DIAGNOSTIC_ERROR, DIAGNOSTIC_CANNOT_READ, filename, "Cannot open file %s: %s", filename,
+                          diagnostic_strerror(errno, reason, sizeof(reason)));
+        return -1;
+    }
+
+    int status = model_schema_load_source(schema, filename, source.data, source.size, counts);
+    source_file_close(&source);
+    return status;
+}
+
+// Table whose singular snake_case name is that of `name`: "Billing::Invoice" -> billing_invoice
+static const ModelTable* lookup_table(const ModelSchema* schema, const char* name, size_t len) {
+    if (len == 0) return NULL;
+    char key[MAX_NAME_LENGTH];
+    route_singular_name(name, len, key, sizeof(key));
+    for (char* p = key; *p; p++) {
+        if (*p == '/') *p = '_';
+    }
+    Symbol symbol = symbol_intern_cstr(key);
+    const TableSlot* slot = find_table(schema, symbol);
+    return slot && slot->key == symbol ? slot->table : NULL;
+}
+
+void model_schema_match(const ModelSchema* schema, ApiSpec* spec, ModelMatchSummary* summary) {
+    memset(summary, 0, sizeof(ModelMatchSummary));
+    for (int i = 0; i < spec->resources.count; i++) {
+        ResourceInfo* resource = &spec->resources.items[i];
+        resource->model_table = NULL;
+        if (resource->abstract) continue;
+
+        // model_name 'Billing::Invoice': billing_invoices, then invoices
+        const char* model = resource->model_name;
+        if (has_text(model)) {
+            resource->model_table = lookup_table(schema, model, strlen(model));
+            const char* base = model;
+            for (const char* p = model; (p = strstr(p, "::")); p += 2) base = p + 2;
+            if (!resource->model_table && base != model) {
+                resource->model_table = lookup_table(schema, base, strlen(base));
+            }
+        }
+        // user_account_resource.rb: user_accounts
+        const char* class_name = resource->class_name;
+        if (!resource->model_table && has_text(class_name)) {
+            size_t len = strlen(class_name);
+            if (len > 9 && strcmp(class_name + len - 9, "_resource") == 0) len -= 9;
+            else if (len > 8 && strcmp(class_name + len - 8, "Resource") == 0) len -= 8;
+            resource->model_table = lookup_table(schema, class_name, len);
+        }
+
+        if (resource->model_table) summary->typed++;
+        else summary->untyped++;
+    }
+}
+
+// OpenAPI type of a filter: its declared type, else the type of the column
+// it is named after, else string. Declared types unknown to the schema
+// reader are passed on as written.
+ColumnType model_filter_type(const ResourceInfo* resource, const Filter* filter) {
+    const ColumnType* type = model_column_type(filter->type);
+    if (!type && symbol_has_text(filter->type)) return (ColumnType){ symbol_name(filter->type), NULL };
+    if (!type) type = model_table_column(resource->model_table, filter->name);
+    return type ? *type : (ColumnType){ "string", NULL };
+}
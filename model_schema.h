@@ -0,0 +1,68 @@
+#ifndef MODEL_SCHEMA_H
+#define MODEL_SCHEMA_H
+
+#include <stddef.h>
+
+#include "api_spec.h"
+#include "resource_parser.h"
+
+// OpenAPI type of a column or of a declared filter type
+typedef struct {
+    const char* type;   // "string", "integer", "number", "boolean" or "object"
+    const char* format; // "date-time", "uuid", "int64", ...; NULL if none
+} ColumnType;
+
+typedef struct {
+    Symbol key; // Singular snake_case name of the table
+    const ModelTable* table;
+} TableSlot;
+
+// Tables and column types of db/schema.rb or structure.sql, indexed by the
+// singular snake_case table name and then by column symbol
+typedef struct {
+    Arena arena;
+    TableSlot* slots;
+    size_t capacity;
+    int table_count;
+    int column_count;
+} ModelSchema;
+
+typedef struct {
+    int typed;   // Resources that found their table
+    int untyped; // ... and those that did not
+} ModelMatchSummary;
+
+void model_schema_init(ModelSchema* schema);
+void model_schema_free(ModelSchema* schema);
+
+// Reads a schema in one pass: `create_table` blocks of a db/schema.rb, or
+// `CREATE TABLE` statements of a structure.sql (PostgreSQL or MySQL) when
+// the name ends in ".sql". Columns of unknown or array types are left out.
+// `counts` may be NULL. Returns -1 if the file could not be read or memory
+// ran out.
+int model_schema_load(ModelSchema* schema, const char* filename, ParseCounts* counts);
+
+// Same for a schema that is already in memory; `filename` decides between
+// the two syntaxes and names it in diagnostics. Returns -1 when out of memory.
+int model_schema_load_source(ModelSchema* schema, const char* filename, const char* data, size_t size,
+                             ParseCounts* counts);
+
+// Sets ResourceInfo.model_table for every resource of `spec`: the table of
+// its model_name ("Billing::Invoice" -> billing_invoices, then invoices), or
+// of its class name without "Resource" when it names no model. Resources
+// without a table get NULL.
+void model_schema_match(const ModelSchema* schema, ApiSpec* spec, ModelMatchSummary* summary);
+
+// OpenAPI type of `column` in `table`; NULL when either is unknown.
+const ColumnType* model_table_column(const ModelTable* table, Symbol column);
+
+// OpenAPI type of a Rails or SQL type name ("datetime", "uuid", "bigint");
+// NULL when the name is not a known type.
+const ColumnType* model_column_type(Symbol type_name);
+
+// OpenAPI type of a filter: its declared type, else the type of the column
+// it is named after (see model_schema_match()), else string. Declared
+// types this reader does not know are passed on as written.
+ColumnType model_filter_type(const ResourceInfo* resource, const Filter* filter);
+
+#endif
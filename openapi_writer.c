@@ -0,0 +1,1688 @@
+#include "openapi_writer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "diagnostics.h"
+#include "model_schema.h"
+#include "routes_parser.h"
+#include "work_pool.h"
+
+// Open-addressing table from an object key to the index of its last
+// occurrence, used to collapse duplicate keys the way json-c does
+typedef struct {
+    const char* key;
+    int last;
+    int emitted;
+} KeySlot;
+
+typedef struct {
+    KeySlot* slots;
+    size_t capacity;
+    size_t count; // Occupied slots
+} KeyTable;
+
+typedef struct {
+    Symbol name;
+    const char* type; // JSON type, or the linkage schema of a relationship
+    const char* format;
+    int linkage;
+} Property;
+
+static int key_table_reset(KeyTable* table, int count) {
+    size_t capacity = 16;
+    while (capacity < (size_t)count * 2) capacity *= 2;
+    if (capacity > table->capacity) {
+        KeySlot* slots = realloc(table->slots, capacity * sizeof(KeySlot));
+        if (!slots) return -1;
+        table->slots = slots;
+        table->capacity = capacity;
+    }
+    memset(table->slots, 0, table->capacity * sizeof(KeySlot));
+    table->count = 0;
+    return 0;
+}
+
+static void key_table_free(KeyTable* table) {
+    free(table->slots);
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
+
+static uint64_t hash_string(const char* str) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const char* p = str; *p; p++) hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    return hash;
+}
+
+static KeySlot* key_table_slot(KeyTable* table, const char* key) {
+    size_t mask = table->capacity - 1;
+    for (size_t i = hash_string(key) & mask;; i = (i + 1) & mask) {
+        KeySlot* slot = &table->slots[i];
+        if (!slot->key) {
+            slot->key = key;
+            table->count++;
+            return slot;
+        }
+        if (strcmp(slot->key, key) == 0) return slot;
+    }
+}
+
+// The slot of `key`, or NULL if the table does not hold it; safe to call
+// from several threads, unlike key_table_slot()
+static const KeySlot* key_table_find(const KeyTable* table, const char* key) {
+    if (table->count == 0) return NULL;
+    size_t mask = table->capacity - 1;
+    for (size_t i = hash_string(key) & mask;; i = (i + 1) & mask) {
+        const KeySlot* slot = &table->slots[i];
+        if (!slot->key) return NULL;
+        if (strcmp(slot->key, key) == 0) return slot;
+    }
+}
+
+// Makes room for `more` keys next to the ones the table holds
+static int key_table_reserve(KeyTable* table, int more) {
+    if ((table->count + more) * 2 <= table->capacity) return 0;
+    KeyTable grown = { 0 };
+    if (key_table_reset(&grown, (int)table->count + more) != 0) return -1;
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->slots[i].key) *key_table_slot(&grown, table->slots[i].key) = table->slots[i];
+    }
+    key_table_free(table);
+    *table = grown;
+    return 0;
+}
+
+// Records the last index of every key; call before emitting the keys
+static int key_table_build(KeyTable* table, const char* const* keys, int count) {
+    if (key_table_reset(table, count) != 0) return -1;
+    for (int i = 0; i < count; i++) key_table_slot(table, keys[i])->last = i;
+    return 0;
+}
+
+// Index of the value to emit for `key`, or -1 if the key was already emitted
+static int key_table_claim(KeyTable* table, const char* key) {
+    KeySlot* slot = key_table_slot(table, key);
+    if (slot->emitted) return -1;
+    slot->emitted = 1;
+    return slot->last;
+}
+
+// Objects with fewer entries are written on the calling thread
+#define MIN_PARALLEL_ENTRIES 64
+
+static int pool_jobs(int jobs, int count) {
+    return count < MIN_PARALLEL_ENTRIES ? 1 : jobs;
+}
+
+// Writes value `index` of an object
+typedef void (*EmitValueFn)(SpecEmitter* out, const void* ctx, int index);
+
+// Values serialized by one worker, back to back
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+    OutputSink sink;
+    void* copy; // The emitter forked for each value
+} FragmentBuffer;
+
+typedef struct {
+    int worker;
+    size_t offset;
+    size_t size;
+} Fragment;
+
+typedef struct {
+    const SpecEmitter* out;
+    EmitValueFn emit_value;
+    const void* ctx;
+    FragmentBuffer* buffers;
+    Fragment* fragments;
+} FragmentJob;
+
+static int fragment_write(void* ctx, const char* data, size_t size) {
+    FragmentBuffer* buffer = ctx;
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 1 << 16;
+        while (capacity < buffer->size + size) capacity *= 2;
+        char* grown = realloc(buffer->data, capacity);
+        if (!grown) return -1;
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+    return 0;
+}
+
+static void render_fragment(void* ctx, size_t index, int worker_id) {
+    FragmentJob* job = ctx;
+    FragmentBuffer* buffer = &job->buffers[worker_id];
+    Fragment* fragment = &job->fragments[index];
+    fragment->worker = worker_id;
+    fragment->offset = buffer->sink.bytes_written + buffer->sink.used;
+    job->emit_value(job->out->fork(job->out, buffer->copy, &buffer->sink), job->ctx, (int)index);
+    fragment->size = buffer->sink.bytes_written + buffer->sink.used - fragment->offset;
+}
+
+// Writes the entries of the current object in order. With several jobs and
+// an emitter that can fork, the values are first serialized on a thread
+// pool and then spliced in behind their keys, giving the same bytes.
+static int emit_entries(SpecEmitter* out, const char* const* keys, int count, EmitValueFn emit_value,
+                        const void* ctx, int jobs) {
+    jobs = pool_jobs(jobs, count);
+    if (jobs < 2 || !out->fork) {
+        for (int i = 0; i < count; i++) {
+            out->key(out, keys[i]);
+            emit_value(out, ctx, i);
+        }
+        return 0;
+    }
+
+    FragmentJob job = { out, emit_value, ctx, calloc(jobs, sizeof(FragmentBuffer)), malloc(count * sizeof(Fragment)) };
+    int status = job.buffers && job.fragments ? 0 : -1;
+    for (int w = 0; status == 0 && w < jobs; w++) {
+        FragmentBuffer* buffer = &job.buffers[w];
+        buffer->copy = malloc(out->fork_size);
+        if (!buffer->copy || output_sink_init(&buffer->sink, 1 << 16, fragment_write, buffer) != 0) status = -1;
+    }
+    if (status == 0) {
+        // Every value is forked from the position after the first key
+        out->key(out, keys[0]);
+        work_pool_run(jobs, count, render_fragment, &job);
+        for (int w = 0; w < jobs; w++) {
+            if (output_sink_flush(&job.buffers[w].sink) != 0) status = -1;
+        }
+    }
+    for (int i = 0; status == 0 && i < count; i++) {
+        const Fragment* fragment = &job.fragments[i];
+        if (i > 0) out->key(out, keys[i]);
+        out->splice(out, job.buffers[fragment->worker].data + fragment->offset, fragment->size);
+    }
+
+    for (int w = 0; job.buffers && w < jobs; w++) {
+        output_sink_free(&job.buffers[w].sink);
+        free(job.buffers[w].copy);
+        free(job.buffers[w].data);
+    }
+    free(job.buffers);
+    free(job.fragments);
+    return status;
+}
+
+// One operation of the paths section
+typedef struct {
+    const ResourceInfo* resource;
+    const char* path;
+    const char* verb;   // "get", "post", ...
+    const char* action; // Controller action, selects the summary
+    int* parameters;    // Indices into Components.parameters, in order
+    int parameter_count;
+} Operation;
+
+typedef struct {
+    Operation* items;
+    int count;
+    int capacity;
+} OperationList;
+
+// A parameter of components/parameters, shared by every operation that has it
+typedef struct {
+    const char* key; // Name under components/parameters
+    const char* name;
+    const char* in; // "path" or "query"
+    const char* type;
+    const char* format; // NULL if none
+} Parameter;
+
+typedef struct {
+    Parameter* items;
+    int count;
+    int capacity;
+} ParameterList;
+
+// Everything operations and schemas refer to with $ref
+typedef struct {
+    ParameterList parameters;
+    KeyTable signatures; // "in\tname\ttype" -> index into parameters
+    KeyTable keys;       // Keys taken under components/parameters
+    Arena* arena;        // Parameters, signatures and keys
+} Components;
+
+// Relationship linkage schemas of components/schemas, referenced by every
+// relationship property
+#define RESOURCE_IDENTIFIER_SCHEMA "JsonApiResourceIdentifier"
+#define RELATIONSHIP_LINKS_SCHEMA "JsonApiRelationshipLinks"
+#define TO_ONE_SCHEMA "JsonApiToOneRelationship"
+#define TO_MANY_SCHEMA "JsonApiToManyRelationship"
+
+// Where $refs point: at the components of the same document, or between the
+// files of a sharded spec (openapi_shards_open())
+typedef struct {
+    const char* up;        // "../" per directory between the file and the spec directory; NULL in one document
+    const char* extension; // Of the shard files
+    const KeyTable* folded; // Schemas whose file escapes upper case letters too; NULL in one document
+} RefStyle;
+
+static const RefStyle document_refs = { NULL, NULL, NULL };
+
+#define MAX_REF_LENGTH 1024
+
+// Appends `str` to `ref`, stopping short of its end
+static size_t append_ref(char* ref, size_t len, const char* str) {
+    while (*str && len + 1 < MAX_REF_LENGTH) ref[len++] = *str++;
+    ref[len] = '\0';
+    return len;
+}
+
+// JSON pointer escaping: "~" -> "~0", "/" -> "~1"
+static size_t append_pointer(char* ref, size_t len, const char* key) {
+    for (const char* p = key; *p && len + 3 < MAX_REF_LENGTH; p++) {
+        if (*p == '~' || *p == '/') {
+            ref[len++] = '~';
+            ref[len++] = *p == '~' ? '0' : '1';
+        } else {
+            ref[len++] = *p;
+        }
+    }
+    ref[len] = '\0';
+    return len;
+}
+
+static int plain_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+// Appends `c` as it may stand in a file name and a URI: itself, or "~XX".
+// With `fold`, upper case letters are written as "~XX" as well.
+static size_t append_name_char(char* ref, size_t len, char c, int fold) {
+    if (len + 4 >= MAX_REF_LENGTH) return len;
+    if (plain_name_char(c) && !(fold && c >= 'A' && c <= 'Z')) {
+        ref[len++] = c;
+    } else {
+        len += snprintf(ref + len, 4, "~%02X", (unsigned char)c);
+    }
+    ref[len] = '\0';
+    return len;
+}
+
+// File of a schema below schemas/: "Billing::Invoice" -> "Billing.Invoice"
+static size_t append_schema_file(char* ref, size_t len, const char* key, int fold) {
+    for (const char* p = key; *p; p++) {
+        if (p[0] == ':' && p[1] == ':' && len + 2 < MAX_REF_LENGTH) {
+            ref[len++] = '.';
+            ref[len] = '\0';
+            p++;
+        } else {
+            len = append_name_char(ref, len, *p, fold);
+        }
+    }
+    return len;
+}
+
+// File of a path item below paths/, a directory per segment:
+// "/api/v1/users/{id}" -> "api/v1/users/@id"
+static size_t append_path_file(char* ref, size_t len, const char* path, int fold) {
+    while (*path == '/') path++;
+    if (!*path) return append_name_char(ref, len, '/', fold);
+    while (*path) {
+        size_t segment = strcspn(path, "/");
+        const char* p = path;
+        const char* end = path + segment;
+        if (segment > 2 && p[0] == '{' && end[-1] == '}') {
+            len = append_ref(ref, len, "@");
+            p++;
+            end--;
+        }
+        for (; p < end; p++) len = append_name_char(ref, len, *p, fold);
+        path += segment;
+        if (*path == '/' && *++path) len = append_ref(ref, len, "/");
+    }
+    return len;
+}
+
+static void emit_ref(SpecEmitter* out, const RefStyle* refs, const char* section, const char* key) {
+    char ref[MAX_REF_LENGTH];
+    size_t len;
+    if (!refs->up) {
+        len = append_ref(ref, 0, "#/components/");
+        len = append_ref(ref, len, section);
+        len = append_pointer(ref, append_ref(ref, len, "/"), key);
+    } else if (strcmp(section, "schemas") == 0) {
+        len = append_ref(ref, append_ref(ref, 0, refs->up), "schemas/");
+        int fold = refs->folded && key_table_find(refs->folded, key);
+        len = append_ref(ref, append_schema_file(ref, len, key, fold), refs->extension);
+    } else {
+        len = append_ref(ref, append_ref(ref, 0, refs->up), section);
+        len = append_ref(ref, append_ref(ref, len, refs->extension), "#/");
+        append_pointer(ref, len, key);
+    }
+    out->begin_object(out);
+    emit_key_string(out, "$ref", ref);
+    out->end_object(out);
+}
+
+static const char* fallback_path(const ResourceInfo* resource, Arena* scratch) {
+    // Generate default path - be safe with string operations
+    char default_path[256];
+    int written = snprintf(default_path, sizeof(default_path), "/api/v1/%s",
+                           has_text(resource->model_name) ? resource->model_name : "resource");
+    if (written < 0 || (size_t)written >= sizeof(default_path)) {
+        strcpy(default_path, "/api/v1/resource"); // fallback
+    }
+    return arena_intern_cstr(scratch, default_path);
+}
+
+static int add_operation(OperationList* list, Arena* scratch, const ResourceInfo* resource, const char* path,
+                         const char* method, const char* action) {
+    char verb[16];
+    size_t len = 0;
+    for (; method[len] && len + 1 < sizeof(verb); len++) {
+        verb[len] = (char)(method[len] >= 'A' && method[len] <= 'Z' ? method[len] + ('a' - 'A') : method[len]);
+    }
+    Operation* operation = ARENA_PUSH(scratch, *list);
+    if (!operation) return -1;
+    operation->resource = resource;
+    operation->path = path;
+    operation->verb = arena_intern(scratch, verb, len);
+    operation->action = action ? action : "";
+    return operation->verb ? 0 : -1;
+}
+
+// Link and related-resource routes of every relationship of the resource
+static int add_relationship_operations(OperationList* list, Arena* scratch, const ResourceInfo* resource,
+                                       const RouteInfo* route) {
+    const RelationList* relations = resource_relations(resource);
+    for (int r = 0; r < relations->count; r++) {
+        const Relation* relation = &relations->items[r];
+        if (!symbol_has_text(relation->name)) continue;
+
+        char links[512];
+        char related[512];
+        const char* name = symbol_name(relation->name);
+        snprintf(links, sizeof(links), "%s/relationships/%s", route->path, name);
+        snprintf(related, sizeof(related), "%s/%s", route->path, name);
+        const char* links_path = arena_intern_cstr(scratch, links);
+        const char* related_path = arena_intern_cstr(scratch, related);
+        if (!links_path || !related_path) return -1;
+
+        const JsonapiLinkRoute* routes;
+        int count = jsonapi_link_routes(symbol_is(relation->type, "has_many"), &routes);
+        for (int i = 0; i < count; i++) {
+            const char* path = routes[i].related ? related_path : links_path;
+            if (add_operation(list, scratch, resource, path, routes[i].method, routes[i].action) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static int collect_resource_operations(const ResourceInfo* resource, OperationList* list, Arena* scratch) {
+    if (resource->abstract) return 0;
+    if (!resource->route) {
+        const char* path = fallback_path(resource, scratch);
+        if (!path || add_operation(list, scratch, resource, path, "GET", "index") != 0) return -1;
+        // POST method (create) - only if creatable_fields exist
+        if (resource_creatable_fields(resource)->count > 0 &&
+            add_operation(list, scratch, resource, path, "POST", "create") != 0) {
+            return -1;
+        }
+        return 0;
+    }
+
+    for (int r = 0; r < resource->route_count; r++) {
+        const RouteInfo* route = &resource->route[r];
+        int status = route->method
+                         ? add_operation(list, scratch, resource, route->path, route->method, route->action)
+                         : add_relationship_operations(list, scratch, resource, route);
+        if (status != 0) return -1;
+    }
+    return 0;
+}
+
+static int collect_operations(const ApiSpec* spec, OperationList* list, Arena* scratch) {
+    for (int i = 0; i < spec->resources.count; i++) {
+        if (collect_resource_operations(&spec->resources.items[i], list, scratch) != 0) return -1;
+    }
+    return 0;
+}
+
+int openapi_resource_operations(const ResourceInfo* resource, PathOperationList* list, Arena* arena) {
+    OperationList operations = { 0 };
+    if (collect_resource_operations(resource, &operations, arena) != 0) return -1;
+    for (int i = 0; i < operations.count; i++) {
+        PathOperation* operation = ARENA_PUSH(arena, *list);
+        if (!operation) return -1;
+        operation->verb = operations.items[i].verb;
+        operation->path = operations.items[i].path;
+    }
+    return 0;
+}
+
+static const char* operation_summary(const char* action) {
+    static const struct {
+        const char* action;
+        const char* summary;
+    } summaries[] = {
+        { "index", "List resources" },
+        { "create", "Create resource" },
+        { "show", "Show resource" },
+        { "update", "Update resource" },
+        { "destroy", "Delete resource" },
+        { "show_relationship", "Show relationship" },
+        { "create_relationship", "Add to relationship" },
+        { "update_relationship", "Replace relationship" },
+        { "destroy_relationship", "Remove from relationship" },
+        { "get_related_resource", "Show related resource" },
+        { "get_related_resources", "List related resources" },
+    };
+    for (size_t i = 0; i < sizeof(summaries) / sizeof(summaries[0]); i++) {
+        if (strcmp(summaries[i].action, action) == 0) return summaries[i].summary;
+    }
+    return action;
+}
+
+static void emit_parameter(SpecEmitter* out, const Parameter* parameter) {
+    out->begin_object(out);
+    emit_key_string(out, "name", parameter->name);
+    emit_key_string(out, "in", parameter->in);
+    out->key(out, "required");
+    out->boolean(out, strcmp(parameter->in, "path") == 0);
+    out->key(out, "schema");
+    out->begin_object(out);
+    emit_key_string(out, "type", parameter->type);
+    if (parameter->format) emit_key_string(out, "format", parameter->format);
+    out->end_object(out);
+    out->end_object(out);
+}
+
+// Key under components/parameters: "id" for a path parameter, "filter_name"
+// or "filter_name_type" for a filter (the format for a string), made unique
+// with a numeric suffix
+static const char* parameter_key(Components* components, const char* name, const char* in, const char* type,
+                                 const char* format) {
+    char key[256];
+    int len = snprintf(key, sizeof(key), "%s%s", strcmp(in, "path") == 0 ? "" : "filter_", name);
+    const char* suffix = strcmp(type, "string") != 0 ? type : format;
+    if (suffix && len > 0 && (size_t)len < sizeof(key)) {
+        snprintf(key + len, sizeof(key) - len, "_%s", suffix);
+    }
+    // Keys may only hold letters, digits, '.', '-' and '_'
+    for (char* p = key; *p; p++) {
+        if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '.' ||
+              *p == '-' || *p == '_')) {
+            *p = '_';
+        }
+    }
+
+    len = (int)strlen(key);
+    if (len > (int)sizeof(key) - 16) key[len = (int)sizeof(key) - 16] = '\0';
+    for (int suffix = 2;; suffix++) {
+        const char* interned = arena_intern_cstr(components->arena, key);
+        if (!interned) return NULL;
+        KeySlot* slot = key_table_slot(&components->keys, interned);
+        if (!slot->emitted) {
+            slot->emitted = 1;
+            return interned;
+        }
+        snprintf(key + len, sizeof(key) - len, "_%d", suffix);
+    }
+}
+
+static int add_parameter(Components* components, const char* name, size_t name_len, const char* in, const char* type,
+                         const char* format) {
+    char signature[512];
+    snprintf(signature, sizeof(signature), "%s\t%.*s\t%s\t%s", in, (int)name_len, name, type, format ? format : "");
+    KeySlot* slot = key_table_slot(&components->signatures, signature);
+    if (slot->emitted) return slot->last;
+    // Only new signatures are copied, so repeated lookups allocate nothing
+    slot->key = arena_intern_cstr(components->arena, signature);
+    if (!slot->key) return -1;
+
+    Parameter* parameter = ARENA_PUSH(components->arena, components->parameters);
+    if (!parameter) return -1;
+    parameter->name = arena_intern(components->arena, name, name_len);
+    parameter->in = in;
+    parameter->type = type;
+    parameter->format = format;
+    if (parameter->name) parameter->key = parameter_key(components, parameter->name, in, type, format);
+    if (!parameter->name || !parameter->key) return -1;
+    slot->emitted = 1;
+    slot->last = components->parameters.count - 1;
+    return slot->last;
+}
+
+static int filter_count(const Operation* operation) {
+    return strcmp(operation->action, "index") == 0 ? resource_filters(operation->resource)->count : 0;
+}
+
+// Gives every operation its parameters: path parameters ({id}, {user_id}),
+// then filters as query parameters of the list. Equal parameters are
+// collected once into components->parameters, which may already hold those
+// of earlier operations.
+static int collect_parameters(OperationList* operations, Components* components, Arena* scratch) {
+    int bound = 0;
+    for (int i = 0; i < operations->count; i++) {
+        for (const char* p = operations->items[i].path; (p = strchr(p, '{')); p++) bound++;
+        bound += filter_count(&operations->items[i]);
+    }
+    if (key_table_reserve(&components->signatures, bound) != 0 || key_table_reserve(&components->keys, bound) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < operations->count; i++) {
+        Operation* operation = &operations->items[i];
+        int filters = filter_count(operation);
+        int path_params = 0;
+        for (const char* p = operation->path; (p = strchr(p, '{')); p++) path_params++;
+        if (path_params + filters == 0) continue;
+        operation->parameters = arena_alloc(scratch, (path_params + filters) * sizeof(int));
+        if (!operation->parameters) return -1;
+
+        for (const char* p = operation->path; (p = strchr(p, '{')); p++) {
+            const char* close = strchr(p, '}');
+            if (!close) break;
+            int index = add_parameter(components, p + 1, close - p - 1, "path", "string", NULL);
+            if (index < 0) return -1;
+            operation->parameters[operation->parameter_count++] = index;
+        }
+        const FilterList* filter_list = resource_filters(operation->resource);
+        for (int f = 0; f < filters; f++) {
+            const Filter* filter = &filter_list->items[f];
+            const char* name = filter->name ? symbol_name(filter->name) : "";
+            ColumnType type = model_filter_type(operation->resource, filter);
+            int index = add_parameter(components, name, strlen(name), "query", type.type, type.format);
+            if (index < 0) return -1;
+            operation->parameters[operation->parameter_count++] = index;
+        }
+    }
+    return 0;
+}
+
+static void emit_operation(SpecEmitter* out, const Operation* operation, const Components* components,
+                           const RefStyle* refs) {
+    out->begin_object(out);
+    emit_key_string(out, "summary", operation_summary(operation->action));
+    if (operation->parameter_count > 0) {
+        out->key(out, "parameters");
+        out->begin_array(out);
+        for (int i = 0; i < operation->parameter_count; i++) {
+            emit_ref(out, refs, "parameters", components->parameters.items[operation->parameters[i]].key);
+        }
+        out->end_array(out);
+    }
+    out->end_object(out);
+}
+
+// Operations on one path, linked through `next`; a verb declared twice
+// keeps its first position and its last operation
+static void emit_path_item(SpecEmitter* out, const Operation* operations, const int* next, int first,
+                           const Components* components, const RefStyle* refs) {
+    out->begin_object(out);
+    for (int i = first; i >= 0; i = next[i]) {
+        int seen = 0;
+        for (int j = first; j != i; j = next[j]) {
+            if (operations[j].verb == operations[i].verb) seen = 1;
+        }
+        if (seen) continue;
+        int winner = i;
+        for (int j = next[i]; j >= 0; j = next[j]) {
+            if (operations[j].verb == operations[i].verb) winner = j;
+        }
+        out->key(out, operations[i].verb);
+        emit_operation(out, &operations[winner], components, refs);
+    }
+    out->end_object(out);
+}
+
+static int under_prefix(const char* path, const char* prefix) {
+    size_t len = strlen(prefix);
+    if (len == 0) return 1;
+    return strncmp(path, prefix, len) == 0 && (path[len] == '\0' || path[len] == '/' || prefix[len - 1] == '/');
+}
+
+// Drops the operations outside `prefix` (NULL keeps all) and marks the
+// resources that keep at least one in `served`
+static void keep_operations(OperationList* operations, const ApiSpec* spec, const char* prefix, char* served) {
+    int kept = 0;
+    for (int i = 0; i < operations->count; i++) {
+        const Operation* operation = &operations->items[i];
+        if (prefix && !under_prefix(operation->path, prefix)) continue;
+        served[operation->resource - spec->resources.items] = 1;
+        operations->items[kept++] = *operation;
+    }
+    operations->count = kept;
+}
+
+// Operations of the paths section, chained by path
+typedef struct {
+    const Operation* operations;
+    const int* next;
+    const int* firsts; // First operation on each path
+    const Components* components;
+    const RefStyle* refs;
+} PathItems;
+
+static void emit_path_value(SpecEmitter* out, const void* ctx, int index) {
+    const PathItems* items = ctx;
+    emit_path_item(out, items->operations, items->next, items->firsts[index], items->components, items->refs);
+}
+
+// Chains the operations of `spec` below `prefix` by path into `items`, and
+// lists the paths in document order in `paths`
+static int plan_paths(const ApiSpec* spec, const char* prefix, char* served, KeyTable* table, Components* components,
+                      Arena* scratch, PathItems* items, const char*** paths_out, int* path_count_out) {
+    OperationList operations = { 0 };
+    if (collect_operations(spec, &operations, scratch) != 0) return -1;
+    keep_operations(&operations, spec, prefix, served);
+    if (collect_parameters(&operations, components, scratch) != 0) return -1;
+    int count = operations.count;
+    int* next = arena_alloc(scratch, (count ? count : 1) * sizeof(int));
+    int* firsts = arena_alloc(scratch, (count ? count : 1) * sizeof(int));
+    const char** paths = arena_alloc(scratch, (count ? count : 1) * sizeof(const char*));
+    if (!next || !firsts || !paths || key_table_reset(table, count) != 0) return -1;
+
+    // Chain the operations of each path in order; the slot holds the last one seen
+    for (int i = 0; i < count; i++) {
+        KeySlot* slot = key_table_slot(table, operations.items[i].path);
+        next[i] = -1;
+        if (slot->emitted) next[slot->last] = i;
+        slot->last = i;
+        slot->emitted = 1;
+    }
+    int path_count = 0;
+    for (int i = 0; i < count; i++) {
+        KeySlot* slot = key_table_slot(table, operations.items[i].path);
+        if (!slot->emitted) continue;
+        slot->emitted = 0;
+        firsts[path_count] = i;
+        paths[path_count++] = operations.items[i].path;
+    }
+    *items = (PathItems){ operations.items, next, firsts, components, &document_refs };
+    *paths_out = paths;
+    *path_count_out = path_count;
+    return 0;
+}
+
+static void emit_typed(SpecEmitter* out, const char* key, const char* type, const char* format) {
+    out->key(out, key);
+    out->begin_object(out);
+    emit_key_string(out, "type", type);
+    if (format) emit_key_string(out, "format", format);
+    out->end_object(out);
+}
+
+// Linkage schemas in the order components/schemas lists them
+enum { RESOURCE_IDENTIFIER, RELATIONSHIP_LINKS, TO_ONE, TO_MANY };
+
+static const char* const linkage_schemas[] = {
+    [RESOURCE_IDENTIFIER] = RESOURCE_IDENTIFIER_SCHEMA,
+    [RELATIONSHIP_LINKS] = RELATIONSHIP_LINKS_SCHEMA,
+    [TO_ONE] = TO_ONE_SCHEMA,
+    [TO_MANY] = TO_MANY_SCHEMA,
+};
+
+#define LINKAGE_SCHEMA_COUNT ((int)(sizeof(linkage_schemas) / sizeof(linkage_schemas[0])))
+
+// Resource identifier objects and the to-one and to-many relationship
+// objects made of them, as JSON:API defines them
+static void emit_linkage_schema(SpecEmitter* out, const RefStyle* refs, int index) {
+    out->begin_object(out);
+    emit_key_string(out, "type", "object");
+    if (index == RESOURCE_IDENTIFIER) {
+        out->key(out, "required");
+        out->begin_array(out);
+        out->string(out, "type");
+        out->string(out, "id");
+        out->end_array(out);
+        out->key(out, "properties");
+        out->begin_object(out);
+        emit_typed(out, "type", "string", NULL);
+        emit_typed(out, "id", "string", NULL);
+        out->end_object(out);
+    } else if (index == RELATIONSHIP_LINKS) {
+        out->key(out, "properties");
+        out->begin_object(out);
+        emit_typed(out, "self", "string", NULL);
+        emit_typed(out, "related", "string", NULL);
+        out->end_object(out);
+    } else {
+        out->key(out, "properties");
+        out->begin_object(out);
+        out->key(out, "links");
+        emit_ref(out, refs, "schemas", RELATIONSHIP_LINKS_SCHEMA);
+        out->key(out, "data");
+        out->begin_object(out);
+        if (index == TO_MANY) {
+            emit_key_string(out, "type", "array");
+            out->key(out, "items");
+            emit_ref(out, refs, "schemas", RESOURCE_IDENTIFIER_SCHEMA);
+        } else {
+            out->key(out, "nullable");
+            out->boolean(out, 1);
+            out->key(out, "allOf");
+            out->begin_array(out);
+            emit_ref(out, refs, "schemas", RESOURCE_IDENTIFIER_SCHEMA);
+            out->end_array(out);
+        }
+        out->end_object(out);
+        out->end_object(out);
+    }
+    out->end_object(out);
+}
+
+static void emit_linkage_schemas(SpecEmitter* out) {
+    for (int i = 0; i < LINKAGE_SCHEMA_COUNT; i++) {
+        out->key(out, linkage_schemas[i]);
+        emit_linkage_schema(out, &document_refs, i);
+    }
+}
+
+// Every parameter of components/parameters, by key
+static void emit_parameter_map(SpecEmitter* out, const Components* components) {
+    out->begin_object(out);
+    for (int i = 0; i < components->parameters.count; i++) {
+        out->key(out, components->parameters.items[i].key);
+        emit_parameter(out, &components->parameters.items[i]);
+    }
+    out->end_object(out);
+}
+
+// Components/Parameters section: path parameters and filters
+static void emit_parameters(SpecEmitter* out, const Components* components) {
+    if (components->parameters.count == 0) return;
+    out->key(out, "parameters");
+    emit_parameter_map(out, components);
+}
+
+// Scratch of one thread for finding the properties of schemas
+typedef struct {
+    Property* items;
+    int capacity;
+    // Last occurrence of each property name in the current schema, indexed
+    // by symbol; valid where marks[symbol] is the schema's generation
+    int* last;
+    unsigned* marks;
+    size_t symbols;
+    unsigned generation;
+    Arena arena; // Properties and shapes of the planned schemas
+    int failed;
+} SchemaScratch;
+
+// A schema of components/schemas: its properties, or the earlier schema
+// that has the same ones
+typedef struct {
+    const ResourceInfo* resource;
+    const Property* properties;
+    int count;
+    const char* shape; // One "name\ttype\tformat\n" line per property
+    int same_as;       // Index of the first schema with this shape, -1 for that one
+} SchemaPlan;
+
+static void schema_scratch_free(SchemaScratch* scratch) {
+    free(scratch->items);
+    free(scratch->last);
+    free(scratch->marks);
+    arena_reset(&scratch->arena);
+}
+
+// Makes room in `last` and `marks` for every symbol of the properties
+static int reserve_symbols(SchemaScratch* scratch, const Property* properties, int count) {
+    size_t needed = 0;
+    for (int i = 0; i < count; i++) {
+        if (properties[i].name >= needed) needed = (size_t)properties[i].name + 1;
+    }
+    if (needed <= scratch->symbols) return 0;
+    size_t symbols = scratch->symbols ? scratch->symbols : 1024;
+    while (symbols < needed) symbols *= 2;
+    int* last = realloc(scratch->last, symbols * sizeof(int));
+    if (last) scratch->last = last;
+    unsigned* marks = realloc(scratch->marks, symbols * sizeof(unsigned));
+    if (!last || !marks) return -1;
+    memset(marks + scratch->symbols, 0, (symbols - scratch->symbols) * sizeof(unsigned));
+    scratch->marks = marks;
+    scratch->symbols = symbols;
+    return 0;
+}
+
+// Fills in the properties and shape of `plan->resource`
+static int plan_schema(SchemaScratch* scratch, SchemaPlan* plan) {
+    const ResourceInfo* resource = plan->resource;
+    const SymbolList* attributes = resource_attributes(resource);
+    const RelationList* relations = resource_relations(resource);
+    int needed = attributes->count + relations->count;
+    if (needed > scratch->capacity) {
+        Property* grown = realloc(scratch->items, needed * sizeof(Property));
+        if (!grown) return -1;
+        scratch->items = grown;
+        scratch->capacity = needed;
+    }
+
+    // Attributes as strings, then relationships as linkage objects
+    Property* properties = scratch->items;
+    int count = 0;
+    for (int a = 0; a < attributes->count; a++) {
+        Symbol attribute = attributes->items[a];
+        if (!symbol_has_text(attribute)) continue;
+        const ColumnType* column = model_table_column(resource->model_table, attribute);
+        properties[count++] = (Property){ attribute, column ? column->type : "string", column ? column->format : NULL, 0 };
+    }
+    for (int r = 0; r < relations->count; r++) {
+        const Relation* relation = &relations->items[r];
+        if (!symbol_has_text(relation->name)) continue;
+        int to_many = symbol_is(relation->type, "has_many");
+        properties[count++] = (Property){ relation->name, to_many ? TO_MANY_SCHEMA : TO_ONE_SCHEMA, NULL, 1 };
+    }
+
+    // Winners in emission order, which also make up the shape of the schema.
+    // A name is recorded with the generation and claimed with generation + 1.
+    if (reserve_symbols(scratch, properties, count) != 0) return -1;
+    scratch->generation += 2;
+    unsigned recorded = scratch->generation;
+    for (int i = 0; i < count; i++) {
+        scratch->last[properties[i].name] = i;
+        scratch->marks[properties[i].name] = recorded;
+    }
+    Property* winners = arena_alloc(&scratch->arena, (count ? count : 1) * sizeof(Property));
+    if (!winners) return -1;
+    int kept = 0;
+    size_t shape_size = 1;
+    for (int i = 0; i < count; i++) {
+        Symbol name = properties[i].name;
+        if (scratch->marks[name] != recorded) continue;
+        scratch->marks[name] = recorded + 1;
+        winners[kept] = properties[scratch->last[name]];
+        const char* format = winners[kept].format;
+        shape_size += symbol_length(name) + strlen(winners[kept].type) + (format ? strlen(format) : 0) + 3;
+        kept++;
+    }
+
+    char* shape = arena_alloc(&scratch->arena, shape_size);
+    if (!shape) return -1;
+    char* end = shape;
+    for (int i = 0; i < kept; i++) {
+        const char* format = winners[i].format;
+        end += sprintf(end, "%s\t%s\t%s\n", symbol_name(winners[i].name), winners[i].type, format ? format : "");
+    }
+    *end = '\0';
+    plan->properties = winners;
+    plan->count = kept;
+    plan->shape = shape;
+    plan->same_as = -1;
+    return 0;
+}
+
+typedef struct {
+    SchemaPlan* plans;
+    SchemaScratch* scratches;
+} PlanJob;
+
+static void plan_task(void* ctx, size_t index, int worker_id) {
+    PlanJob* job = ctx;
+    SchemaScratch* scratch = &job->scratches[worker_id];
+    if (!scratch->failed && plan_schema(scratch, &job->plans[index]) != 0) scratch->failed = 1;
+}
+
+// Plans every schema on `jobs` threads, then points each one at the first
+// with the same shape. Returns whether a written schema has relationships,
+// which refer to the linkage schemas, or -1 when out of memory.
+static int plan_schemas(SchemaPlan* plans, int count, int jobs, SchemaScratch* scratches, KeyTable* shapes) {
+    PlanJob job = { plans, scratches };
+    work_pool_run(pool_jobs(jobs, count), count, plan_task, &job);
+    for (int w = 0; w < jobs; w++) {
+        if (scratches[w].failed) return -1;
+    }
+
+    if (key_table_reset(shapes, count) != 0) return -1;
+    int linked = 0;
+    for (int i = 0; i < count; i++) {
+        KeySlot* slot = key_table_slot(shapes, plans[i].shape);
+        if (slot->emitted) {
+            plans[i].same_as = slot->last;
+            continue;
+        }
+        slot->emitted = 1;
+        slot->last = i;
+        for (int p = 0; p < plans[i].count; p++) linked |= plans[i].properties[p].linkage;
+    }
+    return linked;
+}
+
+typedef struct {
+    const SchemaPlan* plans;
+    const char* const* keys; // Key of each schema
+    const RefStyle* refs;
+} SchemaSet;
+
+static void emit_schema(SpecEmitter* out, const void* ctx, int index) {
+    const SchemaSet* set = ctx;
+    const SchemaPlan* plan = &set->plans[index];
+    if (plan->same_as >= 0) {
+        emit_ref(out, set->refs, "schemas", set->keys[plan->same_as]);
+        return;
+    }
+
+    out->begin_object(out);
+    emit_key_string(out, "type", "object");
+    out->key(out, "properties");
+    out->begin_object(out);
+    for (int i = 0; i < plan->count; i++) {
+        const Property* property = &plan->properties[i];
+        if (property->linkage) {
+            out->key(out, symbol_name(property->name));
+            emit_ref(out, set->refs, "schemas", property->type);
+        } else {
+            emit_typed(out, symbol_name(property->name), property->type, property->format);
+        }
+    }
+    out->end_object(out);
+    out->end_object(out);
+}
+
+// Opens the document and writes everything before the paths
+static void begin_document(SpecEmitter* out) {
+    out->begin_object(out);
+    emit_key_string(out, "openapi", "3.0.0");
+
+    // Info section
+    out->key(out, "info");
+    out->begin_object(out);
+    emit_key_string(out, "title", "Rails JSON:API Specification");
+    emit_key_string(out, "version", "1.0.0");
+    out->end_object(out);
+}
+
+// Schema key of a resource: its model, else its class
+static const char* schema_key(const ResourceInfo* resource) {
+    return has_text(resource->model_name) ? resource->model_name : resource->class_name;
+}
+
+// Everything the document holds, worked out before any of it is written
+typedef struct {
+    Arena scratch;
+    KeyTable path_table;
+    KeyTable schema_table;
+    KeyTable shapes;
+    Components components;
+    SchemaScratch* scratches; // One per job
+    int jobs;
+    PathItems items;
+    const char** paths; // In document order
+    int path_count;
+    SchemaPlan* plans;
+    const char** schema_keys;
+    int schema_count;
+    int linked; // A written schema has relationships
+} DocumentPlan;
+
+static void document_plan_free(DocumentPlan* plan) {
+    for (int w = 0; plan->scratches && w < plan->jobs; w++) schema_scratch_free(&plan->scratches[w]);
+    free(plan->scratches);
+    key_table_free(&plan->components.signatures);
+    key_table_free(&plan->components.keys);
+    key_table_free(&plan->path_table);
+    key_table_free(&plan->schema_table);
+    key_table_free(&plan->shapes);
+    arena_reset(&plan->scratch);
+}
+
+static int plan_document(const ApiSpec* spec, const char* prefix, int jobs, DocumentPlan* plan) {
+    int count = spec->resources.count;
+    memset(plan, 0, sizeof(DocumentPlan));
+    arena_init(&plan->scratch);
+    plan->jobs = jobs < 1 ? 1 : jobs;
+    plan->scratches = calloc(plan->jobs, sizeof(SchemaScratch));
+
+    Arena* scratch = &plan->scratch;
+    const char** keys = arena_calloc(scratch, count ? count : 1, sizeof(const char*));
+    int* indices = arena_calloc(scratch, count ? count : 1, sizeof(int));
+    char* with_paths = arena_calloc(scratch, count ? count : 1, 1);
+    plan->schema_keys = arena_calloc(scratch, count ? count : 1, sizeof(const char*));
+    plan->plans = arena_calloc(scratch, count ? count : 1, sizeof(SchemaPlan));
+    if (!plan->scratches || !keys || !indices || !with_paths || !plan->schema_keys || !plan->plans) return -1;
+    for (int w = 0; w < plan->jobs; w++) arena_init(&plan->scratches[w].arena);
+    plan->components.arena = scratch;
+
+    // Paths section
+    if (plan_paths(spec, prefix, with_paths, &plan->path_table, &plan->components, scratch, &plan->items,
+                   &plan->paths, &plan->path_count) != 0) {
+        return -1;
+    }
+
+    // Components/Schemas section; abstract base resources have none, and
+    // below a prefix only resources with paths there have one
+    int served = 0;
+    for (int i = 0; i < count; i++) {
+        const ResourceInfo* resource = &spec->resources.items[i];
+        if (resource->abstract || (prefix && !with_paths[i])) continue;
+        indices[served] = i;
+        keys[served++] = schema_key(resource);
+    }
+    if (key_table_build(&plan->schema_table, keys, served) != 0) return -1;
+    for (int i = 0; i < served; i++) {
+        int winner = key_table_claim(&plan->schema_table, keys[i]);
+        if (winner < 0) continue;
+        plan->schema_keys[plan->schema_count] = keys[i];
+        plan->plans[plan->schema_count++].resource = &spec->resources.items[indices[winner]];
+    }
+    plan->linked = plan_schemas(plan->plans, plan->schema_count, plan->jobs, plan->scratches, &plan->shapes);
+    return plan->linked < 0 ? -1 : 0;
+}
+
+static int emit_document(const ApiSpec* spec, SpecEmitter* out, const char* prefix, int jobs) {
+    DocumentPlan plan;
+    int status = plan_document(spec, prefix, jobs, &plan);
+    if (status == 0) {
+        begin_document(out);
+        out->key(out, "paths");
+        out->begin_object(out);
+        status = emit_entries(out, plan.paths, plan.path_count, emit_path_value, &plan.items, plan.jobs);
+    }
+    if (status == 0) {
+        out->end_object(out);
+        out->key(out, "components");
+        out->begin_object(out);
+        out->key(out, "schemas");
+        out->begin_object(out);
+        SchemaSet set = { plan.plans, plan.schema_keys, &document_refs };
+        status = emit_entries(out, plan.schema_keys, plan.schema_count, emit_schema, &set, plan.jobs);
+    }
+    if (status == 0) {
+        if (plan.linked) emit_linkage_schemas(out);
+        out->end_object(out);
+        emit_parameters(out, &plan.components);
+        out->end_object(out);
+        out->end_object(out);
+    }
+    document_plan_free(&plan);
+    return status;
+}
+
+int openapi_emit(const ApiSpec* spec, SpecEmitter* out) {
+    return emit_document(spec, out, NULL, 1);
+}
+
+int openapi_emit_parallel(const ApiSpec* spec, SpecEmitter* out, const char* path_prefix, int jobs) {
+    return emit_document(spec, out, path_prefix, jobs);
+}
+
+int openapi_emit_prefix(const ApiSpec* spec, SpecEmitter* out, const char* path_prefix) {
+    return emit_document(spec, out, path_prefix, 1);
+}
+
+struct OpenApiShards {
+    DocumentPlan plan;
+    const char* extension;
+    OpenApiShard* items;
+    int count;
+    int first_path;   // The path items follow the root and the parameters
+    int first_schema; // Then the schemas, the linkage schemas last
+    KeyTable folded;  // Schemas whose file escapes upper case letters too (fold_shard_files())
+};
+
+static const OpenApiShard* add_shard(OpenApiShards* shards, OpenApiShardKind kind, const char* name,
+                                     const char* file) {
+    OpenApiShard* shard = &shards->items[shards->count++];
+    shard->kind = kind;
+    shard->name = name;
+    shard->file = file;
+    return file ? shard : NULL;
+}
+
+// "paths/api/v1/users/@id.json", "schemas/Billing.Invoice.json"
+static const char* shard_file(OpenApiShards* shards, OpenApiShardKind kind, const char* name, int fold) {
+    char file[MAX_REF_LENGTH];
+    size_t len;
+    if (kind == OPENAPI_SHARD_PATH) {
+        len = append_path_file(file, append_ref(file, 0, "paths/"), name, fold);
+    } else {
+        len = append_schema_file(file, append_ref(file, 0, "schemas/"), name, fold);
+    }
+    append_ref(file, len, shards->extension);
+    return arena_intern_cstr(&shards->plan.scratch, file);
+}
+
+static int has_upper_case(const char* str) {
+    for (const char* p = str; *p; p++) {
+        if (*p >= 'A' && *p <= 'Z') return 1;
+    }
+    return 0;
+}
+
+// Keeps case-insensitive file systems from mapping two shards to one file.
+// Of names whose files differ only in case, the one without upper case
+// letters (or else the first) keeps its file; the others escape their upper
+// case letters as "~XX" too, which no two of them can then share.
+static int fold_shard_files(OpenApiShards* shards) {
+    Arena* arena = &shards->plan.scratch;
+    int count = shards->count - shards->first_path;
+    KeyTable lowered = { 0 }; // Lower case file -> the shard keeping it, `emitted` counting the shards
+    const char** lower = arena_alloc(arena, (count > 0 ? count : 1) * sizeof(const char*));
+    if (!lower || key_table_reset(&lowered, count) != 0) {
+        key_table_free(&lowered);
+        return -1;
+    }
+    int status = 0;
+    for (int i = 0; status == 0 && i < count; i++) {
+        const OpenApiShard* shard = &shards->items[shards->first_path + i];
+        char file[MAX_REF_LENGTH];
+        size_t len = append_ref(file, 0, shard->file);
+        for (size_t j = 0; j < len; j++) {
+            if (file[j] >= 'A' && file[j] <= 'Z') file[j] = (char)(file[j] - 'A' + 'a');
+        }
+        lower[i] = arena_intern_cstr(arena, file);
+        if (!lower[i]) {
+            status = -1;
+            break;
+        }
+        KeySlot* slot = key_table_slot(&lowered, lower[i]);
+        if (slot->emitted++ == 0 || !has_upper_case(shard->name)) slot->last = i;
+    }
+    for (int i = 0; status == 0 && i < count; i++) {
+        OpenApiShard* shard = &shards->items[shards->first_path + i];
+        const KeySlot* slot = key_table_find(&lowered, lower[i]);
+        if (slot->emitted < 2 || slot->last == i) continue;
+        if (shard->kind == OPENAPI_SHARD_SCHEMA) {
+            if (key_table_reserve(&shards->folded, 1) != 0) {
+                status = -1;
+                break;
+            }
+            key_table_slot(&shards->folded, shard->name);
+        }
+        shard->file = shard_file(shards, shard->kind, shard->name, 1);
+        if (!shard->file) status = -1;
+    }
+    key_table_free(&lowered);
+    return status;
+}
+
+OpenApiShards* openapi_shards_open(const ApiSpec* spec, const char* path_prefix, const char* extension, int jobs) {
+    OpenApiShards* shards = calloc(1, sizeof(OpenApiShards));
+    if (!shards) return NULL;
+    DocumentPlan* plan = &shards->plan;
+    if (plan_document(spec, path_prefix, jobs, plan) != 0) {
+        openapi_shards_free(shards);
+        return NULL;
+    }
+
+    Arena* arena = &plan->scratch;
+    int linkage = plan->linked ? LINKAGE_SCHEMA_COUNT : 0;
+    shards->items = arena_alloc(arena, (2 + plan->path_count + plan->schema_count + linkage) * sizeof(OpenApiShard));
+    shards->extension = arena_intern_cstr(arena, extension);
+    char root[64];
+    char parameters[64];
+    snprintf(root, sizeof(root), "openapi%s", extension);
+    snprintf(parameters, sizeof(parameters), "parameters%s", extension);
+    int status = shards->items && shards->extension ? 0 : -1;
+    if (status == 0 && !add_shard(shards, OPENAPI_SHARD_ROOT, NULL, arena_intern_cstr(arena, root))) status = -1;
+    if (status == 0 && plan->components.parameters.count > 0 &&
+        !add_shard(shards, OPENAPI_SHARD_PARAMETERS, NULL, arena_intern_cstr(arena, parameters))) {
+        status = -1;
+    }
+    shards->first_path = shards->count;
+    for (int i = 0; status == 0 && i < plan->path_count; i++) {
+        const char* path = plan->paths[i];
+        if (!add_shard(shards, OPENAPI_SHARD_PATH, path, shard_file(shards, OPENAPI_SHARD_PATH, path, 0))) status = -1;
+    }
+    shards->first_schema = shards->count;
+    for (int i = 0; status == 0 && i < plan->schema_count + linkage; i++) {
+        const char* key = i < plan->schema_count ? plan->schema_keys[i] : linkage_schemas[i - plan->schema_count];
+        if (!add_shard(shards, OPENAPI_SHARD_SCHEMA, key, shard_file(shards, OPENAPI_SHARD_SCHEMA, key, 0))) status = -1;
+    }
+    if (status == 0) status = fold_shard_files(shards);
+    if (status != 0) {
+        openapi_shards_free(shards);
+        return NULL;
+    }
+    return shards;
+}
+
+void openapi_shards_free(OpenApiShards* shards) {
+    if (!shards) return;
+    document_plan_free(&shards->plan);
+    key_table_free(&shards->folded);
+    free(shards);
+}
+
+int openapi_shard_count(const OpenApiShards* shards) {
+    return shards->count;
+}
+
+const OpenApiShard* openapi_shard(const OpenApiShards* shards, int index) {
+    return &shards->items[index];
+}
+
+// The document with a $ref to its file in place of every path item, schema
+// and parameter
+static void emit_shard_root(const OpenApiShards* shards, SpecEmitter* out) {
+    const Components* components = &shards->plan.components;
+    RefStyle refs = { "", shards->extension, &shards->folded };
+    begin_document(out);
+    out->key(out, "paths");
+    out->begin_object(out);
+    for (int i = shards->first_path; i < shards->first_schema; i++) {
+        out->key(out, shards->items[i].name);
+        out->begin_object(out);
+        emit_key_string(out, "$ref", shards->items[i].file);
+        out->end_object(out);
+    }
+    out->end_object(out);
+
+    out->key(out, "components");
+    out->begin_object(out);
+    out->key(out, "schemas");
+    out->begin_object(out);
+    for (int i = shards->first_schema; i < shards->count; i++) {
+        out->key(out, shards->items[i].name);
+        emit_ref(out, &refs, "schemas", shards->items[i].name);
+    }
+    out->end_object(out);
+    if (components->parameters.count > 0) {
+        out->key(out, "parameters");
+        out->begin_object(out);
+        for (int i = 0; i < components->parameters.count; i++) {
+            out->key(out, components->parameters.items[i].key);
+            emit_ref(out, &refs, "parameters", components->parameters.items[i].key);
+        }
+        out->end_object(out);
+    }
+    out->end_object(out);
+    out->end_object(out);
+}
+
+void openapi_shards_emit(const OpenApiShards* shards, int index, SpecEmitter* out) {
+    const DocumentPlan* plan = &shards->plan;
+    const OpenApiShard* shard = &shards->items[index];
+    if (shard->kind == OPENAPI_SHARD_ROOT) {
+        emit_shard_root(shards, out);
+    } else if (shard->kind == OPENAPI_SHARD_PARAMETERS) {
+        emit_parameter_map(out, &plan->components);
+    } else if (shard->kind == OPENAPI_SHARD_PATH) {
+        // Back up from the directory of the path item to the spec directory
+        char up[MAX_REF_LENGTH];
+        size_t len = append_ref(up, 0, "");
+        for (const char* p = shard->file; *p; p++) {
+            if (*p == '/') len = append_ref(up, len, "../");
+        }
+        RefStyle refs = { up, shards->extension, &shards->folded };
+        const PathItems* items = &plan->items;
+        emit_path_item(out, items->operations, items->next, items->firsts[index - shards->first_path],
+                       &plan->components, &refs);
+    } else {
+        RefStyle refs = { "../", shards->extension, &shards->folded };
+        int schema = index - shards->first_schema;
+        if (schema < plan->schema_count) {
+            SchemaSet set = { plan->plans, plan->schema_keys, &refs };
+            emit_schema(out, &set, schema);
+        } else {
+            emit_linkage_schema(out, &refs, schema - plan->schema_count);
+        }
+    }
+}
+
+static void emit_index_entry(SpecEmitter* out, const OpenApiShard* shard, uint64_t hash) {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    out->begin_object(out);
+    emit_key_string(out, "file", shard->file);
+    emit_key_string(out, "hash", hex);
+    out->end_object(out);
+}
+
+void openapi_shards_emit_index(const OpenApiShards* shards, const uint64_t* hashes, SpecEmitter* out) {
+    out->begin_object(out);
+    for (int i = 0; i < shards->first_path; i++) {
+        out->key(out, shards->items[i].kind == OPENAPI_SHARD_ROOT ? "openapi" : "parameters");
+        emit_index_entry(out, &shards->items[i], hashes[i]);
+    }
+    out->key(out, "paths");
+    out->begin_object(out);
+    for (int i = shards->first_path; i < shards->first_schema; i++) {
+        out->key(out, shards->items[i].name);
+        emit_index_entry(out, &shards->items[i], hashes[i]);
+    }
+    out->end_object(out);
+    out->key(out, "schemas");
+    out->begin_object(out);
+    for (int i = shards->first_schema; i < shards->count; i++) {
+        out->key(out, shards->items[i].name);
+        emit_index_entry(out, &shards->items[i], hashes[i]);
+    }
+    out->end_object(out);
+    out->end_object(out);
+}
+
+// A schema serialized into the spool; when its key comes again, the bytes
+// of the later resource replace it at the same position
+typedef struct {
+    const char* key;
+    size_t offset;
+    size_t size;
+    uint64_t shape; // Hash of the shape, to find identical schemas
+    int linkage;    // Has relationships
+} SpooledSchema;
+
+typedef struct {
+    SpooledSchema* items;
+    int count;
+    int capacity;
+} SpooledSchemaList;
+
+// A path an earlier batch wrote; the string is interned in the stream's arena
+typedef struct {
+    uint64_t hash; // 0 marks a free slot
+    const char* path;
+} WrittenPath;
+
+struct OpenApiStream {
+    SpecEmitter* out;
+    const char* prefix;
+    int jobs;
+    Arena arena; // Prefix, paths, schema keys and components
+    Components components;
+    WrittenPath* paths; // Open-addressing table of the paths written so far
+    size_t path_capacity;
+    size_t path_count;
+    SpooledSchemaList schemas;
+    KeyTable schema_table; // Key -> index into schemas
+    FILE* spool;
+    OutputSink spool_sink;
+    OutputSink discard;            // Takes what the template writes
+    SpecEmitter* schema_template;  // Positioned after a key of components/schemas
+    void* template_copy;
+    void* value_copy;              // The template forked for each schema
+    SchemaScratch scratch;
+    OpenApiStreamSummary summary;
+    int failed;
+};
+
+static int discard_write(void* ctx, const char* data, size_t size) {
+    (void)ctx;
+    (void)data;
+    (void)size;
+    return 0;
+}
+
+static void stream_free(OpenApiStream* stream) {
+    if (stream->spool) fclose(stream->spool);
+    output_sink_free(&stream->spool_sink);
+    output_sink_free(&stream->discard);
+    free(stream->template_copy);
+    free(stream->value_copy);
+    free(stream->paths);
+    key_table_free(&stream->schema_table);
+    key_table_free(&stream->components.signatures);
+    key_table_free(&stream->components.keys);
+    schema_scratch_free(&stream->scratch);
+    arena_reset(&stream->arena);
+    free(stream);
+}
+
+OpenApiStream* openapi_stream_open(SpecEmitter* out, const char* path_prefix, int jobs) {
+    if (!out->fork) return NULL;
+    OpenApiStream* stream = calloc(1, sizeof(OpenApiStream));
+    if (!stream) return NULL;
+    arena_init(&stream->arena);
+    arena_init(&stream->scratch.arena);
+    stream->out = out;
+    stream->jobs = jobs < 1 ? 1 : jobs;
+    stream->components.arena = &stream->arena;
+    stream->prefix = path_prefix ? arena_intern_cstr(&stream->arena, path_prefix) : NULL;
+    stream->spool = tmpfile();
+    stream->template_copy = malloc(out->fork_size);
+    stream->value_copy = malloc(out->fork_size);
+    if ((path_prefix && !stream->prefix) || !stream->spool || !stream->template_copy || !stream->value_copy ||
+        output_sink_init(&stream->spool_sink, 1 << 16, output_sink_write_file, stream->spool) != 0 ||
+        output_sink_init(&stream->discard, 1 << 8, discard_write, NULL) != 0) {
+        stream_free(stream);
+        return NULL;
+    }
+
+    begin_document(out);
+    out->key(out, "paths");
+    // Schemas are serialized long before the components begin, from a copy
+    // taken here and moved to where a schema value starts
+    SpecEmitter* template = out->fork(out, stream->template_copy, &stream->discard);
+    template->begin_object(template);
+    template->key(template, "schemas");
+    template->begin_object(template);
+    template->key(template, "");
+    stream->schema_template = template;
+    out->begin_object(out);
+    return stream;
+}
+
+// Whether an earlier batch wrote `path`; remembers it if not. Returns -1
+// when out of memory.
+static int path_written(OpenApiStream* stream, const char* path) {
+    if ((stream->path_count + 1) * 2 > stream->path_capacity) {
+        size_t capacity = stream->path_capacity ? stream->path_capacity * 2 : 1024;
+        WrittenPath* grown = calloc(capacity, sizeof(WrittenPath));
+        if (!grown) return -1;
+        for (size_t i = 0; i < stream->path_capacity; i++) {
+            if (!stream->paths[i].hash) continue;
+            size_t slot = stream->paths[i].hash & (capacity - 1);
+            while (grown[slot].hash) slot = (slot + 1) & (capacity - 1);
+            grown[slot] = stream->paths[i];
+        }
+        free(stream->paths);
+        stream->paths = grown;
+        stream->path_capacity = capacity;
+    }
+
+    uint64_t hash = hash_string(path);
+    if (!hash) hash = 1;
+    size_t mask = stream->path_capacity - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        WrittenPath* written = &stream->paths[slot];
+        if (written->hash == hash && strcmp(written->path, path) == 0) return 1;
+        if (!written->hash) {
+            // The batch's strings are released before the next one comes
+            written->path = arena_intern_cstr(&stream->arena, path);
+            if (!written->path) return -1;
+            written->hash = hash;
+            stream->path_count++;
+            return 0;
+        }
+    }
+}
+
+// Writes the paths of one batch, leaving out those an earlier batch wrote
+static int stream_paths(OpenApiStream* stream, const ApiSpec* spec, char* served, Arena* scratch) {
+    KeyTable table = { 0 };
+    PathItems items;
+    const char** paths;
+    int count;
+    int status = plan_paths(spec, stream->prefix, served, &table, &stream->components, scratch, &items, &paths, &count);
+    key_table_free(&table);
+    if (status != 0) return -1;
+
+    int* firsts = (int*)items.firsts;
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        int written = path_written(stream, paths[i]);
+        if (written < 0) return -1;
+        if (written) {
+            report_diagnostic(DIAGNOSTIC_WARNING, DIAGNOSTIC_REPEATED_PATH, items.operations[firsts[i]].resource->source_path,
+                              "%s was written by an earlier batch, leaving out its operations from %s", paths[i],
+                              items.operations[firsts[i]].resource->class_name);
+            stream->summary.repeated_paths++;
+            continue;
+        }
+        firsts[kept] = firsts[i];
+        paths[kept++] = paths[i];
+    }
+    return emit_entries(stream->out, paths, kept, emit_path_value, &items, stream->jobs);
+}
+
+// Serializes the schemas of one batch into the spool
+static int stream_schemas(OpenApiStream* stream, const ApiSpec* spec, const char* served) {
+    if (key_table_reserve(&stream->schema_table, spec->resources.count) != 0) return -1;
+    OutputSink* sink = &stream->spool_sink;
+    int status = 0;
+    for (int i = 0; status == 0 && i < spec->resources.count; i++) {
+        const ResourceInfo* resource = &spec->resources.items[i];
+        if (resource->abstract || (stream->prefix && !served[i])) continue;
+        SchemaPlan plan = { resource, NULL, 0, NULL, -1 };
+        if (plan_schema(&stream->scratch, &plan) != 0) {
+            status = -1;
+            break;
+        }
+
+        KeySlot* slot = key_table_slot(&stream->schema_table, schema_key(resource));
+        if (!slot->emitted) {
+            // The key outlives the batch
+            slot->key = arena_intern_cstr(&stream->arena, slot->key);
+            SpooledSchema* schema = ARENA_PUSH(&stream->arena, stream->schemas);
+            if (!slot->key || !schema) {
+                status = -1;
+                break;
+            }
+            slot->emitted = 1;
+            slot->last = stream->schemas.count - 1;
+            schema->key = slot->key;
+        }
+
+        SpooledSchema* schema = &stream->schemas.items[slot->last];
+        schema->offset = sink->bytes_written + sink->used;
+        SchemaSet set = { &plan, NULL, &document_refs };
+        emit_schema(stream->schema_template->fork(stream->schema_template, stream->value_copy, sink), &set, 0);
+        schema->size = sink->bytes_written + sink->used - schema->offset;
+        schema->shape = hash_string(plan.shape);
+        schema->linkage = 0;
+        for (int p = 0; p < plan.count; p++) schema->linkage |= plan.properties[p].linkage;
+    }
+    arena_reset(&stream->scratch.arena);
+    return status;
+}
+
+int openapi_stream_add(OpenApiStream* stream, const ApiSpec* spec) {
+    if (stream->failed) return -1;
+    Arena scratch;
+    arena_init(&scratch);
+    char* served = calloc(spec->resources.count ? spec->resources.count : 1, 1);
+    int status = served ? stream_paths(stream, spec, served, &scratch) : -1;
+    if (status == 0) status = stream_schemas(stream, spec, served);
+    free(served);
+    arena_reset(&scratch);
+    if (status != 0 || stream->spool_sink.failed) stream->failed = 1;
+    return stream->failed ? -1 : 0;
+}
+
+static int read_spool(const OpenApiStream* stream, const SpooledSchema* schema, char* buffer) {
+    size_t done = 0;
+    while (done < schema->size) {
+        ssize_t got = pread(fileno(stream->spool), buffer + done, schema->size - done, (off_t)(schema->offset + done));
+        if (got <= 0) return -1;
+        done += (size_t)got;
+    }
+    return 0;
+}
+
+// Points each schema at the first one serialized to the same bytes, which
+// is the first one with the same shape. Returns whether a written schema
+// has relationships, or -1 on failure.
+static int find_same_schemas(const OpenApiStream* stream, int* same_as, char* first, char* second) {
+    size_t capacity = 16;
+    while (capacity < (size_t)stream->schemas.count * 2) capacity *= 2;
+    int* slots = malloc(capacity * sizeof(int));
+    if (!slots) return -1;
+    memset(slots, 0xff, capacity * sizeof(int));
+
+    int linked = 0;
+    for (int i = 0; linked >= 0 && i < stream->schemas.count; i++) {
+        const SpooledSchema* schema = &stream->schemas.items[i];
+        size_t slot = schema->shape & (capacity - 1);
+        same_as[i] = -1;
+        for (; slots[slot] >= 0; slot = (slot + 1) & (capacity - 1)) {
+            const SpooledSchema* other = &stream->schemas.items[slots[slot]];
+            if (other->shape != schema->shape || other->size != schema->size) continue;
+            if (read_spool(stream, schema, first) != 0 || read_spool(stream, other, second) != 0) {
+                linked = -1;
+                break;
+            }
+            if (memcmp(first, second, schema->size) == 0) {
+                same_as[i] = slots[slot];
+                break;
+            }
+        }
+        if (linked < 0 || same_as[i] >= 0) continue;
+        slots[slot] = i;
+        linked |= schema->linkage;
+    }
+    free(slots);
+    return linked;
+}
+
+int openapi_stream_close(OpenApiStream* stream, OpenApiStreamSummary* summary) {
+    SpecEmitter* out = stream->out;
+    // The spool is read back through its descriptor
+    int status = stream->failed || output_sink_flush(&stream->spool_sink) != 0 || fflush(stream->spool) != 0 ? -1 : 0;
+    size_t largest = 1;
+    for (int i = 0; i < stream->schemas.count; i++) {
+        if (stream->schemas.items[i].size > largest) largest = stream->schemas.items[i].size;
+    }
+    int* same_as = malloc((stream->schemas.count ? stream->schemas.count : 1) * sizeof(int));
+    char* first = malloc(largest);
+    char* second = malloc(largest);
+    int linked = status == 0 && same_as && first && second ? find_same_schemas(stream, same_as, first, second) : -1;
+
+    if (linked >= 0) {
+        out->end_object(out);
+        out->key(out, "components");
+        out->begin_object(out);
+        out->key(out, "schemas");
+        out->begin_object(out);
+        for (int i = 0; linked >= 0 && i < stream->schemas.count; i++) {
+            const SpooledSchema* schema = &stream->schemas.items[i];
+            out->key(out, schema->key);
+            if (same_as[i] >= 0) {
+                emit_ref(out, &document_refs, "schemas", stream->schemas.items[same_as[i]].key);
+            } else if (read_spool(stream, schema, first) == 0) {
+                out->splice(out, first, schema->size);
+            } else {
+                linked = -1;
+            }
+        }
+    }
+    if (linked >= 0) {
+        if (linked) emit_linkage_schemas(out);
+        out->end_object(out);
+        emit_parameters(out, &stream->components);
+        out->end_object(out);
+        out->end_object(out);
+    }
+
+    stream->summary.spooled_bytes = stream->spool_sink.bytes_written;
+    if (summary) *summary = stream->summary;
+    free(same_as);
+    free(first);
+    free(second);
+    stream_free(stream);
+    return linked >= 0 ? 0 : -1;
+}
+
+int openapi_emit_schema(const ApiSpec* spec, SpecEmitter* out, const char* key) {
+    // The last resource with the key wins, as in the whole document
+    const ResourceInfo* resource = NULL;
+    for (int i = 0; i < spec->resources.count; i++) {
+        const ResourceInfo* candidate = &spec->resources.items[i];
+        if (!candidate->abstract && strcmp(schema_key(candidate), key) == 0) resource = candidate;
+    }
+    if (!resource) return 1;
+
+    SchemaScratch scratch = { 0 };
+    arena_init(&scratch.arena);
+    SchemaPlan plan = { resource, NULL, 0, NULL, -1 };
+    int status = plan_schema(&scratch, &plan);
+    if (status == 0) {
+        SchemaSet set = { &plan, &key, &document_refs };
+        emit_schema(out, &set, 0);
+    }
+    schema_scratch_free(&scratch);
+    return status;
+}
@@ -0,0 +1,139 @@
+#ifndef OPENAPI_WRITER_H
+#define OPENAPI_WRITER_H
+
+#include <stdint.h>
+
+#include "api_spec.h"
+#include "spec_emitter.h"
+
+// Walks `spec` and emits the OpenAPI 3.0 document as events. A key that
+// occurs more than once in an object (two resources on one path, one model
+// behind two resources) is emitted once, at its first position, with the
+// value of its last occurrence: the same result as adding each entry to a
+// json-c object in turn.
+//
+// Parameters are written once under components/parameters and referenced
+// with $ref from every operation that has them; resources whose schemas
+// come out identical refer to the first one, and relationships refer to
+// shared JSON:API linkage schemas. Returns -1 when out of memory.
+int openapi_emit(const ApiSpec* spec, SpecEmitter* emitter);
+
+// Same document (restricted as by openapi_emit_prefix() unless
+// `path_prefix` is NULL), with the path items and schemas serialized on
+// `jobs` threads when the emitter can fork (spec_emitter.h) and spliced in
+// afterwards in document order, so the output is the same as
+// openapi_emit()'s. Other emitters get every event on the calling thread.
+int openapi_emit_parallel(const ApiSpec* spec, SpecEmitter* emitter, const char* path_prefix, int jobs);
+
+// Same document restricted to the paths below `path_prefix` ("/api/v1"
+// keeps "/api/v1" and "/api/v1/users/{id}") and the schemas of the
+// resources served there.
+int openapi_emit_prefix(const ApiSpec* spec, SpecEmitter* emitter, const char* path_prefix);
+
+// openapi_emit_parallel() for trees too large to hold at once: resources
+// are added in batches that may be released afterwards. The paths of each
+// batch are written as it comes, and its schemas are serialized into a
+// temporary file that openapi_stream_close() copies into the components.
+// Apart from the parameters, only the paths and a key and offset per schema
+// stay in memory. The document is the same except where resources of
+// different batches share a path: since it is written with the first, that
+// batch's path item is kept where openapi_emit_parallel() would let the
+// last resource win, and the later batches' operations are reported. The
+// emitter must be able to fork (spec_emitter.h).
+typedef struct OpenApiStream OpenApiStream;
+
+typedef struct {
+    int repeated_paths;   // Paths left out because an earlier batch wrote them
+    size_t spooled_bytes; // Schemas serialized into the temporary file
+} OpenApiStreamSummary;
+
+// Begins the document below `path_prefix` (NULL for every path). Returns
+// NULL when the emitter cannot fork, the temporary file cannot be created
+// or out of memory.
+OpenApiStream* openapi_stream_open(SpecEmitter* emitter, const char* path_prefix, int jobs);
+
+// Writes the paths of the resources of `spec` and spools their schemas;
+// the routes they point to must stay in place until the stream is closed.
+// Returns -1 on failure, after which the document cannot be completed.
+int openapi_stream_add(OpenApiStream* stream, const ApiSpec* spec);
+
+// Writes the components, ends the document and frees the stream. Returns
+// -1 when anything failed along the way.
+int openapi_stream_close(OpenApiStream* stream, OpenApiStreamSummary* summary);
+
+// The same document split into files, for consumers that load one path or
+// schema at a time. Below the spec directory, with `extension` ".json":
+//
+//     openapi.json                  the document, with a $ref to the file
+//                                   of every path item, schema and parameter
+//     parameters.json               components/parameters
+//     paths/api/v1/users/@id.json   the path item of "/api/v1/users/{id}"
+//     schemas/Billing.Invoice.json  the schema under "Billing::Invoice"
+//
+// Path items and schemas refer to each other and to the parameters with
+// relative $refs ("../../../../schemas/User.json",
+// "../../../../parameters.json#/id"). Apart from "::" and "{id}" as above,
+// characters other than letters, digits, '_' and '-' are written as "~XX"
+// in file names, so every path and schema key has a file of its own. Where
+// two files would differ only in case, the name with upper case letters
+// (the later one if both have some) escapes those as well, as in
+// "schemas/~55ser.json" next to "schemas/user.json", so that the files stay
+// apart on case-insensitive file systems too.
+typedef struct OpenApiShards OpenApiShards;
+
+typedef enum {
+    OPENAPI_SHARD_ROOT,
+    OPENAPI_SHARD_PARAMETERS,
+    OPENAPI_SHARD_PATH,
+    OPENAPI_SHARD_SCHEMA,
+} OpenApiShardKind;
+
+typedef struct {
+    OpenApiShardKind kind;
+    const char* name; // The path or schema key; NULL for the root and the parameters
+    const char* file; // Below the spec directory
+} OpenApiShard;
+
+// Plans the files of the document below `path_prefix` (NULL for every
+// path) on `jobs` threads. The spec must stay in place until the shards
+// are freed. Returns NULL when out of memory.
+OpenApiShards* openapi_shards_open(const ApiSpec* spec, const char* path_prefix, const char* extension, int jobs);
+void openapi_shards_free(OpenApiShards* shards);
+
+// The root comes first, then the parameters (when there are any), the path
+// items and the schemas in document order.
+int openapi_shard_count(const OpenApiShards* shards);
+const OpenApiShard* openapi_shard(const OpenApiShards* shards, int index);
+
+// Emits the content of file `index`; several threads may emit at once.
+void openapi_shards_emit(const OpenApiShards* shards, int index, SpecEmitter* emitter);
+
+// Emits an index mapping "openapi", "parameters", every path (under
+// "paths") and schema key (under "schemas") to its file and `hashes[i]`,
+// the hash of file i's content.
+void openapi_shards_emit_index(const OpenApiShards* shards, const uint64_t* hashes, SpecEmitter* emitter);
+
+// Emits the schema that components/schemas holds under `key` (a model or
+// class name), written out even where the whole document refers to an
+// identical one. Linkage schemas are referenced, not included. Returns 1
+// when no resource has that key, -1 when out of memory.
+int openapi_emit_schema(const ApiSpec* spec, SpecEmitter* emitter, const char* key);
+
+// Verb and path of one operation of the paths section
+typedef struct {
+    const char* verb; // "get", "post", ...
+    const char* path;
+} PathOperation;
+
+typedef struct {
+    PathOperation* items;
+    int count;
+    int capacity;
+} PathOperationList;
+
+// Appends the operations the document has for `resource` to `list`, in
+// document order; paths made up for it are allocated in `arena`. Returns -1
+// when out of memory.
+int openapi_resource_operations(const ResourceInfo* resource, PathOperationList* list, Arena* arena);
+
+#endif
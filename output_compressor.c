@@ -0,0 +1,140 @@
+#include "output_compressor.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define GZIP_BUFFER_SIZE (1 << 16)
+#define GZIP_WINDOW_BITS (15 + 16) // 32 KB window with a gzip header and trailer
+
+int compression_parse(const char* name, Compression* compression) {
+    if (strcmp(name, "none") == 0) {
+        *compression = COMPRESSION_NONE;
+    } else if (strcmp(name, "gzip") == 0) {
+        *compression = COMPRESSION_GZIP;
+    } else if (strcmp(name, "zstd") == 0) {
+#ifdef HAVE_ZSTD
+        *compression = COMPRESSION_ZSTD;
+#else
+        printf("Error: This build has no zstd support (build with -DHAVE_ZSTD -lzstd)\n");
+        return -1;
+#endif
+    } else {
+        printf("Error: --compress expects 'gzip' or 'zstd', got '%s'\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+const char* compression_extension(Compression compression) {
+    switch (compression) {
+        case COMPRESSION_GZIP: return ".gz";
+        case COMPRESSION_ZSTD: return ".zst";
+        default: return "";
+    }
+}
+
+static int write_out(OutputCompressor* compressor, const unsigned char* data, size_t size) {
+    if (size == 0) return 0;
+    if (fwrite(data, 1, size, compressor->file) != size) return -1;
+    compressor->bytes_out += size;
+    return 0;
+}
+
+// Feeds `size` bytes through deflate (or finishes the stream when `flush` is
+// Z_FINISH), writing out every full buffer
+static int gzip_deflate(OutputCompressor* compressor, const char* data, size_t size, int flush) {
+    z_stream* stream = compressor->stream;
+    stream->next_in = (Bytef*)data;
+    stream->avail_in = (uInt)size;
+    int status;
+    do {
+        stream->next_out = compressor->buffer;
+        stream->avail_out = (uInt)compressor->buffer_size;
+        status = deflate(stream, flush);
+        if (status == Z_STREAM_ERROR) return -1;
+        if (write_out(compressor, compressor->buffer, compressor->buffer_size - stream->avail_out) != 0) return -1;
+    } while (stream->avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+    return 0;
+}
+
+int output_compressor_open(OutputCompressor* compressor, Compression compression, FILE* file) {
+    memset(compressor, 0, sizeof(OutputCompressor));
+    compressor->compression = compression;
+    compressor->file = file;
+
+    if (compression == COMPRESSION_GZIP) {
+        z_stream* stream = calloc(1, sizeof(z_stream));
+        compressor->buffer_size = GZIP_BUFFER_SIZE;
+        compressor->buffer = malloc(compressor->buffer_size);
+        if (!stream || !compressor->buffer ||
+            deflateInit2(stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            free(stream);
+            free(compressor->buffer);
+            return -1;
+        }
+        compressor->stream = stream;
+    }
+#ifdef HAVE_ZSTD
+    if (compression == COMPRESSION_ZSTD) {
+        compressor->stream = ZSTD_createCCtx();
+        compressor->buffer_size = ZSTD_CStreamOutSize();
+        compressor->buffer = malloc(compressor->buffer_size);
+        if (!compressor->stream || !compressor->buffer) {
+            ZSTD_freeCCtx(compressor->stream);
+            free(compressor->buffer);
+            return -1;
+        }
+    }
+#endif
+    return 0;
+}
+
+#ifdef HAVE_ZSTD
+// Runs `size` bytes through the zstd stream with `mode`, writing out every
+// buffer it fills; ZSTD_e_end loops until the frame is complete
+static int zstd_compress(OutputCompressor* compressor, const char* data, size_t size, ZSTD_EndDirective mode) {
+    ZSTD_inBuffer input = { data, size, 0 };
+    size_t remaining;
+    do {
+        ZSTD_outBuffer output = { compressor->buffer, compressor->buffer_size, 0 };
+        remaining = ZSTD_compressStream2(compressor->stream, &output, &input, mode);
+        if (ZSTD_isError(remaining)) return -1;
+        if (write_out(compressor, compressor->buffer, output.pos) != 0) return -1;
+    } while (mode == ZSTD_e_end ? remaining != 0 : input.pos < input.size);
+    return 0;
+}
+#endif
+
+int output_compressor_write(void* ctx, const char* data, size_t size) {
+    OutputCompressor* compressor = ctx;
+    switch (compressor->compression) {
+        case COMPRESSION_GZIP: return gzip_deflate(compressor, data, size, Z_NO_FLUSH);
+#ifdef HAVE_ZSTD
+        case COMPRESSION_ZSTD: return zstd_compress(compressor, data, size, ZSTD_e_continue);
+#endif
+        default: return write_out(compressor, (const unsigned char*)data, size);
+    }
+}
+
+int output_compressor_finish(OutputCompressor* compressor) {
+    int status = 0;
+    if (compressor->compression == COMPRESSION_GZIP && compressor->stream) {
+        status = gzip_deflate(compressor, NULL, 0, Z_FINISH);
+        deflateEnd(compressor->stream);
+        free(compressor->stream);
+    }
+#ifdef HAVE_ZSTD
+    if (compressor->compression == COMPRESSION_ZSTD && compressor->stream) {
+        status = zstd_compress(compressor, NULL, 0, ZSTD_e_end);
+        ZSTD_freeCCtx(compressor->stream);
+    }
+#endif
+    free(compressor->buffer);
+    compressor->stream = NULL;
+    compressor->buffer = NULL;
+    return status;
+}
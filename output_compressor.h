@@ -0,0 +1,40 @@
+#ifndef OUTPUT_COMPRESSOR_H
+#define OUTPUT_COMPRESSOR_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+    COMPRESSION_NONE,
+    COMPRESSION_GZIP,
+    COMPRESSION_ZSTD, // Needs a build with -DHAVE_ZSTD -lzstd
+} Compression;
+
+// Writes everything it receives into a file, compressed on the way
+typedef struct {
+    Compression compression;
+    FILE* file;
+    void* stream;          // z_stream or ZSTD_CCtx
+    unsigned char* buffer; // Compressed bytes on their way to the file
+    size_t buffer_size;
+    size_t bytes_out; // Bytes written to the file
+} OutputCompressor;
+
+// "gzip" or "zstd" (also "none"). Returns -1 after printing an error when
+// the name is unknown or this build cannot produce the format.
+int compression_parse(const char* name, Compression* compression);
+
+// ".gz", ".zst" or ""
+const char* compression_extension(Compression compression);
+
+// Returns -1 if the compressor could not be set up.
+int output_compressor_open(OutputCompressor* compressor, Compression compression, FILE* file);
+
+// OutputSinkWriteFn for an OutputCompressor context.
+int output_compressor_write(void* ctx, const char* data, size_t size);
+
+// Writes what is left and the format's trailer, and releases the
+// compressor; the file stays open. Returns -1 if any write failed.
+int output_compressor_finish(OutputCompressor* compressor);
+
+#endif
@@ -0,0 +1,60 @@
+#include "output_sink.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int output_sink_init(OutputSink* sink, size_t capacity, OutputSinkWriteFn write, void* ctx) {
+    memset(sink, 0, sizeof(OutputSink));
+    sink->buffer = malloc(capacity);
+    if (!sink->buffer) return -1;
+    sink->capacity = capacity;
+    sink->write = write;
+    sink->ctx = ctx;
+    return 0;
+}
+
+void output_sink_free(OutputSink* sink) {
+    free(sink->buffer);
+    sink->buffer = NULL;
+    sink->used = 0;
+    sink->capacity = 0;
+}
+
+static void emit(OutputSink* sink, const char* data, size_t size) {
+    if (sink->failed || size == 0) return;
+    if (sink->write(sink->ctx, data, size) != 0) sink->failed = 1;
+    else sink->bytes_written += size;
+}
+
+void output_sink_write(OutputSink* sink, const char* data, size_t size) {
+    if (sink->used + size <= sink->capacity) {
+        memcpy(sink->buffer + sink->used, data, size);
+        sink->used += size;
+        return;
+    }
+
+    emit(sink, sink->buffer, sink->used);
+    sink->used = 0;
+    // Chunks at least as large as the buffer go straight through
+    if (size >= sink->capacity) {
+        emit(sink, data, size);
+    } else {
+        memcpy(sink->buffer, data, size);
+        sink->used = size;
+    }
+}
+
+void output_sink_puts(OutputSink* sink, const char* str) {
+    output_sink_write(sink, str, strlen(str));
+}
+
+int output_sink_flush(OutputSink* sink) {
+    emit(sink, sink->buffer, sink->used);
+    sink->used = 0;
+    return sink->failed ? -1 : 0;
+}
+
+int output_sink_write_file(void* ctx, const char* data, size_t size) {
+    return fwrite(data, 1, size, (FILE*)ctx) == size ? 0 : -1;
+}
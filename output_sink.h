@@ -0,0 +1,39 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <stddef.h>
+
+// Receives each flushed chunk; returns 0 on success, -1 on failure.
+typedef int (*OutputSinkWriteFn)(void* ctx, const char* data, size_t size);
+
+// Buffered byte sink in front of a write callback. Once a write fails the
+// sink drops everything that follows and output_sink_flush() reports it.
+typedef struct {
+    char* buffer;
+    size_t used;
+    size_t capacity;
+    OutputSinkWriteFn write;
+    void* ctx;
+    size_t bytes_written;
+    int failed;
+} OutputSink;
+
+// Returns -1 if the buffer could not be allocated.
+int output_sink_init(OutputSink* sink, size_t capacity, OutputSinkWriteFn write, void* ctx);
+void output_sink_free(OutputSink* sink);
+
+void output_sink_write(OutputSink* sink, const char* data, size_t size);
+void output_sink_puts(OutputSink* sink, const char* str);
+
+static inline void output_sink_putc(OutputSink* sink, char c) {
+    if (sink->used == sink->capacity) output_sink_write(sink, &c, 1);
+    else sink->buffer[sink->used++] = c;
+}
+
+// Hands the buffered bytes to the callback. Returns -1 if any write failed.
+int output_sink_flush(OutputSink* sink);
+
+// OutputSinkWriteFn for a FILE* context.
+int output_sink_write_file(void* ctx, const char* data, size_t size);
+
+#endif
@@ -0,0 +1,491 @@
+#include "parse_cache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "output_sink.h"
+#include "resource_parser.h"
+
+#define PARSE_CACHE_MAGIC "JRPC"
+#define NULL_STRING 0xffffffffu
+
+#ifdef __APPLE__
+#define STAT_MTIME_NSEC(st) ((st).st_mtimespec.tv_nsec)
+#else
+#define STAT_MTIME_NSEC(st) ((st).st_mtim.tv_nsec)
+#endif
+
+uint64_t hash_bytes(const void* data, size_t size) {
+    const unsigned char* p = data;
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ size;
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+        p += 8;
+        size -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, size);
+    hash = (hash ^ tail) * 0xc4ceb9fe1a85ec53ULL;
+    return hash ^ (hash >> 29);
+}
+
+// Bounds-checked reader over the mapped cache file. Strings are stored
+// NUL-terminated, so they are used in place until they are interned.
+typedef struct {
+    const char* cur;
+    const char* end;
+    int failed;
+} Reader;
+
+static uint64_t read_u64(Reader* reader) {
+    uint64_t value = 0;
+    if (reader->end - reader->cur < 8) {
+        reader->failed = 1;
+        return 0;
+    }
+    memcpy(&value, reader->cur, 8);
+    reader->cur += 8;
+    return value;
+}
+
+static uint32_t read_u32(Reader* reader) {
+    uint32_t value = 0;
+    if (reader->end - reader->cur < 4) {
+        reader->failed = 1;
+        return 0;
+    }
+    memcpy(&value, reader->cur, 4);
+    reader->cur += 4;
+    return value;
+}
+
+// Returns the string or NULL; interned into `arena` unless it is NULL
+static const char* read_string(Reader* reader, Arena* arena) {
+    uint32_t len = read_u32(reader);
+    if (reader->failed || len == NULL_STRING) return NULL;
+    if ((size_t)(reader->end - reader->cur) <= len || reader->cur[len] != '\0') {
+        reader->failed = 1;
+        return NULL;
+    }
+    const char* str = reader->cur;
+    reader->cur += len + 1;
+    return arena ? arena_intern(arena, str, len) : str;
+}
+
+// Reads a string as a symbol; with a NULL arena it is only skipped
+static Symbol read_symbol(Reader* reader, Arena* arena) {
+    const char* str = read_string(reader, NULL);
+    return str && arena ? symbol_intern_cstr(str) : SYMBOL_NONE;
+}
+
+static void read_stamp(Reader* reader, CacheStamp* stamp) {
+    stamp->mtime_sec = (int64_t)read_u64(reader);
+    stamp->mtime_nsec = (int64_t)read_u64(reader);
+    stamp->size = read_u64(reader);
+    stamp->hash = read_u64(reader);
+}
+
+static void read_string_list(Reader* reader, Arena* arena, StringList* list) {
+    uint32_t count = read_u32(reader);
+    for (uint32_t i = 0; i < count && !reader->failed; i++) {
+        const char* str = read_string(reader, arena);
+        if (!arena) continue;
+        const char** slot = ARENA_PUSH(arena, *list);
+        if (slot) *slot = str;
+    }
+}
+
+static void read_symbol_list(Reader* reader, Arena* arena, SymbolList* list) {
+    uint32_t count = read_u32(reader);
+    for (uint32_t i = 0; i < count && !reader->failed; i++) {
+        Symbol symbol = read_symbol(reader, arena);
+        if (!arena) continue;
+        Symbol* slot = ARENA_PUSH(arena, *list);
+        if (slot) *slot = symbol;
+    }
+}
+
+// Reads one resource; with a NULL arena it is only skipped
+static void read_resource(Reader* reader, Arena* arena, ResourceInfo* resource) {
+    ResourceInfo skipped;
+    if (!arena) resource = &skipped;
+    resource->class_name = read_string(reader, arena);
+    resource->declared_name = read_string(reader, arena);
+    resource->model_name = read_string(reader, arena);
+    resource->create_form = read_string(reader, arena);
+    resource->paginator = read_string(reader, arena);
+    resource->default_sort_field = read_string(reader, arena);
+    resource->default_sort_direction = read_string(reader, arena);
+    read_symbol_list(reader, arena, &resource->attributes);
+
+    uint32_t filters = read_u32(reader);
+    for (uint32_t i = 0; i < filters && !reader->failed; i++) {
+        Filter filter;
+        filter.name = read_symbol(reader, arena);
+        filter.type = read_symbol(reader, arena);
+        filter.collection = read_symbol(reader, arena);
+        if (!arena) continue;
+        Filter* slot = ARENA_PUSH(arena, resource->filters);
+        if (slot) *slot = filter;
+    }
+
+    uint32_t relations = read_u32(reader);
+    for (uint32_t i = 0; i < relations && !reader->failed; i++) {
+        Relation relation;
+        relation.name = read_symbol(reader, arena);
+        relation.relation_name = read_symbol(reader, arena);
+        relation.foreign_key_on = read_symbol(reader, arena);
+        relation.type = read_symbol(reader, arena);
+        if (!arena) continue;
+        Relation* slot = ARENA_PUSH(arena, resource->relations);
+        if (slot) *slot = relation;
+    }
+
+    read_symbol_list(reader, arena, &resource->creatable_fields);
+    read_symbol_list(reader, arena, &resource->updatable_fields);
+    resource->superclass = read_string(reader, arena);
+    resource->abstract = read_u32(reader) != 0;
+    read_string_list(reader, arena, &resource->includes);
+}
+
+static void read_routes(Reader* reader, ApiSpec* spec) {
+    Arena* arena = spec ? &spec->arena : NULL;
+    int first = spec ? spec->routes.count : 0;
+    uint32_t count = read_u32(reader);
+    for (uint32_t i = 0; i < count && !reader->failed; i++) {
+        RouteInfo route = { 0 };
+        route.path = read_string(reader, arena);
+        route.controller = read_string(reader, arena);
+        route.action = read_string(reader, arena);
+        route.method = read_string(reader, arena);
+        route.resource_name = read_string(reader, arena);
+        route.namespace_path = read_string(reader, arena);
+        route.group = first + (int)read_u32(reader);
+        if (!spec) continue;
+        RouteInfo* slot = ARENA_PUSH(arena, spec->routes);
+        if (slot) *slot = route;
+    }
+}
+
+void parse_cache_init(ParseCache* cache) {
+    memset(cache, 0, sizeof(ParseCache));
+}
+
+void parse_cache_free(ParseCache* cache) {
+    if (cache->file.data) source_file_close(&cache->file);
+    free(cache->entries);
+    free(cache->slots);
+    parse_cache_init(cache);
+}
+
+static uint64_t hash_path(const char* path) {
+    return hash_bytes(path, strlen(path));
+}
+
+static const CacheEntry* find_entry(const ParseCache* cache, const char* path) {
+    if (cache->capacity == 0) return NULL;
+    size_t mask = cache->capacity - 1;
+    for (size_t i = hash_path(path) & mask;; i = (i + 1) & mask) {
+        const CacheEntry* entry = cache->slots[i];
+        if (!entry || strcmp(entry->path, path) == 0) return entry;
+    }
+}
+
+int parse_cache_load(ParseCache* cache, const char* path) {
+    parse_cache_init(cache);
+    if (source_file_open(&cache->file, path) != 0) return -1;
+
+    Reader reader = { cache->file.data, cache->file.data + cache->file.size, 0 };
+    if (cache->file.size < 8 || memcmp(reader.cur, PARSE_CACHE_MAGIC, 4) != 0) goto invalid;
+    reader.cur += 4;
+    if (read_u32(&reader) != PARSE_CACHE_VERSION) goto invalid;
+    cache->saved_at = (int64_t)read_u64(&reader);
+
+    cache->has_routes = read_u32(&reader) != 0;
+    if (cache->has_routes) {
+        cache->routes.path = read_string(&reader, NULL);
+        read_stamp(&reader, &cache->routes.stamp);
+        cache->routes.offset = reader.cur - cache->file.data;
+        read_routes(&reader, NULL);
+    }
+
+    uint32_t count = read_u32(&reader);
+    if (reader.failed || count > cache->file.size) goto invalid;
+    cache->entries = calloc(count ? count : 1, sizeof(CacheEntry));
+    cache->capacity = 16;
+    while (cache->capacity < (size_t)count * 2) cache->capacity *= 2;
+    cache->slots = calloc(cache->capacity, sizeof(CacheEntry*));
+    if (!cache->entries || !cache->slots) goto invalid;
+
+    for (uint32_t i = 0; i < count; i++) {
+        CacheEntry* entry = &cache->entries[i];
+        entry->path = read_string(&reader, NULL);
+        read_stamp(&reader, &entry->stamp);
+        entry->offset = reader.cur - cache->file.data;
+        read_resource(&reader, NULL, NULL);
+        if (reader.failed || !entry->path) goto invalid;
+
+        size_t mask = cache->capacity - 1;
+        size_t slot = hash_path(entry->path) & mask;
+        while (cache->slots[slot]) slot = (slot + 1) & mask;
+        cache->slots[slot] = entry;
+    }
+    if (reader.failed) goto invalid;
+    cache->entry_count = count;
+    return 0;
+
+invalid:
+    printf("Warning: Ignoring unreadable parse cache %s\n", path);
+    parse_cache_free(cache);
+    return -1;
+}
+
+static int stat_stamp(const char* path, CacheStamp* stamp) {
+    struct stat st;
+    memset(stamp, 0, sizeof(CacheStamp));
+    if (stat(path, &st) != 0) return -1;
+    stamp->mtime_sec = st.st_mtime;
+    stamp->mtime_nsec = STAT_MTIME_NSEC(st);
+    stamp->size = st.st_size;
+    return 0;
+}
+
+// Unchanged without looking at the content. Files written in the second the
+// cache was saved may still change within the same mtime, so they are hashed.
+static int same_metadata(const ParseCache* cache, const CacheEntry* entry, const CacheStamp* stamp) {
+    return entry->stamp.mtime_sec == stamp->mtime_sec && entry->stamp.mtime_nsec == stamp->mtime_nsec &&
+           entry->stamp.size == stamp->size && entry->stamp.mtime_sec < cache->saved_at;
+}
+
+static int restore_resource(const ParseCache* cache, const CacheEntry* entry, const char* path,
+                            ResourceInfo* resource, Arena* arena) {
+    Reader reader = { cache->file.data + entry->offset, cache->file.data + cache->file.size, 0 };
+    memset(resource, 0, sizeof(ResourceInfo));
+    read_resource(&reader, arena, resource);
+    if (reader.failed) {
+        memset(resource, 0, sizeof(ResourceInfo));
+        return -1;
+    }
+    resource->source_path = arena_intern_cstr(arena, path);
+    return 0;
+}
+
+// Restores the entry when the content hash matches, else parses `data`
+static void parse_source(const ParseCache* cache, const CacheEntry* entry, const char* path, const char* data,
+                         size_t size, ResourceInfo* resource, Arena* arena, CacheStamp* stamp, ParseCounts* counts) {
+    stamp->size = size;
+    stamp->hash = hash_bytes(data, size);
+    if (counts) counts->bytes = size;
+    if (entry && entry->stamp.size == stamp->size && entry->stamp.hash == stamp->hash &&
+        restore_resource(cache, entry, path, resource, arena) == 0) {
+        stamp->result = PARSE_CACHE_HIT;
+        stamp->rehashed = 1;
+    } else {
+        int lines = parse_resource_source(path, data, size, resource, arena);
+        if (counts) counts->lines = lines;
+        stamp->result = PARSE_CACHE_MISS;
+    }
+}
+
+ParseCacheResult parse_cache_resource(const ParseCache* cache, const char* path, ResourceInfo* resource,
+                                      Arena* arena, CacheStamp* stamp, ParseCounts* counts) {
+    const CacheEntry* entry = find_entry(cache, path);
+    if (stat_stamp(path, stamp) == 0 && entry && same_metadata(cache, entry, stamp) &&
+        restore_resource(cache, entry, path, resource, arena) == 0) {
+        stamp->hash = entry->stamp.hash;
+        return stamp->result = PARSE_CACHE_HIT;
+    }
+
+    SourceFile source;
+    if (source_file_open(&source, path) != 0) {
+        // Reports the error and leaves the resource with just its class name
+        parse_resource_file(path, resource, arena, NULL);
+        return stamp->result = PARSE_CACHE_UNREADABLE;
+    }
+    parse_source(cache, entry, path, source.data, source.size, resource, arena, stamp, counts);
+    source_file_close(&source);
+    return stamp->result;
+}
+
+ParseCacheResult parse_cache_resource_source(const ParseCache* cache, const char* path, const char* data,
+                                             size_t size, ResourceInfo* resource, Arena* arena, CacheStamp* stamp,
+                                             ParseCounts* counts) {
+    const CacheEntry* entry = find_entry(cache, path);
+    stamp->size = size;
+    if (entry && same_metadata(cache, entry, stamp) && restore_resource(cache, entry, path, resource, arena) == 0) {
+        stamp->hash = entry->stamp.hash;
+        return stamp->result = PARSE_CACHE_HIT;
+    }
+    parse_source(cache, entry, path, data, size, resource, arena, stamp, counts);
+    return stamp->result;
+}
+
+ParseCacheResult parse_cache_routes(const ParseCache* cache, const char* path, ApiSpec* spec, CacheStamp* stamp) {
+    const CacheEntry* entry = cache->has_routes && strcmp(cache->routes.path, path) == 0 ? &cache->routes : NULL;
+    if (stat_stamp(path, stamp) != 0) return stamp->result = PARSE_CACHE_UNREADABLE;
+
+    int hit = entry && same_metadata(cache, entry, stamp);
+    if (hit) {
+        stamp->hash = entry->stamp.hash;
+    } else {
+        SourceFile source;
+        if (source_file_open(&source, path) != 0) return stamp->result = PARSE_CACHE_UNREADABLE;
+        stamp->size = source.size;
+        stamp->hash = hash_bytes(source.data, source.size);
+        source_file_close(&source);
+        hit = entry && entry->stamp.size == stamp->size && entry->stamp.hash == stamp->hash;
+        stamp->rehashed = hit;
+    }
+    if (!hit) return stamp->result = PARSE_CACHE_MISS;
+
+    int first = spec->routes.count;
+    Reader reader = { cache->file.data + entry->offset, cache->file.data + cache->file.size, 0 };
+    read_routes(&reader, spec);
+    if (reader.failed) {
+        spec->routes.count = first;
+        return stamp->result = PARSE_CACHE_MISS;
+    }
+    return stamp->result = PARSE_CACHE_HIT;
+}
+
+static void write_u32(OutputSink* sink, uint32_t value) {
+    output_sink_write(sink, (const char*)&value, 4);
+}
+
+static void write_u64(OutputSink* sink, uint64_t value) {
+    output_sink_write(sink, (const char*)&value, 8);
+}
+
+static void write_string(OutputSink* sink, const char* str) {
+    if (!str) {
+        write_u32(sink, NULL_STRING);
+        return;
+    }
+    size_t len = strlen(str);
+    write_u32(sink, (uint32_t)len);
+    output_sink_write(sink, str, len + 1);
+}
+
+static void write_stamp(OutputSink* sink, const CacheStamp* stamp) {
+    write_u64(sink, (uint64_t)stamp->mtime_sec);
+    write_u64(sink, (uint64_t)stamp->mtime_nsec);
+    write_u64(sink, stamp->size);
+    write_u64(sink, stamp->hash);
+}
+
+static void write_string_list(OutputSink* sink, const StringList* list) {
+    write_u32(sink, (uint32_t)list->count);
+    for (int i = 0; i < list->count; i++) write_string(sink, list->items[i]);
+}
+
+// Symbols are numbered per process, so the cache holds their names
+static void write_symbol_list(OutputSink* sink, const SymbolList* list) {
+    write_u32(sink, (uint32_t)list->count);
+    for (int i = 0; i < list->count; i++) write_string(sink, symbol_name(list->items[i]));
+}
+
+static void write_resource(OutputSink* sink, const ResourceInfo* resource) {
+    write_string(sink, resource->class_name);
+    write_string(sink, resource->declared_name);
+    write_string(sink, resource->model_name);
+    write_string(sink, resource->create_form);
+    write_string(sink, resource->paginator);
+    write_string(sink, resource->default_sort_field);
+    write_string(sink, resource->default_sort_direction);
+    write_symbol_list(sink, &resource->attributes);
+
+    write_u32(sink, (uint32_t)resource->filters.count);
+    for (int i = 0; i < resource->filters.count; i++) {
+        const Filter* filter = &resource->filters.items[i];
+        write_string(sink, symbol_name(filter->name));
+        write_string(sink, symbol_name(filter->type));
+        write_string(sink, symbol_name(filter->collection));
+    }
+
+    write_u32(sink, (uint32_t)resource->relations.count);
+    for (int i = 0; i < resource->relations.count; i++) {
+        const Relation* relation = &resource->relations.items[i];
+        write_string(sink, symbol_name(relation->name));
+        write_string(sink, symbol_name(relation->relation_name));
+        write_string(sink, symbol_name(relation->foreign_key_on));
+        write_string(sink, symbol_name(relation->type));
+    }
+
+    write_symbol_list(sink, &resource->creatable_fields);
+    write_symbol_list(sink, &resource->updatable_fields);
+    write_string(sink, resource->superclass);
+    write_u32(sink, (uint32_t)resource->abstract);
+    write_string_list(sink, &resource->includes);
+}
+
+int parse_cache_save(const char* path, const ApiSpec* spec, const CacheStamp* stamps,
+                     const char* routes_path, const CacheStamp* routes_stamp) {
+    char temp_path[1024];
+    int written = snprintf(temp_path, sizeof(temp_path), "%s.tmp.%ld", path, (long)getpid());
+    if (written < 0 || (size_t)written >= sizeof(temp_path)) return -1;
+
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        printf("Warning: Cannot write parse cache %s: %s\n", temp_path, strerror(errno));
+        return -1;
+    }
+    OutputSink sink;
+    if (output_sink_init(&sink, 1 << 16, output_sink_write_file, file) != 0) {
+        fclose(file);
+        remove(temp_path);
+        return -1;
+    }
+
+    output_sink_write(&sink, PARSE_CACHE_MAGIC, 4);
+    write_u32(&sink, PARSE_CACHE_VERSION);
+    write_u64(&sink, (uint64_t)time(NULL));
+
+    int routes_cached = routes_stamp && routes_stamp->result != PARSE_CACHE_UNREADABLE;
+    write_u32(&sink, routes_cached);
+    if (routes_cached) {
+        write_string(&sink, routes_path);
+        write_stamp(&sink, routes_stamp);
+        write_u32(&sink, (uint32_t)spec->routes.count);
+        for (int i = 0; i < spec->routes.count; i++) {
+            const RouteInfo* route = &spec->routes.items[i];
+            write_string(&sink, route->path);
+            write_string(&sink, route->controller);
+            write_string(&sink, route->action);
+            write_string(&sink, route->method);
+            write_string(&sink, route->resource_name);
+            write_string(&sink, route->namespace_path);
+            write_u32(&sink, (uint32_t)route->group);
+        }
+    }
+
+    uint32_t count = 0;
+    for (int i = 0; i < spec->resources.count; i++) {
+        if (stamps[i].result != PARSE_CACHE_UNREADABLE && spec->resources.items[i].source_path) count++;
+    }
+    write_u32(&sink, count);
+    for (int i = 0; i < spec->resources.count; i++) {
+        const ResourceInfo* resource = &spec->resources.items[i];
+        if (stamps[i].result == PARSE_CACHE_UNREADABLE || !resource->source_path) continue;
+        write_string(&sink, resource->source_path);
+        write_stamp(&sink, &stamps[i]);
+        write_resource(&sink, resource);
+    }
+
+    int status = output_sink_flush(&sink);
+    output_sink_free(&sink);
+    if (fclose(file) != 0) status = -1;
+    if (status == 0 && rename(temp_path, path) != 0) status = -1;
+    if (status != 0) {
+        printf("Warning: Cannot write parse cache %s\n", path);
+        remove(temp_path);
+    }
+    return status;
+}
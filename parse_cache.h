@@ -0,0 +1,84 @@
+#ifndef PARSE_CACHE_H
+#define PARSE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "api_spec.h"
+#include "resource_parser.h"
+#include "source_file.h"
+
+// Bump whenever ResourceInfo, RouteInfo or the parsers change what they
+// extract, so caches written by older builds are discarded.
+#define PARSE_CACHE_VERSION 5
+
+typedef enum {
+    PARSE_CACHE_UNREADABLE, // The file could not be read; nothing is cached for it
+    PARSE_CACHE_MISS,       // Parsed from source
+    PARSE_CACHE_HIT         // Restored from the cache
+} ParseCacheResult;
+
+// Identity of one source file as seen by the cache
+typedef struct {
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t size;
+    uint64_t hash; // Content hash
+    ParseCacheResult result;
+    int rehashed;  // A hit found through the content hash; the cached mtime is stale
+
+} CacheStamp;
+
+typedef struct {
+    const char* path; // NUL-terminated, inside the mapped cache file
+    CacheStamp stamp;
+    size_t offset;    // Serialized ResourceInfo
+} CacheEntry;
+
+// Parse results of an earlier run, keyed by path. A file is reused when its
+// mtime and size are unchanged, or when they changed but the content hash
+// did not (a touch, a checkout of the same content). Files modified in the
+// same second the cache was written are always hashed.
+// Lookups only read the cache, so workers may share it.
+typedef struct {
+    SourceFile file;
+    int64_t saved_at;
+    CacheEntry* entries;
+    int entry_count;
+    CacheEntry** slots; // Open-addressing index over entries by path
+    size_t capacity;
+    int has_routes;
+    CacheEntry routes;
+} ParseCache;
+
+void parse_cache_init(ParseCache* cache);
+void parse_cache_free(ParseCache* cache);
+
+// Loads the cache written by parse_cache_save. Returns -1 and leaves the
+// cache empty if the file is missing, from another version or damaged.
+int parse_cache_load(ParseCache* cache, const char* path);
+
+// Restores the resource parsed from `path` or parses it again, filling
+// `stamp` for the next parse_cache_save. `counts` (may be NULL) receives the
+// bytes read and lines parsed; both stay 0 for a hit on unchanged metadata.
+ParseCacheResult parse_cache_resource(const ParseCache* cache, const char* path, ResourceInfo* resource,
+                                      Arena* arena, CacheStamp* stamp, ParseCounts* counts);
+
+// Same for a file whose content was read ahead: `stamp` comes zeroed apart
+// from the mtime read along with `data`.
+ParseCacheResult parse_cache_resource_source(const ParseCache* cache, const char* path, const char* data,
+                                             size_t size, ResourceInfo* resource, Arena* arena, CacheStamp* stamp,
+                                             ParseCounts* counts);
+
+// Appends the routes of `path` to spec->routes if the cache holds them.
+// On a miss nothing is added and the caller parses the file itself.
+ParseCacheResult parse_cache_routes(const ParseCache* cache, const char* path, ApiSpec* spec, CacheStamp* stamp);
+
+// Writes every resource of `spec` (stamps[i] belongs to resources.items[i])
+// and the routes to `path` through a temporary file and a rename.
+int parse_cache_save(const char* path, const ApiSpec* spec, const CacheStamp* stamps,
+                     const char* routes_path, const CacheStamp* routes_stamp);
+
+uint64_t hash_bytes(const void* data, size_t size);
+
+#endif
@@ -0,0 +1,160 @@
+#include "resource_filter.h"
+
+#include <ctype.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "route_index.h"
+
+#define MAX_CLASS_NAME_LENGTH 512
+
+void resource_filter_init(ResourceFilter* filter) {
+    memset(filter, 0, sizeof(ResourceFilter));
+    arena_init(&filter->arena);
+}
+
+void resource_filter_free(ResourceFilter* filter) {
+    arena_reset(&filter->arena);
+    memset(filter, 0, sizeof(ResourceFilter));
+}
+
+int resource_filter_add(ResourceFilter* filter, const char* pattern, int exclude) {
+    StringList* list = exclude ? &filter->excludes : &filter->includes;
+    const char** slot = ARENA_PUSH(&filter->arena, *list);
+    if (!slot) return -1;
+    *slot = arena_intern_cstr(&filter->arena, pattern);
+    return *slot ? 0 : -1;
+}
+
+int resource_filter_set_prefix(ResourceFilter* filter, const char* prefix) {
+    size_t len = strlen(prefix);
+    while (len > 0 && prefix[len - 1] == '/') len--;
+    while (len > 0 && prefix[0] == '/') {
+        prefix++;
+        len--;
+    }
+    filter->path_prefix = NULL;
+    if (len == 0) return 0;
+    char* normalized = arena_alloc(&filter->arena, len + 2);
+    if (!normalized) return -1;
+    normalized[0] = '/';
+    memcpy(normalized + 1, prefix, len);
+    normalized[len + 1] = '\0';
+    filter->path_prefix = normalized;
+    return 0;
+}
+
+int resource_filter_active(const ResourceFilter* filter) {
+    return filter->includes.count > 0 || filter->excludes.count > 0 || filter->path_prefix;
+}
+
+// Part of `path` below `directory`
+static const char* relative_path(const char* directory, const char* path) {
+    size_t len = strlen(directory);
+    if (strncmp(path, directory, len) != 0) return path;
+    path += len;
+    while (*path == '/') path++;
+    return path;
+}
+
+// Part of `path` that names its class: below app/resources/ when the path
+// runs through it, as the resource directory may be a namespace inside it
+static const char* autoload_path(const char* directory, const char* path) {
+    const char* root = NULL;
+    for (const char* p = path; (p = strstr(p, "app/resources/")); p++) root = p + 14;
+    return root ? root : relative_path(directory, path);
+}
+
+// "api/v1/user_resource.rb" -> "Api::V1::UserResource"
+static void class_name_of(const char* relative, char* out, size_t size) {
+    size_t pos = 0;
+    int word_start = 1;
+    const char* end = relative + strlen(relative);
+    if (end - relative > 3 && strcmp(end - 3, ".rb") == 0) end -= 3;
+    for (const char* p = relative; p < end && pos + 3 < size; p++) {
+        if (*p == '/') {
+            out[pos++] = ':';
+            out[pos++] = ':';
+            word_start = 1;
+        } else if (*p == '_') {
+            word_start = 1;
+        } else {
+            out[pos++] = word_start ? (char)toupper((unsigned char)*p) : *p;
+            word_start = 0;
+        }
+    }
+    out[pos] = '\0';
+}
+
+static int pattern_matches(const char* pattern, const char* relative, const char* class_name) {
+    if (isupper((unsigned char)pattern[0])) return fnmatch(pattern, class_name, 0) == 0;
+    if (strchr(pattern, '/')) return fnmatch(pattern, relative, 0) == 0;
+    const char* base = strrchr(relative, '/');
+    return fnmatch(pattern, base ? base + 1 : relative, 0) == 0;
+}
+
+static int any_matches(const StringList* patterns, const char* relative, const char* class_name) {
+    for (int i = 0; i < patterns->count; i++) {
+        if (pattern_matches(patterns->items[i], relative, class_name)) return 1;
+    }
+    return 0;
+}
+
+int resource_filter_matches(const ResourceFilter* filter, const char* directory, const char* path) {
+    if (filter->includes.count == 0 && filter->excludes.count == 0) return 1;
+    const char* relative = relative_path(directory, path);
+    char class_name[MAX_CLASS_NAME_LENGTH];
+    class_name_of(autoload_path(directory, path), class_name, sizeof(class_name));
+    if (filter->includes.count > 0 && !any_matches(&filter->includes, relative, class_name)) return 0;
+    return !any_matches(&filter->excludes, relative, class_name);
+}
+
+static int under_prefix(const char* path, const char* prefix) {
+    size_t len = strlen(prefix);
+    return strncmp(path, prefix, len) == 0 && (path[len] == '\0' || path[len] == '/');
+}
+
+int resource_filter_apply(const ResourceFilter* filter, const char* directory, const ApiSpec* spec, PathList* files) {
+    int kept = 0;
+    for (int i = 0; i < files->count; i++) {
+        if (resource_filter_matches(filter, directory, files->paths[i])) {
+            files->paths[kept++] = files->paths[i];
+        } else {
+            free(files->paths[i]);
+        }
+    }
+    int dropped = files->count - kept;
+    files->count = kept;
+    if (!filter->path_prefix || kept == 0) return dropped;
+
+    // Each file goes with the route its class name leads to
+    char** names = calloc(kept, sizeof(char*));
+    int* routes = calloc(kept, sizeof(int));
+    int status = names && routes ? 0 : -1;
+    for (int i = 0; status == 0 && i < kept; i++) {
+        char class_name[MAX_CLASS_NAME_LENGTH];
+        class_name_of(autoload_path(directory, files->paths[i]), class_name, sizeof(class_name));
+        names[i] = strdup(class_name);
+        if (!names[i]) status = -1;
+    }
+    if (status == 0) status = route_match_class_names(spec, (const char* const*)names, kept, routes);
+
+    if (status == 0) {
+        int routed = 0;
+        for (int i = 0; i < kept; i++) {
+            if (routes[i] < 0 || under_prefix(spec->routes.items[routes[i]].path, filter->path_prefix)) {
+                files->paths[routed++] = files->paths[i];
+            } else {
+                free(files->paths[i]);
+            }
+        }
+        dropped += kept - routed;
+        files->count = routed;
+    }
+    for (int i = 0; names && i < kept; i++) free(names[i]);
+    free(names);
+    free(routes);
+    return status == 0 ? dropped : -1;
+}
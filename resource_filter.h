@@ -0,0 +1,53 @@
+#ifndef RESOURCE_FILTER_H
+#define RESOURCE_FILTER_H
+
+#include "api_spec.h"
+#include "resource_scan.h"
+
+// Which resource files of the tree a run generates the spec for, decided
+// from their paths before any of them is opened. Patterns are fnmatch(3)
+// globs in which `*` also matches '/' and "::":
+//
+//     Api::V1::*Resource    starts with an uppercase letter: a class name
+//     api/v1/*              contains '/': a path below the resource directory
+//     user*_resource.rb     anything else: a file name
+//
+// Class names are derived from paths the way Rails autoloads them:
+// app/resources/api/v1/user_resource.rb holds Api::V1::UserResource
+// whichever directory was scanned, and outside app/resources the path below
+// the resource directory is used. A file is kept when it matches an
+// include (or there is none) and no exclude.
+typedef struct ResourceFilter ResourceFilter;
+
+struct ResourceFilter {
+    StringList includes;
+    StringList excludes;
+    const char* path_prefix; // "/api/v1"; NULL for every route
+    Arena arena;
+};
+
+void resource_filter_init(ResourceFilter* filter);
+void resource_filter_free(ResourceFilter* filter);
+
+// Adds an --include (or with `exclude`, an --exclude) pattern. Returns -1
+// when out of memory.
+int resource_filter_add(ResourceFilter* filter, const char* pattern, int exclude);
+
+// Keeps only the resources served below `prefix` ("/api/v1/" and "api/v1"
+// both become "/api/v1"; "/" keeps every route). Returns -1 when out of memory.
+int resource_filter_set_prefix(ResourceFilter* filter, const char* prefix);
+
+// Whether any pattern or prefix was given.
+int resource_filter_active(const ResourceFilter* filter);
+
+// Whether the patterns keep `path`, a file found below `directory`.
+int resource_filter_matches(const ResourceFilter* filter, const char* directory, const char* path);
+
+// Drops from `files` (found below `directory`) what the patterns reject
+// and, with a path prefix, the files whose class name routes outside it in
+// `spec`, whose routes must already be parsed; files no route names by
+// class are kept, since their model name may still match one. The kept
+// files stay in order. Returns the number dropped, or -1 when out of memory.
+int resource_filter_apply(const ResourceFilter* filter, const char* directory, const ApiSpec* spec, PathList* files);
+
+#endif
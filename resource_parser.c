@@ -0,0 +1,498 @@
+#include "resource_parser.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "diagnostics.h"
+#include "keyword_prefilter.h"
+#include "ruby_lexer.h"
+#include "source_file.h"
+
+#define MAX_FIELD_NESTING 16
+
+typedef struct {
+    ResourceInfo* resource;
+    Arena* arena;
+    RubyLexer* lexer;
+    int use_prefilter;
+    char modules[256]; // Enclosing modules seen before the class, "Api::V1"
+    size_t modules_len;
+} ResourceParser;
+
+typedef void (*StatementHandler)(ResourceParser* parser, const RubyStatement* stmt);
+
+static const char* intern_view(Arena* arena, StrView view) {
+    return arena_intern(arena, view.ptr, view.len);
+}
+
+static Symbol symbol_view(StrView view) {
+    return symbol_intern(view.ptr, view.len);
+}
+
+static void add_string(Arena* arena, StringList* list, StrView value) {
+    const char** slot = ARENA_PUSH(arena, *list);
+    if (slot) *slot = intern_view(arena, value);
+}
+
+static void add_symbol(Arena* arena, SymbolList* list, StrView value) {
+    Symbol* slot = ARENA_PUSH(arena, *list);
+    if (slot) *slot = symbol_view(value);
+}
+
+static int is_value_token(const RubyToken* token) {
+    return token->type == RUBY_TOKEN_SYMBOL || token->type == RUBY_TOKEN_STRING;
+}
+
+// First top-level symbol or string argument of a statement (`has_one :owner`).
+static int first_value(const RubyStatement* stmt, StrView* value) {
+    RubyTokenizer tokenizer;
+    RubyToken token;
+    ruby_tokenizer_init(&tokenizer, stmt->args);
+    while (ruby_tokenizer_next(&tokenizer, &token)) {
+        if (token.depth == 0 && is_value_token(&token)) {
+            *value = token.text;
+            return 1;
+        }
+        if (token.type == RUBY_TOKEN_LABEL) return 0;
+    }
+    return 0;
+}
+
+// Value of a top-level keyword option (`type: 'string'`, `direction: :desc`).
+static int option_value(const RubyStatement* stmt, const char* label, StrView* value) {
+    RubyTokenizer tokenizer;
+    RubyToken token;
+    size_t label_len = strlen(label);
+    ruby_tokenizer_init(&tokenizer, stmt->args);
+    while (ruby_tokenizer_next(&tokenizer, &token)) {
+        if (token.depth == 0 && token.type == RUBY_TOKEN_LABEL && str_view_eq(token.text, label, label_len)) {
+            if (ruby_tokenizer_next(&tokenizer, &token) && is_value_token(&token)) {
+                *value = token.text;
+                return 1;
+            }
+            return 0;
+        }
+    }
+    return 0;
+}
+
+static const char* option_string(ResourceParser* parser, const RubyStatement* stmt, const char* label) {
+    StrView value;
+    return option_value(stmt, label, &value) ? intern_view(parser->arena, value) : NULL;
+}
+
+static Symbol option_symbol(const RubyStatement* stmt, const char* label) {
+    StrView value;
+    return option_value(stmt, label, &value) ? symbol_view(value) : SYMBOL_NONE;
+}
+
+// Leading constant path of a class or module statement (`Api::V1::UserResource < BaseResource`)
+static StrView constant_path(StrView args) {
+    StrView path = { args.ptr, 0 };
+    while (path.len < args.len) {
+        char c = path.ptr[path.len];
+        if (c != ':' && c != '_' && !(c >= 'a' && c <= 'z') && !(c >= 'A' && c <= 'Z') && !(c >= '0' && c <= '9')) break;
+        path.len++;
+    }
+    return path;
+}
+
+// module Api; remembered as a prefix for the resource class
+static void handle_module(ResourceParser* parser, const RubyStatement* stmt) {
+    StrView name = constant_path(stmt->args);
+    if (parser->resource->declared_name || name.len == 0) return;
+    if (parser->modules_len + name.len + 2 >= sizeof(parser->modules)) return;
+
+    if (parser->modules_len > 0) {
+        memcpy(parser->modules + parser->modules_len, "::", 2);
+        parser->modules_len += 2;
+    }
+    memcpy(parser->modules + parser->modules_len, name.ptr, name.len);
+    parser->modules_len += name.len;
+}
+
+// class Api::V1::UserResource < BaseResource; only the first class counts
+static void handle_class(ResourceParser* parser, const RubyStatement* stmt) {
+    StrView name = constant_path(stmt->args);
+    if (parser->resource->declared_name || name.len == 0 || name.ptr[0] == ':') return;
+
+    char qualified[512];
+    int written = snprintf(qualified, sizeof(qualified), "%.*s%s%.*s", (int)parser->modules_len, parser->modules,
+                           parser->modules_len > 0 ? "::" : "", (int)name.len, name.ptr);
+    if (written > 0 && (size_t)written < sizeof(qualified)) {
+        parser->resource->declared_name = arena_intern(parser->arena, qualified, written);
+    }
+
+    const char* p = name.ptr + name.len;
+    const char* end = stmt->args.ptr + stmt->args.len;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (p == end || *p != '<') return;
+    p++;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    StrView superclass = constant_path((StrView){ p, end - p });
+    if (superclass.len > 0) parser->resource->superclass = intern_view(parser->arena, superclass);
+}
+
+// include Auditable, Api::Sortable; calls such as `include Rails.application...` are skipped
+static void handle_include(ResourceParser* parser, const RubyStatement* stmt) {
+    StrView args = stmt->args;
+    while (args.len > 0) {
+        while (args.len > 0 && (args.ptr[0] == ' ' || args.ptr[0] == '\t' || args.ptr[0] == ',')) {
+            args.ptr++;
+            args.len--;
+        }
+        StrView name = constant_path(args);
+        if (name.len == 0 || !(name.ptr[0] == ':' || (name.ptr[0] >= 'A' && name.ptr[0] <= 'Z'))) return;
+        args.ptr += name.len;
+        args.len -= name.len;
+        if (args.len > 0 && args.ptr[0] != ',' && args.ptr[0] != ' ' && args.ptr[0] != '\t') return;
+        add_string(parser->arena, &parser->resource->includes, name);
+    }
+}
+
+// abstract; a base class for other resources
+static void handle_abstract(ResourceParser* parser, const RubyStatement* stmt) {
+    (void)stmt;
+    parser->resource->abstract = 1;
+}
+
+// model_name 'Customer'
+static void handle_model_name(ResourceParser* parser, const RubyStatement* stmt) {
+    StrView value;
+    if (first_value(stmt, &value)) parser->resource->model_name = intern_view(parser->arena, value);
+}
+
+// create_form 'Customers::CreateForm'
+static void handle_create_form(ResourceParser* parser, const RubyStatement* stmt) {
+    StrView value;
+    if (first_value(stmt, &value)) parser->resource->create_form = intern_view(parser->arena, value);
+}
+
+// paginator :paged
+static void handle_paginator(ResourceParser* parser, const RubyStatement* stmt) {
+    StrView value;
+    if (first_value(stmt, &value)) parser->resource->paginator = intern_view(parser->arena, value);
+}
+
+// default_sort field: 'created_at', direction: :desc
+static void handle_default_sort(ResourceParser* parser, const RubyStatement* stmt) {
+    const char* field = option_string(parser, stmt, "field");
+    if (field) parser->resource->default_sort_field = field;
+
+    StrView direction;
+    if (option_value(stmt, "direction", &direction) &&
+        (STR_VIEW_EQ(direction, "asc") || STR_VIEW_EQ(direction, "desc"))) {
+        parser->resource->default_sort_direction = intern_view(parser->arena, direction);
+    }
+}
+
+// attributes :name, :status
+static void handle_attributes(ResourceParser* parser, const RubyStatement* stmt) {
+    RubyTokenizer tokenizer;
+    RubyToken token;
+    ruby_tokenizer_init(&tokenizer, stmt->args);
+    while (ruby_tokenizer_next(&tokenizer, &token)) {
+        if (token.type == RUBY_TOKEN_LABEL) break; // Trailing options apply to all attributes
+        if (token.depth == 0 && is_value_token(&token)) {
+            add_symbol(parser->arena, &parser->resource->attributes, token.text);
+        }
+    }
+}
+
+// attribute :name, format: :custom
+static void handle_attribute(ResourceParser* parser, const RubyStatement* stmt) {
+    StrView value;
+    if (first_value(stmt, &value)) add_symbol(parser->arena, &parser->resource->attributes, value);
+}
+
+// filter :status, ransack_filter :name, type: 'string', association_uuid_filter :account_id, ...
+static void handle_filter(ResourceParser* parser, const RubyStatement* stmt) {
+    StrView name;
+    if (!first_value(stmt, &name)) return;
+
+    Filter* filter = ARENA_PUSH(parser->arena, parser->resource->filters);
+    if (!filter) return;
+    filter->name = symbol_view(name);
+
+    filter->type = option_symbol(stmt, "type");
+    if (!filter->type && STR_VIEW_EQ(stmt->keyword, "association_uuid_filter")) {
+        filter->type = symbol_intern_cstr("uuid");
+    }
+    filter->collection = option_symbol(stmt, "collection");
+}
+
+// filters :name, :status
+static void handle_filters(ResourceParser* parser, const RubyStatement* stmt) {
+    RubyTokenizer tokenizer;
+    RubyToken token;
+    ruby_tokenizer_init(&tokenizer, stmt->args);
+    while (ruby_tokenizer_next(&tokenizer, &token)) {
+        if (token.type == RUBY_TOKEN_LABEL) break;
+        if (token.depth != 0 || !is_value_token(&token)) continue;
+
+        Filter* filter = ARENA_PUSH(parser->arena, parser->resource->filters);
+        if (!filter) return;
+        filter->name = symbol_view(token.text);
+    }
+}
+
+// has_one :owner, has_many :items, relationship :owner, to: :one
+static void handle_relation(ResourceParser* parser, const RubyStatement* stmt) {
+    StrView name;
+    if (!first_value(stmt, &name)) return;
+
+    Relation* relation = ARENA_PUSH(parser->arena, parser->resource->relations);
+    if (!relation) return;
+    relation->name = symbol_view(name);
+
+    const char* type = "has_one";
+    if (STR_VIEW_EQ(stmt->keyword, "has_many")) {
+        type = "has_many";
+    } else if (STR_VIEW_EQ(stmt->keyword, "relationship")) {
+        StrView to;
+        if (option_value(stmt, "to", &to) && STR_VIEW_EQ(to, "many")) type = "has_many";
+    }
+    relation->type = symbol_intern_cstr(type);
+
+    relation->relation_name = option_symbol(stmt, "relation_name");
+    relation->foreign_key_on = option_symbol(stmt, "foreign_key_on");
+}
+
+// Whether the `[` at `p` indexes the value right before it, as in
+// `context[:admin]`, instead of opening an array literal
+static int indexes_value(StrView text, const char* p) {
+    if (p == text.ptr) return 0;
+    char c = p[-1];
+    return isalnum((unsigned char)c) || c == '_' || c == '?' || c == '!' || c == ')' || c == ']' || c == '}' ||
+           c == '"' || c == '\'';
+}
+
+// Adds the symbols of the array literals in `text` to `fields`, leaving out
+// literals that are subtracted: `super + %i[name status] - [:secret]`.
+// Symbols elsewhere, such as the keys of `context[:current_user]`, are not
+// fields.
+static void collect_fields(ResourceParser* parser, StrView text, SymbolList* fields) {
+    RubyTokenizer tokenizer;
+    RubyToken token;
+    int subtracting = 0;
+    char literals[MAX_FIELD_NESTING]; // Per open bracket: whether it is an array literal
+    ruby_tokenizer_init(&tokenizer, text);
+    while (ruby_tokenizer_next(&tokenizer, &token)) {
+        if (token.type == RUBY_TOKEN_PUNCT) {
+            char c = token.text.ptr[0];
+            if (token.depth == 0 && c == '-') subtracting = 1;
+            else if (token.depth == 0 && c == '+') subtracting = 0;
+            else if ((c == '[' || c == '(' || c == '{') && token.depth < MAX_FIELD_NESTING) {
+                literals[token.depth] = c == '[' && !indexes_value(text, token.text.ptr);
+            }
+            continue;
+        }
+        if (subtracting) continue;
+
+        if (token.type == RUBY_TOKEN_WORD_ARRAY) {
+            StrView words = token.text;
+            StrView word;
+            while (ruby_next_word(&words, &word)) {
+                add_symbol(parser->arena, fields, word);
+            }
+        } else if (token.type == RUBY_TOKEN_SYMBOL && token.depth > 0 && token.depth <= MAX_FIELD_NESTING &&
+                   literals[token.depth - 1]) {
+            add_symbol(parser->arena, fields, token.text);
+        }
+    }
+}
+
+// Collects the fields returned by a method body, up to its closing `end`.
+static void collect_method_fields(ResourceParser* parser, SymbolList* fields) {
+    RubyStatement stmt;
+    int depth = 1;
+    while (ruby_lexer_next(parser->lexer, &stmt)) {
+        depth += stmt.block_delta;
+        if (depth <= 0) break;
+        collect_fields(parser, stmt.text, fields);
+    }
+}
+
+static KeywordPrefilter prefilter;
+
+// Jumps from a `def` that ends its line to the `end` aligned with it, the
+// layout every formatter enforces, so the body is never tokenized. Returns 0
+// when the def is not laid out that way and the body has to be lexed.
+static int skip_aligned_body(ResourceParser* parser, const RubyStatement* stmt) {
+    RubyLexer* lexer = parser->lexer;
+    if (!parser->use_prefilter || lexer->cur >= lexer->end || lexer->cur[0] != '\n') return 0;
+
+    const char* line_start = stmt->text.ptr;
+    while (line_start > lexer->begin && (line_start[-1] == ' ' || line_start[-1] == '\t')) line_start--;
+    if (line_start > lexer->begin && line_start[-1] != '\n') return 0;
+
+    size_t size = lexer->end - lexer->begin;
+    size_t pos = lexer->cur + 1 - lexer->begin;
+    int lines = 1;
+    size_t found = keyword_prefilter_find_line(&prefilter, lexer->begin, size, pos,
+                                               stmt->text.ptr - line_start, "end", &lines);
+    if (found >= size) return 0;
+
+    RubyStatement closing;
+    lexer->cur = lexer->begin + found;
+    lexer->line += lines;
+    ruby_lexer_next(lexer, &closing);
+    return 1;
+}
+
+// def self.creatable_fields / def self.updatable_fields; other method bodies are skipped
+static void handle_def(ResourceParser* parser, const RubyStatement* stmt) {
+    SymbolList* fields = NULL;
+
+    StrView args = stmt->args;
+    if (args.len >= 5 && memcmp(args.ptr, "self.", 5) == 0) {
+        StrView name = { args.ptr + 5, 0 };
+        while (5 + name.len < args.len && (name.ptr[name.len] == '_' || (name.ptr[name.len] >= 'a' && name.ptr[name.len] <= 'z'))) {
+            name.len++;
+        }
+        if (STR_VIEW_EQ(name, "creatable_fields")) fields = &parser->resource->creatable_fields;
+        else if (STR_VIEW_EQ(name, "updatable_fields")) fields = &parser->resource->updatable_fields;
+    }
+
+    if (stmt->block_delta <= 0) {
+        // Endless method: def self.creatable_fields(_context) = %i[name]
+        if (fields) collect_fields(parser, stmt->args, fields);
+        return;
+    }
+
+    if (fields) collect_method_fields(parser, fields);
+    else if (!skip_aligned_body(parser, stmt)) ruby_lexer_skip_block(parser->lexer);
+}
+
+// Sorted by keyword for the binary search in find_handler()
+static const struct {
+    const char* keyword;
+    StatementHandler handler;
+} statement_handlers[] = {
+    { "abstract", handle_abstract },
+    { "association_uuid_filter", handle_filter },
+    { "attribute", handle_attribute },
+    { "attributes", handle_attributes },
+    { "class", handle_class },
+    { "create_form", handle_create_form },
+    { "def", handle_def },
+    { "default_sort", handle_default_sort },
+    { "filter", handle_filter },
+    { "filters", handle_filters },
+    { "has_many", handle_relation },
+    { "has_one", handle_relation },
+    { "include", handle_include },
+    { "model_name", handle_model_name },
+    { "module", handle_module },
+    { "paginator", handle_paginator },
+    { "ransack_filter", handle_filter },
+    { "relationship", handle_relation },
+};
+
+static StatementHandler find_handler(StrView keyword) {
+    if (keyword.len == 0) return NULL;
+
+    size_t low = 0;
+    size_t high = sizeof(statement_handlers) / sizeof(statement_handlers[0]);
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        const char* candidate = statement_handlers[mid].keyword;
+        int cmp = strncmp(candidate, keyword.ptr, keyword.len);
+        if (cmp == 0) cmp = candidate[keyword.len] == '\0' ? 0 : 1;
+        if (cmp == 0) return statement_handlers[mid].handler;
+        if (cmp < 0) low = mid + 1;
+        else high = mid;
+    }
+
+    // Custom filter macros such as boolean_filter or date_range_filter
+    if (keyword.len > 7 && memcmp(keyword.ptr + keyword.len - 7, "_filter", 7) == 0) {
+        return handle_filter;
+    }
+    return NULL;
+}
+
+static void set_source_names(const char* filename, ResourceInfo* resource, Arena* arena) {
+    // Extract class name from filename, without the .rb extension
+    const char* basename = strrchr(filename, '/');
+    if (basename) basename++;
+    else basename = filename;
+
+    const char* ext = strstr(basename, ".rb");
+    resource->class_name = arena_intern(arena, basename, ext ? (size_t)(ext - basename) : strlen(basename));
+    resource->source_path = arena_intern_cstr(arena, filename);
+}
+
+static pthread_once_t prefilter_once = PTHREAD_ONCE_INIT;
+
+static void init_prefilter(void) {
+    const char* keywords[sizeof(statement_handlers) / sizeof(statement_handlers[0]) + 2];
+    size_t count = 0;
+    for (size_t i = 0; i < sizeof(statement_handlers) / sizeof(statement_handlers[0]); i++) {
+        keywords[count++] = statement_handlers[i].keyword;
+    }
+    // The lexer must still see =begin comment blocks and __END__
+    keywords[count++] = "=begin";
+    keywords[count++] = "__END__";
+
+    static const char* const infixes[] = { "_filter", "<<~", "<<-" };
+    keyword_prefilter_init(&prefilter, keywords, count, infixes, sizeof(infixes) / sizeof(infixes[0]));
+}
+
+int parse_resource_source(const char* filename, const char* data, size_t size,
+                          ResourceInfo* resource, Arena* arena) {
+    set_source_names(filename, resource, arena);
+
+    int use_prefilter = keyword_prefilter_mode() != KEYWORD_PREFILTER_OFF;
+    if (use_prefilter) pthread_once(&prefilter_once, init_prefilter);
+
+    RubyLexer lexer;
+    ruby_lexer_init(&lexer, data, size);
+    ResourceParser parser = { resource, arena, &lexer, use_prefilter, { 0 }, 0 };
+
+    RubyStatement stmt;
+    for (;;) {
+        // Jump over lines that cannot start a DSL statement. Only at line
+        // boundaries, so `a; b` keeps its second statement.
+        if (use_prefilter && (lexer.cur == lexer.begin || lexer.cur[-1] == '\n' ||
+                              (lexer.cur < lexer.end && lexer.cur[0] == '\n'))) {
+            size_t pos = lexer.cur - data;
+            if (pos < size && data[pos] == '\n') {
+                pos++;
+                lexer.line++;
+            }
+            lexer.cur = data + keyword_prefilter_next(&prefilter, data, size, pos, &lexer.line);
+        }
+
+        if (!ruby_lexer_next(&lexer, &stmt)) break;
+
+        StatementHandler handler = find_handler(stmt.keyword);
+        if (handler) handler(&parser, &stmt);
+    }
+
+    // The line counter stands one past a trailing newline
+    int at_end = lexer.cur == lexer.end && size > 0 && data[size - 1] == '\n';
+    return lexer.line - at_end;
+}
+
+int parse_resource_file(const char* filename, ResourceInfo* resource, Arena* arena, ParseCounts* counts) {
+    SourceFile source;
+    if (source_file_open(&source, filename) != 0) {
+        int error = errno;
+        char reason[128];
+        set_source_names(filename, resource, arena);
+        report_diagnostic(DIAGNOSTIC_ERROR, DIAGNOSTIC_CANNOT_READ, filename, "Cannot open file %s: %s", filename,
+                          diagnostic_strerror(error, reason, sizeof(reason)));
+        return -1;
+    }
+
+    int lines = parse_resource_source(filename, source.data, source.size, resource, arena);
+    if (counts) {
+        counts->bytes = source.size;
+        counts->lines = lines;
+    }
+    source_file_close(&source);
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef RESOURCE_PARSER_H
+#define RESOURCE_PARSER_H
+
+#include <stddef.h>
+
+#include "api_spec.h"
+
+// How much source one parse went through, for --stats
+typedef struct {
+    size_t bytes;
+    int lines;
+} ParseCounts;
+
+// Parses one *_resource.rb file into `resource`, allocating from `arena`.
+// `counts` may be NULL. Returns 0 on success, -1 if the file could not be read.
+int parse_resource_file(const char* filename, ResourceInfo* resource, Arena* arena, ParseCounts* counts);
+
+// Same as parse_resource_file for source text that is already in memory.
+// `filename` only determines the class name. Returns the number of lines
+// scanned, which is short of the whole text after `__END__`.
+int parse_resource_source(const char* filename, const char* data, size_t size,
+                          ResourceInfo* resource, Arena* arena);
+
+#endif
@@ -0,0 +1,245 @@
+#include "resource_scan.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "file_ingest.h"
+#include "resource_filter.h"
+#include "resource_parser.h"
+#include "work_pool.h"
+
+#define MAX_PATH_LENGTH 512
+#define MAX_SCAN_DEPTH 32
+#define MIN_INGEST_WINDOW 64 // Files read ahead of the parsers, at least
+#define INGEST_WINDOW_PER_JOB 16
+
+void path_list_add(PathList* list, const char* path) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        char** paths = realloc(list->paths, capacity * sizeof(char*));
+        if (!paths) return;
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    char* copy = strdup(path);
+    if (copy) list->paths[list->count++] = copy;
+}
+
+void path_list_free(PathList* list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->paths[i]);
+    }
+    free(list->paths);
+    memset(list, 0, sizeof(PathList));
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static int has_suffix(const char* str, const char* suffix) {
+    size_t str_len = strlen(str);
+    size_t suffix_len = strlen(suffix);
+    return str_len >= suffix_len && strcmp(str + str_len - suffix_len, suffix) == 0;
+}
+
+int is_resource_path(const char* path) {
+    return has_suffix(path, "_resource.rb");
+}
+
+static void collect_below(const char* directory, PathList* list, int depth) {
+    if (depth > MAX_SCAN_DEPTH) {
+        printf("Warning: Skipping %s, nested deeper than %d levels\n", directory, MAX_SCAN_DEPTH);
+        return;
+    }
+
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        printf("Error: Cannot open directory %s\n", directory);
+        return;
+    }
+
+    size_t dir_len = strlen(directory);
+    const char* separator = (dir_len > 0 && directory[dir_len - 1] == '/') ? "" : "/";
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        char filepath[MAX_PATH_LENGTH];
+        int written = snprintf(filepath, sizeof(filepath), "%s%s%s", directory, separator, entry->d_name);
+        if (written < 0 || written >= (int)sizeof(filepath)) {
+            printf("Warning: Path too long, skipping %s%s%s\n", directory, separator, entry->d_name);
+            continue;
+        }
+
+        int is_dir = 0;
+        int is_file = 0;
+        if (entry->d_type == DT_DIR) {
+            is_dir = 1;
+        } else if (entry->d_type == DT_REG) {
+            is_file = 1;
+        } else if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            if (lstat(filepath, &st) == 0 && S_ISDIR(st.st_mode)) {
+                is_dir = 1;
+            } else if (stat(filepath, &st) == 0 && S_ISREG(st.st_mode)) {
+                is_file = 1;
+            }
+        }
+
+        if (is_dir) {
+            collect_below(filepath, list, depth + 1);
+        } else if (is_file && is_resource_path(entry->d_name)) {
+            path_list_add(list, filepath);
+        }
+    }
+
+    closedir(dir);
+}
+
+typedef struct {
+    char** paths;
+    ResourceInfo* slots;
+    Arena* arenas; // One per worker
+    const ParseCache* cache;
+    CacheStamp* stamps;
+    FileParseStats* file_stats;
+    FileIngest* ingest; // Reads the files ahead of the parsers; NULL when they read their own
+} ScanJob;
+
+static long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void record_stats(ScanJob* job, size_t index, long long start, const ParseCounts* counts) {
+    if (!job->file_stats) return;
+    FileParseStats* stats = &job->file_stats[index];
+    stats->path = job->slots[index].source_path;
+    stats->wall_ns = monotonic_ns() - start;
+    stats->bytes = counts->bytes;
+    stats->lines = counts->lines;
+}
+
+static void parse_resource_task(void* ctx, size_t index, int worker_id) {
+    ScanJob* job = ctx;
+    ParseCounts counts = { 0, 0 };
+    long long start = job->file_stats ? monotonic_ns() : 0;
+
+    if (job->cache) {
+        parse_cache_resource(job->cache, job->paths[index], &job->slots[index], &job->arenas[worker_id],
+                             &job->stamps[index], &counts);
+    } else {
+        parse_resource_file(job->paths[index], &job->slots[index], &job->arenas[worker_id], &counts);
+    }
+    record_stats(job, index, start, &counts);
+}
+
+// One parser of the pipeline: takes files as their reads complete until all
+// are parsed. Per-file times cover the parse, not the wait for the disk.
+static void parse_ingested_task(void* ctx, size_t index, int worker_id) {
+    (void)index;
+    ScanJob* job = ctx;
+    IngestedFile file;
+    while (file_ingest_next(job->ingest, &file) == 0) {
+        const char* path = job->paths[file.index];
+        ResourceInfo* resource = &job->slots[file.index];
+        Arena* arena = &job->arenas[worker_id];
+        ParseCounts counts = { 0, 0 };
+        long long start = job->file_stats ? monotonic_ns() : 0;
+
+        if (file.error) {
+            // Reports the error and leaves the resource with just its class name
+            parse_resource_file(path, resource, arena, NULL);
+            if (job->stamps) job->stamps[file.index].result = PARSE_CACHE_UNREADABLE;
+        } else if (job->cache) {
+            CacheStamp* stamp = &job->stamps[file.index];
+            stamp->mtime_sec = file.mtime_sec;
+            stamp->mtime_nsec = file.mtime_nsec;
+            parse_cache_resource_source(job->cache, path, file.data, file.size, resource, arena, stamp, &counts);
+        } else {
+            counts.lines = parse_resource_source(path, file.data, file.size, resource, arena);
+            counts.bytes = file.size;
+        }
+        file_ingest_release(job->ingest, &file);
+        record_stats(job, file.index, start, &counts);
+    }
+}
+
+void collect_resource_files(const char* directory, PathList* list) {
+    collect_below(directory, list, 0);
+    qsort(list->paths, list->count, sizeof(char*), compare_paths);
+}
+
+CacheStamp* parse_resource_files(const PathList* files, ApiSpec* spec, int jobs, const ParseCache* cache,
+                                 FileParseStats* file_stats) {
+    // Every file gets its own slot, so workers never share a ResourceInfo
+    ResourceInfo* slots = api_spec_add_resources(spec, files->count);
+    Arena* arenas = calloc(jobs, sizeof(Arena));
+    CacheStamp* stamps = cache ? calloc(files->count ? files->count : 1, sizeof(CacheStamp)) : NULL;
+    if ((files->count > 0 && !slots) || !arenas || (cache && !stamps)) {
+        printf("Error: Out of memory while parsing %d resource files\n", files->count);
+        free(arenas);
+        free(stamps);
+        return NULL;
+    }
+
+    ScanJob job = { files->paths, slots, arenas, cache, stamps, file_stats, NULL };
+    // A cache that knows the files only needs their metadata, so they are
+    // read ahead only when it is missing or empty (a fresh checkout)
+    if (files->count > 1 && (!cache || cache->entry_count == 0)) {
+        int window = jobs * INGEST_WINDOW_PER_JOB;
+        if (window < MIN_INGEST_WINDOW) window = MIN_INGEST_WINDOW;
+        job.ingest = file_ingest_start(files->paths, files->count, window);
+    }
+    if (job.ingest) {
+        // Each worker runs one parser loop
+        work_pool_run(jobs, jobs, parse_ingested_task, &job);
+        file_ingest_finish(job.ingest);
+    } else {
+        work_pool_run(jobs, files->count, parse_resource_task, &job);
+    }
+
+    // Worker arenas are folded into the spec so one reset frees everything
+    for (int i = 0; i < jobs; i++) {
+        arena_adopt(&spec->arena, &arenas[i]);
+    }
+    free(arenas);
+    return stamps;
+}
+
+void select_resource_files(const char* directory, const ApiSpec* spec, const ResourceFilter* filter, PathList* list) {
+    collect_resource_files(directory, list);
+    if (!filter || !resource_filter_active(filter)) return;
+    int found = list->count;
+    if (resource_filter_apply(filter, directory, spec, list) < 0) {
+        printf("Error: Out of memory while selecting resource files\n");
+    }
+    printf("Selected %d of %d resource files\n", list->count, found);
+}
+
+CacheStamp* scan_resource_files(const char* directory, ApiSpec* spec, int jobs, const ParseCache* cache,
+                                const ResourceFilter* filter, RunStats* stats) {
+    PathList files = { 0 };
+    run_stats_begin(stats, STATS_SCAN);
+    select_resource_files(directory, spec, filter, &files);
+    run_stats_end(stats, STATS_SCAN);
+
+    int first = spec->resources.count;
+    FileParseStats* file_stats = run_stats_files(stats, files.count);
+    run_stats_begin(stats, STATS_PARSE_RESOURCES);
+    CacheStamp* stamps = parse_resource_files(&files, spec, jobs, cache, file_stats);
+    run_stats_end(stats, STATS_PARSE_RESOURCES);
+    for (int i = first; i < spec->resources.count; i++) {
+        printf("Parsed resource: %s\n", spec->resources.items[i].class_name);
+    }
+
+    path_list_free(&files);
+    return stamps;
+}
@@ -0,0 +1,49 @@
+#ifndef RESOURCE_SCAN_H
+#define RESOURCE_SCAN_H
+
+#include "api_spec.h"
+#include "parse_cache.h"
+#include "run_stats.h"
+
+typedef struct {
+    char** paths;
+    int count;
+    int capacity;
+} PathList;
+
+void path_list_add(PathList* list, const char* path);
+void path_list_free(PathList* list);
+
+// Whether `path` names a resource file (*_resource.rb).
+int is_resource_path(const char* path);
+
+// Recursively collects *_resource.rb files below `directory` into `list`,
+// sorted by path so every run sees them in the same order. Symlinked
+// directories are not followed so a link cycle cannot trap the walk.
+void collect_resource_files(const char* directory, PathList* list);
+
+// Parses `files` on `jobs` threads into new resources appended to `spec`, in
+// list order, restoring unchanged files from `cache` when it is given.
+// Without a cache, or with an empty one, the files are read ahead of the
+// parsers through file_ingest (see file_ingest_set_mode()).
+// `file_stats` (may be NULL) must hold one entry per file.
+// Returns the cache stamps of the new resources (caller frees), or NULL
+// without a cache.
+CacheStamp* parse_resource_files(const PathList* files, ApiSpec* spec, int jobs, const ParseCache* cache,
+                                 FileParseStats* file_stats);
+
+struct ResourceFilter;
+
+// collect_resource_files() keeping only what `filter` (may be NULL)
+// selects, reporting how many that is; with a path prefix the routes must
+// be in `spec` already.
+void select_resource_files(const char* directory, const ApiSpec* spec, const struct ResourceFilter* filter,
+                           PathList* list);
+
+// select_resource_files() followed by parse_resource_files(), printing the
+// name of every parsed resource. Both phases are timed into `stats` (may be
+// NULL).
+CacheStamp* scan_resource_files(const char* directory, ApiSpec* spec, int jobs, const ParseCache* cache,
+                                const struct ResourceFilter* filter, RunStats* stats);
+
+#endif
@@ -0,0 +1,340 @@
+#include "route_index.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diagnostics.h"
+
+#define MAX_KEY_LENGTH 512
+
+typedef struct {
+    const char* key;
+    int first; // First route declaring the key
+    int last;
+    int count; // Distinct routes declaring the key
+} IndexSlot;
+
+struct RouteIndex {
+    IndexSlot* slots;
+    size_t capacity;
+    Arena arena;
+    const RouteList* routes;
+};
+
+static int is_lower_or_digit(char c) {
+    return islower((unsigned char)c) || isdigit((unsigned char)c);
+}
+
+// Appends `len` bytes of `name` as snake_case: "Api::V1::UserAccount" -> "api/v1/user_account"
+static void append_snake(char* out, size_t* pos, const char* name, size_t len) {
+    for (size_t i = 0; i < len && *pos + 2 < MAX_KEY_LENGTH; i++) {
+        char c = name[i];
+        if (c == ':' && i + 1 < len && name[i + 1] == ':') {
+            out[(*pos)++] = '/';
+            i++;
+            continue;
+        }
+        if (c == '-') c = '_';
+        if (isupper((unsigned char)c)) {
+            // Word boundary before "Account" in "UserAccount" and before "Request" in "HTTPRequest"
+            int boundary = i > 0 && (is_lower_or_digit(name[i - 1]) ||
+                                     (isupper((unsigned char)name[i - 1]) && i + 1 < len && islower((unsigned char)name[i + 1])));
+            if (boundary && *pos > 0 && out[*pos - 1] != '/' && out[*pos - 1] != '_') out[(*pos)++] = '_';
+            c = (char)tolower((unsigned char)c);
+        }
+        out[(*pos)++] = c;
+    }
+    out[*pos] = '\0';
+}
+
+static int ends_with(const char* word, size_t len, const char* suffix) {
+    size_t suffix_len = strlen(suffix);
+    return len >= suffix_len && memcmp(word + len - suffix_len, suffix, suffix_len) == 0;
+}
+
+// Singularizes the last word of the snake_case key in out[start..*pos)
+static void singularize(char* out, size_t start, size_t* pos) {
+    static const struct {
+        const char* plural;
+        const char* singular;
+    } irregular[] = {
+        { "people", "person" }, { "children", "child" }, { "men", "man" }, { "women", "woman" },
+        { "mice", "mouse" }, { "geese", "goose" }, { "feet", "foot" }, { "teeth", "tooth" },
+    };
+
+    char* word = out + start;
+    size_t len = *pos - start;
+    for (size_t i = len; i > 0; i--) {
+        if (word[i - 1] == '_' || word[i - 1] == '/') {
+            word += i;
+            len -= i;
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(irregular) / sizeof(irregular[0]); i++) {
+        if (strlen(irregular[i].plural) == len && memcmp(word, irregular[i].plural, len) == 0) {
+            size_t singular_len = strlen(irregular[i].singular);
+            memcpy(word, irregular[i].singular, singular_len + 1);
+            *pos = (word - out) + singular_len;
+            return;
+        }
+    }
+
+    if (len <= 2 || ends_with(word, len, "ss") || ends_with(word, len, "us") || ends_with(word, len, "is") ||
+        ends_with(word, len, "news")) {
+        return;
+    }
+    if (ends_with(word, len, "ies") && len > 3) {
+        len -= 2;
+        word[len - 1] = 'y';
+    } else if (ends_with(word, len, "sses") || ends_with(word, len, "shes") || ends_with(word, len, "ches") ||
+               ends_with(word, len, "xes") || ends_with(word, len, "zes")) {
+        len -= 2;
+    } else if (word[len - 1] == 's') {
+        len -= 1;
+    }
+    word[len] = '\0';
+    *pos = (word - out) + len;
+}
+
+// "<namespace>/<singular name>"; `namespace_path` may be NULL
+static void make_key(char* out, const char* namespace_path, const char* name, size_t len) {
+    size_t pos = 0;
+    out[0] = '\0';
+    if (has_text(namespace_path)) {
+        append_snake(out, &pos, namespace_path, strlen(namespace_path));
+        if (pos + 1 < MAX_KEY_LENGTH) out[pos++] = '/';
+        out[pos] = '\0';
+    }
+    size_t start = pos;
+    append_snake(out, &pos, name, len);
+    singularize(out, start, &pos);
+}
+
+void route_singular_name(const char* name, size_t len, char* out, size_t size) {
+    char key[MAX_KEY_LENGTH];
+    size_t pos = 0;
+    key[0] = '\0';
+    append_snake(key, &pos, name, len);
+    singularize(key, 0, &pos);
+    snprintf(out, size, "%s", key);
+}
+
+static uint64_t hash_key(const char* key) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const char* p = key; *p; p++) hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    return hash;
+}
+
+static IndexSlot* find_slot(const RouteIndex* index, const char* key) {
+    size_t mask = index->capacity - 1;
+    for (size_t i = hash_key(key) & mask;; i = (i + 1) & mask) {
+        IndexSlot* slot = &index->slots[i];
+        if (!slot->key || strcmp(slot->key, key) == 0) return slot;
+    }
+}
+
+static void index_route(RouteIndex* index, const char* key, int route) {
+    IndexSlot* slot = find_slot(index, key);
+    if (!slot->key) {
+        slot->key = arena_intern_cstr(&index->arena, key);
+        if (!slot->key) return;
+        slot->first = route;
+        slot->count = 1;
+    } else if (slot->last != route) {
+        slot->count++;
+    }
+    slot->last = route;
+}
+
+static const IndexSlot* lookup(const RouteIndex* index, const char* namespace_path, const char* name, size_t len) {
+    if (len == 0) return NULL;
+    char key[MAX_KEY_LENGTH];
+    make_key(key, namespace_path, name, len);
+    const IndexSlot* slot = find_slot(index, key);
+    return slot->key ? slot : NULL;
+}
+
+static int build_index(RouteIndex* index, const ApiSpec* spec) {
+    arena_init(&index->arena);
+    index->routes = &spec->routes;
+    index->capacity = 16;
+    size_t keys = 0;
+    for (int i = 0; i < spec->routes.count; i++) {
+        const char* namespace_path = spec->routes.items[i].namespace_path;
+        keys++;
+        for (const char* p = namespace_path; p && *p; p = strchr(p + 1, '/')) keys++;
+    }
+    // One key per namespace suffix, at a load factor below one half
+    while (index->capacity < keys * 2) index->capacity *= 2;
+    index->slots = calloc(index->capacity, sizeof(IndexSlot));
+    if (!index->slots) return -1;
+
+    char key[MAX_KEY_LENGTH];
+    for (int i = 0; i < spec->routes.count; i++) {
+        const RouteInfo* route = &spec->routes.items[i];
+        // One entry per declaration: the rest of its routes follow the first
+        if (route->group != i || !has_text(route->resource_name)) continue;
+        size_t len = strlen(route->resource_name);
+
+        // "api/v1/user", "v1/user" and "user", so resources declared under
+        // a longer or shorter module path still meet their route
+        const char* namespace_path = route->namespace_path;
+        for (;;) {
+            make_key(key, namespace_path, route->resource_name, len);
+            index_route(index, key, i);
+            if (!has_text(namespace_path)) break;
+            namespace_path = strchr(namespace_path, '/');
+            if (namespace_path) namespace_path++;
+        }
+    }
+    return 0;
+}
+
+static void free_index(RouteIndex* index) {
+    free(index->slots);
+    arena_reset(&index->arena);
+}
+
+// Splits "Api::V1::UserResource" into namespace "Api::V1" and "User"
+static void resource_names(const ResourceInfo* resource, char* namespace_path, size_t size,
+                           const char** name, size_t* name_len) {
+    namespace_path[0] = '\0';
+    const char* declared = resource->declared_name;
+    const char* base = has_text(declared) ? declared : resource->class_name;
+    if (!base) base = "";
+
+    if (has_text(declared)) {
+        const char* separator = NULL;
+        for (const char* p = declared; (p = strstr(p, "::")); p += 2) separator = p;
+        if (separator) {
+            size_t len = separator - declared;
+            if (len >= size) len = size - 1;
+            memcpy(namespace_path, declared, len);
+            namespace_path[len] = '\0';
+            base = separator + 2;
+        }
+    }
+
+    *name = base;
+    *name_len = strlen(base);
+    if (ends_with(base, *name_len, "Resource")) *name_len -= 8;
+    else if (ends_with(base, *name_len, "_resource")) *name_len -= 9;
+}
+
+// Last segment of "Billing::Invoice"
+static const char* model_base(const char* model_name) {
+    if (!has_text(model_name)) return "";
+    const char* base = model_name;
+    for (const char* p = model_name; (p = strstr(p, "::")); p += 2) base = p + 2;
+    return base;
+}
+
+RouteIndex* route_index_open(const ApiSpec* spec) {
+    RouteIndex* index = calloc(1, sizeof(RouteIndex));
+    if (index && build_index(index, spec) != 0) {
+        route_index_close(index);
+        return NULL;
+    }
+    return index;
+}
+
+void route_index_close(RouteIndex* index) {
+    if (!index) return;
+    free_index(index);
+    free(index);
+}
+
+int route_match_class_names(const ApiSpec* spec, const char* const* class_names, int count, int* routes) {
+    RouteIndex* index = route_index_open(spec);
+    if (!index) return -1;
+
+    for (int i = 0; i < count; i++) {
+        ResourceInfo probe;
+        memset(&probe, 0, sizeof(probe));
+        probe.declared_name = class_names[i];
+        char namespace_path[MAX_KEY_LENGTH];
+        const char* name;
+        size_t name_len;
+        resource_names(&probe, namespace_path, sizeof(namespace_path), &name, &name_len);
+
+        const IndexSlot* slot = NULL;
+        const char* suffix = namespace_path;
+        while (!slot) {
+            slot = lookup(index, suffix, name, name_len);
+            if (!suffix[0]) break;
+            suffix = strstr(suffix, "::");
+            suffix = suffix ? suffix + 2 : "";
+        }
+        routes[i] = slot ? slot->first : -1;
+    }
+
+    route_index_close(index);
+    return 0;
+}
+
+void route_index_match(const RouteIndex* index, ResourceList* resources, RouteMatchSummary* summary) {
+    const RouteList* routes = index->routes;
+    for (int i = 0; i < resources->count; i++) {
+        ResourceInfo* resource = &resources->items[i];
+        if (resource->abstract) {
+            resource->route = NULL;
+            resource->route_count = 0;
+            continue;
+        }
+        char namespace_path[MAX_KEY_LENGTH];
+        const char* name;
+        size_t name_len;
+        resource_names(resource, namespace_path, sizeof(namespace_path), &name, &name_len);
+        const char* model = model_base(resource->model_name);
+
+        // Most specific namespace first: "api/v1/user", then "v1/user", then "user"
+        const IndexSlot* slot = NULL;
+        const char* suffix = namespace_path;
+        while (!slot) {
+            slot = lookup(index, suffix, name, name_len);
+            if (!slot) slot = lookup(index, suffix, model, strlen(model));
+            if (!suffix[0]) break;
+            suffix = strstr(suffix, "::");
+            suffix = suffix ? suffix + 2 : "";
+        }
+
+        if (!slot) {
+            resource->route = NULL;
+            resource->route_count = 0;
+            summary->unmatched++;
+            report_diagnostic(DIAGNOSTIC_WARNING, DIAGNOSTIC_UNMATCHED, resource->source_path, "No route matches resource %s",
+                              resource->class_name);
+            continue;
+        }
+
+        resource->route = &routes->items[slot->first];
+        resource->route_count = 1;
+        while (slot->first + resource->route_count < routes->count &&
+               resource->route[resource->route_count].group == slot->first) {
+            resource->route_count++;
+        }
+        summary->matched++;
+        if (slot->count > 1) {
+            summary->ambiguous++;
+            report_diagnostic(DIAGNOSTIC_WARNING, DIAGNOSTIC_AMBIGUOUS, resource->source_path,
+                              "Resource %s matches %d routes (key '%s'), using %s", resource->class_name, slot->count,
+                              slot->key, resource->route->path);
+        }
+    }
+}
+
+void match_resource_routes(ApiSpec* spec, RouteMatchSummary* summary) {
+    memset(summary, 0, sizeof(RouteMatchSummary));
+    RouteIndex* index = route_index_open(spec);
+    if (!index) {
+        report_diagnostic(DIAGNOSTIC_ERROR, DIAGNOSTIC_OUT_OF_MEMORY, NULL, "Out of memory while indexing routes");
+        return;
+    }
+    route_index_match(index, &spec->resources, summary);
+    route_index_close(index);
+}
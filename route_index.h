@@ -0,0 +1,48 @@
+#ifndef ROUTE_INDEX_H
+#define ROUTE_INDEX_H
+
+#include "api_spec.h"
+
+typedef struct {
+    int matched;
+    int unmatched;
+    int ambiguous; // Matched, but the name was shared by several routes
+} RouteMatchSummary;
+
+// Links every resource to the routes that serve it: ResourceInfo.route is the
+// first of the route_count routes drawn by one `resources` declaration.
+// Route and resource names are normalized to singular snake_case keys
+// ("UserAccounts" and "user_account" both become "user_account") and the
+// routes are indexed in a hash table under every suffix of their namespace
+// ("api/v1/user_account", "v1/user_account", "user_account"). Each resource
+// is looked up by its class name, then its model name, with the longest
+// namespace suffix of its declared class first. Ties go to the
+// declaration that comes first. Unmatched and ambiguous resources are reported;
+// abstract resources are left out.
+void match_resource_routes(ApiSpec* spec, RouteMatchSummary* summary);
+
+// For each of `count` declared class names ("Api::V1::UserResource"), the
+// first route of the declaration match_resource_routes() would link it to
+// going by the class name alone, or -1 when none matches. Before a file is
+// parsed its model name is unknown, so a resource that would be matched
+// through its model name at a closer namespace can get a different answer
+// here. Returns -1 when out of memory.
+int route_match_class_names(const ApiSpec* spec, const char* const* class_names, int count, int* routes);
+
+// The index match_resource_routes() builds over the routes of a spec, kept
+// to match resources arriving in several batches. The spec's routes must
+// stay in place while it is open.
+typedef struct RouteIndex RouteIndex;
+
+// Returns NULL when out of memory.
+RouteIndex* route_index_open(const ApiSpec* spec);
+void route_index_close(RouteIndex* index);
+
+// match_resource_routes() for `resources`, which may belong to another spec
+// than the routes, adding to `summary`.
+void route_index_match(const RouteIndex* index, ResourceList* resources, RouteMatchSummary* summary);
+
+// Singular snake_case form of a route name: "user_accounts" -> "user_account".
+void route_singular_name(const char* name, size_t len, char* out, size_t size);
+
+#endif
@@ -0,0 +1,635 @@
+#include "routes_parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diagnostics.h"
+#include "route_index.h"
+#include "ruby_lexer.h"
+#include "source_file.h"
+
+#define MAX_ROUTE_DEPTH 32
+#define MAX_ROUTE_PATH 512
+#define MAX_ROUTE_VALUES 16
+
+// Routes JSONAPI::Resources draws for one relationship: the links below
+// `relationships/<name>` and the related resource at `<name>`
+static const JsonapiLinkRoute to_one_routes[] = {
+    { "GET", "show_relationship", 0 },
+    { "PUT", "update_relationship", 0 },
+    { "PATCH", "update_relationship", 0 },
+    { "DELETE", "destroy_relationship", 0 },
+    { "GET", "get_related_resource", 1 },
+};
+
+static const JsonapiLinkRoute to_many_routes[] = {
+    { "GET", "show_relationship", 0 },
+    { "POST", "create_relationship", 0 },
+    { "PUT", "update_relationship", 0 },
+    { "PATCH", "update_relationship", 0 },
+    { "DELETE", "destroy_relationship", 0 },
+    { "GET", "get_related_resources", 1 },
+};
+
+int jsonapi_link_routes(int to_many, const JsonapiLinkRoute** routes) {
+    *routes = to_many ? to_many_routes : to_one_routes;
+    return to_many ? (int)(sizeof(to_many_routes) / sizeof(to_many_routes[0]))
+                   : (int)(sizeof(to_one_routes) / sizeof(to_one_routes[0]));
+}
+
+typedef enum {
+    FRAME_TRANSPARENT, // draw, constraints, defaults, if ...: children see the enclosing scope
+    FRAME_IGNORED,     // concern definitions and methods: nothing inside is drawn here
+    FRAME_SCOPE,       // namespace, scope
+    FRAME_RESOURCES,   // resources/resource blocks; nested declarations go below the member
+    FRAME_MEMBER,
+    FRAME_COLLECTION
+} FrameKind;
+
+// What a block contributes to the declarations inside it. Strings are
+// interned in the spec arena.
+typedef struct {
+    FrameKind kind;
+    const char* path;   // URL prefix for nested declarations, "" at the top
+    const char* module; // Controller namespace, "api/v1"; "" at the top
+    // Innermost resource, for member/collection routes and links
+    int group;          // -1 outside of a resource
+    const char* resource_name;
+    const char* controller;
+    const char* member_path;
+    const char* collection_path;
+} RouteFrame;
+
+typedef struct {
+    ApiSpec* spec;
+    Arena* arena;
+    RouteFrame frames[MAX_ROUTE_DEPTH];
+    int depth;
+    int skipped; // Blocks opened past MAX_ROUTE_DEPTH
+    int* groups; // Declaration-order group of every route drawn, parallel to spec->routes from `first`
+    int groups_capacity;
+    int first;
+    int group_count;
+} RoutesParser;
+
+// Arguments of one routing call: positional symbols and strings plus the
+// options the expander understands
+typedef struct {
+    StrView names[MAX_ROUTE_VALUES];
+    int name_count;
+    StrView only[MAX_ROUTE_VALUES];
+    int only_count;
+    int has_only;
+    StrView except[MAX_ROUTE_VALUES];
+    int except_count;
+    StrView via[MAX_ROUTE_VALUES];
+    int via_count;
+    StrView to;
+    StrView path;
+    StrView module;
+    StrView controller;
+    StrView param;
+    StrView on;
+    int has_path;
+} RouteArgs;
+
+static int is_value_token(const RubyToken* token) {
+    return token->type == RUBY_TOKEN_SYMBOL || token->type == RUBY_TOKEN_STRING;
+}
+
+// Reads the value after an option label: a symbol or string, a %i[] list or
+// a [...] array of them. Returns the number of values stored.
+static int read_option_values(RubyTokenizer* tokenizer, int depth, StrView* values, int capacity) {
+    RubyToken token;
+    if (!ruby_tokenizer_next(tokenizer, &token)) return 0;
+    if (is_value_token(&token)) {
+        values[0] = token.text;
+        return 1;
+    }
+
+    int count = 0;
+    if (token.type == RUBY_TOKEN_WORD_ARRAY) {
+        StrView words = token.text;
+        StrView word;
+        while (count < capacity && ruby_next_word(&words, &word)) values[count++] = word;
+        return count;
+    }
+    if (token.type == RUBY_TOKEN_PUNCT && token.text.ptr[0] == '[') {
+        while (ruby_tokenizer_next(tokenizer, &token) && token.depth > depth) {
+            if (is_value_token(&token) && count < capacity) values[count++] = token.text;
+        }
+    }
+    return count;
+}
+
+static void parse_route_args(StrView text, RouteArgs* args) {
+    memset(args, 0, sizeof(RouteArgs));
+    RubyTokenizer tokenizer;
+    RubyToken token;
+    ruby_tokenizer_init(&tokenizer, text);
+
+    // `namespace(:api) do` keeps its arguments one level down
+    int depth = 0;
+    RubyTokenizer peek = tokenizer;
+    if (ruby_tokenizer_next(&peek, &token) && token.type == RUBY_TOKEN_PUNCT && token.text.ptr[0] == '(') {
+        tokenizer = peek;
+        depth = 1;
+    }
+
+    while (ruby_tokenizer_next(&tokenizer, &token)) {
+        if (token.depth != depth) continue;
+        if (is_value_token(&token)) {
+            // 'status' => 'status#show'
+            if (token.type == RUBY_TOKEN_STRING && memchr(token.text.ptr, '#', token.text.len)) {
+                args->to = token.text;
+            } else if (args->name_count < MAX_ROUTE_VALUES) {
+                args->names[args->name_count++] = token.text;
+            }
+            continue;
+        }
+        if (token.type != RUBY_TOKEN_LABEL) continue;
+
+        StrView label = token.text;
+        StrView value[MAX_ROUTE_VALUES];
+        int count = read_option_values(&tokenizer, depth, value, MAX_ROUTE_VALUES);
+        if (STR_VIEW_EQ(label, "only")) {
+            memcpy(args->only, value, count * sizeof(StrView));
+            args->only_count = count;
+            args->has_only = 1;
+        } else if (STR_VIEW_EQ(label, "except")) {
+            memcpy(args->except, value, count * sizeof(StrView));
+            args->except_count = count;
+        } else if (STR_VIEW_EQ(label, "via")) {
+            memcpy(args->via, value, count * sizeof(StrView));
+            args->via_count = count;
+        } else if (count > 0) {
+            if (STR_VIEW_EQ(label, "to")) args->to = value[0];
+            else if (STR_VIEW_EQ(label, "path")) {
+                args->path = value[0];
+                args->has_path = 1;
+            }
+            else if (STR_VIEW_EQ(label, "module")) args->module = value[0];
+            else if (STR_VIEW_EQ(label, "controller")) args->controller = value[0];
+            else if (STR_VIEW_EQ(label, "param")) args->param = value[0];
+            else if (STR_VIEW_EQ(label, "on")) args->on = value[0];
+        }
+    }
+}
+
+static int contains(const StrView* values, int count, const char* value) {
+    size_t len = strlen(value);
+    for (int i = 0; i < count; i++) {
+        if (str_view_eq(values[i], value, len)) return 1;
+    }
+    return 0;
+}
+
+// Whether `only:`/`except:` let `action` through
+static int action_enabled(const RouteArgs* args, const char* action) {
+    if (args->has_only && !contains(args->only, args->only_count, action)) return 0;
+    return !contains(args->except, args->except_count, action);
+}
+
+// Appends "/segment" to out[0..*len), turning `:id` into `{id}` and `*path`
+// into `{path}` and dropping optional parts such as `(.:format)`
+static void append_segment(char* out, size_t* len, const char* segment, size_t segment_len) {
+    while (segment_len > 0 && segment[0] == '/') {
+        segment++;
+        segment_len--;
+    }
+    if (segment_len == 0) return;
+    if (*len + 1 < MAX_ROUTE_PATH) out[(*len)++] = '/';
+
+    int optional = 0;
+    int in_param = 0;
+    for (size_t i = 0; i < segment_len && *len + 2 < MAX_ROUTE_PATH; i++) {
+        char c = segment[i];
+        if (c == '(') optional++;
+        if (optional) {
+            if (c == ')') optional--;
+            continue;
+        }
+        if ((c == ':' || c == '*') && !in_param) {
+            out[(*len)++] = '{';
+            in_param = 1;
+            continue;
+        }
+        if (in_param && (c == '/' || c == '.' || c == '-')) {
+            out[(*len)++] = '}';
+            in_param = 0;
+        }
+        out[(*len)++] = c;
+    }
+    if (in_param && *len + 1 < MAX_ROUTE_PATH) out[(*len)++] = '}';
+    while (*len > 1 && out[*len - 1] == '/') (*len)--;
+    out[*len] = '\0';
+}
+
+static const char* join_path(RoutesParser* parser, const char* prefix, const char* segment, size_t segment_len) {
+    char path[MAX_ROUTE_PATH];
+    size_t len = strlen(prefix);
+    if (len >= MAX_ROUTE_PATH) len = MAX_ROUTE_PATH - 1;
+    memcpy(path, prefix, len);
+    path[len] = '\0';
+    append_segment(path, &len, segment, segment_len);
+    return arena_intern(parser->arena, path, len);
+}
+
+static const char* join_module(RoutesParser* parser, const char* module, StrView name) {
+    while (name.len > 0 && name.ptr[0] == '/') {
+        name.ptr++;
+        name.len--;
+    }
+    if (name.len == 0) return module;
+    char joined[MAX_ROUTE_PATH];
+    int written = snprintf(joined, sizeof(joined), "%s%s%.*s", module, module[0] ? "/" : "", (int)name.len, name.ptr);
+    if (written < 0 || written >= (int)sizeof(joined)) return module;
+    return arena_intern(parser->arena, joined, written);
+}
+
+static int new_group(RoutesParser* parser) {
+    return parser->group_count++;
+}
+
+static void add_route(RoutesParser* parser, const RouteFrame* frame, int group, const char* method, const char* path,
+                      const char* controller, const char* action, const char* resource_name) {
+    ApiSpec* spec = parser->spec;
+    int index = spec->routes.count - parser->first;
+    if (index == parser->groups_capacity) {
+        int capacity = parser->groups_capacity ? parser->groups_capacity * 2 : 256;
+        int* groups = realloc(parser->groups, capacity * sizeof(int));
+        if (!groups) return;
+        parser->groups = groups;
+        parser->groups_capacity = capacity;
+    }
+
+    RouteInfo* route = ARENA_PUSH(parser->arena, spec->routes);
+    if (!route) return;
+    route->path = path[0] ? path : arena_intern_cstr(parser->arena, "/");
+    route->controller = controller;
+    route->action = action ? arena_intern_cstr(parser->arena, action) : NULL;
+    route->method = method ? arena_intern_cstr(parser->arena, method) : NULL;
+    route->resource_name = resource_name;
+    route->namespace_path = frame->module[0] ? frame->module : NULL;
+    parser->groups[index] = group;
+}
+
+static RouteFrame* current_frame(RoutesParser* parser) {
+    return &parser->frames[parser->depth - 1];
+}
+
+// Pushes the frame a block-opening statement starts; `frame` may be NULL for
+// a block that inherits the enclosing scope
+static void open_blocks(RoutesParser* parser, const RouteFrame* frame, int blocks) {
+    for (int i = 0; i < blocks; i++) {
+        if (parser->depth == MAX_ROUTE_DEPTH) {
+            parser->skipped++;
+            continue;
+        }
+        RouteFrame* next = &parser->frames[parser->depth];
+        if (frame && i == 0) {
+            *next = *frame;
+        } else {
+            *next = parser->frames[parser->depth - 1];
+            next->kind = next->kind == FRAME_IGNORED ? FRAME_IGNORED : FRAME_TRANSPARENT;
+        }
+        parser->depth++;
+    }
+}
+
+// namespace :api / scope '/v1', module: :v1
+static void handle_scope(RoutesParser* parser, const RubyStatement* stmt, int is_namespace) {
+    RouteArgs args;
+    parse_route_args(stmt->args, &args);
+    RouteFrame frame = *current_frame(parser);
+    frame.kind = FRAME_SCOPE;
+
+    if (is_namespace && args.name_count > 0) {
+        StrView segment = args.has_path ? args.path : args.names[0];
+        frame.path = join_path(parser, frame.path, segment.ptr, segment.len);
+        frame.module = join_module(parser, frame.module, args.module.ptr ? args.module : args.names[0]);
+    } else if (!is_namespace) {
+        if (args.name_count > 0) frame.path = join_path(parser, frame.path, args.names[0].ptr, args.names[0].len);
+        if (args.has_path) frame.path = join_path(parser, frame.path, args.path.ptr, args.path.len);
+        if (args.module.ptr) frame.module = join_module(parser, frame.module, args.module);
+    }
+    open_blocks(parser, &frame, stmt->block_delta);
+}
+
+// resources :users / resource :profile, and their JSONAPI::Resources forms.
+// `new` and `edit` render HTML forms and are left out of the spec.
+static void handle_resources(RoutesParser* parser, const RubyStatement* stmt, int singular, int jsonapi) {
+    RouteArgs args;
+    parse_route_args(stmt->args, &args);
+    const RouteFrame* parent = current_frame(parser);
+    RouteFrame frame = *parent;
+
+    for (int n = 0; n < args.name_count; n++) {
+        StrView name = args.names[n];
+        StrView segment = args.has_path ? args.path : name;
+        const char* resource_name = arena_intern(parser->arena, name.ptr, name.len);
+        const char* collection = join_path(parser, parent->path, segment.ptr, segment.len);
+        StrView controller_name = args.controller.ptr ? args.controller : name;
+        const char* module = args.module.ptr ? join_module(parser, parent->module, args.module) : parent->module;
+        const char* controller = join_module(parser, module, controller_name);
+        int group = new_group(parser);
+
+        frame.kind = FRAME_RESOURCES;
+        frame.group = group;
+        frame.resource_name = resource_name;
+        frame.controller = controller;
+        frame.collection_path = collection;
+
+        char param[MAX_ROUTE_PATH];
+        if (singular) {
+            frame.member_path = collection;
+            frame.path = collection;
+        } else {
+            // Members are addressed by `:id` (or `param:`), nested declarations by `:user_id`
+            int written = snprintf(param, sizeof(param), ":%.*s", (int)(args.param.ptr ? args.param.len : 2),
+                                   args.param.ptr ? args.param.ptr : "id");
+            frame.member_path = join_path(parser, collection, param, written);
+
+            char singular_name[MAX_ROUTE_PATH];
+            route_singular_name(name.ptr, name.len, singular_name, sizeof(singular_name));
+            written = snprintf(param, sizeof(param), ":%s_id", singular_name);
+            frame.path = join_path(parser, collection, param, written);
+        }
+
+        if (!singular && action_enabled(&args, "index")) {
+            add_route(parser, &frame, group, "GET", collection, controller, "index", resource_name);
+        }
+        if (action_enabled(&args, "create")) {
+            add_route(parser, &frame, group, "POST", collection, controller, "create", resource_name);
+        }
+        if (action_enabled(&args, "show")) {
+            add_route(parser, &frame, group, "GET", frame.member_path, controller, "show", resource_name);
+        }
+        if (action_enabled(&args, "update")) {
+            add_route(parser, &frame, group, "PATCH", frame.member_path, controller, "update", resource_name);
+            add_route(parser, &frame, group, "PUT", frame.member_path, controller, "update", resource_name);
+        }
+        if (action_enabled(&args, "destroy")) {
+            add_route(parser, &frame, group, "DELETE", frame.member_path, controller, "destroy", resource_name);
+        }
+
+        // jsonapi_resources without a block links every relationship of the resource
+        if (jsonapi && stmt->block_delta <= 0) {
+            add_route(parser, &frame, group, NULL, frame.member_path, controller, "jsonapi_relationships",
+                      resource_name);
+        }
+    }
+
+    // A block belongs to the last resource: `resources :a, :b do` nests below :b
+    if (args.name_count > 0) {
+        open_blocks(parser, &frame, stmt->block_delta);
+    } else {
+        open_blocks(parser, NULL, stmt->block_delta);
+    }
+}
+
+static const char* verb_method(StrView verb) {
+    if (STR_VIEW_EQ(verb, "get")) return "GET";
+    if (STR_VIEW_EQ(verb, "post")) return "POST";
+    if (STR_VIEW_EQ(verb, "patch")) return "PATCH";
+    if (STR_VIEW_EQ(verb, "put")) return "PUT";
+    if (STR_VIEW_EQ(verb, "delete")) return "DELETE";
+    return NULL;
+}
+
+// get :activate, on: :member / get 'health', to: 'health#show' / match ..., via: [...]
+static void handle_verb(RoutesParser* parser, const RubyStatement* stmt, int is_root) {
+    RouteArgs args;
+    parse_route_args(stmt->args, &args);
+    const RouteFrame* frame = current_frame(parser);
+
+    StrView name = args.name_count > 0 ? args.names[0] : (StrView){ "", 0 };
+    if (is_root) name = (StrView){ "", 0 };
+
+    // Where the route hangs: member or collection of the enclosing resource,
+    // or the scope (which below a resource is its nested path)
+    const char* prefix = frame->path;
+    if (frame->kind == FRAME_MEMBER || (args.on.ptr && STR_VIEW_EQ(args.on, "member"))) {
+        prefix = frame->member_path ? frame->member_path : frame->path;
+    } else if (frame->kind == FRAME_COLLECTION || (args.on.ptr && STR_VIEW_EQ(args.on, "collection"))) {
+        prefix = frame->collection_path ? frame->collection_path : frame->path;
+    }
+    StrView segment = args.has_path ? args.path : name;
+    const char* path = join_path(parser, prefix, segment.ptr, segment.len);
+
+    // Controller and action from `to: 'controller#action'`, else the resource and the route name
+    const char* controller = frame->controller;
+    char action[MAX_ROUTE_PATH];
+    action[0] = '\0';
+    if (args.to.ptr) {
+        const char* hash = memchr(args.to.ptr, '#', args.to.len);
+        if (hash) {
+            StrView controller_name = { args.to.ptr, hash - args.to.ptr };
+            controller = join_module(parser, frame->module, controller_name);
+            snprintf(action, sizeof(action), "%.*s", (int)(args.to.len - (hash + 1 - args.to.ptr)), hash + 1);
+        }
+    } else if (args.controller.ptr) {
+        controller = join_module(parser, frame->module, args.controller);
+    }
+    if (!action[0]) snprintf(action, sizeof(action), "%.*s", (int)name.len, name.ptr);
+    if (!action[0]) snprintf(action, sizeof(action), "%s", is_root ? "root" : "index");
+    for (char* p = action; *p; p++) {
+        if (*p == '/' || *p == '-') *p = '_';
+    }
+
+    int group = frame->group >= 0 ? frame->group : new_group(parser);
+    const char* resource_name = frame->group >= 0 ? frame->resource_name : NULL;
+
+    if (STR_VIEW_EQ(stmt->keyword, "match")) {
+        for (int i = 0; i < args.via_count; i++) {
+            const char* method = verb_method(args.via[i]);
+            if (method) add_route(parser, frame, group, method, path, controller, action, resource_name);
+        }
+        if (args.via_count == 0 || contains(args.via, args.via_count, "all")) {
+            add_route(parser, frame, group, "GET", path, controller, action, resource_name);
+        }
+    } else {
+        const char* method = is_root ? "GET" : verb_method(stmt->keyword);
+        add_route(parser, frame, group, method, path, controller, action, resource_name);
+    }
+    open_blocks(parser, NULL, stmt->block_delta);
+}
+
+// jsonapi_link(s) and jsonapi_related_resource(s) for named relationships
+static void handle_jsonapi_link(RoutesParser* parser, const RubyStatement* stmt, int to_many, int related) {
+    RouteArgs args;
+    parse_route_args(stmt->args, &args);
+    const RouteFrame* frame = current_frame(parser);
+    if (frame->group < 0) {
+        open_blocks(parser, NULL, stmt->block_delta);
+        return;
+    }
+
+    const JsonapiLinkRoute* routes;
+    int count = jsonapi_link_routes(to_many, &routes);
+    for (int n = 0; n < args.name_count; n++) {
+        StrView name = args.names[n];
+        char segment[MAX_ROUTE_PATH];
+        int written = snprintf(segment, sizeof(segment), "relationships/%.*s", (int)name.len, name.ptr);
+        const char* links_path = join_path(parser, frame->member_path, segment, written);
+        const char* related_path = join_path(parser, frame->member_path, name.ptr, name.len);
+
+        for (int i = 0; i < count; i++) {
+            if (routes[i].related != related) continue;
+            // only:/except: name the link actions (:show, :create, :update, :destroy)
+            const char* link_action = routes[i].related ? "show" : routes[i].action;
+            size_t action_len = strcspn(link_action, "_");
+            char short_action[16];
+            snprintf(short_action, sizeof(short_action), "%.*s", (int)action_len, link_action);
+            if (!routes[i].related && !action_enabled(&args, short_action)) continue;
+
+            add_route(parser, frame, frame->group, routes[i].method, routes[i].related ? related_path : links_path,
+                      frame->controller, routes[i].action, frame->resource_name);
+        }
+    }
+    open_blocks(parser, NULL, stmt->block_delta);
+}
+
+static void handle_statement(RoutesParser* parser, const RubyStatement* stmt) {
+    if (stmt->block_delta < 0) {
+        for (int i = stmt->block_delta; i < 0; i++) {
+            if (parser->skipped > 0) parser->skipped--;
+            else if (parser->depth > 1) parser->depth--;
+        }
+        return;
+    }
+
+    StrView keyword = stmt->keyword;
+    FrameKind kind = current_frame(parser)->kind;
+    if (kind == FRAME_IGNORED || parser->skipped > 0) {
+        open_blocks(parser, NULL, stmt->block_delta);
+        return;
+    }
+
+    if (STR_VIEW_EQ(keyword, "namespace")) {
+        handle_scope(parser, stmt, 1);
+    } else if (STR_VIEW_EQ(keyword, "scope")) {
+        handle_scope(parser, stmt, 0);
+    } else if (STR_VIEW_EQ(keyword, "resources")) {
+        handle_resources(parser, stmt, 0, 0);
+    } else if (STR_VIEW_EQ(keyword, "resource")) {
+        handle_resources(parser, stmt, 1, 0);
+    } else if (STR_VIEW_EQ(keyword, "jsonapi_resources")) {
+        handle_resources(parser, stmt, 0, 1);
+    } else if (STR_VIEW_EQ(keyword, "jsonapi_resource")) {
+        handle_resources(parser, stmt, 1, 1);
+    } else if (STR_VIEW_EQ(keyword, "jsonapi_relationships")) {
+        const RouteFrame* frame = current_frame(parser);
+        if (frame->group >= 0) {
+            add_route(parser, frame, frame->group, NULL, frame->member_path, frame->controller,
+                      "jsonapi_relationships", frame->resource_name);
+        }
+        open_blocks(parser, NULL, stmt->block_delta);
+    } else if (STR_VIEW_EQ(keyword, "jsonapi_link")) {
+        handle_jsonapi_link(parser, stmt, 0, 0);
+    } else if (STR_VIEW_EQ(keyword, "jsonapi_links")) {
+        handle_jsonapi_link(parser, stmt, 1, 0);
+    } else if (STR_VIEW_EQ(keyword, "jsonapi_related_resource")) {
+        handle_jsonapi_link(parser, stmt, 0, 1);
+    } else if (STR_VIEW_EQ(keyword, "jsonapi_related_resources")) {
+        handle_jsonapi_link(parser, stmt, 1, 1);
+    } else if ((STR_VIEW_EQ(keyword, "member") || STR_VIEW_EQ(keyword, "collection")) && stmt->block_delta > 0) {
+        RouteFrame frame = *current_frame(parser);
+        frame.kind = STR_VIEW_EQ(keyword, "member") ? FRAME_MEMBER : FRAME_COLLECTION;
+        open_blocks(parser, &frame, stmt->block_delta);
+    } else if (verb_method(keyword) || STR_VIEW_EQ(keyword, "match")) {
+        handle_verb(parser, stmt, 0);
+    } else if (STR_VIEW_EQ(keyword, "root")) {
+        handle_verb(parser, stmt, 1);
+    } else if (STR_VIEW_EQ(keyword, "concern") || STR_VIEW_EQ(keyword, "def") || STR_VIEW_EQ(keyword, "class") ||
+               STR_VIEW_EQ(keyword, "module")) {
+        RouteFrame frame = *current_frame(parser);
+        frame.kind = FRAME_IGNORED;
+        open_blocks(parser, &frame, stmt->block_delta);
+    } else {
+        open_blocks(parser, NULL, stmt->block_delta);
+    }
+}
+
+// Routes end up grouped by the resource that declared them, in declaration
+// order, and each route's group becomes the index of the group's first route
+static int group_routes(RoutesParser* parser) {
+    ApiSpec* spec = parser->spec;
+    int count = spec->routes.count - parser->first;
+    if (count == 0) return 0;
+
+    int* starts = calloc(parser->group_count + 1, sizeof(int));
+    RouteInfo* sorted = malloc(count * sizeof(RouteInfo));
+    if (!starts || !sorted) {
+        free(starts);
+        free(sorted);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) starts[parser->groups[i] + 1]++;
+    for (int g = 0; g < parser->group_count; g++) starts[g + 1] += starts[g];
+
+    RouteInfo* routes = spec->routes.items + parser->first;
+    for (int i = 0; i < count; i++) {
+        int group = parser->groups[i];
+        sorted[starts[group]] = routes[i];
+        sorted[starts[group]++].group = group;
+    }
+
+    int start = 0;
+    for (int i = 0; i < count; i++) {
+        if (sorted[i].group != sorted[start].group) start = i;
+        routes[i] = sorted[i];
+        routes[i].group = parser->first + start;
+    }
+    free(starts);
+    free(sorted);
+    return 0;
+}
+
+int parse_routes_source(const char* filename, const char* data, size_t size, ApiSpec* spec, ParseCounts* counts) {
+    RoutesParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.spec = spec;
+    parser.arena = &spec->arena;
+    parser.first = spec->routes.count;
+    RouteFrame* top = &parser.frames[0];
+    top->kind = FRAME_TRANSPARENT;
+    top->path = "";
+    top->module = "";
+    top->group = -1;
+    parser.depth = 1;
+
+    RubyLexer lexer;
+    ruby_lexer_init(&lexer, data, size);
+    RubyStatement stmt;
+    while (ruby_lexer_next(&lexer, &stmt)) {
+        handle_statement(&parser, &stmt);
+    }
+
+    int status = group_routes(&parser);
+    if (status != 0) {
+        report_diagnostic(DIAGNOSTIC_ERROR, DIAGNOSTIC_OUT_OF_MEMORY, filename,
+                          "Out of memory while grouping routes of %s", filename);
+        spec->routes.count = parser.first;
+    }
+    if (counts) {
+        counts->bytes = size;
+        counts->lines = lexer.line - (size > 0 && data[size - 1] == '\n');
+    }
+
+    free(parser.groups);
+    return status;
+}
+
+void parse_routes_file(const char* filename, ApiSpec* spec, ParseCounts* counts) {
+    SourceFile source;
+    if (source_file_open(&source, filename) != 0) {
+        report_diagnostic(DIAGNOSTIC_ERROR, DIAGNOSTIC_CANNOT_READ, filename, "Cannot open routes file %s", filename);
+        return;
+    }
+
+    parse_routes_source(filename, source.data, source.size, spec, counts);
+    source_file_close(&source);
+}
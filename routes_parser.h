@@ -0,0 +1,37 @@
+#ifndef ROUTES_PARSER_H
+#define ROUTES_PARSER_H
+
+#include "api_spec.h"
+#include "resource_parser.h"
+
+// One route JSONAPI::Resources draws for a relationship: the link routes
+// below `<member>/relationships/<name>` and, when `related` is set, the
+// related resource at `<member>/<name>`.
+typedef struct {
+    const char* method;
+    const char* action;
+    int related;
+} JsonapiLinkRoute;
+
+// The routes of a to-one (`jsonapi_link`) or to-many (`jsonapi_links`)
+// relationship; returns their number.
+int jsonapi_link_routes(int to_many, const JsonapiLinkRoute** routes);
+
+// Expands a Rails routes file into one RouteInfo per verb and path, the way
+// `rails routes` lists them: `namespace` and `scope` blocks (path: and
+// module: options), `resources`/`resource` with only:/except:, nested
+// resources below `/{parent_id}`, member and collection blocks, get/post/
+// patch/put/delete/match/root, and the jsonapi_resources, jsonapi_link(s)
+// and jsonapi_related_resource(s) helpers. `new` and `edit` are skipped.
+// A block-less jsonapi_resources leaves a route with a NULL method and the
+// action "jsonapi_relationships" on the member path; the writer expands it
+// from the resource's relationships. Routes of one declaration are
+// contiguous and share RouteInfo.group. `counts` (may be NULL) receives the
+// bytes and lines read.
+void parse_routes_file(const char* filename, ApiSpec* spec, ParseCounts* counts);
+
+// Same as parse_routes_file for a routes file that is already in memory;
+// `filename` only names it in diagnostics. Returns -1 when out of memory.
+int parse_routes_source(const char* filename, const char* data, size_t size, ApiSpec* spec, ParseCounts* counts);
+
+#endif
@@ -0,0 +1,408 @@
+#include "ruby_lexer.h"
+
+#include <ctype.h>
+
+static int is_ident_start(char c) {
+    return isalpha((unsigned char)c) || c == '_';
+}
+
+static int is_ident_char(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// Characters that carry a statement over to the next line when they end it
+static int is_continuation(char c) {
+    return c != '\0' && strchr(",\\.+=&", c) != NULL;
+}
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static char closing_delimiter(char open) {
+    switch (open) {
+        case '(': return ')';
+        case '[': return ']';
+        case '{': return '}';
+        case '<': return '>';
+        default: return open;
+    }
+}
+
+static int starts_line_with(const char* p, const char* end, const char* word, size_t len) {
+    return (size_t)(end - p) >= len && memcmp(p, word, len) == 0 &&
+           ((size_t)(end - p) == len || isspace((unsigned char)p[len]));
+}
+
+static const char* skip_to_newline(const char* p, const char* end) {
+    const char* newline = memchr(p, '\n', end - p);
+    return newline ? newline : end;
+}
+
+// Skips a quoted literal starting at the opening delimiter `p`. Brackets nest.
+static const char* skip_delimited(const char* p, const char* end, int* line) {
+    char open = *p++;
+    char close = closing_delimiter(open);
+    int nesting = 1;
+    while (p < end) {
+        char c = *p;
+        if (c == '\\' && p + 1 < end) {
+            if (p[1] == '\n') (*line)++;
+            p += 2;
+            continue;
+        }
+        if (c == '\n') (*line)++;
+        if (c == close && --nesting == 0) return p + 1;
+        if (c == open && open != close) nesting++;
+        p++;
+    }
+    return end;
+}
+
+// Recognizes %i[ %w( %q{ %( ... and returns the opening delimiter, or NULL.
+static const char* percent_literal_delimiter(const char* p, const char* end) {
+    if (p + 1 >= end || *p != '%') return NULL;
+    const char* q = p + 1;
+    if (q < end && strchr("iIwWqQrsx", *q) && *q != '\0') q++;
+    if (q < end && (*q == '(' || *q == '[' || *q == '{' || *q == '<' || *q == '|' || *q == '!')) return q;
+    return NULL;
+}
+
+void ruby_lexer_init(RubyLexer* lexer, const char* data, size_t size) {
+    lexer->begin = data;
+    lexer->cur = data;
+    lexer->end = data + size;
+    lexer->line = 1;
+}
+
+// Skips whitespace, comment lines and =begin/=end blocks between statements.
+// Returns 0 at the end of the input or at __END__.
+static int skip_gap(RubyLexer* lexer) {
+    const char* p = lexer->cur;
+    const char* end = lexer->end;
+
+    for (;;) {
+        while (p < end && (is_blank(*p) || *p == '\n' || *p == ';')) {
+            if (*p == '\n') lexer->line++;
+            p++;
+        }
+        if (p >= end) break;
+
+        int line_start = (p == lexer->begin || p[-1] == '\n');
+        if (*p == '#') {
+            p = skip_to_newline(p, end);
+            continue;
+        }
+        if (line_start && starts_line_with(p, end, "=begin", 6)) {
+            p = skip_to_newline(p, end);
+            while (p < end) {
+                p++;
+                lexer->line++;
+                int is_end = starts_line_with(p, end, "=end", 4);
+                p = skip_to_newline(p, end);
+                if (is_end) break;
+            }
+            continue;
+        }
+        if (line_start && starts_line_with(p, end, "__END__", 7)) {
+            p = end;
+        }
+        break;
+    }
+
+    lexer->cur = p;
+    return p < end;
+}
+
+// Skips the body of a pending heredoc, which begins after the current line.
+static const char* skip_heredoc(const char* p, const char* end, StrView terminator, int* line) {
+    while (p < end) {
+        const char* line_start = p;
+        const char* line_end = skip_to_newline(p, end);
+        while (line_start < line_end && is_blank(*line_start)) line_start++;
+        const char* content_end = line_end;
+        while (content_end > line_start && is_blank(content_end[-1])) content_end--;
+
+        p = line_end < end ? line_end + 1 : end;
+        if (line_end < end) (*line)++;
+        if ((size_t)(content_end - line_start) == terminator.len &&
+            memcmp(line_start, terminator.ptr, terminator.len) == 0) {
+            break;
+        }
+    }
+    return p;
+}
+
+static int opens_block_keyword(StrView word) {
+    return STR_VIEW_EQ(word, "def") || STR_VIEW_EQ(word, "class") || STR_VIEW_EQ(word, "module") ||
+           STR_VIEW_EQ(word, "if") || STR_VIEW_EQ(word, "unless") || STR_VIEW_EQ(word, "while") ||
+           STR_VIEW_EQ(word, "until") || STR_VIEW_EQ(word, "case") || STR_VIEW_EQ(word, "begin") ||
+           STR_VIEW_EQ(word, "for");
+}
+
+// Works out whether a statement opens or closes a `... end` block.
+static int block_delta(const RubyStatement* stmt) {
+    if (STR_VIEW_EQ(stmt->keyword, "end")) return -1;
+
+    if (opens_block_keyword(stmt->keyword)) {
+        // Endless method: def name(args) = expression
+        if (STR_VIEW_EQ(stmt->keyword, "def")) {
+            RubyTokenizer tokenizer;
+            RubyToken token;
+            ruby_tokenizer_init(&tokenizer, stmt->args);
+            while (ruby_tokenizer_next(&tokenizer, &token)) {
+                if (token.type == RUBY_TOKEN_PUNCT && token.depth == 0 && token.text.ptr[0] == '=' &&
+                    token.text.ptr > stmt->args.ptr && is_blank(token.text.ptr[-1])) {
+                    return 0;
+                }
+            }
+        }
+        return 1;
+    }
+
+    int delta = 0;
+    RubyTokenizer tokenizer;
+    RubyToken token;
+    RubyToken previous = { RUBY_TOKEN_EOF, { NULL, 0 }, 0 };
+    ruby_tokenizer_init(&tokenizer, stmt->args);
+    while (ruby_tokenizer_next(&tokenizer, &token)) {
+        // Block keywords used as expressions: x = if ..., foo(case ...)
+        if (token.type == RUBY_TOKEN_IDENT && previous.type == RUBY_TOKEN_PUNCT &&
+            strchr("=(,|&", previous.text.ptr[0]) && opens_block_keyword(token.text) &&
+            !STR_VIEW_EQ(token.text, "def")) {
+            delta++;
+        }
+        previous = token;
+    }
+
+    // Trailing `do` or `do |args|`
+    const char* p = stmt->text.ptr + stmt->text.len;
+    const char* start = stmt->text.ptr;
+    if (p > start && p[-1] == '|') {
+        p--;
+        while (p > start && p[-1] != '|') p--;
+        if (p > start) p--;
+        while (p > start && is_blank(p[-1])) p--;
+    }
+    if (p - start >= 2 && p[-2] == 'd' && p[-1] == 'o' && (p - start == 2 || !is_ident_char(p[-3]))) {
+        delta++;
+    }
+    return delta;
+}
+
+int ruby_lexer_next(RubyLexer* lexer, RubyStatement* stmt) {
+    if (!skip_gap(lexer)) return 0;
+
+    const char* start = lexer->cur;
+    const char* end = lexer->end;
+    const char* p = start;
+    const char* text_end = start;
+    int depth = 0;
+    char last_significant = 0;
+    StrView heredoc = { NULL, 0 };
+
+    stmt->line = lexer->line;
+
+    while (p < end) {
+        char c = *p;
+
+        if (c == '\n') {
+            if (heredoc.ptr) {
+                lexer->line++;
+                p = skip_heredoc(p + 1, end, heredoc, &lexer->line);
+                heredoc.ptr = NULL;
+                if (depth > 0 || is_continuation(last_significant)) continue;
+                break;
+            }
+            if (depth > 0 || is_continuation(last_significant)) {
+                lexer->line++;
+                p++;
+                continue;
+            }
+            // Leading-dot method chains continue the statement on the next line
+            const char* next = p + 1;
+            while (next < end && is_blank(*next)) next++;
+            if (next + 1 < end && next[0] == '.' && next[1] != '.') {
+                lexer->line++;
+                p = next;
+                continue;
+            }
+            break;
+        }
+
+        if (is_blank(c)) {
+            p++;
+            continue;
+        }
+
+        if (c == '#') {
+            p = skip_to_newline(p, end);
+            continue;
+        }
+
+        if (c == ';' && depth == 0) break;
+
+        if (c == '\'' || c == '"' || c == '`') {
+            p = skip_delimited(p, end, &lexer->line);
+        } else if (c == '%' && percent_literal_delimiter(p, end)) {
+            p = skip_delimited(percent_literal_delimiter(p, end), end, &lexer->line);
+        } else if (c == '/' && (p == start || (last_significant && strchr("(,=!~|&{[;:", last_significant)))) {
+            // Regular expression literal
+            const char* q = p + 1;
+            while (q < end && *q != '/' && *q != '\n') q += (*q == '\\' && q + 1 < end) ? 2 : 1;
+            p = (q < end && *q == '/') ? q + 1 : q;
+        } else if (c == '<' && p + 2 < end && p[1] == '<' && (p[2] == '~' || p[2] == '-')) {
+            // Heredoc: <<~ID, <<-ID, <<~'ID', <<~"ID"
+            const char* q = p + 3;
+            char quote = (q < end && (*q == '\'' || *q == '"')) ? *q++ : 0;
+            const char* id_start = q;
+            while (q < end && is_ident_char(*q)) q++;
+            if (q > id_start) {
+                heredoc.ptr = id_start;
+                heredoc.len = q - id_start;
+                if (quote && q < end && *q == quote) q++;
+                p = q;
+            } else {
+                p += 2;
+            }
+        } else {
+            if (c == '(' || c == '[' || c == '{') depth++;
+            else if ((c == ')' || c == ']' || c == '}') && depth > 0) depth--;
+            else if (c == '?' && p + 1 < end && p > start && !is_ident_char(p[-1]) && !isspace((unsigned char)p[1])) {
+                p++; // Character literal such as ?( or ?[
+            }
+            p++;
+        }
+        last_significant = p[-1];
+        text_end = p;
+    }
+
+    lexer->cur = p;
+
+    stmt->text.ptr = start;
+    stmt->text.len = text_end - start;
+
+    const char* k = start;
+    if (is_ident_start(*k)) {
+        while (k < text_end && is_ident_char(*k)) k++;
+        if (k < text_end && (*k == '?' || *k == '!')) k++;
+        // A hash label (`name: value`) is not a method call
+        if (k < text_end && *k == ':' && (k + 1 >= text_end || k[1] != ':')) k = start;
+    }
+    stmt->keyword.ptr = start;
+    stmt->keyword.len = k - start;
+
+    while (k < text_end && isspace((unsigned char)*k)) k++;
+    stmt->args.ptr = k;
+    stmt->args.len = text_end - k;
+
+    stmt->block_delta = block_delta(stmt);
+    return 1;
+}
+
+void ruby_lexer_skip_block(RubyLexer* lexer) {
+    RubyStatement stmt;
+    int depth = 1;
+    while (depth > 0 && ruby_lexer_next(lexer, &stmt)) {
+        depth += stmt.block_delta;
+    }
+}
+
+void ruby_tokenizer_init(RubyTokenizer* tokenizer, StrView text) {
+    tokenizer->cur = text.ptr;
+    tokenizer->end = text.ptr + text.len;
+    tokenizer->depth = 0;
+}
+
+static void set_token(RubyToken* token, RubyTokenType type, const char* start, const char* end, int depth) {
+    token->type = type;
+    token->text.ptr = start;
+    token->text.len = end - start;
+    token->depth = depth;
+}
+
+int ruby_tokenizer_next(RubyTokenizer* tokenizer, RubyToken* token) {
+    const char* p = tokenizer->cur;
+    const char* end = tokenizer->end;
+    int line = 0;
+
+    for (;;) {
+        while (p < end && isspace((unsigned char)*p)) p++;
+        if (p < end && *p == '#') {
+            p = skip_to_newline(p, end);
+            continue;
+        }
+        if (p + 1 < end && p[0] == '\\' && p[1] == '\n') {
+            p += 2;
+            continue;
+        }
+        break;
+    }
+
+    if (p >= end) {
+        tokenizer->cur = end;
+        set_token(token, RUBY_TOKEN_EOF, end, end, tokenizer->depth);
+        return 0;
+    }
+
+    char c = *p;
+    if (c == ':' && p + 1 < end && (p[1] == '"' || p[1] == '\'')) {
+        const char* close = skip_delimited(p + 1, end, &line);
+        set_token(token, RUBY_TOKEN_SYMBOL, p + 2, close > p + 2 ? close - 1 : close, tokenizer->depth);
+        p = close;
+    } else if (c == ':' && p + 1 < end && is_ident_start(p[1])) {
+        const char* q = p + 1;
+        while (q < end && is_ident_char(*q)) q++;
+        if (q < end && (*q == '?' || *q == '!' || *q == '=')) q++;
+        set_token(token, RUBY_TOKEN_SYMBOL, p + 1, q, tokenizer->depth);
+        p = q;
+    } else if (is_ident_char(c)) {
+        const char* q = p;
+        while (q < end && is_ident_char(*q)) q++;
+        if (q < end && (*q == '?' || *q == '!')) q++;
+        if (is_ident_start(c) && q < end && *q == ':' && (q + 1 >= end || q[1] != ':')) {
+            set_token(token, RUBY_TOKEN_LABEL, p, q, tokenizer->depth);
+            p = q + 1;
+        } else {
+            set_token(token, RUBY_TOKEN_IDENT, p, q, tokenizer->depth);
+            p = q;
+        }
+    } else if (c == '\'' || c == '"') {
+        const char* close = skip_delimited(p, end, &line);
+        set_token(token, RUBY_TOKEN_STRING, p + 1, close > p + 1 ? close - 1 : close, tokenizer->depth);
+        p = close;
+    } else if (c == '%' && percent_literal_delimiter(p, end)) {
+        const char* open = percent_literal_delimiter(p, end);
+        const char* close = skip_delimited(open, end, &line);
+        RubyTokenType type = (open - p == 2 && strchr("iIwW", p[1])) ? RUBY_TOKEN_WORD_ARRAY : RUBY_TOKEN_STRING;
+        set_token(token, type, open + 1, close > open + 1 ? close - 1 : close, tokenizer->depth);
+        p = close;
+    } else {
+        if (c == ')' || c == ']' || c == '}') {
+            if (tokenizer->depth > 0) tokenizer->depth--;
+            set_token(token, RUBY_TOKEN_PUNCT, p, p + 1, tokenizer->depth);
+        } else {
+            set_token(token, RUBY_TOKEN_PUNCT, p, p + 1, tokenizer->depth);
+            if (c == '(' || c == '[' || c == '{') tokenizer->depth++;
+        }
+        // `::` is one token so it is never mistaken for a symbol
+        p += (c == ':' && p + 1 < end && p[1] == ':') ? 2 : 1;
+    }
+
+    tokenizer->cur = p;
+    return 1;
+}
+
+int ruby_next_word(StrView* words, StrView* word) {
+    const char* p = words->ptr;
+    const char* end = words->ptr + words->len;
+    while (p < end && isspace((unsigned char)*p)) p++;
+    const char* start = p;
+    while (p < end && !isspace((unsigned char)*p)) p++;
+
+    word->ptr = start;
+    word->len = p - start;
+    words->len -= p - words->ptr;
+    words->ptr = p;
+    return word->len > 0;
+}
@@ -0,0 +1,75 @@
+#ifndef RUBY_LEXER_H
+#define RUBY_LEXER_H
+
+#include <stddef.h>
+#include <string.h>
+
+// Non-owning slice of a source buffer.
+typedef struct {
+    const char* ptr;
+    size_t len;
+} StrView;
+
+static inline int str_view_eq(StrView view, const char* str, size_t len) {
+    return view.len == len && (len == 0 || memcmp(view.ptr, str, len) == 0);
+}
+
+#define STR_VIEW_EQ(view, literal) str_view_eq((view), (literal), sizeof(literal) - 1)
+
+// One logical Ruby statement. A statement ends at a newline unless a bracket,
+// string or percent literal is still open, or the line ends in a
+// continuation character (`,`, `\`, `.`, `+`, `=`). Comments are excluded.
+typedef struct {
+    StrView text;    // Whole statement
+    StrView keyword; // Leading identifier ("attributes", "def", "end", ...), may be empty
+    StrView args;    // Everything after the keyword
+    int line;        // 1-based line of the first byte
+    int block_delta; // +1 opens a block (def/class/if/... or trailing `do`), -1 is `end`
+} RubyStatement;
+
+typedef struct {
+    const char* begin;
+    const char* cur;
+    const char* end;
+    int line;
+} RubyLexer;
+
+void ruby_lexer_init(RubyLexer* lexer, const char* data, size_t size);
+
+// Returns 1 and fills `stmt`, or 0 at the end of the input (or at __END__).
+int ruby_lexer_next(RubyLexer* lexer, RubyStatement* stmt);
+
+// Consumes statements up to and including the `end` that closes a block
+// opened by the statement just returned.
+void ruby_lexer_skip_block(RubyLexer* lexer);
+
+typedef enum {
+    RUBY_TOKEN_EOF,
+    RUBY_TOKEN_IDENT,      // foo, Foo, foo?, 42
+    RUBY_TOKEN_SYMBOL,     // :foo or :"foo" (text excludes the colon and quotes)
+    RUBY_TOKEN_STRING,     // 'foo' or "foo" (text excludes the quotes)
+    RUBY_TOKEN_LABEL,      // foo: (text excludes the colon)
+    RUBY_TOKEN_WORD_ARRAY, // %i[...] / %w[...] (text is the inside of the brackets)
+    RUBY_TOKEN_PUNCT       // any other single character
+} RubyTokenType;
+
+typedef struct {
+    RubyTokenType type;
+    StrView text;
+    int depth; // Bracket nesting depth at the token, 0 for top-level arguments
+} RubyToken;
+
+// Tokenizer over a statement's argument text.
+typedef struct {
+    const char* cur;
+    const char* end;
+    int depth;
+} RubyTokenizer;
+
+void ruby_tokenizer_init(RubyTokenizer* tokenizer, StrView text);
+int ruby_tokenizer_next(RubyTokenizer* tokenizer, RubyToken* token);
+
+// Splits the inside of a %i[]/%w[] literal; returns 0 when no words remain.
+int ruby_next_word(StrView* words, StrView* word);
+
+#endif
@@ -0,0 +1,209 @@
+#include "run_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "json_writer.h"
+#include "output_sink.h"
+
+static const char* const phase_names[STATS_PHASE_COUNT] = {
+    "scan", "parse_resources", "resolve_classes", "parse_routes", "parse_schema", "match_routes", "generate",
+    "serialize"
+};
+
+static long long clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void run_stats_init(RunStats* stats) {
+    memset(stats, 0, sizeof(RunStats));
+}
+
+void run_stats_free(RunStats* stats) {
+    if (!stats) return;
+    free(stats->files);
+    memset(stats, 0, sizeof(RunStats));
+}
+
+void run_stats_begin(RunStats* stats, StatsPhase phase) {
+    if (!stats) return;
+    stats->started_wall[phase] = clock_ns(CLOCK_MONOTONIC);
+    stats->started_cpu[phase] = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void run_stats_end(RunStats* stats, StatsPhase phase) {
+    if (!stats) return;
+    PhaseTime* time = &stats->phases[phase];
+    time->wall_ns += clock_ns(CLOCK_MONOTONIC) - stats->started_wall[phase];
+    time->cpu_ns += clock_ns(CLOCK_PROCESS_CPUTIME_ID) - stats->started_cpu[phase];
+    time->ran = 1;
+}
+
+FileParseStats* run_stats_files(RunStats* stats, int count) {
+    if (!stats) return NULL;
+    free(stats->files);
+    stats->files = calloc(count > 0 ? count : 1, sizeof(FileParseStats));
+    stats->file_count = stats->files ? count : 0;
+    return stats->files;
+}
+
+void run_stats_arena(RunStats* stats, const Arena* arena) {
+    if (!stats) return;
+    stats->allocations = arena->allocations;
+    stats->arena_bytes = arena->bytes_used;
+}
+
+static size_t peak_rss_bytes(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss; // Bytes on macOS
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+static int compare_slowest(const void* a, const void* b) {
+    const FileParseStats* x = a;
+    const FileParseStats* y = b;
+    if (x->wall_ns != y->wall_ns) return x->wall_ns < y->wall_ns ? 1 : -1;
+    return strcmp(x->path ? x->path : "", y->path ? y->path : "");
+}
+
+// Nearest-rank percentile of files sorted slowest first
+static long long percentile(const FileParseStats* sorted, int count, int percent) {
+    if (count == 0) return 0;
+    int rank = (int)(((long long)count * percent + 99) / 100); // 1-based, from the fastest
+    if (rank < 1) rank = 1;
+    return sorted[count - rank].wall_ns;
+}
+
+typedef struct {
+    FileParseStats* sorted;
+    long long parse_ns;
+    size_t bytes;
+    long long lines;
+} FileSummary;
+
+static void summarize_files(const RunStats* stats, FileSummary* summary) {
+    memset(summary, 0, sizeof(FileSummary));
+    summary->bytes = stats->routes.bytes + stats->schema.bytes;
+    summary->lines = stats->routes.lines + stats->schema.lines;
+    for (int i = 0; i < stats->file_count; i++) {
+        summary->parse_ns += stats->files[i].wall_ns;
+        summary->bytes += stats->files[i].bytes;
+        summary->lines += stats->files[i].lines;
+    }
+    if (stats->file_count == 0) return;
+    summary->sorted = malloc(stats->file_count * sizeof(FileParseStats));
+    if (!summary->sorted) return;
+    memcpy(summary->sorted, stats->files, stats->file_count * sizeof(FileParseStats));
+    qsort(summary->sorted, stats->file_count, sizeof(FileParseStats), compare_slowest);
+}
+
+static void report_text(const RunStats* stats, const FileSummary* summary, int slowest, FILE* file) {
+    int count = summary->sorted ? stats->file_count : 0;
+    fprintf(file, "\nRun statistics\n");
+    fprintf(file, "  %-18s %12s %12s\n", "phase", "wall ms", "cpu ms");
+    for (int p = 0; p < STATS_PHASE_COUNT; p++) {
+        if (!stats->phases[p].ran) continue;
+        fprintf(file, "  %-18s %12.3f %12.3f\n", phase_names[p], stats->phases[p].wall_ns / 1e6,
+                stats->phases[p].cpu_ns / 1e6);
+    }
+    fprintf(file, "  Resource files: %d, %.3f ms parsing in total, p50 %.3f ms, p99 %.3f ms\n", stats->file_count,
+            summary->parse_ns / 1e6, percentile(summary->sorted, count, 50) / 1e6,
+            percentile(summary->sorted, count, 99) / 1e6);
+    fprintf(file, "  Read %zu bytes, scanned %lld lines\n", summary->bytes, summary->lines);
+    fprintf(file, "  Arena: %zu allocations, %zu bytes\n", stats->allocations, stats->arena_bytes);
+    fprintf(file, "  Output: %zu bytes\n", stats->output_bytes);
+    if (stats->batches > 0) {
+        fprintf(file, "  Low memory: %d batches, %zu bytes of schemas spooled\n", stats->batches,
+                stats->spooled_bytes);
+    }
+    fprintf(file, "  Peak RSS: %.1f MB\n", peak_rss_bytes() / 1e6);
+
+    if (slowest > count) slowest = count;
+    if (slowest > 0) fprintf(file, "  Slowest files:\n");
+    for (int i = 0; i < slowest; i++) {
+        const FileParseStats* entry = &summary->sorted[i];
+        fprintf(file, "  %10.3f ms %8zu bytes %6d lines  %s\n", entry->wall_ns / 1e6, entry->bytes, entry->lines,
+                entry->path ? entry->path : "?");
+    }
+}
+
+static void report_json(const RunStats* stats, const FileSummary* summary, int slowest, FILE* file) {
+    int count = summary->sorted ? stats->file_count : 0;
+    OutputSink sink;
+    if (output_sink_init(&sink, 1 << 12, output_sink_write_file, file) != 0) return;
+    JsonWriter writer;
+    json_writer_init(&writer, &sink, 1);
+    SpecEmitter* out = &writer.emitter;
+
+    out->begin_object(out);
+    out->key(out, "phases");
+    out->begin_object(out);
+    for (int p = 0; p < STATS_PHASE_COUNT; p++) {
+        if (!stats->phases[p].ran) continue;
+        out->key(out, phase_names[p]);
+        out->begin_object(out);
+        emit_key_integer(out, "wall_ns", stats->phases[p].wall_ns);
+        emit_key_integer(out, "cpu_ns", stats->phases[p].cpu_ns);
+        out->end_object(out);
+    }
+    out->end_object(out);
+
+    out->key(out, "resource_files");
+    out->begin_object(out);
+    emit_key_integer(out, "count", stats->file_count);
+    emit_key_integer(out, "parse_ns", summary->parse_ns);
+    emit_key_integer(out, "p50_ns", percentile(summary->sorted, count, 50));
+    emit_key_integer(out, "p99_ns", percentile(summary->sorted, count, 99));
+    out->end_object(out);
+
+    emit_key_integer(out, "bytes_read", (long long)summary->bytes);
+    emit_key_integer(out, "lines_scanned", summary->lines);
+    emit_key_integer(out, "allocations", (long long)stats->allocations);
+    emit_key_integer(out, "arena_bytes", (long long)stats->arena_bytes);
+    emit_key_integer(out, "output_bytes", (long long)stats->output_bytes);
+    if (stats->batches > 0) {
+        emit_key_integer(out, "batches", stats->batches);
+        emit_key_integer(out, "spooled_bytes", (long long)stats->spooled_bytes);
+    }
+    emit_key_integer(out, "peak_rss_bytes", (long long)peak_rss_bytes());
+
+    if (slowest > count) slowest = count;
+    out->key(out, "slowest_files");
+    out->begin_array(out);
+    for (int i = 0; i < slowest; i++) {
+        const FileParseStats* entry = &summary->sorted[i];
+        out->begin_object(out);
+        emit_key_string(out, "path", entry->path ? entry->path : "");
+        emit_key_integer(out, "wall_ns", entry->wall_ns);
+        emit_key_integer(out, "bytes", (long long)entry->bytes);
+        emit_key_integer(out, "lines", entry->lines);
+        out->end_object(out);
+    }
+    out->end_array(out);
+    out->end_object(out);
+
+    output_sink_putc(&sink, '\n');
+    output_sink_flush(&sink);
+    output_sink_free(&sink);
+}
+
+void run_stats_report(const RunStats* stats, StatsFormat format, int slowest, FILE* file) {
+    if (!stats) return;
+    FileSummary summary;
+    summarize_files(stats, &summary);
+    if (format == STATS_JSON) {
+        report_json(stats, &summary, slowest, file);
+    } else {
+        report_text(stats, &summary, slowest, file);
+    }
+    fflush(file);
+    free(summary.sorted);
+}
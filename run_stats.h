@@ -0,0 +1,74 @@
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include <stdio.h>
+
+#include "arena.h"
+#include "resource_parser.h"
+
+typedef enum {
+    STATS_SCAN,            // Walking the resource directory
+    STATS_PARSE_RESOURCES,
+    STATS_RESOLVE_CLASSES, // Superclasses and concerns
+    STATS_PARSE_ROUTES,
+    STATS_PARSE_SCHEMA,    // db/schema.rb or structure.sql, and typing resources from it
+    STATS_MATCH_ROUTES,
+    STATS_GENERATE,        // Building the json-c document (--dom only)
+    STATS_SERIALIZE,       // Writing the spec; includes generating it when streamed
+    STATS_PHASE_COUNT
+} StatsPhase;
+
+typedef enum {
+    STATS_TEXT,
+    STATS_JSON
+} StatsFormat;
+
+typedef struct {
+    long long wall_ns;
+    long long cpu_ns; // Process CPU time, so parallel phases exceed their wall time
+    int ran;
+} PhaseTime;
+
+// One parsed resource file
+typedef struct {
+    const char* path; // source_path of the resource
+    long long wall_ns;
+    size_t bytes;
+    int lines;
+} FileParseStats;
+
+// Timings and counters of one run, for --stats. Every function accepts a
+// NULL RunStats and does nothing, so call sites need no checks.
+typedef struct {
+    PhaseTime phases[STATS_PHASE_COUNT];
+    long long started_wall[STATS_PHASE_COUNT];
+    long long started_cpu[STATS_PHASE_COUNT];
+    FileParseStats* files;
+    int file_count;
+    ParseCounts routes;
+    ParseCounts schema;
+    size_t output_bytes;
+    size_t allocations; // Arena allocations made for the spec
+    size_t arena_bytes;
+    int batches;          // Resource batches of --low-memory, 0 without it
+    size_t spooled_bytes; // Schemas --low-memory held in its temporary file
+} RunStats;
+
+void run_stats_init(RunStats* stats);
+void run_stats_free(RunStats* stats);
+
+void run_stats_begin(RunStats* stats, StatsPhase phase);
+void run_stats_end(RunStats* stats, StatsPhase phase);
+
+// Room for the per-file measurements of `count` files, replacing earlier
+// ones. Returns NULL without stats or when out of memory.
+FileParseStats* run_stats_files(RunStats* stats, int count);
+
+// Takes the allocation counters of the arena the spec ended up in.
+void run_stats_arena(RunStats* stats, const Arena* arena);
+
+// Writes the phase times, per-file p50/p99, byte, line and allocation
+// counts, peak RSS and the `slowest` slowest files.
+void run_stats_report(const RunStats* stats, StatsFormat format, int slowest, FILE* file);
+
+#endif
@@ -0,0 +1,227 @@
+#include "shard_files.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parse_cache.h"
+#include "work_pool.h"
+
+#define MAX_PATH_LENGTH 1024
+#define MAX_PRUNE_DEPTH 64
+
+// What one worker renders, and the file on disk it is compared with
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+    char* disk;
+    size_t disk_capacity;
+    OutputSink sink;
+    ShardSummary summary;
+    int failed;
+} ShardBuffer;
+
+typedef struct {
+    const char* directory;
+    const char* separator; // Between the directory and the file paths
+    ShardFile* files;
+    ShardRenderFn render;
+    void* ctx;
+    ShardBuffer* buffers;
+} ShardJob;
+
+static int buffer_write(void* ctx, const char* data, size_t size) {
+    ShardBuffer* buffer = ctx;
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 1 << 16;
+        while (capacity < buffer->size + size) capacity *= 2;
+        char* grown = realloc(buffer->data, capacity);
+        if (!grown) return -1;
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+    return 0;
+}
+
+static const char* separator_after(const char* directory) {
+    size_t len = strlen(directory);
+    return len > 0 && directory[len - 1] == '/' ? "" : "/";
+}
+
+// Whether `path` already holds what `buffer` rendered
+static int same_content(const char* path, ShardBuffer* buffer) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+    struct stat st;
+    int same = fstat(fileno(file), &st) == 0 && (size_t)st.st_size == buffer->size;
+    if (same && buffer->size > buffer->disk_capacity) {
+        char* grown = realloc(buffer->disk, buffer->size);
+        if (grown) {
+            buffer->disk = grown;
+            buffer->disk_capacity = buffer->size;
+        } else {
+            same = 0;
+        }
+    }
+    if (same && buffer->size > 0) {
+        same = fread(buffer->disk, 1, buffer->size, file) == buffer->size &&
+               memcmp(buffer->disk, buffer->data, buffer->size) == 0;
+    }
+    fclose(file);
+    return same;
+}
+
+// Creates the directories above `path`
+static void make_parents(const char* path) {
+    char parent[MAX_PATH_LENGTH];
+    snprintf(parent, sizeof(parent), "%s", path);
+    for (char* p = parent + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(parent, 0777);
+        *p = '/';
+    }
+}
+
+// Numbers the temporary files of this process, so that no two writers
+// share one, whichever threads they run on
+static unsigned long temp_files;
+
+// Writes a temporary file next to `path` and renames it over `path`, so
+// readers never see a half-written file
+static int replace_file(const char* path, const char* data, size_t size) {
+    char temp_path[MAX_PATH_LENGTH + 48];
+    unsigned long serial = __atomic_fetch_add(&temp_files, 1, __ATOMIC_RELAXED);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp.%ld.%lu", path, (long)getpid(), serial);
+    FILE* file = fopen(temp_path, "wb");
+    if (!file && errno == ENOENT) {
+        make_parents(path);
+        file = fopen(temp_path, "wb");
+    }
+    if (!file) return -1;
+    int status = fwrite(data, 1, size, file) == size ? 0 : -1;
+    if (fclose(file) != 0) status = -1;
+    if (status == 0 && rename(temp_path, path) != 0) status = -1;
+    if (status != 0) remove(temp_path);
+    return status;
+}
+
+static void write_task(void* ctx, size_t index, int worker_id) {
+    ShardJob* job = ctx;
+    ShardBuffer* buffer = &job->buffers[worker_id];
+    ShardFile* file = &job->files[index];
+    char path[MAX_PATH_LENGTH];
+    int written = snprintf(path, sizeof(path), "%s%s%s", job->directory, job->separator, file->path);
+    if (written < 0 || written >= (int)sizeof(path)) {
+        printf("Error: Path too long: %s%s%s\n", job->directory, job->separator, file->path);
+        buffer->failed = 1;
+        return;
+    }
+
+    buffer->size = 0;
+    job->render(job->ctx, (int)index, &buffer->sink);
+    if (output_sink_flush(&buffer->sink) != 0) {
+        printf("Error: Out of memory while rendering %s\n", path);
+        buffer->failed = 1;
+        return;
+    }
+    file->hash = hash_bytes(buffer->data, buffer->size);
+    if (same_content(path, buffer)) {
+        buffer->summary.unchanged++;
+    } else if (replace_file(path, buffer->data, buffer->size) == 0) {
+        buffer->summary.written++;
+        buffer->summary.bytes_written += buffer->size;
+    } else {
+        printf("Error: Cannot write %s\n", path);
+        buffer->failed = 1;
+    }
+}
+
+int shard_files_write(const char* directory, ShardFile* files, int count, ShardRenderFn render, void* ctx, int jobs,
+                      ShardSummary* summary) {
+    if (jobs < 1) jobs = 1;
+    ShardJob job = { directory, separator_after(directory), files, render, ctx, calloc(jobs, sizeof(ShardBuffer)) };
+    int status = job.buffers ? 0 : -1;
+    for (int w = 0; status == 0 && w < jobs; w++) {
+        if (output_sink_init(&job.buffers[w].sink, 1 << 16, buffer_write, &job.buffers[w]) != 0) status = -1;
+    }
+    if (status == 0) work_pool_run(jobs, count, write_task, &job);
+
+    for (int w = 0; job.buffers && w < jobs; w++) {
+        ShardBuffer* buffer = &job.buffers[w];
+        if (buffer->failed) status = -1;
+        summary->written += buffer->summary.written;
+        summary->unchanged += buffer->summary.unchanged;
+        summary->bytes_written += buffer->summary.bytes_written;
+        output_sink_free(&buffer->sink);
+        free(buffer->data);
+        free(buffer->disk);
+    }
+    free(job.buffers);
+    return status;
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static int has_suffix(const char* str, const char* suffix) {
+    size_t str_len = strlen(str);
+    size_t suffix_len = strlen(suffix);
+    return str_len >= suffix_len && strcmp(str + str_len - suffix_len, suffix) == 0;
+}
+
+typedef struct {
+    const char** kept; // Paths of the files to keep, sorted
+    int count;
+    const char* extension;
+    size_t root_length; // Of the directory and its separator
+    ShardSummary* summary;
+} PruneWalk;
+
+static void prune_below(const PruneWalk* walk, const char* directory, int depth) {
+    DIR* dir = depth <= MAX_PRUNE_DEPTH ? opendir(directory) : NULL;
+    if (!dir) return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char path[MAX_PATH_LENGTH];
+        int written = snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        struct stat st;
+        if (written < 0 || written >= (int)sizeof(path) || lstat(path, &st) != 0) continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            // Fails unless the walk left it empty
+            prune_below(walk, path, depth + 1);
+            rmdir(path);
+        } else if (S_ISREG(st.st_mode) && has_suffix(entry->d_name, walk->extension)) {
+            const char* relative = path + walk->root_length;
+            if (bsearch(&relative, walk->kept, walk->count, sizeof(const char*), compare_paths)) continue;
+            if (remove(path) == 0) walk->summary->removed++;
+        }
+    }
+    closedir(dir);
+}
+
+void shard_files_prune(const char* directory, const char* subdirectory, const ShardFile* files, int count,
+                       const char* extension, ShardSummary* summary) {
+    const char** kept = malloc((count ? count : 1) * sizeof(const char*));
+    if (!kept) return;
+    for (int i = 0; i < count; i++) kept[i] = files[i].path;
+    qsort(kept, count, sizeof(const char*), compare_paths);
+
+    const char* separator = separator_after(directory);
+    char root[MAX_PATH_LENGTH];
+    int written = snprintf(root, sizeof(root), "%s%s%s", directory, separator, subdirectory);
+    PruneWalk walk = { kept, count, extension, strlen(directory) + strlen(separator), summary };
+    if (written > 0 && written < (int)sizeof(root)) prune_below(&walk, root, 0);
+    free(kept);
+}
@@ -0,0 +1,40 @@
+#ifndef SHARD_FILES_H
+#define SHARD_FILES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "output_sink.h"
+
+// Generated files below one directory, written only where their content
+// changed so file watchers and caches downstream see nothing else. Each
+// file is rendered into memory, compared with the one on disk and, when it
+// differs, written to a temporary file renamed over it.
+typedef struct {
+    const char* path; // Below the directory: "paths/api/v1/users.json"
+    uint64_t hash;    // Of the rendered content (hash_bytes())
+} ShardFile;
+
+typedef struct {
+    int written;   // Files created or replaced
+    int unchanged; // Files whose content was already on disk
+    int removed;   // Files shard_files_prune() deleted
+    size_t bytes_written;
+} ShardSummary;
+
+// Renders file `index` into `sink`; called on the worker threads
+typedef void (*ShardRenderFn)(void* ctx, int index, OutputSink* sink);
+
+// Renders `count` files on `jobs` threads, fills in their hashes and writes
+// those that changed, creating directories as needed. Adds to `summary`.
+// Returns -1 when a file could not be written.
+int shard_files_write(const char* directory, ShardFile* files, int count, ShardRenderFn render, void* ctx, int jobs,
+                      ShardSummary* summary);
+
+// Deletes the files ending in `extension` below `subdirectory` of
+// `directory` that are not among `files`, and the directories that leaves
+// empty. Adds to `summary`.
+void shard_files_prune(const char* directory, const char* subdirectory, const ShardFile* files, int count,
+                       const char* extension, ShardSummary* summary);
+
+#endif
@@ -0,0 +1,83 @@
+#include "source_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int read_all(int fd, SourceFile* file) {
+    size_t capacity = 64 * 1024;
+    size_t size = 0;
+    char* buffer = malloc(capacity);
+    if (!buffer) return -1;
+
+    for (;;) {
+        if (size == capacity) {
+            char* grown = realloc(buffer, capacity * 2);
+            if (!grown) {
+                free(buffer);
+                errno = ENOMEM;
+                return -1;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+        ssize_t n = read(fd, buffer + size, capacity - size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(buffer);
+            return -1;
+        }
+        if (n == 0) break;
+        size += n;
+    }
+
+    file->data = buffer;
+    file->size = size;
+    file->mapped = 0;
+    return 0;
+}
+
+int source_file_open_fd(SourceFile* file, int fd) {
+    memset(file, 0, sizeof(SourceFile));
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+#endif
+            file->data = data;
+            file->size = st.st_size;
+            file->mapped = 1;
+            return 0;
+        }
+    }
+    return read_all(fd, file);
+}
+
+int source_file_open(SourceFile* file, const char* path) {
+    memset(file, 0, sizeof(SourceFile));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    int result = source_file_open_fd(file, fd);
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return result;
+}
+
+void source_file_close(SourceFile* file) {
+    if (file->mapped) {
+        munmap((void*)file->data, file->size);
+    } else {
+        free((void*)file->data);
+    }
+    memset(file, 0, sizeof(SourceFile));
+}
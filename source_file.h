@@ -0,0 +1,22 @@
+#ifndef SOURCE_FILE_H
+#define SOURCE_FILE_H
+
+#include <stddef.h>
+
+// Read-only view of a whole file. Regular files are memory-mapped; anything
+// that cannot be mapped (pipes, empty files) is read into a heap buffer.
+typedef struct {
+    const char* data;
+    size_t size;
+    int mapped;
+} SourceFile;
+
+// Returns 0 on success, -1 with errno set on failure.
+int source_file_open(SourceFile* file, const char* path);
+
+// Same for a descriptor the caller opened and closes again: a regular file
+// is mapped whole whatever its offset, anything else is read to its end.
+int source_file_open_fd(SourceFile* file, int fd);
+void source_file_close(SourceFile* file);
+
+#endif
@@ -0,0 +1,332 @@
+#include "spec_diff.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "openapi_writer.h"
+#include "work_pool.h"
+
+#define FNV_OFFSET 1469598103934665603ULL
+#define FNV_PRIME 1099511628211ULL
+
+// A resource reduced to what the diff looks at
+typedef struct {
+    const ResourceInfo* resource;
+    const char* key; // Declared class name
+    uint64_t fingerprint;
+    PathOperationList operations;
+    int next;    // Next resource of the same spec with the same key, or -1
+    int partner; // Resource of the other spec it is compared with, or -1
+    int failed;  // Ran out of memory collecting its operations
+} ResourcePrint;
+
+typedef struct {
+    ResourcePrint* prints;
+    Arena* arenas; // One per worker
+} PrintJob;
+
+// Key -> first resource with that key, chained through ResourcePrint.next
+typedef struct {
+    const char* key;
+    int first;
+} PrintSlot;
+
+// Operations of the new spec, by verb and path
+typedef struct {
+    const PathOperation** slots;
+    size_t capacity;
+} OperationSet;
+
+// FNV-1a over the string and its terminator, so concatenations stay apart
+static uint64_t hash_text(uint64_t hash, const char* str) {
+    for (const char* p = str ? str : ""; *p; p++) hash = (hash ^ (unsigned char)*p) * FNV_PRIME;
+    return hash * FNV_PRIME;
+}
+
+// Spreads one element's hash over all bits before it is summed into a
+// fingerprint; a sum does not depend on the order of the elements
+static uint64_t mix(uint64_t hash) {
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+// The index-th field clients may write: the declared list, else every
+// attribute and then every relationship. SYMBOL_NONE past the end.
+static Symbol writable_field(const ResourceInfo* resource, const SymbolList* declared, int index) {
+    if (declared->count > 0) return index < declared->count ? declared->items[index] : SYMBOL_NONE;
+    const SymbolList* attributes = resource_attributes(resource);
+    if (index < attributes->count) return attributes->items[index];
+    index -= attributes->count;
+    const RelationList* relations = resource_relations(resource);
+    return index < relations->count ? relations->items[index].name : SYMBOL_NONE;
+}
+
+static int is_writable(const ResourceInfo* resource, const SymbolList* declared, Symbol name) {
+    Symbol field;
+    for (int i = 0; (field = writable_field(resource, declared, i)) != SYMBOL_NONE; i++) {
+        if (field == name) return 1;
+    }
+    return 0;
+}
+
+static uint64_t hash_fields(const ResourceInfo* resource, const SymbolList* declared, const char* tag) {
+    uint64_t fingerprint = 0;
+    Symbol field;
+    for (int i = 0; (field = writable_field(resource, declared, i)) != SYMBOL_NONE; i++) {
+        fingerprint += mix(hash_text(hash_text(FNV_OFFSET, tag), symbol_name(field)));
+    }
+    return fingerprint;
+}
+
+static void print_resource_task(void* ctx, size_t index, int worker_id) {
+    PrintJob* job = ctx;
+    ResourcePrint* print = &job->prints[index];
+    const ResourceInfo* resource = print->resource;
+    if (openapi_resource_operations(resource, &print->operations, &job->arenas[worker_id]) != 0) {
+        print->failed = 1;
+        return;
+    }
+
+    uint64_t fingerprint = 0;
+    for (int i = 0; i < print->operations.count; i++) {
+        const PathOperation* operation = &print->operations.items[i];
+        fingerprint += mix(hash_text(hash_text(hash_text(FNV_OFFSET, "operation"), operation->verb), operation->path));
+    }
+    const FilterList* filters = resource_filters(resource);
+    for (int i = 0; i < filters->count; i++) {
+        ColumnType type = model_filter_type(resource, &filters->items[i]);
+        uint64_t hash = hash_text(hash_text(FNV_OFFSET, "filter"), symbol_name(filters->items[i].name));
+        fingerprint += mix(hash_text(hash_text(hash, type.type), type.format));
+    }
+    fingerprint += hash_fields(resource, resource_creatable_fields(resource), "creatable");
+    fingerprint += hash_fields(resource, resource_updatable_fields(resource), "updatable");
+    print->fingerprint = fingerprint;
+}
+
+// Fingerprints every resource that is part of the document (abstract ones are not)
+static ResourcePrint* print_resources(const ApiSpec* spec, int jobs, Arena* arena, int* count) {
+    *count = 0;
+    ResourcePrint* prints = arena_calloc(arena, spec->resources.count + 1, sizeof(ResourcePrint));
+    Arena* arenas = calloc(jobs, sizeof(Arena));
+    if (!prints || !arenas) {
+        free(arenas);
+        return NULL;
+    }
+    for (int i = 0; i < spec->resources.count; i++) {
+        const ResourceInfo* resource = &spec->resources.items[i];
+        if (resource->abstract) continue;
+        ResourcePrint* print = &prints[(*count)++];
+        print->resource = resource;
+        print->key = has_text(resource->declared_name) ? resource->declared_name
+                     : has_text(resource->class_name)  ? resource->class_name
+                                                       : resource->source_path;
+        print->next = -1;
+        print->partner = -1;
+    }
+
+    PrintJob job = { prints, arenas };
+    work_pool_run(jobs, *count, print_resource_task, &job);
+    for (int i = 0; i < jobs; i++) arena_adopt(arena, &arenas[i]);
+    free(arenas);
+    for (int i = 0; i < *count; i++) {
+        if (prints[i].failed) return NULL;
+    }
+    return prints;
+}
+
+static uint64_t hash_key(const char* key) {
+    return hash_text(FNV_OFFSET, key);
+}
+
+static PrintSlot* find_print(PrintSlot* slots, size_t capacity, const char* key) {
+    size_t mask = capacity - 1;
+    for (size_t i = hash_key(key) & mask;; i = (i + 1) & mask) {
+        if (!slots[i].key || strcmp(slots[i].key, key) == 0) return &slots[i];
+    }
+}
+
+// Pairs every new resource with the first old one of the same key that has
+// no partner yet; counts the new resources left over as added
+static int pair_resources(SpecDiff* diff, ResourcePrint* before, int before_count, ResourcePrint* after,
+                          int after_count) {
+    size_t capacity = 16;
+    while (capacity < (size_t)before_count * 2) capacity *= 2;
+    PrintSlot* slots = calloc(capacity, sizeof(PrintSlot));
+    if (!slots) return -1;
+    // Inserted back to front so every chain runs in spec order
+    for (int i = before_count - 1; i >= 0; i--) {
+        PrintSlot* slot = find_print(slots, capacity, before[i].key);
+        before[i].next = slot->key ? slot->first : -1;
+        slot->key = before[i].key;
+        slot->first = i;
+    }
+
+    for (int j = 0; j < after_count; j++) {
+        const PrintSlot* slot = find_print(slots, capacity, after[j].key);
+        int i = slot->key ? slot->first : -1;
+        while (i >= 0 && before[i].partner >= 0) i = before[i].next;
+        if (i < 0) {
+            diff->added++;
+            continue;
+        }
+        before[i].partner = j;
+        after[j].partner = i;
+    }
+    free(slots);
+    return 0;
+}
+
+static uint64_t hash_operation(const char* verb, const char* path) {
+    return hash_text(hash_text(FNV_OFFSET, verb), path);
+}
+
+static const PathOperation** find_operation(const OperationSet* set, const char* verb, const char* path) {
+    size_t mask = set->capacity - 1;
+    for (size_t i = hash_operation(verb, path) & mask;; i = (i + 1) & mask) {
+        const PathOperation* operation = set->slots[i];
+        if (!operation || (strcmp(operation->verb, verb) == 0 && strcmp(operation->path, path) == 0)) {
+            return &set->slots[i];
+        }
+    }
+}
+
+static int build_operation_set(OperationSet* set, const ResourcePrint* prints, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) total += prints[i].operations.count;
+    set->capacity = 16;
+    while (set->capacity < total * 2) set->capacity *= 2;
+    set->slots = calloc(set->capacity, sizeof(PathOperation*));
+    if (!set->slots) return -1;
+    for (int i = 0; i < count; i++) {
+        for (int o = 0; o < prints[i].operations.count; o++) {
+            const PathOperation* operation = &prints[i].operations.items[o];
+            *find_operation(set, operation->verb, operation->path) = operation;
+        }
+    }
+    return 0;
+}
+
+static SpecChange* add_change(SpecDiff* diff, SpecChangeKind kind, const ResourcePrint* print) {
+    SpecChange* change = ARENA_PUSH(&diff->arena, *diff);
+    if (!change) return NULL;
+    change->kind = kind;
+    change->resource = print->key;
+    return change;
+}
+
+static int same_text(const char* a, const char* b) {
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+// Whether a filter of type `after` accepts fewer values than one of type
+// `before`: plain strings take anything and integers fit into numbers
+static int narrows(ColumnType before, ColumnType after) {
+    if (same_text(before.type, after.type) && (!after.format || same_text(before.format, after.format))) return 0;
+    if (!after.format && same_text(after.type, "string")) return 0;
+    if (!after.format && same_text(after.type, "number") && same_text(before.type, "integer")) return 0;
+    return 1;
+}
+
+static int compare_filters(SpecDiff* diff, const ResourcePrint* before, const ResourcePrint* after) {
+    const FilterList* old_filters = resource_filters(before->resource);
+    const FilterList* new_filters = resource_filters(after->resource);
+    for (int i = 0; i < old_filters->count; i++) {
+        const Filter* filter = &old_filters->items[i];
+        const Filter* kept = NULL;
+        for (int k = 0; k < new_filters->count && !kept; k++) {
+            if (new_filters->items[k].name == filter->name) kept = &new_filters->items[k];
+        }
+        if (!kept) {
+            SpecChange* change = add_change(diff, SPEC_CHANGE_FILTER_REMOVED, before);
+            if (!change) return -1;
+            change->name = filter->name;
+            continue;
+        }
+        ColumnType old_type = model_filter_type(before->resource, filter);
+        ColumnType new_type = model_filter_type(after->resource, kept);
+        if (!narrows(old_type, new_type)) continue;
+        SpecChange* change = add_change(diff, SPEC_CHANGE_FILTER_NARROWED, before);
+        if (!change) return -1;
+        change->name = filter->name;
+        change->before = old_type;
+        change->after = new_type;
+    }
+    return 0;
+}
+
+static int compare_fields(SpecDiff* diff, const ResourcePrint* before, const SymbolList* old_declared,
+                          const ResourcePrint* after, const SymbolList* new_declared, SpecChangeKind kind) {
+    Symbol field;
+    for (int i = 0; (field = writable_field(before->resource, old_declared, i)) != SYMBOL_NONE; i++) {
+        if (is_writable(after->resource, new_declared, field)) continue;
+        SpecChange* change = add_change(diff, kind, before);
+        if (!change) return -1;
+        change->name = field;
+    }
+    return 0;
+}
+
+static int compare_resource(SpecDiff* diff, const ResourcePrint* before, const ResourcePrint* after,
+                            OperationSet* served, const ResourcePrint* after_prints, int after_count) {
+    // Operations are looked up in the whole new spec, so one that moved to another resource stays
+    for (int o = 0; o < before->operations.count; o++) {
+        const PathOperation* operation = &before->operations.items[o];
+        if (!served->slots && build_operation_set(served, after_prints, after_count) != 0) return -1;
+        if (*find_operation(served, operation->verb, operation->path)) continue;
+        SpecChange* change = add_change(diff, SPEC_CHANGE_PATH_REMOVED, before);
+        if (!change) return -1;
+        change->verb = operation->verb;
+        change->path = operation->path;
+    }
+    if (!after) return 0;
+
+    const ResourceInfo* old_resource = before->resource;
+    const ResourceInfo* new_resource = after->resource;
+    if (compare_filters(diff, before, after) != 0 ||
+        compare_fields(diff, before, resource_creatable_fields(old_resource), after,
+                       resource_creatable_fields(new_resource), SPEC_CHANGE_NOT_CREATABLE) != 0 ||
+        compare_fields(diff, before, resource_updatable_fields(old_resource), after,
+                       resource_updatable_fields(new_resource), SPEC_CHANGE_NOT_UPDATABLE) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+void spec_diff_init(SpecDiff* diff) {
+    memset(diff, 0, sizeof(SpecDiff));
+    arena_init(&diff->arena);
+}
+
+void spec_diff_free(SpecDiff* diff) {
+    arena_reset(&diff->arena);
+    memset(diff, 0, sizeof(SpecDiff));
+}
+
+int spec_diff_compare(SpecDiff* diff, const ApiSpec* before, const ApiSpec* after, int jobs) {
+    int before_count = 0;
+    int after_count = 0;
+    ResourcePrint* old_prints = print_resources(before, jobs, &diff->arena, &before_count);
+    ResourcePrint* new_prints = old_prints ? print_resources(after, jobs, &diff->arena, &after_count) : NULL;
+    if (!new_prints || pair_resources(diff, old_prints, before_count, new_prints, after_count) != 0) return -1;
+
+    // Built on the first resource that lost something, never when all fingerprints match
+    OperationSet served = { NULL, 0 };
+    int status = 0;
+    for (int i = 0; i < before_count && status == 0; i++) {
+        const ResourcePrint* print = &old_prints[i];
+        const ResourcePrint* partner = print->partner >= 0 ? &new_prints[print->partner] : NULL;
+        if (partner && partner->fingerprint == print->fingerprint) {
+            diff->unchanged++;
+            continue;
+        }
+        if (partner) diff->changed++;
+        else diff->removed++;
+        status = compare_resource(diff, print, partner, &served, new_prints, after_count);
+    }
+    free(served.slots);
+    return status;
+}
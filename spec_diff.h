@@ -0,0 +1,52 @@
+#ifndef SPEC_DIFF_H
+#define SPEC_DIFF_H
+
+#include "api_spec.h"
+#include "model_schema.h"
+
+typedef enum {
+    SPEC_CHANGE_PATH_REMOVED,    // An operation that no resource serves any more
+    SPEC_CHANGE_FILTER_REMOVED,
+    SPEC_CHANGE_FILTER_NARROWED, // Same filter, a type that accepts fewer values
+    SPEC_CHANGE_NOT_CREATABLE,   // A field that left creatable_fields
+    SPEC_CHANGE_NOT_UPDATABLE,   // A field that left updatable_fields
+} SpecChangeKind;
+
+// One breaking change; strings point into the compared specs or the diff's arena
+typedef struct {
+    SpecChangeKind kind;
+    const char* resource; // Declared class name in the old tree
+    const char* verb;     // Removed operation: "get", "post", ...
+    const char* path;
+    Symbol name;          // Filter or field
+    ColumnType before;    // Filter types of a narrowing
+    ColumnType after;
+} SpecChange;
+
+typedef struct {
+    Arena arena;
+    SpecChange* items;
+    int count;
+    int capacity;
+    int unchanged; // Resources skipped because their fingerprints match
+    int changed;
+    int added;
+    int removed;
+} SpecDiff;
+
+void spec_diff_init(SpecDiff* diff);
+void spec_diff_free(SpecDiff* diff);
+
+// Lists what `after` breaks for clients of `before`: removed operations,
+// removed or narrowed filters, and fields that left creatable_fields or
+// updatable_fields (both default to every attribute and relationship when
+// a resource does not declare them). Resources are paired by declared
+// class name. Each one is first reduced to a 64-bit fingerprint of its
+// operations, filter types and writable fields, computed on `jobs` threads,
+// so a pair with equal fingerprints is skipped without looking further.
+// An operation that moved to another resource is not reported. Run
+// class_graph_resolve() and match_resource_routes() on both specs first.
+// Returns -1 when out of memory.
+int spec_diff_compare(SpecDiff* diff, const ApiSpec* before, const ApiSpec* after, int jobs);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SPEC_EMITTER_H
+#define SPEC_EMITTER_H
+
+#include "output_sink.h"
+
+// Event interface the OpenAPI walker drives: one call per container, key and
+// scalar, in document order. Implementations serialize the events directly
+// (json_writer.c) or build a document from them.
+typedef struct SpecEmitter SpecEmitter;
+
+struct SpecEmitter {
+    void (*begin_object)(SpecEmitter* emitter);
+    void (*end_object)(SpecEmitter* emitter);
+    void (*begin_array)(SpecEmitter* emitter);
+    void (*end_array)(SpecEmitter* emitter);
+    // Names the next value of the enclosing object
+    void (*key)(SpecEmitter* emitter, const char* key);
+    void (*string)(SpecEmitter* emitter, const char* value);
+    void (*boolean)(SpecEmitter* emitter, int value);
+    void (*integer)(SpecEmitter* emitter, long long value);
+
+    // Optional, NULL where values cannot be written out of order (a document
+    // builder). Right after a key, fork() copies the emitter into `copy`
+    // (fork_size bytes) writing to `sink`, so the copy serializes the value
+    // exactly as the emitter would; the emitter itself is only read, so
+    // several threads may fork it at once. splice() then writes a value
+    // serialized that way after a later key of the same object.
+    size_t fork_size;
+    SpecEmitter* (*fork)(const SpecEmitter* emitter, void* copy, OutputSink* sink);
+    void (*splice)(SpecEmitter* emitter, const char* data, size_t size);
+};
+
+static inline void emit_key_string(SpecEmitter* emitter, const char* key, const char* value) {
+    emitter->key(emitter, key);
+    emitter->string(emitter, value);
+}
+
+static inline void emit_key_integer(SpecEmitter* emitter, const char* key, long long value) {
+    emitter->key(emitter, key);
+    emitter->integer(emitter, value);
+}
+
+#endif
@@ -0,0 +1,25 @@
+#include "spec_format.h"
+
+#include "cbor_writer.h"
+#include "json_writer.h"
+#include "yaml_writer.h"
+
+int spec_format_emit(SpecFormat format, OutputSink* sink, SpecWalkFn walk, void* ctx) {
+    int status;
+    if (format == SPEC_FORMAT_YAML) {
+        YamlWriter writer;
+        yaml_writer_init(&writer, sink);
+        status = walk(ctx, &writer.emitter);
+    } else if (format == SPEC_FORMAT_CBOR) {
+        CborWriter writer;
+        cbor_writer_init(&writer, sink);
+        return walk(ctx, &writer.emitter);
+    } else {
+        JsonWriter writer;
+        json_writer_init(&writer, sink, format == SPEC_FORMAT_JSON);
+        status = walk(ctx, &writer.emitter);
+    }
+    // Text formats end with a newline
+    output_sink_putc(sink, '\n');
+    return status;
+}
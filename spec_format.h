@@ -0,0 +1,23 @@
+#ifndef SPEC_FORMAT_H
+#define SPEC_FORMAT_H
+
+#include "output_sink.h"
+#include "spec_emitter.h"
+
+// The formats a spec is written in and the writer behind each, shared by
+// the command and the library so both serialize a document the same way.
+typedef enum {
+    SPEC_FORMAT_JSON,     // Indented
+    SPEC_FORMAT_JSON_MIN, // Without whitespace
+    SPEC_FORMAT_YAML,
+    SPEC_FORMAT_CBOR
+} SpecFormat;
+
+// Emits a whole document into `emitter`; returns 0 on success, -1 on failure.
+typedef int (*SpecWalkFn)(void* ctx, SpecEmitter* emitter);
+
+// Runs `walk` into the writer of `format` over `sink`. Text formats end
+// with a newline. Returns what `walk` returns.
+int spec_format_emit(SpecFormat format, OutputSink* sink, SpecWalkFn walk, void* ctx);
+
+#endif
@@ -0,0 +1,330 @@
+#include "spec_server.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "json_writer.h"
+#include "openapi_writer.h"
+#include "output_sink.h"
+
+#define MAX_REQUEST_LENGTH 1024
+#define REQUEST_TIMEOUT_SEC 5
+#define RESPONSE_TIMEOUT_SEC 30 // For the whole response, however slowly the client reads it
+
+typedef struct {
+    ApiSpec spec;      // Own copy, never modified
+    char* document;    // Whole spec, rendered when published
+    size_t document_size;
+    long number;
+    int refs;          // The server's reference plus one per running request
+} Snapshot;
+
+struct SpecServer {
+    int fd;
+    char* socket_path;
+    int pretty;
+    int jobs; // Threads that render a published snapshot
+    pthread_t* threads;
+    int thread_count;
+    pthread_mutex_t lock; // Guards `current` and every snapshot's refs
+    Snapshot* current;
+    long published;
+    int stopping;
+};
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+static int buffer_write(void* ctx, const char* data, size_t size) {
+    Buffer* buffer = ctx;
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 1 << 16;
+        while (capacity < buffer->size + size) capacity *= 2;
+        char* grown = realloc(buffer->data, capacity);
+        if (!grown) return -1;
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+    return 0;
+}
+
+typedef enum {
+    RENDER_SPEC,
+    RENDER_PREFIX,
+    RENDER_SCHEMA
+} RenderKind;
+
+// Renders into `buffer` (the whole spec on `jobs` threads); returns 1 when a
+// schema does not exist, -1 when out of memory
+static int render(const ApiSpec* spec, int pretty, int jobs, RenderKind kind, const char* arg, Buffer* buffer) {
+    OutputSink sink;
+    if (output_sink_init(&sink, 1 << 16, buffer_write, buffer) != 0) return -1;
+    JsonWriter writer;
+    json_writer_init(&writer, &sink, pretty);
+    int status = kind == RENDER_PREFIX   ? openapi_emit_prefix(spec, &writer.emitter, arg)
+                 : kind == RENDER_SCHEMA ? openapi_emit_schema(spec, &writer.emitter, arg)
+                                         : openapi_emit_parallel(spec, &writer.emitter, NULL, jobs);
+    output_sink_putc(&sink, '\n');
+    if (output_sink_flush(&sink) != 0 && status == 0) status = -1;
+    output_sink_free(&sink);
+    return status;
+}
+
+static void snapshot_free(Snapshot* snapshot) {
+    api_spec_reset(&snapshot->spec);
+    free(snapshot->document);
+    free(snapshot);
+}
+
+static Snapshot* acquire(SpecServer* server) {
+    pthread_mutex_lock(&server->lock);
+    Snapshot* snapshot = server->current;
+    if (snapshot) snapshot->refs++;
+    pthread_mutex_unlock(&server->lock);
+    return snapshot;
+}
+
+static void release(SpecServer* server, Snapshot* snapshot) {
+    if (!snapshot) return;
+    pthread_mutex_lock(&server->lock);
+    int last = --snapshot->refs == 0;
+    pthread_mutex_unlock(&server->lock);
+    if (last) snapshot_free(snapshot);
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Sends all of `data` by `deadline` (now_ms()); returns -1 if the client
+// went away or did not take it in time, and the connection is dropped
+static int send_all(int fd, const char* data, size_t size, int64_t deadline) {
+    while (size > 0) {
+        int64_t left = deadline - now_ms();
+        if (left <= 0) return -1;
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        int ready = poll(&pfd, 1, (int)left);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) return -1;
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+            return -1;
+        }
+        data += sent;
+        size -= (size_t)sent;
+    }
+    return 0;
+}
+
+static void send_response(int fd, long number, const char* body, size_t size) {
+    int64_t deadline = now_ms() + RESPONSE_TIMEOUT_SEC * 1000;
+    char header[64];
+    int len = snprintf(header, sizeof(header), "OK %ld %zu\n", number, size);
+    if (send_all(fd, header, (size_t)len, deadline) == 0 && size > 0) send_all(fd, body, size, deadline);
+}
+
+static void send_error(int fd, const char* message, const char* arg) {
+    char line[MAX_REQUEST_LENGTH + 64];
+    int len = snprintf(line, sizeof(line), "ERROR %s%s%s\n", message, arg ? " " : "", arg ? arg : "");
+    if (len > (int)sizeof(line) - 1) len = (int)sizeof(line) - 1;
+    send_all(fd, line, (size_t)len, now_ms() + RESPONSE_TIMEOUT_SEC * 1000);
+}
+
+// Reads the request line; returns its length without the newline, or -1
+static int read_request(int fd, char* request, size_t size) {
+    size_t used = 0;
+    while (used + 1 < size) {
+        ssize_t n = recv(fd, request + used, size - 1 - used, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        char* newline = memchr(request + used, '\n', (size_t)n);
+        used += (size_t)n;
+        if (newline) {
+            used = (size_t)(newline - request);
+            break;
+        }
+    }
+    while (used > 0 && (request[used - 1] == '\r' || request[used - 1] == ' ')) used--;
+    request[used] = '\0';
+    return used > 0 ? (int)used : -1;
+}
+
+static void serve_connection(SpecServer* server, int fd) {
+    char request[MAX_REQUEST_LENGTH];
+    if (read_request(fd, request, sizeof(request)) < 0) return;
+
+    // "<command> [argument]"
+    char* arg = strchr(request, ' ');
+    if (arg) {
+        *arg++ = '\0';
+        while (*arg == ' ') arg++;
+    }
+
+    Snapshot* snapshot = acquire(server);
+    if (!snapshot) {
+        send_error(fd, "no snapshot yet", NULL);
+        return;
+    }
+
+    if (strcmp(request, "spec") == 0) {
+        send_response(fd, snapshot->number, snapshot->document, snapshot->document_size);
+    } else if (strcmp(request, "version") == 0) {
+        send_response(fd, snapshot->number, NULL, 0);
+    } else if (strcmp(request, "prefix") == 0 || strcmp(request, "schema") == 0) {
+        RenderKind kind = request[0] == 'p' ? RENDER_PREFIX : RENDER_SCHEMA;
+        Buffer buffer = { 0 };
+        int status = arg && *arg ? render(&snapshot->spec, server->pretty, 1, kind, arg, &buffer) : -2;
+        if (status == 0) send_response(fd, snapshot->number, buffer.data, buffer.size);
+        else if (status == -2) send_error(fd, "missing argument for", request);
+        else if (status == 1) send_error(fd, "no schema named", arg);
+        else send_error(fd, "out of memory", NULL);
+        free(buffer.data);
+    } else {
+        send_error(fd, "unknown request", request);
+    }
+    release(server, snapshot);
+}
+
+static void* serve_requests(void* ctx) {
+    SpecServer* server = ctx;
+    for (;;) {
+        int fd = accept(server->fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break; // Closed by spec_server_close()
+        }
+        pthread_mutex_lock(&server->lock);
+        int stopping = server->stopping;
+        pthread_mutex_unlock(&server->lock);
+        if (!stopping) {
+            // A client that never finishes its request line, or does not
+            // read the response, only holds up this thread, and not for long:
+            // its connection is dropped (send_all())
+            struct timeval timeout = { REQUEST_TIMEOUT_SEC, 0 };
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            serve_connection(server, fd);
+        }
+        close(fd);
+        if (stopping) break;
+    }
+    return NULL;
+}
+
+// Removes a socket file whose server no longer answers; returns -1 if one does
+static int remove_stale_socket(const struct sockaddr_un* address) {
+    struct stat st;
+    if (stat(address->sun_path, &st) != 0 || !S_ISSOCK(st.st_mode)) return 0;
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) return -1;
+    int alive = connect(probe, (const struct sockaddr*)address, sizeof(*address)) == 0;
+    close(probe);
+    if (alive) return -1;
+    unlink(address->sun_path);
+    return 0;
+}
+
+SpecServer* spec_server_open(const char* socket_path, int threads, int pretty) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        printf("Error: Socket path %s is too long\n", socket_path);
+        return NULL;
+    }
+    strcpy(address.sun_path, socket_path);
+    if (remove_stale_socket(&address) != 0) {
+        printf("Error: Another server is listening on %s\n", socket_path);
+        return NULL;
+    }
+
+    SpecServer* server = calloc(1, sizeof(SpecServer));
+    if (!server) return NULL;
+    server->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    server->pretty = pretty;
+    server->jobs = threads > 0 ? threads : 1;
+    pthread_mutex_init(&server->lock, NULL);
+    if (server->fd < 0 || bind(server->fd, (const struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(server->fd, 64) != 0) {
+        printf("Error: Cannot listen on %s: %s\n", socket_path, strerror(errno));
+        if (server->fd >= 0) close(server->fd);
+        pthread_mutex_destroy(&server->lock);
+        free(server);
+        return NULL;
+    }
+    server->socket_path = strdup(socket_path);
+
+    server->threads = calloc(threads > 0 ? threads : 1, sizeof(pthread_t));
+    for (int i = 0; server->threads && i < threads; i++) {
+        if (pthread_create(&server->threads[i], NULL, serve_requests, server) != 0) break;
+        server->thread_count++;
+    }
+    if (server->thread_count == 0) {
+        printf("Error: Cannot start request threads for %s\n", socket_path);
+        spec_server_close(server);
+        return NULL;
+    }
+    return server;
+}
+
+long spec_server_publish(SpecServer* server, const ApiSpec* spec) {
+    Snapshot* snapshot = calloc(1, sizeof(Snapshot));
+    if (!snapshot) return -1;
+    if (api_spec_copy(spec, &snapshot->spec) != 0) {
+        free(snapshot);
+        return -1;
+    }
+    Buffer document = { 0 };
+    if (render(&snapshot->spec, server->pretty, server->jobs, RENDER_SPEC, NULL, &document) != 0) {
+        free(document.data);
+        snapshot_free(snapshot);
+        return -1;
+    }
+    snapshot->document = document.data;
+    snapshot->document_size = document.size;
+    snapshot->refs = 1;
+
+    pthread_mutex_lock(&server->lock);
+    Snapshot* previous = server->current;
+    long number = snapshot->number = ++server->published;
+    server->current = snapshot;
+    pthread_mutex_unlock(&server->lock);
+    release(server, previous);
+    return number;
+}
+
+void spec_server_close(SpecServer* server) {
+    if (!server) return;
+    pthread_mutex_lock(&server->lock);
+    server->stopping = 1;
+    pthread_mutex_unlock(&server->lock);
+    // Wakes the threads blocked in accept()
+    shutdown(server->fd, SHUT_RDWR);
+    for (int i = 0; i < server->thread_count; i++) pthread_join(server->threads[i], NULL);
+    close(server->fd);
+    if (server->socket_path) unlink(server->socket_path);
+
+    release(server, server->current);
+    pthread_mutex_destroy(&server->lock);
+    free(server->threads);
+    free(server->socket_path);
+    free(server);
+}
@@ -0,0 +1,35 @@
+#ifndef SPEC_SERVER_H
+#define SPEC_SERVER_H
+
+#include "api_spec.h"
+
+// Serves the spec over a Unix domain socket from resident snapshots. Every
+// connection sends one request line and gets one response:
+//
+//     spec              the whole document
+//     prefix /api/v1    the paths below /api/v1 and the schemas they use
+//     schema User       one schema of components/schemas
+//     version           nothing but the snapshot number
+//
+// The response is "OK <snapshot> <length>\n" followed by <length> bytes of
+// JSON, or "ERROR <message>\n". Requests are handled on several threads,
+// each against the snapshot that was current when it arrived, so readers
+// never wait for each other or for a new snapshot being published.
+typedef struct SpecServer SpecServer;
+
+// Listens on `socket_path` with `threads` request threads, and renders
+// published snapshots on as many; a socket file left behind by a server
+// that is gone is replaced. `pretty` selects indented JSON. Returns NULL
+// after printing an error.
+SpecServer* spec_server_open(const char* socket_path, int threads, int pretty);
+
+// Copies `spec` into a new snapshot, renders its whole document once and
+// makes it current; requests still running keep the old one until they
+// finish. Returns the snapshot number, or -1 when out of memory, in which
+// case the current snapshot stays.
+long spec_server_publish(SpecServer* server, const ApiSpec* spec);
+
+// Stops accepting, waits for running requests and removes the socket file.
+void spec_server_close(SpecServer* server);
+
+#endif
@@ -0,0 +1,135 @@
+#include "symbol_table.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+// Entries live in chunks that double in size and never move, so a symbol
+// is looked up without the lock: symbol s is entry s + FIRST_CHUNK_SIZE - 1
+// of a virtual array whose chunk k covers [FIRST_CHUNK_SIZE << k,
+// FIRST_CHUNK_SIZE << (k + 1)).
+#define FIRST_CHUNK_BITS 8
+#define FIRST_CHUNK_SIZE (1u << FIRST_CHUNK_BITS)
+#define MAX_CHUNKS (32 - FIRST_CHUNK_BITS)
+#define THREAD_CACHE_SIZE 1024
+
+typedef struct {
+    const char* name;
+    uint32_t length;
+    uint32_t hash;
+} SymbolEntry;
+
+static struct {
+    pthread_mutex_t lock;
+    SymbolEntry* chunks[MAX_CHUNKS];
+    uint32_t count;  // Symbols handed out; the next one is count + 1
+    Symbol* index;   // Open addressing by hash; SYMBOL_NONE marks a free slot
+    uint32_t capacity;
+    size_t entry_bytes;
+    Arena names;
+} table = { PTHREAD_MUTEX_INITIALIZER, { NULL }, 0, NULL, 0, 0, { 0 } };
+
+// Symbols this thread interned recently, by hash
+static __thread Symbol thread_cache[THREAD_CACHE_SIZE];
+
+static uint32_t hash_name(const char* str, size_t len) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) hash = (hash ^ (unsigned char)str[i]) * 1099511628211ULL;
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static SymbolEntry* entry_of(Symbol symbol) {
+    uint32_t position = symbol - 1 + FIRST_CHUNK_SIZE;
+    int top = 31 - __builtin_clz(position);
+    return &table.chunks[top - FIRST_CHUNK_BITS][position - (1u << top)];
+}
+
+static int matches(Symbol symbol, const char* str, size_t len, uint32_t hash) {
+    const SymbolEntry* entry = entry_of(symbol);
+    return entry->hash == hash && entry->length == len && memcmp(entry->name, str, len) == 0;
+}
+
+static int grow_index(void) {
+    uint32_t capacity = table.capacity ? table.capacity * 2 : 1024;
+    Symbol* index = calloc(capacity, sizeof(Symbol));
+    if (!index) return -1;
+    for (uint32_t i = 0; i < table.capacity; i++) {
+        Symbol symbol = table.index[i];
+        if (symbol == SYMBOL_NONE) continue;
+        uint32_t slot = entry_of(symbol)->hash & (capacity - 1);
+        while (index[slot] != SYMBOL_NONE) slot = (slot + 1) & (capacity - 1);
+        index[slot] = symbol;
+    }
+    free(table.index);
+    table.index = index;
+    table.capacity = capacity;
+    return 0;
+}
+
+// Adds a name the index does not hold yet; called with the lock held
+static Symbol add_symbol(const char* str, size_t len, uint32_t hash, uint32_t slot) {
+    Symbol symbol = table.count + 1;
+    uint32_t position = symbol - 1 + FIRST_CHUNK_SIZE;
+    int top = 31 - __builtin_clz(position);
+    SymbolEntry** chunk = &table.chunks[top - FIRST_CHUNK_BITS];
+    if (position == (1u << top) && !*chunk) {
+        *chunk = malloc(sizeof(SymbolEntry) << top);
+        if (!*chunk) return SYMBOL_NONE;
+        table.entry_bytes += sizeof(SymbolEntry) << top;
+    }
+
+    SymbolEntry* entry = &(*chunk)[position - (1u << top)];
+    entry->name = arena_strndup(&table.names, str, len);
+    if (!entry->name) return SYMBOL_NONE;
+    entry->length = (uint32_t)len;
+    entry->hash = hash;
+    table.index[slot] = symbol;
+    table.count++;
+    return symbol;
+}
+
+Symbol symbol_intern(const char* str, size_t len) {
+    uint32_t hash = hash_name(str, len);
+    Symbol* cached = &thread_cache[hash & (THREAD_CACHE_SIZE - 1)];
+    if (*cached != SYMBOL_NONE && matches(*cached, str, len, hash)) return *cached;
+
+    pthread_mutex_lock(&table.lock);
+    Symbol symbol = SYMBOL_NONE;
+    if ((table.count + 1) * 2 <= table.capacity || grow_index() == 0) {
+        uint32_t mask = table.capacity - 1;
+        uint32_t slot = hash & mask;
+        while (table.index[slot] != SYMBOL_NONE && !matches(table.index[slot], str, len, hash)) {
+            slot = (slot + 1) & mask;
+        }
+        symbol = table.index[slot] != SYMBOL_NONE ? table.index[slot] : add_symbol(str, len, hash, slot);
+    }
+    pthread_mutex_unlock(&table.lock);
+
+    *cached = symbol;
+    return symbol;
+}
+
+Symbol symbol_intern_cstr(const char* str) {
+    return symbol_intern(str, strlen(str));
+}
+
+const char* symbol_name(Symbol symbol) {
+    return symbol == SYMBOL_NONE ? NULL : entry_of(symbol)->name;
+}
+
+size_t symbol_length(Symbol symbol) {
+    return symbol == SYMBOL_NONE ? 0 : entry_of(symbol)->length;
+}
+
+int symbol_is(Symbol symbol, const char* str) {
+    return symbol != SYMBOL_NONE && strcmp(entry_of(symbol)->name, str) == 0;
+}
+
+void symbol_table_stats(SymbolTableStats* stats) {
+    pthread_mutex_lock(&table.lock);
+    stats->count = table.count;
+    stats->bytes = table.names.bytes_used + table.entry_bytes + (size_t)table.capacity * sizeof(Symbol);
+    pthread_mutex_unlock(&table.lock);
+}
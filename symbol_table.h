@@ -0,0 +1,46 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 32-bit handle of an interned identifier (attribute, filter, relation and
+// field names and types). Equal names have equal symbols, so comparing two
+// names is an integer compare. 0 is no name at all.
+typedef uint32_t Symbol;
+
+#define SYMBOL_NONE 0
+
+typedef struct {
+    Symbol* items;
+    int count;
+    int capacity;
+} SymbolList;
+
+// Returns the symbol of str[0..len), adding it to the process-wide table on
+// first sight. Safe to call from any thread; names seen before are usually
+// found in a per-thread cache without taking the table's lock. Returns
+// SYMBOL_NONE when out of memory.
+Symbol symbol_intern(const char* str, size_t len);
+Symbol symbol_intern_cstr(const char* str);
+
+// Canonical NUL-terminated copy of the name, valid for the rest of the
+// process; NULL for SYMBOL_NONE. Never takes a lock.
+const char* symbol_name(Symbol symbol);
+size_t symbol_length(Symbol symbol);
+
+static inline int symbol_has_text(Symbol symbol) {
+    return symbol_length(symbol) > 0;
+}
+
+// Whether `symbol` names `str`
+int symbol_is(Symbol symbol, const char* str);
+
+typedef struct {
+    size_t count; // Distinct names
+    size_t bytes; // Names, entries and index
+} SymbolTableStats;
+
+void symbol_table_stats(SymbolTableStats* stats);
+
+#endif
@@ -0,0 +1,172 @@
+#include "work_pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "diagnostics.h"
+
+// A worker's queue is a half-open slice [next, end) of task indices.
+// The owner takes from the front, thieves split off the back half.
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+} WorkQueue;
+
+typedef struct WorkPool WorkPool;
+
+typedef struct {
+    WorkPool* pool;
+    int id;
+    pthread_t thread;
+} Worker;
+
+struct WorkPool {
+    WorkQueue* queues;
+    Worker* workers;
+    int jobs;
+    WorkPoolTask fn;
+    void* ctx;
+};
+
+static int queue_pop(WorkQueue* queue, size_t* index) {
+    int ok = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->next < queue->end) {
+        *index = queue->next++;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok;
+}
+
+static size_t queue_size(WorkQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    size_t size = queue->end - queue->next;
+    pthread_mutex_unlock(&queue->lock);
+    return size;
+}
+
+// Moves the back half of the fullest victim's slice into `self`.
+static int steal(WorkPool* pool, int self) {
+    for (;;) {
+        int victim = -1;
+        size_t best = 0;
+        for (int i = 0; i < pool->jobs; i++) {
+            if (i == self) continue;
+            size_t size = queue_size(&pool->queues[i]);
+            if (size > best) {
+                best = size;
+                victim = i;
+            }
+        }
+        if (victim < 0) return 0;
+
+        WorkQueue* from = &pool->queues[victim];
+        size_t begin = 0, end = 0;
+        pthread_mutex_lock(&from->lock);
+        size_t remaining = from->end - from->next;
+        if (remaining > 0) {
+            size_t take = (remaining + 1) / 2;
+            end = from->end;
+            begin = end - take;
+            from->end = begin;
+        }
+        pthread_mutex_unlock(&from->lock);
+
+        // The victim may have drained its slice between the scan and the lock
+        if (begin == end) continue;
+
+        WorkQueue* to = &pool->queues[self];
+        pthread_mutex_lock(&to->lock);
+        to->next = begin;
+        to->end = end;
+        pthread_mutex_unlock(&to->lock);
+        return 1;
+    }
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    WorkPool* pool = worker->pool;
+    size_t index;
+
+    do {
+        while (queue_pop(&pool->queues[worker->id], &index)) {
+            pool->fn(pool->ctx, index, worker->id);
+        }
+    } while (steal(pool, worker->id));
+
+    return NULL;
+}
+
+int work_pool_default_jobs(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+int work_pool_run(int jobs, size_t count, WorkPoolTask fn, void* ctx) {
+    if (jobs < 1) jobs = 1;
+    if ((size_t)jobs > count) jobs = count > 0 ? (int)count : 1;
+
+    if (jobs == 1) {
+        for (size_t i = 0; i < count; i++) {
+            fn(ctx, i, 0);
+        }
+        return 1;
+    }
+
+    WorkPool pool = { 0 };
+    pool.jobs = jobs;
+    pool.fn = fn;
+    pool.ctx = ctx;
+    pool.queues = calloc(jobs, sizeof(WorkQueue));
+    pool.workers = calloc(jobs, sizeof(Worker));
+    if (!pool.queues || !pool.workers) {
+        free(pool.queues);
+        free(pool.workers);
+        for (size_t i = 0; i < count; i++) {
+            fn(ctx, i, 0);
+        }
+        return 1;
+    }
+
+    // Seed every worker with an equal contiguous slice
+    for (int i = 0; i < jobs; i++) {
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        pool.queues[i].next = count * i / jobs;
+        pool.queues[i].end = count * (i + 1) / jobs;
+    }
+
+    // Worker 0 runs on the calling thread
+    int started = 1;
+    for (int i = 1; i < jobs; i++) {
+        pool.workers[i].pool = &pool;
+        pool.workers[i].id = i;
+        if (pthread_create(&pool.workers[i].thread, NULL, worker_main, &pool.workers[i]) != 0) {
+            // Slices of workers that failed to start are stolen by the others
+            report_diagnostic(DIAGNOSTIC_WARNING, DIAGNOSTIC_NO_THREAD, NULL, "Could not start worker thread %d", i);
+            pool.workers[i].pool = NULL;
+            continue;
+        }
+        started++;
+    }
+
+    pool.workers[0].pool = &pool;
+    pool.workers[0].id = 0;
+    worker_main(&pool.workers[0]);
+
+    for (int i = 1; i < jobs; i++) {
+        if (pool.workers[i].pool) {
+            pthread_join(pool.workers[i].thread, NULL);
+        }
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    }
+    free(pool.queues);
+    free(pool.workers);
+    return started;
+}
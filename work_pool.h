@@ -0,0 +1,18 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stddef.h>
+
+// Task callback: processes item `index` on worker `worker_id` (0 <= worker_id < jobs).
+typedef void (*WorkPoolTask)(void* ctx, size_t index, int worker_id);
+
+// Runs `fn` once for every index in [0, count) on `jobs` threads.
+// Each worker starts with a contiguous slice of the index range and, once it
+// runs dry, steals half of the remaining slice of the busiest other worker.
+// Returns the number of workers actually used (1 means everything ran inline).
+int work_pool_run(int jobs, size_t count, WorkPoolTask fn, void* ctx);
+
+// Number of online CPUs, never less than 1.
+int work_pool_default_jobs(void);
+
+#endif
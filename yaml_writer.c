@@ -0,0 +1,191 @@
+#include "yaml_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+static const char spaces[] = "                                                                ";
+
+static void write_indent(OutputSink* sink, int width) {
+    while (width > 0) {
+        int chunk = width < (int)sizeof(spaces) - 1 ? width : (int)sizeof(spaces) - 1;
+        output_sink_write(sink, spaces, chunk);
+        width -= chunk;
+    }
+}
+
+// Plain scalars are limited to names, paths and sentences that no YAML 1.1
+// or 1.2 reader takes for a number, boolean, null or indicator
+static int is_plain(const char* str) {
+    static const char* const reserved[] = { "true", "false", "yes", "no", "on", "off", "y", "n", "null" };
+    char first = str[0];
+    if (!((first >= 'a' && first <= 'z') || (first >= 'A' && first <= 'Z') || first == '_' || first == '/')) {
+        return 0;
+    }
+    const char* p = str;
+    for (; *p; p++) {
+        char c = *p;
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.' ||
+              c == '/' || c == '-' || c == ' ')) {
+            return 0;
+        }
+    }
+    if (p[-1] == ' ') return 0;
+    for (size_t i = 0; i < sizeof(reserved) / sizeof(reserved[0]); i++) {
+        if (strcasecmp(str, reserved[i]) == 0) return 0;
+    }
+    return 1;
+}
+
+static void write_scalar(OutputSink* sink, const char* str) {
+    static const char hex[] = "0123456789abcdef";
+    if (is_plain(str)) {
+        output_sink_puts(sink, str);
+        return;
+    }
+
+    output_sink_putc(sink, '"');
+    const char* run = str;
+    for (const char* p = str; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 0x20 && c != '"' && c != '\\' && c != 0x7f) continue;
+
+        output_sink_write(sink, run, p - run);
+        run = p + 1;
+        switch (c) {
+            case '"': output_sink_write(sink, "\\\"", 2); break;
+            case '\\': output_sink_write(sink, "\\\\", 2); break;
+            case '\n': output_sink_write(sink, "\\n", 2); break;
+            case '\r': output_sink_write(sink, "\\r", 2); break;
+            case '\t': output_sink_write(sink, "\\t", 2); break;
+            default: {
+                char escaped[4] = { '\\', 'x', hex[c >> 4], hex[c & 15] };
+                output_sink_write(sink, escaped, sizeof(escaped));
+                break;
+            }
+        }
+    }
+    output_sink_write(sink, run, strlen(run));
+    output_sink_putc(sink, '"');
+}
+
+// Line break and indentation in front of an entry of the innermost container
+static void begin_entry(YamlWriter* writer) {
+    YamlFrame* frame = &writer->frames[writer->depth - 1];
+    if (frame->count++ == 0 && frame->same_line) return;
+    output_sink_putc(writer->sink, '\n');
+    write_indent(writer->sink, frame->indent);
+}
+
+// Separator in front of a scalar: after its key, or as an array item
+static void begin_value(YamlWriter* writer) {
+    if (writer->after_key) {
+        writer->after_key = 0;
+        output_sink_putc(writer->sink, ' ');
+        return;
+    }
+    if (writer->depth == 0) return;
+    begin_entry(writer);
+    output_sink_write(writer->sink, "- ", 2);
+}
+
+static void open_container(YamlWriter* writer, int is_array) {
+    if (writer->depth == YAML_WRITER_MAX_DEPTH) {
+        writer->sink->failed = 1;
+        return;
+    }
+    YamlFrame frame = { is_array, 0, 0, 1, 0 };
+    if (writer->depth > 0) {
+        const YamlFrame* parent = &writer->frames[writer->depth - 1];
+        frame.indent = parent->indent + 2;
+        if (writer->after_key) {
+            // Entries start on the lines below the key
+            writer->after_key = 0;
+            frame.same_line = 0;
+            frame.after_key = 1;
+        } else {
+            // An array item: the first entry goes right after its "- "
+            begin_entry(writer);
+            output_sink_write(writer->sink, "- ", 2);
+        }
+    }
+    writer->frames[writer->depth++] = frame;
+}
+
+static void close_container(YamlWriter* writer) {
+    if (writer->depth == 0) return;
+    const YamlFrame* frame = &writer->frames[--writer->depth];
+    if (frame->count > 0) return;
+    if (frame->after_key) output_sink_putc(writer->sink, ' ');
+    output_sink_write(writer->sink, frame->is_array ? "[]" : "{}", 2);
+}
+
+static void writer_begin_object(SpecEmitter* emitter) {
+    open_container((YamlWriter*)emitter, 0);
+}
+
+static void writer_begin_array(SpecEmitter* emitter) {
+    open_container((YamlWriter*)emitter, 1);
+}
+
+static void writer_end(SpecEmitter* emitter) {
+    close_container((YamlWriter*)emitter);
+}
+
+static void writer_key(SpecEmitter* emitter, const char* key) {
+    YamlWriter* writer = (YamlWriter*)emitter;
+    if (writer->depth == 0) return;
+    begin_entry(writer);
+    write_scalar(writer->sink, key);
+    output_sink_putc(writer->sink, ':');
+    writer->after_key = 1;
+}
+
+static void writer_string(SpecEmitter* emitter, const char* value) {
+    YamlWriter* writer = (YamlWriter*)emitter;
+    begin_value(writer);
+    write_scalar(writer->sink, value);
+}
+
+static void writer_boolean(SpecEmitter* emitter, int value) {
+    YamlWriter* writer = (YamlWriter*)emitter;
+    begin_value(writer);
+    output_sink_puts(writer->sink, value ? "true" : "false");
+}
+
+static void writer_integer(SpecEmitter* emitter, long long value) {
+    YamlWriter* writer = (YamlWriter*)emitter;
+    begin_value(writer);
+    char digits[24];
+    int len = snprintf(digits, sizeof(digits), "%lld", value);
+    output_sink_write(writer->sink, digits, len);
+}
+
+// A value after a key only reads the indentation of the frames around it
+static SpecEmitter* writer_fork(const SpecEmitter* emitter, void* copy, OutputSink* sink) {
+    YamlWriter* writer = memcpy(copy, emitter, sizeof(YamlWriter));
+    writer->sink = sink;
+    return &writer->emitter;
+}
+
+static void writer_splice(SpecEmitter* emitter, const char* data, size_t size) {
+    YamlWriter* writer = (YamlWriter*)emitter;
+    writer->after_key = 0;
+    output_sink_write(writer->sink, data, size);
+}
+
+void yaml_writer_init(YamlWriter* writer, OutputSink* sink) {
+    memset(writer, 0, sizeof(YamlWriter));
+    writer->emitter.begin_object = writer_begin_object;
+    writer->emitter.end_object = writer_end;
+    writer->emitter.begin_array = writer_begin_array;
+    writer->emitter.end_array = writer_end;
+    writer->emitter.key = writer_key;
+    writer->emitter.string = writer_string;
+    writer->emitter.boolean = writer_boolean;
+    writer->emitter.integer = writer_integer;
+    writer->emitter.fork_size = sizeof(YamlWriter);
+    writer->emitter.fork = writer_fork;
+    writer->emitter.splice = writer_splice;
+    writer->sink = sink;
+}
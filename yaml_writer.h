@@ -0,0 +1,31 @@
+#ifndef YAML_WRITER_H
+#define YAML_WRITER_H
+
+#include "output_sink.h"
+#include "spec_emitter.h"
+
+#define YAML_WRITER_MAX_DEPTH 32
+
+typedef struct {
+    int is_array;
+    int count;     // Entries written so far
+    int indent;    // Column of the entries
+    int same_line; // The first entry continues the current line ("- " or the document start)
+    int after_key; // Opened as the value of a key, so "{}" and "[]" need a space
+} YamlFrame;
+
+// Streams block-style YAML into a sink. Nothing is buffered: an entry is
+// written as soon as its event arrives, empty containers become {} and [],
+// and strings are quoted whenever a plain scalar could be read as
+// something else.
+typedef struct {
+    SpecEmitter emitter;
+    OutputSink* sink;
+    int depth;
+    YamlFrame frames[YAML_WRITER_MAX_DEPTH];
+    int after_key;
+} YamlWriter;
+
+void yaml_writer_init(YamlWriter* writer, OutputSink* sink);
+
+#endif